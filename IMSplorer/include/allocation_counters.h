@@ -0,0 +1,35 @@
+#pragma once
+
+#include "pch.h"
+
+// Define IMS_DISABLE_ALLOCATION_COUNTERS to keep the default operator new, the counters then stay at zero
+
+namespace IMS {
+	struct AllocationStats {
+		uint64_t count = 0; // Allocations
+		uint64_t bytes = 0; // Requested, frees aren't tracked
+
+		AllocationStats operator-(const AllocationStats& other) const { return { this->count - other.count, this->bytes - other.bytes }; }
+	};
+
+	/// <summary>
+	/// Heap allocations made by the calling thread since it started, through operator new or ImGui's allocator.
+	/// Two reads around a piece of code tell what it allocated, other threads don't interfere.
+	/// </summary>
+	AllocationStats ThreadAllocations();
+
+	/// <summary>
+	/// Heap allocations made by every thread since the process started
+	/// </summary>
+	AllocationStats TotalAllocations();
+
+	/// <summary>
+	/// Route ImGui's allocations through the counters. Call before anything is allocated through ImGui.
+	/// </summary>
+	void CountImGuiAllocations();
+
+	/// <summary>
+	/// Whether the counters are compiled in
+	/// </summary>
+	bool AllocationCountersEnabled();
+} // namespace IMS
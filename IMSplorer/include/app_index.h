@@ -0,0 +1,277 @@
+#pragma once
+
+#include "pch.h"
+
+#include "dir_watcher.h"
+#include "path_utf8.h"
+#include "shell_link.h"
+
+namespace IMS {
+	static constexpr uint32_t kNoDirectory = UINT32_MAX;
+
+	/// <summary>
+	/// Compact record for a single Start menu shortcut. The strings live in the owning snapshot's blob,
+	/// each one followed by a null terminator so they can be handed to ImGui directly.
+	/// </summary>
+	struct AppEntry {
+		uint32_t nameOffset = 0;  // Display name (shortcut file name without extension)
+		uint32_t lowerOffset = 0; // Lowercased display name, same length as the display name
+		uint32_t pathOffset = 0;  // Full path of the shortcut, UTF-8
+		uint32_t directory = kNoDirectory; // Directory record the shortcut was found in
+		uint32_t targetOffset = 0;           // What the shortcut points at, empty if it couldn't be resolved
+		uint32_t argumentsOffset = 0;
+		uint32_t workingDirectoryOffset = 0;
+		uint32_t iconOffset = 0;             // Icon file, empty to use the target's
+		uint32_t lowerTargetNameOffset = 0;  // Lowercased target file name without extension, same length as the target name
+		int32_t iconIndex = 0;
+		uint32_t primary = 0;                // First entry with the same target and arguments, its own index if there's none
+		uint16_t nameLength = 0;
+		uint16_t pathLength = 0;
+		uint16_t targetLength = 0;
+		uint16_t argumentsLength = 0;
+		uint16_t workingDirectoryLength = 0;
+		uint16_t iconLength = 0;
+		uint16_t targetNameStart = 0;        // The target name is the part of the target at [start, start + length)
+		uint16_t targetNameLength = 0;
+	};
+
+	/// <summary>
+	/// A scanned folder and its modification time. Records are stored depth first,
+	/// so a directory's subtree is the range up to subtreeEnd.
+	/// </summary>
+	struct AppDirectory {
+		uint32_t pathOffset = 0;
+		uint32_t pathLength = 0;
+		int64_t modified = 0;             // Last write time in file clock ticks, changes when direct children are added, removed or renamed
+		uint32_t parent = kNoDirectory;
+		uint32_t subtreeEnd = 0;          // One past the last descendant
+	};
+
+	/// <summary>
+	/// Immutable view of the application index. Entries are sorted by their lowercased display name,
+	/// and the lowercased names are packed back to back at the start of the blob so searches can scan them linearly,
+	/// followed by the lowercased target names in the same way.
+	/// The records either live in memory owned by the snapshot or point straight into a mapped index file.
+	/// </summary>
+	class AppSnapshot {
+	public:
+		size_t Size() const { return this->entries.size(); }
+		bool Empty() const { return this->entries.empty(); }
+
+		std::string_view Name(size_t i) const { return { this->blob.data() + this->entries[i].nameOffset, this->entries[i].nameLength }; }
+		std::string_view LowerName(size_t i) const { return { this->blob.data() + this->entries[i].lowerOffset, this->entries[i].nameLength }; }
+		std::string_view Path(size_t i) const { return { this->blob.data() + this->entries[i].pathOffset, this->entries[i].pathLength }; }
+		const char* NameCStr(size_t i) const { return this->blob.data() + this->entries[i].nameOffset; }
+
+		std::string_view Target(size_t i) const { return { this->blob.data() + this->entries[i].targetOffset, this->entries[i].targetLength }; }
+		std::string_view Arguments(size_t i) const { return { this->blob.data() + this->entries[i].argumentsOffset, this->entries[i].argumentsLength }; }
+		std::string_view WorkingDirectory(size_t i) const { return { this->blob.data() + this->entries[i].workingDirectoryOffset, this->entries[i].workingDirectoryLength }; }
+		std::string_view IconLocation(size_t i) const { return { this->blob.data() + this->entries[i].iconOffset, this->entries[i].iconLength }; }
+		int32_t IconIndex(size_t i) const { return this->entries[i].iconIndex; }
+		const char* TargetCStr(size_t i) const { return this->blob.data() + this->entries[i].targetOffset; }
+
+		std::string_view TargetName(size_t i) const { return this->Target(i).substr(this->entries[i].targetNameStart, this->entries[i].targetNameLength); }
+		std::string_view LowerTargetName(size_t i) const { return { this->blob.data() + this->entries[i].lowerTargetNameOffset, this->entries[i].targetNameLength }; }
+
+		/// <summary>
+		/// An earlier entry launches the same thing (see Primary), only one of them gets listed
+		/// </summary>
+		bool IsDuplicate(size_t i) const { return this->entries[i].primary != i; }
+		uint32_t Primary(size_t i) const { return this->entries[i].primary; }
+
+		/// <summary>
+		/// The resolved shortcut, relativePath isn't kept
+		/// </summary>
+		ShellLink Link(size_t i) const;
+
+		std::string_view DirectoryPath(size_t i) const { return { this->blob.data() + this->directories[i].pathOffset, this->directories[i].pathLength }; }
+
+		/// <summary>
+		/// Every lowercased name, in entry order, separated by null terminators
+		/// </summary>
+		std::string_view LowerNames() const { return { this->blob.data(), this->lowerNamesSize }; }
+
+		/// <summary>
+		/// Every lowercased target name, in entry order, separated by null terminators
+		/// </summary>
+		std::string_view LowerTargetNames() const { return { this->blob.data() + this->lowerNamesSize, this->lowerTargetNamesSize }; }
+
+		std::span<const AppEntry> Entries() const { return this->entries; }
+		std::span<const AppDirectory> Directories() const { return this->directories; }
+		std::string_view Blob() const { return this->blob; }
+
+	private:
+		friend class AppSnapshotBuilder;
+		friend std::shared_ptr<const AppSnapshot> LoadAppIndex(const std::filesystem::path& path);
+
+		std::shared_ptr<const void> storage; // Keeps the records alive (owned buffers or the file mapping)
+		std::span<const AppEntry> entries;
+		std::span<const AppDirectory> directories;
+		std::string_view blob;
+		size_t lowerNamesSize = 0;
+		size_t lowerTargetNamesSize = 0;
+	};
+
+	/// <summary>
+	/// Collects shortcuts and packs them into an AppSnapshot
+	/// </summary>
+	class AppSnapshotBuilder {
+	public:
+		/// <summary>
+		/// Open a directory record, shortcuts added until the matching EndDirectory belong to it.
+		/// Directories nest, a directory opened inside another one is its child.
+		/// </summary>
+		void BeginDirectory(std::string_view path, int64_t modified);
+		void EndDirectory();
+
+		void Add(std::string_view name, std::string_view path, ShellLink link = {});
+
+		/// <summary>
+		/// Add a shortcut whose target still has to be read, see ResolveShortcuts
+		/// </summary>
+		void AddShortcut(std::string_view name, std::string_view path);
+
+		/// <summary>
+		/// Parse every shortcut added with AddShortcut, spread over the hardware threads
+		/// </summary>
+		/// <returns>Number of shortcuts parsed</returns>
+		size_t ResolveShortcuts();
+
+		/// <summary>
+		/// Sort, mark duplicates and pack everything added so far
+		/// </summary>
+		std::shared_ptr<const AppSnapshot> Build();
+
+	private:
+		struct Pending {
+			std::string name;
+			std::string lower;
+			std::string path;
+			ShellLink link;
+			uint32_t directory = kNoDirectory;
+			bool resolve = false;
+		};
+
+		struct PendingDirectory {
+			std::string path;
+			int64_t modified = 0;
+			uint32_t parent = kNoDirectory;
+			uint32_t subtreeEnd = 0;
+		};
+
+		std::vector<Pending> pending;
+		std::vector<PendingDirectory> directories;
+		std::vector<uint32_t> open; // Directories that haven't ended yet, innermost last
+	};
+
+	/// <summary>
+	/// Walks Start menu folders into a builder. Given the previous snapshot, folders whose modification
+	/// time still matches aren't listed again: their shortcuts and subfolders are carried over and only
+	/// the subfolders get checked in turn, so a refresh costs a stat per folder unless something changed.
+	/// </summary>
+	class ShortcutScanner {
+	public:
+		explicit ShortcutScanner(std::shared_ptr<const AppSnapshot> previous = nullptr);
+
+		/// <returns>Number of shortcuts found under root</returns>
+		size_t Scan(const std::filesystem::path& root, AppSnapshotBuilder& builder);
+
+		/// <summary>
+		/// Folders that had to be listed (new or modified)
+		/// </summary>
+		size_t Rescanned() const { return this->rescanned; }
+
+		/// <summary>
+		/// Folders carried over from the previous snapshot
+		/// </summary>
+		size_t Reused() const { return this->reused; }
+
+	private:
+		size_t Walk(const std::filesystem::path& path, AppSnapshotBuilder& builder);
+
+		std::shared_ptr<const AppSnapshot> previous;
+		std::unordered_map<std::string_view, uint32_t> previousDirectories; // Path -> directory record
+		std::vector<uint32_t> entriesByDirectory;                           // Entry indices grouped by directory
+		std::vector<uint32_t> directoryStart;                               // Directory -> first index in entriesByDirectory
+
+		size_t rescanned = 0;
+		size_t reused = 0;
+	};
+
+	/// <summary>
+	/// Index of the shortcuts in the Start menu folders. Scanning happens off the render loop,
+	/// the render loop only ever reads the latest published snapshot.
+	/// With a cache path, the index is persisted and mapped back in on the next start.
+	/// </summary>
+	class AppIndex {
+	public:
+		AppIndex();
+		~AppIndex();
+
+		/// <summary>
+		/// The machine wide and per-user Start menu folders
+		/// </summary>
+		static std::vector<std::filesystem::path> DefaultRoots();
+
+		/// <summary>
+		/// Where the index is persisted, set before the first scan. `path` is a small file naming the current
+		/// generation, every save goes to a new file next to it (appindex.current -> appindex.<n>.bin): Windows
+		/// won't replace a file while it's mapped, and the published snapshot maps the last one.
+		/// </summary>
+		void SetCachePath(std::filesystem::path path) { this->cachePath = std::move(path); }
+
+		/// <summary>
+		/// Map the persisted index and publish it as is, a following Scan only rescans stale folders
+		/// </summary>
+		/// <returns>False if there's no usable index file</returns>
+		bool Load();
+
+		/// <summary>
+		/// Refresh from every root and publish a fresh snapshot (blocking).
+		/// Persists the result if anything changed.
+		/// </summary>
+		void Scan(const std::vector<std::filesystem::path>& roots);
+
+		/// <summary>
+		/// Same as Scan, but on a background thread. Ignored if a scan is already running.
+		/// </summary>
+		/// <param name="onDone">Called on the background thread once the new snapshot is published</param>
+		void ScanAsync(const std::vector<std::filesystem::path>& roots, std::function<void()> onDone = nullptr);
+
+		/// <summary>
+		/// Apply a batch from a DirWatcher: only the shortcuts and folders it names are touched, new folders get listed.
+		/// An overflowed batch falls back to a single Scan of the roots, which still only lists folders whose modification time moved.
+		/// Persists the result if anything changed.
+		/// </summary>
+		/// <returns>True if a new snapshot was published</returns>
+		bool ApplyChanges(const FileChangeBatch& batch, const std::vector<std::filesystem::path>& roots);
+
+		std::shared_ptr<const AppSnapshot> Snapshot() const { return this->snapshot.load(std::memory_order_acquire); }
+
+		/// <summary>
+		/// Replace the snapshot with one built elsewhere (e.g. a synthetic one for benchmarks)
+		/// </summary>
+		void Publish(std::shared_ptr<const AppSnapshot> snapshot) { this->snapshot.store(std::move(snapshot), std::memory_order_release); }
+
+	private:
+		bool ScanLocked(const std::vector<std::filesystem::path>& roots);
+		void Persist(const AppSnapshot& snapshot);
+		std::filesystem::path GenerationPath(uint64_t generation) const;
+		void RemoveOldGenerations();
+
+		std::atomic<std::shared_ptr<const AppSnapshot>> snapshot;
+		std::mutex writeMutex; // Serializes scans and applied changes, readers never take it
+		std::atomic<bool> scanning = false;
+		std::filesystem::path cachePath;
+		uint64_t generation = 0; // Index file cachePath names, 0 for none
+		bool persisted = false;  // The cache file matches the published snapshot
+		std::jthread worker;
+	};
+
+	/// <summary>
+	/// ASCII lowercase, multi-byte UTF-8 sequences are left untouched
+	/// </summary>
+	inline char ToLowerAscii(char c) {
+		return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+	}
+} // namespace IMS
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "pch.h"
+
+#include "app_index.h"
+
+namespace IMS {
+	/// <summary>
+	/// On-disk layout of the persisted Start menu index, native endianness:
+	/// header, directory records, entry records, string blob. The records are the in-memory
+	/// AppDirectory/AppEntry structs, so a mapped file is used as is.
+	/// </summary>
+	struct AppIndexFileHeader {
+		static constexpr char kMagic[8] = { 'I', 'M', 'S', 'A', 'P', 'P', 'I', 'X' };
+		static constexpr uint32_t kVersion = 2;
+
+		char magic[8] = {};
+		uint32_t version = 0;
+		uint32_t headerSize = 0;    // sizeof(AppIndexFileHeader)
+		uint32_t directorySize = 0; // sizeof(AppDirectory), catches layout changes the version bump missed
+		uint32_t entrySize = 0;     // sizeof(AppEntry)
+		uint32_t directoryCount = 0;
+		uint32_t entryCount = 0;
+		uint64_t lowerNamesSize = 0;
+		uint64_t lowerTargetNamesSize = 0;
+		uint64_t blobSize = 0;
+		uint64_t fileSize = 0;
+		uint64_t checksum = 0;      // FNV-1a over everything after the header
+	};
+
+	/// <summary>
+	/// Write the snapshot to `path` (atomically replaced)
+	/// </summary>
+	bool SaveAppIndex(const AppSnapshot& snapshot, const std::filesystem::path& path);
+
+	/// <summary>
+	/// Map an index file. Every count, offset and string is bounds checked against the file and the
+	/// checksum has to match, anything truncated, corrupted or from another version is rejected.
+	/// </summary>
+	/// <returns>A snapshot backed by the mapping, nullptr if the file is missing or invalid</returns>
+	std::shared_ptr<const AppSnapshot> LoadAppIndex(const std::filesystem::path& path);
+} // namespace IMS
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "pch.h"
+
+#include "app_index.h"
+#include "frame_scheduler.h"
+#include "launch_history.h"
+
+namespace IMS {
+	struct SearchResult {
+		uint32_t index = 0; // Entry index in the AppSnapshot
+		int32_t score = 0;
+	};
+
+	static constexpr int32_t kNoMatch = INT32_MIN;
+
+	/// <summary>
+	/// Score a name against a query, the query must be lowercased already.
+	/// Every query character has to appear in order (subsequence), matches on word boundaries,
+	/// consecutive matches and prefixes score higher, gaps score lower.
+	/// </summary>
+	/// <param name="name">Original display name, used to detect camelCase boundaries</param>
+	/// <param name="lower">Lowercased display name</param>
+	/// <param name="query">Lowercased query</param>
+	/// <returns>The score, or kNoMatch</returns>
+	int32_t FuzzyScore(std::string_view name, std::string_view lower, std::string_view query);
+
+	/// <summary>
+	/// Append every entry whose lowercased name or target name contains `c` to `out`, in entry order
+	/// (SSE2 scan over AppSnapshot::LowerNames and LowerTargetNames when available)
+	/// </summary>
+	void FilterByChar(const AppSnapshot& apps, char c, std::vector<uint32_t>& out);
+
+	/// <summary>
+	/// Ranked fuzzy search over an AppSnapshot by display name or target file name, shortcuts to the same program show up once.
+	/// Results are cached, so querying with the same text every frame costs nothing, and a query that
+	/// extends the previous one only rescores the previous candidates instead of the whole index.
+	/// With a launch history, apps that get launched often and lately score higher.
+	/// </summary>
+	class AppSearch {
+	public:
+		static constexpr size_t kRecentCount = 8;
+
+		/// <summary>
+		/// Search for `query` and return the best `limit` results, highest score first.
+		/// An empty query returns the kRecentCount most frecent apps, then the rest in index order.
+		/// </summary>
+		const std::vector<SearchResult>& Query(const std::shared_ptr<const AppSnapshot>& apps, std::string_view query, size_t limit);
+
+		/// <summary>
+		/// Rank by launches too, both have to outlive the search
+		/// </summary>
+		/// <param name="clock">What launches decay against, the one they're recorded with</param>
+		void SetHistory(const LaunchHistory* history, const IClock* clock) {
+			this->history = history;
+			this->clock = clock;
+			this->valid = false;
+		}
+
+		const std::vector<SearchResult>& Results() const { return this->results; }
+
+		/// <summary>
+		/// Number of entries matching the last query, can be more than the number of results
+		/// </summary>
+		size_t MatchCount() const { return this->candidates.size(); }
+
+	private:
+		void Rank(const AppSnapshot& apps, size_t limit);
+		void MapHistory(const AppSnapshot& apps);
+		int32_t Boost(uint32_t primary) const;
+
+		std::shared_ptr<const AppSnapshot> apps;
+		std::string lastQuery;
+		std::string lowerQuery;
+		size_t lastLimit = 0;
+		bool valid = false;
+
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> scratch;
+		std::vector<SearchResult> results;
+		std::unordered_set<uint32_t> seenPrimaries;
+
+		const LaunchHistory* history = nullptr;
+		const IClock* clock = nullptr;
+		uint64_t historyGeneration = 0;
+		bool keyed = false;                           // `keys` is for the current snapshot
+		std::unordered_map<uint64_t, uint32_t> keys;  // LaunchHistory::Key of each entry's path -> its primary entry
+		std::unordered_map<uint32_t, int32_t> boosts; // Primary entry -> frecency bonus
+	};
+} // namespace IMS
@@ -0,0 +1,326 @@
+#pragma once
+
+#include "pch.h"
+
+#include <bit>
+#include <tuple>
+#include <spdlog/details/os.h>
+
+#include "spsc_queue.h" // kCacheLine
+
+// IMS_LOG_LEVEL is the lowest level compiled in, one of the IMS_LOG_LEVEL_ values. Calls below it leave nothing
+// in the binary, their arguments aren't even evaluated. Everything in debug builds, info and up otherwise.
+#define IMS_LOG_LEVEL_TRACE 0
+#define IMS_LOG_LEVEL_DEBUG 1
+#define IMS_LOG_LEVEL_INFO 2
+#define IMS_LOG_LEVEL_WARN 3
+#define IMS_LOG_LEVEL_ERROR 4
+#define IMS_LOG_LEVEL_OFF 6
+
+#ifndef IMS_LOG_LEVEL
+#ifdef NDEBUG
+#define IMS_LOG_LEVEL IMS_LOG_LEVEL_INFO
+#else
+#define IMS_LOG_LEVEL IMS_LOG_LEVEL_TRACE
+#endif
+#endif
+
+namespace IMS {
+	/// <summary>
+	/// A log call's level and location, one per call site in static storage
+	/// </summary>
+	struct LogSite {
+		spdlog::level::level_enum level;
+		const char* file;
+		int line;
+	};
+
+	/// <summary>
+	/// Logging for hot paths (window procedure, keyboard hook, render loop). A call only copies its arguments
+	/// into a slot of a bounded lock-free ring, formatting and writing happen on a background thread that
+	/// drains the ring into a spdlog sink (a rotating file by default). When the ring is full the message is
+	/// dropped and counted, the drain thread reports drops in the log. Any thread may log.
+	/// The drain thread sleeps without a timer while nothing is logged, the first message wakes it.
+	/// Arguments are copied byte for byte, so they have to be trivially copyable or strings. Strings are
+	/// copied too and cut short once a slot is full.
+	/// </summary>
+	class AsyncLog {
+	public:
+		static constexpr size_t kSlotSize = 256;
+		static constexpr size_t kCapacity = 1 << 13; // Slots, 2 MB
+		static constexpr size_t kMaxFileSize = 8 * 1024 * 1024;
+		static constexpr size_t kMaxFiles = 3;
+		static constexpr std::chrono::milliseconds kBatchInterval{ 10 }; // A burst piles up this long (or until the ring is half full) before it's written
+
+		static AsyncLog& Get();
+
+		~AsyncLog();
+
+		AsyncLog(const AsyncLog&) = delete;
+		AsyncLog& operator=(const AsyncLog&) = delete;
+
+		/// <summary>
+		/// Start draining into `sink`, which formats (with its own pattern) and writes, only ever from the drain
+		/// thread. Messages logged while stopped are ignored, not counted as dropped.
+		/// </summary>
+		/// <param name="capacity">Slots, a power of two</param>
+		/// <returns>False if it's running already</returns>
+		bool Start(spdlog::sink_ptr sink, size_t capacity = kCapacity);
+
+		/// <summary>
+		/// Start draining into a rotating file: `path`, then path.1 up to kMaxFiles, kMaxFileSize each
+		/// </summary>
+		bool Start(const std::filesystem::path& path, size_t capacity = kCapacity);
+
+		/// <summary>
+		/// Write out what's in the ring and stop the thread. A call racing with Stop may be lost, but the ring
+		/// it writes into stays allocated until the log is destroyed.
+		/// </summary>
+		void Stop();
+
+		bool Running() const { return this->ring.load(std::memory_order_relaxed) != nullptr; }
+
+		/// <summary>
+		/// Runtime threshold on top of IMS_LOG_LEVEL
+		/// </summary>
+		void SetLevel(spdlog::level::level_enum level) { this->level.store(level, std::memory_order_relaxed); }
+
+		/// <summary>
+		/// Wait until everything logged before the call is in the sink, and flush it
+		/// </summary>
+		void Flush();
+
+		/// <summary>
+		/// Use the IMS_LOG_ macros, they fill in the call site and compile out below IMS_LOG_LEVEL
+		/// </summary>
+		template <typename... Args>
+		void Write(const LogSite& site, fmt::format_string<Args...> format, Args&&... args) {
+			Ring* ring = this->ring.load(std::memory_order_acquire);
+			if (!ring || site.level < this->level.load(std::memory_order_relaxed)) return;
+
+			static_assert(kFixedSize<Args...> <= kPayloadSize, "Too many arguments for a log slot");
+			static_assert((kEncodable<Args> && ...), "Log arguments have to be trivially copyable or strings");
+
+			uint64_t position = 0;
+			Slot* slot = Claim(*ring, position);
+			if (!slot) return;
+
+			// Strings share what's left after the fixed size arguments
+			uint8_t* cursor = slot->payload;
+			size_t room = kPayloadSize - kFixedSize<Args...>;
+			bool truncated = false;
+			(Encode(cursor, room, truncated, args), ...);
+
+			fmt::string_view view = format;
+			slot->header.site = &site;
+			slot->header.decode = &Decode<Args...>;
+			slot->header.format = view.data();
+			slot->header.formatSize = (uint32_t)view.size();
+			slot->header.time = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+			slot->header.thread = (uint32_t)spdlog::details::os::thread_id();
+			slot->header.truncated = truncated;
+
+			slot->sequence.store(position + 1, std::memory_order_release);
+
+			// Pairs with the fence in Work: either the drain thread sees this message before it goes to sleep,
+			// or this sees that it's waiting for it
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (position >= this->wakeAt.load(std::memory_order_relaxed))
+				this->Wake();
+		}
+
+		/// <summary>
+		/// Messages taken by the drain thread, dropped because the ring was full, and cut short
+		/// </summary>
+		uint64_t Written() const { return this->written.load(std::memory_order_relaxed); }
+		uint64_t Dropped() const { return this->dropped.load(std::memory_order_relaxed); }
+		uint64_t Truncated() const { return this->truncated.load(std::memory_order_relaxed); }
+
+	private:
+		using Decoder = void (*)(const uint8_t* payload, fmt::string_view format, spdlog::memory_buf_t& out);
+
+		struct Header {
+			const LogSite* site;
+			Decoder decode;
+			const char* format; // The literal at the call site
+			uint64_t time;      // steady_clock ticks
+			uint32_t formatSize;
+			uint32_t thread;
+			bool truncated;
+		};
+
+		static constexpr size_t kPayloadSize = kSlotSize - sizeof(std::atomic<uint64_t>) - sizeof(Header);
+
+		// Ring position + 1 once written, position + capacity once drained (free again)
+		struct alignas(kCacheLine) Slot {
+			std::atomic<uint64_t> sequence = 0;
+			Header header;
+			uint8_t payload[kPayloadSize];
+		};
+		static_assert(sizeof(Slot) == kSlotSize);
+
+		/// <summary>
+		/// The slots and the producers' position, replaced as a whole on every Start
+		/// </summary>
+		struct Ring {
+			explicit Ring(size_t capacity) : slots(std::make_unique<Slot[]>(capacity)), mask(capacity - 1) {
+				for (size_t i = 0; i < capacity; i++)
+					this->slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+
+			alignas(kCacheLine) std::atomic<uint64_t> enqueue = 0;
+			std::unique_ptr<Slot[]> slots;
+			uint64_t mask = 0;
+		};
+
+		static constexpr uint64_t kAwake = UINT64_MAX; // wakeAt while the drain thread isn't waiting for messages
+
+		// Strings are stored as a 16-bit length and their bytes, everything else as it is in memory
+		template <typename T>
+		using Stored = std::conditional_t<std::is_convertible_v<const std::decay_t<T>&, std::string_view>, std::string_view, std::decay_t<T>>;
+
+		template <typename T>
+		static constexpr bool kEncodable = std::is_same_v<Stored<T>, std::string_view> || std::is_trivially_copyable_v<Stored<T>>;
+
+		template <typename T>
+		static constexpr size_t kEncodedSize = std::is_same_v<Stored<T>, std::string_view> ? sizeof(uint16_t) : sizeof(Stored<T>);
+
+		template <typename... Args>
+		static constexpr size_t kFixedSize = (size_t(0) + ... + kEncodedSize<Args>);
+
+		template <typename T>
+		static void Encode(uint8_t*& cursor, size_t& room, bool& truncated, const T& value) {
+			if constexpr (std::is_same_v<Stored<T>, std::string_view>) {
+				std::string_view text;
+				if constexpr (std::is_pointer_v<T>) {
+					if (value) text = value;
+				}
+				else {
+					text = value;
+				}
+
+				uint16_t size = (uint16_t)(std::min)(text.size(), room);
+				truncated = truncated || size < text.size();
+				std::memcpy(cursor, &size, sizeof(size));
+				std::memcpy(cursor + sizeof(size), text.data(), size);
+				cursor += sizeof(size) + size;
+				room -= size;
+			}
+			else {
+				std::memcpy(cursor, &value, sizeof(Stored<T>));
+				cursor += sizeof(Stored<T>);
+			}
+		}
+
+		template <typename T>
+		static Stored<T> DecodeOne(const uint8_t*& cursor) {
+			if constexpr (std::is_same_v<Stored<T>, std::string_view>) {
+				uint16_t size = 0;
+				std::memcpy(&size, cursor, sizeof(size));
+				std::string_view text((const char*)cursor + sizeof(size), size);
+				cursor += sizeof(size) + size;
+				return text;
+			}
+			else {
+				std::array<uint8_t, sizeof(Stored<T>)> bytes;
+				std::memcpy(bytes.data(), cursor, bytes.size());
+				cursor += bytes.size();
+				return std::bit_cast<Stored<T>>(bytes);
+			}
+		}
+
+		template <typename... Args>
+		static void Decode(const uint8_t* payload, fmt::string_view format, spdlog::memory_buf_t& out) {
+			// Braced, so the arguments are read in order
+			std::tuple<Stored<Args>...> values{ DecodeOne<Args>(payload)... };
+			std::apply([&](const auto&... value) { fmt::vformat_to(std::back_inserter(out), format, fmt::make_format_args(value...)); }, values);
+		}
+
+		AsyncLog() = default;
+
+		Slot* Claim(Ring& ring, uint64_t& position) {
+			position = ring.enqueue.load(std::memory_order_relaxed);
+			for (;;) {
+				Slot& slot = ring.slots[position & ring.mask];
+				int64_t lag = (int64_t)(slot.sequence.load(std::memory_order_acquire) - position);
+				if (lag == 0) {
+					if (ring.enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) return &slot;
+				}
+				else if (lag < 0) {
+					// Still holds a message the drain thread hasn't taken
+					this->dropped.fetch_add(1, std::memory_order_relaxed);
+					return nullptr;
+				}
+				else {
+					position = ring.enqueue.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		void Wake();
+		bool Pending() const;
+		size_t Drain();
+		void ReportDrops();
+		void Work(std::stop_token stop);
+
+		alignas(kCacheLine) std::atomic<Ring*> ring = nullptr; // Null while stopped
+		std::atomic<int> level = spdlog::level::trace;
+		alignas(kCacheLine) std::atomic<uint64_t> wakeAt = kAwake; // Position whose commit wakes the drain thread
+		std::vector<std::unique_ptr<Ring>> rings; // Every ring started, kept until destruction
+
+		// Drain thread
+		alignas(kCacheLine) Ring* draining = nullptr;
+		uint64_t dequeue = 0;
+		spdlog::sink_ptr sink;
+		spdlog::memory_buf_t buffer;
+		uint64_t reportedDrops = 0;
+		std::chrono::system_clock::time_point systemEpoch;
+		std::chrono::steady_clock::time_point steadyEpoch;
+
+		std::atomic<uint64_t> written = 0;
+		std::atomic<uint64_t> dropped = 0;
+		std::atomic<uint64_t> truncated = 0;
+
+		std::mutex mutex;
+		std::condition_variable_any wake;
+		uint64_t drainedTo = 0; // dequeue as of the last pass, for Flush
+		bool flushRequested = false;
+		std::jthread thread; // Last, so it stops before the rest goes away
+	};
+} // namespace IMS
+
+#define IMS_LOG_CALL(level, ...) \
+	do { \
+		static constexpr ::IMS::LogSite imsLogSite{ level, __FILE__, __LINE__ }; \
+		::IMS::AsyncLog::Get().Write(imsLogSite, __VA_ARGS__); \
+	} while (0)
+
+#if IMS_LOG_LEVEL <= IMS_LOG_LEVEL_TRACE
+#define IMS_LOG_TRACE(...) IMS_LOG_CALL(::spdlog::level::trace, __VA_ARGS__)
+#else
+#define IMS_LOG_TRACE(...) ((void)0)
+#endif
+
+#if IMS_LOG_LEVEL <= IMS_LOG_LEVEL_DEBUG
+#define IMS_LOG_DEBUG(...) IMS_LOG_CALL(::spdlog::level::debug, __VA_ARGS__)
+#else
+#define IMS_LOG_DEBUG(...) ((void)0)
+#endif
+
+#if IMS_LOG_LEVEL <= IMS_LOG_LEVEL_INFO
+#define IMS_LOG_INFO(...) IMS_LOG_CALL(::spdlog::level::info, __VA_ARGS__)
+#else
+#define IMS_LOG_INFO(...) ((void)0)
+#endif
+
+#if IMS_LOG_LEVEL <= IMS_LOG_LEVEL_WARN
+#define IMS_LOG_WARN(...) IMS_LOG_CALL(::spdlog::level::warn, __VA_ARGS__)
+#else
+#define IMS_LOG_WARN(...) ((void)0)
+#endif
+
+#if IMS_LOG_LEVEL <= IMS_LOG_LEVEL_ERROR
+#define IMS_LOG_ERROR(...) IMS_LOG_CALL(::spdlog::level::err, __VA_ARGS__)
+#else
+#define IMS_LOG_ERROR(...) ((void)0)
+#endif
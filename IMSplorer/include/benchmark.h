@@ -0,0 +1,29 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	/// <summary>
+	/// Time the startup, font, Start menu scan, history, window registry, hotkey, resource sampler, search, logging and trace subsystems on synthetic data, then frame builds
+	/// of the taskbar on the headless platform: 10 to 10k windows, Start menus of 100 to 100k entries, the Run mode.
+	/// A warmed up frame must not allocate from the heap. Results are logged.
+	/// </summary>
+	/// <param name="frames">Measured frames per scenario</param>
+	/// <returns>Process exit code, non-zero if a check failed or a scenario didn't draw anything or allocated</returns>
+	int RunBenchmarks(size_t frames = 500);
+
+	/// <summary>
+	/// Replay a trace recorded with --record on the headless platform, as fast as it goes, and log frame times
+	/// and how long shell events, hook keys and UI input took to reach a frame, as recorded and as replayed
+	/// </summary>
+	/// <returns>Process exit code, non-zero if the trace can't be read</returns>
+	int ReplayTrace(const std::filesystem::path& path);
+
+	/// <summary>
+	/// Time ParseShellLink over every file under `corpus` (e.g. a copy of a Start menu), then parse every
+	/// truncation and single byte corruption of each file to shake out bounds checking mistakes. Results are logged.
+	/// </summary>
+	/// <param name="iterations">Times every file is parsed for the timing</param>
+	/// <returns>Process exit code, non-zero if the corpus is empty</returns>
+	int RunShellLinkBenchmark(const std::filesystem::path& corpus, size_t iterations = 100);
+} // namespace IMS
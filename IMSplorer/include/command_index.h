@@ -0,0 +1,173 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	/// <summary>
+	/// Radix trie over sorted, unique keys, mapping a prefix to the range of keys starting with it.
+	/// Nodes are stored breadth first so siblings sit next to each other, with their first label
+	/// characters in a separate array: picking a child is a memchr over a few bytes, and a lookup
+	/// touches one node per edge, so it scales with the length of the prefix rather than the key count.
+	/// Keys are expected lowercased, lookups fold ASCII case.
+	/// </summary>
+	class PrefixTrie {
+	public:
+		struct Range {
+			uint32_t begin = 0;
+			uint32_t end = 0;
+
+			size_t Size() const { return this->end - this->begin; }
+			bool Empty() const { return this->begin == this->end; }
+		};
+
+		/// <param name="keys">Sorted and unique, none longer than 65535 bytes</param>
+		void Build(std::span<const std::string_view> keys);
+
+		/// <summary>
+		/// Keys starting with `prefix` (compared case-insensitively), every key for an empty prefix
+		/// </summary>
+		Range Find(std::string_view prefix) const;
+
+		size_t NodeCount() const { return this->nodes.size(); }
+		size_t MemoryUsage() const { return this->nodes.size() * (sizeof(Node) + 1) + this->labels.size(); }
+
+	private:
+		struct Node {
+			uint32_t labelOffset = 0; // Edge label from the parent, in `labels`
+			uint32_t firstChild = 0;
+			uint32_t begin = 0;       // Keys under the node
+			uint32_t end = 0;
+			uint16_t labelLength = 0;
+			uint16_t childCount = 0;
+		};
+
+		std::vector<Node> nodes;      // nodes[0] is the root
+		std::vector<char> firstChars; // First label character of every node
+		std::string labels;
+	};
+
+	/// <summary>
+	/// Where executables are looked for. Directories are searched in order, the first one with a name wins.
+	/// </summary>
+	struct CommandSources {
+		std::vector<std::filesystem::path> directories;                     // PATH
+		std::vector<std::pair<std::string, std::string>> registered;        // Name -> executable, UTF-8 (Windows' App Paths)
+		std::vector<std::string> extensions;                                // Lowercased, with the dot (PATHEXT). Empty to go by the execute permission
+	};
+
+	struct CommandEntry {
+		uint32_t nameOffset = 0;  // File name, as found
+		uint32_t lowerOffset = 0; // Lowercased file name, same length
+		uint32_t pathOffset = 0;  // Full path, UTF-8
+		uint16_t nameLength = 0;
+		uint16_t pathLength = 0;
+	};
+
+	/// <summary>
+	/// Immutable set of executables sorted by lowercased name, with a PrefixTrie over the names.
+	/// Strings live in one blob, each followed by a null terminator so they can be handed to ImGui directly.
+	/// </summary>
+	class CommandSnapshot {
+	public:
+		size_t Size() const { return this->entries.size(); }
+		bool Empty() const { return this->entries.empty(); }
+
+		std::string_view Name(size_t i) const { return { this->blob.data() + this->entries[i].nameOffset, this->entries[i].nameLength }; }
+		std::string_view LowerName(size_t i) const { return { this->blob.data() + this->entries[i].lowerOffset, this->entries[i].nameLength }; }
+		std::string_view Path(size_t i) const { return { this->blob.data() + this->entries[i].pathOffset, this->entries[i].pathLength }; }
+		const char* NameCStr(size_t i) const { return this->blob.data() + this->entries[i].nameOffset; }
+		const char* PathCStr(size_t i) const { return this->blob.data() + this->entries[i].pathOffset; }
+
+		/// <summary>
+		/// Entries whose name starts with `prefix`, case-insensitively, in name order
+		/// </summary>
+		PrefixTrie::Range Complete(std::string_view prefix) const { return this->trie.Find(prefix); }
+
+		const PrefixTrie& Trie() const { return this->trie; }
+
+	private:
+		friend class CommandSnapshotBuilder;
+
+		std::vector<CommandEntry> entries;
+		std::string blob;
+		PrefixTrie trie;
+	};
+
+	/// <summary>
+	/// Collects executables and packs them into a CommandSnapshot
+	/// </summary>
+	class CommandSnapshotBuilder {
+	public:
+		/// <summary>
+		/// Names are case-insensitive, of several with the same name the first added is kept
+		/// </summary>
+		void Add(std::string_view name, std::string_view path);
+
+		/// <summary>
+		/// Add every executable in the sources' directories, then the registered ones
+		/// </summary>
+		/// <returns>Number of executables found</returns>
+		size_t Scan(const CommandSources& sources);
+
+		std::shared_ptr<const CommandSnapshot> Build();
+
+	private:
+		struct Pending {
+			std::string name;
+			std::string lower;
+			std::string path;
+		};
+
+		std::vector<Pending> pending;
+	};
+
+	/// <summary>
+	/// Split a PATH style list, dropping quotes, empty and repeated entries
+	/// </summary>
+	std::vector<std::filesystem::path> SplitSearchPath(std::string_view value, char separator);
+
+	/// <summary>
+	/// Executables on PATH and in App Paths, for the Start menu's Run mode. Built off the render loop,
+	/// the render loop only ever reads the latest published snapshot.
+	/// </summary>
+	class CommandIndex {
+	public:
+		CommandIndex();
+		~CommandIndex();
+
+		/// <summary>
+		/// The user's PATH as currently configured (on Windows from the registry, so changes show up without
+		/// a restart), PATHEXT and App Paths. Elsewhere the process' PATH and the execute permission.
+		/// </summary>
+		static CommandSources DefaultSources();
+
+		/// <summary>
+		/// Scan `sources` and publish the result (blocking)
+		/// </summary>
+		void Refresh(const CommandSources& sources);
+
+		/// <summary>
+		/// Same as Refresh, on a background thread. A refresh requested while one runs is done right after it.
+		/// </summary>
+		/// <param name="onDone">Called on the background thread once the new snapshot is published</param>
+		void RefreshAsync(CommandSources sources, std::function<void()> onDone = nullptr);
+
+		/// <summary>
+		/// Block until no refresh is running or queued
+		/// </summary>
+		void Wait();
+
+		std::shared_ptr<const CommandSnapshot> Snapshot() const { return this->snapshot.load(std::memory_order_acquire); }
+		void Publish(std::shared_ptr<const CommandSnapshot> snapshot) { this->snapshot.store(std::move(snapshot), std::memory_order_release); }
+
+	private:
+		std::atomic<std::shared_ptr<const CommandSnapshot>> snapshot;
+
+		std::mutex mutex;
+		std::optional<CommandSources> queued;
+		std::function<void()> onDone;
+		bool running = false;
+		std::condition_variable idle;
+		std::jthread worker;
+	};
+} // namespace IMS
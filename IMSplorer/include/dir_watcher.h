@@ -0,0 +1,178 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	enum class FileChangeType : uint8_t {
+		Added,
+		Removed,
+		Renamed,  // oldPath -> path
+		Modified,
+		Overflow, // The backend lost track, anything may have changed
+	};
+
+	struct FileChange {
+		FileChangeType type = FileChangeType::Added;
+		std::filesystem::path path;
+		std::filesystem::path oldPath;
+	};
+
+	/// <summary>
+	/// Net changes over a debounce window, in order. With overflow set the changes are
+	/// incomplete and the watched roots have to be rescanned instead.
+	/// </summary>
+	struct FileChangeBatch {
+		std::vector<FileChange> changes;
+		bool overflow = false;
+	};
+
+	/// <summary>
+	/// OS specific change notifications for a set of directory trees.
+	/// Everything but Interrupt is called from the watcher thread only.
+	/// </summary>
+	class IDirWatchBackend {
+	public:
+		virtual ~IDirWatchBackend() = default;
+
+		/// <summary>
+		/// Watch a directory and everything below it
+		/// </summary>
+		virtual bool Add(const std::filesystem::path& root) = 0;
+
+		/// <summary>
+		/// Wait up to `timeout` for notifications and append them to `out`,
+		/// milliseconds::max() waits until there are some or until Interrupt
+		/// </summary>
+		virtual void Poll(std::chrono::milliseconds timeout, std::vector<FileChange>& out) = 0;
+
+		/// <summary>
+		/// Make a blocked Poll return early, from any thread
+		/// </summary>
+		virtual void Interrupt() = 0;
+	};
+
+#ifdef _WIN32
+	/// <summary>
+	/// Overlapped ReadDirectoryChangesW, one directory handle per root
+	/// </summary>
+	class Win32DirWatchBackend : public IDirWatchBackend {
+	public:
+		Win32DirWatchBackend();
+		~Win32DirWatchBackend() override;
+
+		bool Add(const std::filesystem::path& root) override;
+		void Poll(std::chrono::milliseconds timeout, std::vector<FileChange>& out) override;
+		void Interrupt() override;
+
+	private:
+		static constexpr size_t kBufferSize = 64 * 1024; // Larger buffers aren't allowed over the network
+
+		struct Watch {
+			std::filesystem::path root;
+			HANDLE directory = INVALID_HANDLE_VALUE;
+			OVERLAPPED overlapped = {};
+			std::unique_ptr<DWORD[]> buffer = std::make_unique<DWORD[]>(kBufferSize / sizeof(DWORD)); // DWORD aligned
+		};
+
+		bool Issue(Watch& watch);
+
+		std::vector<std::unique_ptr<Watch>> watches;
+		HANDLE interrupt = nullptr;
+	};
+#endif
+
+#ifdef __linux__
+	/// <summary>
+	/// inotify watches on every directory of the trees, new directories get watched as they appear
+	/// </summary>
+	class InotifyDirWatchBackend : public IDirWatchBackend {
+	public:
+		InotifyDirWatchBackend();
+		~InotifyDirWatchBackend() override;
+
+		bool Add(const std::filesystem::path& root) override;
+		void Poll(std::chrono::milliseconds timeout, std::vector<FileChange>& out) override;
+		void Interrupt() override;
+
+	private:
+		bool AddRecursive(const std::filesystem::path& directory);
+		void RemoveBelow(const std::filesystem::path& directory);
+		void Rebase(const std::filesystem::path& from, const std::filesystem::path& to);
+
+		int fd = -1;
+		int wakeFd = -1;
+		std::unordered_map<int, std::filesystem::path> watches; // Watch descriptor -> directory
+	};
+#endif
+
+	/// <summary>
+	/// Folds raw notifications into net changes: a file added and removed again disappears,
+	/// removed and re-added becomes a modification, added then renamed becomes an add of the
+	/// new name, repeated modifications collapse. An overflow drops everything collected so far.
+	/// </summary>
+	class FileChangeCoalescer {
+	public:
+		void Push(const FileChange& change);
+
+		bool Empty() const { return this->live == 0 && !this->batch.overflow; }
+
+		/// <summary>
+		/// The net changes since the last call, clears the coalescer
+		/// </summary>
+		FileChangeBatch Take();
+
+	private:
+		void Drop(size_t index);
+
+		FileChangeBatch batch;
+		std::vector<bool> dropped;
+		size_t live = 0; // Changes that weren't dropped
+		std::unordered_map<std::filesystem::path::string_type, size_t> last; // Path -> index of its latest change
+	};
+
+	/// <summary>
+	/// Watches directory trees on a background thread and hands out debounced batches: a batch is
+	/// delivered once notifications have been quiet for a while (or have kept coming for too long),
+	/// so a storm like an installer dropping hundreds of shortcuts ends up as a single batch.
+	/// </summary>
+	class DirWatcher {
+	public:
+		struct Options {
+			std::chrono::milliseconds quiet = std::chrono::milliseconds(250);  // Deliver after this long without notifications
+			std::chrono::milliseconds maxDelay = std::chrono::seconds(2);      // Never hold changes back for longer than this
+		};
+
+		using BatchCallback = std::function<void(const FileChangeBatch&)>;
+
+		/// <param name="backend">Can be null, the watcher just stays inactive</param>
+		/// <param name="onBatch">Called on the watcher thread</param>
+		DirWatcher(std::unique_ptr<IDirWatchBackend> backend, BatchCallback onBatch, Options options);
+		DirWatcher(std::unique_ptr<IDirWatchBackend> backend, BatchCallback onBatch) : DirWatcher(std::move(backend), std::move(onBatch), Options()) {}
+		~DirWatcher();
+
+		DirWatcher(const DirWatcher&) = delete;
+		DirWatcher& operator=(const DirWatcher&) = delete;
+
+		/// <summary>
+		/// The native backend for this OS, null where there is none
+		/// </summary>
+		static std::unique_ptr<IDirWatchBackend> CreateDefaultBackend();
+
+		/// <summary>
+		/// Start watching, call once
+		/// </summary>
+		/// <returns>False if none of the roots could be watched</returns>
+		bool Watch(const std::vector<std::filesystem::path>& roots);
+
+		bool Active() const { return this->active; }
+
+	private:
+		void Work(std::stop_token stop);
+
+		std::unique_ptr<IDirWatchBackend> backend;
+		BatchCallback onBatch;
+		Options options;
+		bool active = false;
+		std::jthread thread;
+	};
+} // namespace IMS
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "pch.h"
+
+#include "mapped_file.h"
+
+namespace IMS {
+	/// <summary>
+	/// What goes into the font atlas. Every size becomes its own ImFont, in order,
+	/// so a DPI change only has to pick another font rather than rebuild the atlas.
+	/// </summary>
+	struct FontAtlasSpec {
+		std::filesystem::path path;       // TTF/OTF, empty for ImGui's built-in ProggyClean
+		std::vector<float> sizes;         // Pixels
+		int oversampleH = 1;
+		int oversampleV = 1;
+		bool pixelSnapH = true;
+		std::vector<ImWchar> glyphRanges; // First/last codepoint pairs, zero terminated. Empty for ImGui's default (Latin)
+	};
+
+	/// <summary>
+	/// On-disk layout of a baked font atlas, native endianness: header, font records, glyph records,
+	/// line UVs, then the RGBA32 pixels. Only valid for the ImGui version that wrote it.
+	/// </summary>
+	struct FontAtlasFileHeader {
+		static constexpr char kMagic[8] = { 'I', 'M', 'S', 'F', 'O', 'N', 'T', 'S' };
+		static constexpr uint32_t kVersion = 1;
+
+		char magic[8] = {};
+		uint32_t version = 0;
+		uint32_t headerSize = 0;   // sizeof(FontAtlasFileHeader)
+		uint32_t fontSize = 0;     // sizeof(FontAtlasFileFont)
+		uint32_t glyphSize = 0;    // sizeof(FontAtlasFileGlyph)
+		uint32_t imguiVersion = 0; // IMGUI_VERSION_NUM, the glyph metrics are ImGui's
+		uint32_t lineCount = 0;    // IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1
+		uint64_t key = 0;          // FontAtlasKey of what was baked
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t fontCount = 0;
+		uint32_t glyphCount = 0;
+		float uvScale[2] = {};
+		float uvWhitePixel[2] = {};
+		uint64_t fileSize = 0;
+		uint64_t checksum = 0;     // FNV-1a over everything after the header
+	};
+
+	struct FontAtlasFileFont {
+		float size = 0;
+		float ascent = 0;
+		float descent = 0;
+		uint32_t firstGlyph = 0;
+		uint32_t glyphCount = 0;
+		uint32_t fallbackChar = 0;
+		uint32_t ellipsisChar = 0;
+	};
+
+	struct FontAtlasFileGlyph {
+		static constexpr uint32_t kVisible = 1;
+		static constexpr uint32_t kColored = 2;
+
+		uint32_t codepoint = 0;
+		uint32_t flags = 0;
+		float advanceX = 0;
+		float x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+		float u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+	};
+
+	/// <summary>
+	/// A baked atlas, either about to be saved or pointing into a mapped file
+	/// </summary>
+	struct BakedFontAtlas {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		float uvScale[2] = {};
+		float uvWhitePixel[2] = {};
+		std::span<const FontAtlasFileFont> fonts;
+		std::span<const FontAtlasFileGlyph> glyphs;
+		std::span<const float> lines;     // ImFontAtlas::TexUvLines, 4 floats per width
+		std::span<const uint32_t> pixels; // RGBA32, rows top to bottom
+	};
+
+	/// <summary>
+	/// Hash of everything that changes the baked atlas: the font file's contents, sizes, oversampling and glyph ranges
+	/// </summary>
+	/// <param name="fontData">Contents of spec.path, empty for the built-in font</param>
+	/// <param name="glyphRanges">The ranges actually used, without the terminator</param>
+	uint64_t FontAtlasKey(const FontAtlasSpec& spec, std::span<const uint8_t> fontData, std::span<const ImWchar> glyphRanges);
+
+	/// <summary>
+	/// Write a baked atlas to `path` (atomically replaced)
+	/// </summary>
+	bool SaveFontAtlas(const BakedFontAtlas& atlas, uint64_t key, const std::filesystem::path& path);
+
+	/// <summary>
+	/// Map a baked atlas. Sizes, glyph ranges and the checksum are validated, a file with another key,
+	/// another ImGui version or anything truncated or corrupted is rejected.
+	/// </summary>
+	/// <param name="file">Holds the mapping, the result points into it</param>
+	std::optional<BakedFontAtlas> LoadFontAtlas(const std::filesystem::path& path, uint64_t key, MappedFile& file);
+
+	/// <summary>
+	/// Builds font atlases through an on-disk cache: the first launch rasterizes with stb_truetype and saves
+	/// the result, later ones map the file and hand its pixels and glyphs to ImGui without rasterizing anything.
+	/// Has to outlive the atlas, and Release has to be called before the atlas is destroyed.
+	/// </summary>
+	class FontAtlasCache {
+	public:
+		/// <param name="path">Cache file, empty to always rasterize</param>
+		explicit FontAtlasCache(std::filesystem::path path) : path(std::move(path)) {}
+
+		FontAtlasCache(const FontAtlasCache&) = delete;
+		FontAtlasCache& operator=(const FontAtlasCache&) = delete;
+
+		/// <summary>
+		/// Fill an empty atlas with every size of the font, from the cache if it matches
+		/// </summary>
+		/// <returns>False if the font can't be read or ImGui can't build it</returns>
+		bool Build(ImFontAtlas& atlas, const FontAtlasSpec& spec);
+
+		/// <summary>
+		/// Take the mapped pixels back from the atlas, ImGui would free them otherwise
+		/// </summary>
+		void Release(ImFontAtlas& atlas);
+
+		/// <summary>
+		/// Whether the last Build came from the cache
+		/// </summary>
+		bool Hit() const { return this->hit; }
+
+	private:
+		void Apply(ImFontAtlas& atlas, const BakedFontAtlas& baked, const FontAtlasSpec& spec);
+		void Save(ImFontAtlas& atlas, uint64_t key);
+
+		std::filesystem::path path;
+		MappedFile fontFile;  // ImGui keeps pointing at the font data after rasterizing
+		MappedFile cacheFile; // Its pixels are the atlas texture on a hit
+		unsigned int* mappedPixels = nullptr;
+		bool hit = false;
+	};
+} // namespace IMS
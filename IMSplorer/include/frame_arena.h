@@ -0,0 +1,62 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	/// <summary>
+	/// Bump allocator for what only lives until the end of the frame: labels, tooltips and formatting buffers
+	/// handed to ImGui, which copies them. Nothing is freed individually, Reset drops everything at once.
+	/// A frame that doesn't fit spills into extra blocks, and the next Reset grows the main block to fit,
+	/// so the heap is only touched until the arena has seen the busiest frame. UI thread only.
+	/// </summary>
+	class FrameArena {
+	public:
+		explicit FrameArena(size_t capacity = 16 * 1024);
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		/// <summary>
+		/// Uninitialized memory, valid until the next Reset
+		/// </summary>
+		void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+		/// <summary>
+		/// Zero terminated copy of `text`, valid until the next Reset
+		/// </summary>
+		const char* Copy(std::string_view text);
+
+		/// <summary>
+		/// fmt::format into the arena, zero terminated and valid until the next Reset
+		/// </summary>
+		template <typename... Args>
+		const char* Format(fmt::format_string<Args...> format, Args&&... args) {
+			return this->VFormat(fmt::string_view(format), fmt::make_format_args(args...));
+		}
+
+		const char* VFormat(fmt::string_view format, fmt::format_args args);
+
+		/// <summary>
+		/// Forget everything allocated since the last Reset, once per frame
+		/// </summary>
+		void Reset();
+
+		size_t Used() const { return this->used + this->spilled; }
+		size_t Capacity() const { return this->capacity; }
+
+		/// <summary>
+		/// Frames that didn't fit into the main block
+		/// </summary>
+		uint64_t Overflows() const { return this->overflows; }
+
+	private:
+		std::unique_ptr<char[]> block;
+		size_t capacity = 0;
+		size_t used = 0;
+
+		// Whatever didn't fit this frame, freed (and folded into the main block) on Reset
+		std::vector<std::unique_ptr<char[]>> spills;
+		size_t spilled = 0;
+		uint64_t overflows = 0;
+	};
+} // namespace IMS
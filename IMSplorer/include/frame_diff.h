@@ -0,0 +1,66 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	/// <summary>
+	/// 64-bit hash of a byte range, fast rather than cryptographic. 64 byte stripes go through 8 independent
+	/// lanes (two per SSE2 register where there is SSE2, the same math in plain 64-bit integers elsewhere),
+	/// with a key that changes every stripe so moving data around changes the hash. Pass the previous result
+	/// as `seed` to continue over several ranges.
+	/// </summary>
+	uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+	/// <summary>
+	/// HashBytes in plain 64-bit integers even where there is SSE2, the same result. What the SSE2 path is tested against.
+	/// </summary>
+	uint64_t HashBytesScalar(const void* data, size_t size, uint64_t seed = 0);
+
+	/// <summary>
+	/// Hash of everything in a viewport's draw data that decides what ends up on screen: the display rectangle
+	/// and scale, and per draw list the vertices, the indices and every command (clip rectangle, texture,
+	/// offsets, element count and callback)
+	/// </summary>
+	uint64_t HashDrawData(const ImDrawData& data, uint64_t seed = 0);
+
+	/// <summary>
+	/// Tells which viewports built the same draw data as the last time they were drawn, so their GPU submit and
+	/// present can be skipped and the last frame stays on screen. A viewport that wasn't compared in a frame is
+	/// forgotten, when it comes back it's drawn. UI thread only.
+	/// </summary>
+	class FrameDiff {
+	public:
+		FrameDiff() { this->viewports.reserve(8); }
+
+		/// <summary>
+		/// Compare a viewport's draw data to what it held the last time it was drawn
+		/// </summary>
+		/// <param name="salt">Whatever else goes into the picture, e.g. a count of texture updates</param>
+		/// <returns>True if it has to be drawn, the new hash is remembered then</returns>
+		bool Changed(ImGuiID viewport, const ImDrawData& data, uint64_t salt = 0);
+
+		/// <summary>
+		/// Draw every viewport next frame, for when what's on screen is lost (device lost, resized, occluded)
+		/// </summary>
+		void Invalidate() { this->viewports.clear(); }
+
+		/// <summary>
+		/// Forget the viewports that weren't compared since the last call, once per frame after the last Changed
+		/// </summary>
+		void EndFrame();
+
+		uint64_t Drawn() const { return this->drawn; }
+		uint64_t Skipped() const { return this->skipped; }
+
+	private:
+		struct Entry {
+			ImGuiID viewport = 0;
+			uint64_t hash = 0;
+			bool seen = false;
+		};
+
+		std::vector<Entry> viewports; // A handful, searched linearly
+		uint64_t drawn = 0;
+		uint64_t skipped = 0;
+	};
+} // namespace IMS
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	/// <summary>
+	/// Time source for the scheduler, swapped for a fake one when scripting event sequences
+	/// </summary>
+	class IClock {
+	public:
+		virtual ~IClock() = default;
+
+		virtual std::chrono::steady_clock::time_point Now() const = 0;
+		virtual std::chrono::system_clock::time_point WallNow() const = 0;
+	};
+
+	class SystemClock : public IClock {
+	public:
+		std::chrono::steady_clock::time_point Now() const override { return std::chrono::steady_clock::now(); }
+		std::chrono::system_clock::time_point WallNow() const override { return std::chrono::system_clock::now(); }
+	};
+
+	/// <summary>
+	/// Whatever the UI thread blocks on while idle (the message queue on Windows)
+	/// </summary>
+	class IEventSource {
+	public:
+		static constexpr std::chrono::milliseconds kInfinite = std::chrono::milliseconds::max();
+
+		virtual ~IEventSource() = default;
+
+		/// <summary>
+		/// Block until an event arrives or the timeout expires
+		/// </summary>
+		/// <returns>True if woken by an event</returns>
+		virtual bool Wait(std::chrono::milliseconds timeout) = 0;
+
+		/// <summary>
+		/// Wake a blocked Wait from any thread
+		/// </summary>
+		virtual void Wake() = 0;
+	};
+
+#ifdef _WIN32
+	/// <summary>
+	/// Waits on the calling thread's message queue with MsgWaitForMultipleObjects
+	/// </summary>
+	class Win32EventSource : public IEventSource {
+	public:
+		Win32EventSource();
+
+		bool Wait(std::chrono::milliseconds timeout) override;
+		void Wake() override;
+
+	private:
+		DWORD threadId = 0;
+	};
+#endif
+
+	/// <summary>
+	/// Decides when a frame needs to be rendered so the UI thread can sleep the rest of the time.
+	/// A frame is due when something invalidated the UI, an animation is running, a requested
+	/// deadline has passed or the periodic tick (the clock) crossed a boundary.
+	/// </summary>
+	class FrameScheduler {
+	public:
+		// ImGui needs a couple of frames after a change to settle (hover state, popups, new viewports)
+		static constexpr int kSettleFrames = 3;
+
+		FrameScheduler(IClock& clock, IEventSource& events);
+
+		/// <summary>
+		/// Something changed, render at least `frames` more frames
+		/// </summary>
+		void Invalidate(int frames = kSettleFrames);
+
+		/// <summary>
+		/// Render continuously for the given duration
+		/// </summary>
+		void AnimateFor(std::chrono::steady_clock::duration duration);
+
+		/// <summary>
+		/// Render one frame once the given duration has passed
+		/// </summary>
+		void RequestFrameIn(std::chrono::steady_clock::duration duration);
+
+		/// <summary>
+		/// Drop pending frames and try again later (e.g. while occluded)
+		/// </summary>
+		void Postpone(std::chrono::steady_clock::duration duration);
+
+		/// <summary>
+		/// Render a frame every time the wall clock crosses a multiple of `interval`, zero disables it
+		/// </summary>
+		void SetTickInterval(std::chrono::milliseconds interval);
+
+		/// <summary>
+		/// Block until there's an event or a frame is due, returns immediately if one already is
+		/// </summary>
+		void WaitForWork();
+
+		/// <summary>
+		/// Consume a pending frame
+		/// </summary>
+		/// <returns>True if a frame should be rendered now</returns>
+		bool BeginFrame();
+
+		uint64_t FramesRendered() const { return this->framesRendered; }
+		uint64_t Wakeups() const { return this->wakeups; }
+
+	private:
+		using TimePoint = std::chrono::steady_clock::time_point;
+
+		void Update(TimePoint now);
+		bool Due(TimePoint now) const;
+		TimePoint NextTick() const;
+
+		IClock& clock;
+		IEventSource& events;
+
+		int pendingFrames = kSettleFrames;
+		TimePoint animateUntil = TimePoint::min();
+		TimePoint deadline = TimePoint::max();
+		TimePoint nextTick = TimePoint::max();
+		std::chrono::milliseconds tickInterval = std::chrono::milliseconds::zero();
+
+		uint64_t framesRendered = 0;
+		uint64_t wakeups = 0;
+	};
+} // namespace IMS
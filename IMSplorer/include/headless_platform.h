@@ -0,0 +1,147 @@
+#pragma once
+
+#include "pch.h"
+
+#include "frame_diff.h"
+#include "platform.h"
+
+namespace IMS {
+	/// <summary>
+	/// Event source for threads without a message queue, Wait blocks on a condition variable
+	/// </summary>
+	class ConditionEventSource : public IEventSource {
+	public:
+		bool Wait(std::chrono::milliseconds timeout) override;
+		void Wake() override;
+
+	private:
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool woken = false;
+	};
+
+	/// <summary>
+	/// Runs the taskbar without a window, a device or a renderer: ImGui builds its draw lists
+	/// and they're thrown away. Windows, their processes, their usage and their icons are synthetic.
+	/// Owns the ImGui context, create it before the Taskbar and destroy it after.
+	/// </summary>
+	class HeadlessPlatform : public IPlatform {
+	public:
+		struct FakeWindow {
+			WindowHandle handle = 0;
+			uint32_t pid = 0;
+			std::string title;
+			std::string exePath;
+		};
+
+		explicit HeadlessPlatform(ImVec2 screenSize = ImVec2(1920, 1080), float taskbarHeight = 48.0f);
+		~HeadlessPlatform() override;
+
+		HeadlessPlatform(const HeadlessPlatform&) = delete;
+		HeadlessPlatform& operator=(const HeadlessPlatform&) = delete;
+
+		/// <summary>
+		/// Add a window owned by a fake process, windows with the same exe share a process
+		/// </summary>
+		/// <returns>The new window's handle</returns>
+		WindowHandle AddWindow(std::string title, std::string exePath);
+
+		/// <summary>
+		/// Change a window's title and report it to the host like the shell hook would
+		/// </summary>
+		/// <param name="notify">False to leave reporting it to the caller (a replayed trace has the event already)</param>
+		void SetWindowTitle(WindowHandle handle, std::string title, bool notify = true);
+
+		/// <summary>
+		/// Start menu roots handed to the taskbar
+		/// </summary>
+		void SetAppRoots(std::vector<std::filesystem::path> roots) { this->appRoots = std::move(roots); }
+
+		/// <summary>
+		/// Empty (the default) keeps the Start menu index in memory only
+		/// </summary>
+		void SetCacheDirectory(std::filesystem::path directory) { this->cacheDirectory = std::move(directory); }
+
+		/// <summary>
+		/// Where the Run mode looks for executables, the process' PATH by default
+		/// </summary>
+		void SetCommandPaths(CommandSources sources) { this->commandPaths = std::move(sources); }
+
+		/// <summary>
+		/// Make the next PumpEvents report a quit
+		/// </summary>
+		void Quit() { this->quit = true; }
+
+		void SetHost(IPlatformHost* host) override { this->host = host; }
+
+		IClock& Clock() override { return this->clock; }
+		IEventSource& Events() override { return this->events; }
+		bool PumpEvents() override { return !this->quit; }
+		std::function<bool(uint8_t key)> KeyStateQuery() override { return nullptr; } // Only the events fed in
+
+		void EnumerateWindows(const std::function<void(WindowHandle)>& callback) override;
+		bool IsTaskbarWindow(WindowHandle handle) override;
+		std::string WindowTitle(WindowHandle handle) override;
+		void ActivateWindow(WindowHandle handle) override;
+		void MinimizeWindow(WindowHandle /*handle*/) override {}
+		void CloseWindow(WindowHandle handle) override;
+
+		std::unique_ptr<IProcessBackend> CreateProcessBackend() override;
+		std::unique_ptr<IWindowInfoResolver> CreateWindowResolver(ProcessCache& processes) override;
+		std::unique_ptr<IResourceBackend> CreateResourceBackend() override;
+
+		std::vector<std::filesystem::path> AppRoots() override { return this->appRoots; }
+		std::filesystem::path CacheDirectory() override { return this->cacheDirectory; }
+		std::unique_ptr<IDirWatchBackend> CreateDirWatchBackend() override { return DirWatcher::CreateDefaultBackend(); }
+		void Launch(std::string_view /*path*/) override {}
+		CommandSources CommandPaths() override { return this->commandPaths; }
+		void LaunchCommand(std::string_view /*file*/, std::string_view /*arguments*/) override {}
+
+		std::unique_ptr<IIconBackend> CreateIconBackend() override;
+		ImVec2 ScreenSize() override { return this->screenSize; }
+		ImVec2 WindowSize() override { return ImVec2(this->screenSize.x, this->taskbarHeight); }
+		float TaskbarHeight() override { return this->taskbarHeight; }
+
+		bool BeginFrame() override;
+		void EndFrame() override;
+
+		/// <summary>
+		/// Vertices in the last frame, to check the benchmark actually drew something
+		/// </summary>
+		size_t LastVertexCount() const { return this->lastVertexCount; }
+
+		/// <summary>
+		/// Which frames a real renderer would have skipped, hashed like the Win32 platform does
+		/// </summary>
+		const FrameDiff& Diff() const { return this->frameDiff; }
+
+	private:
+		class ProcessBackend;
+		class WindowResolver;
+		class IconBackend;
+		class ResourceBackend;
+
+		const FakeWindow* Find(WindowHandle handle) const;
+
+		IPlatformHost* host = nullptr;
+
+		SystemClock clock;
+		ConditionEventSource events;
+
+		ImGuiContext* imguiContext = nullptr;
+		ImVec2 screenSize;
+		float taskbarHeight;
+		size_t lastVertexCount = 0;
+		FrameDiff frameDiff;
+		bool quit = false;
+
+		// Read by the metadata worker
+		mutable std::mutex mutex;
+		std::vector<FakeWindow> windows;
+		std::unordered_map<std::string, uint32_t> processes; // Exe path -> pid
+
+		std::vector<std::filesystem::path> appRoots;
+		std::filesystem::path cacheDirectory;
+		CommandSources commandPaths = CommandIndex::DefaultSources();
+	};
+} // namespace IMS
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	/// <summary>
+	/// Windows virtual key codes, used as the key space on every platform
+	/// </summary>
+	namespace Keys {
+		static constexpr uint8_t Shift = 0x10;
+		static constexpr uint8_t Control = 0x11;
+		static constexpr uint8_t Alt = 0x12;
+		static constexpr uint8_t LWin = 0x5B;
+		static constexpr uint8_t RWin = 0x5C;
+		static constexpr uint8_t LShift = 0xA0;
+		static constexpr uint8_t RShift = 0xA1;
+		static constexpr uint8_t LControl = 0xA2;
+		static constexpr uint8_t RControl = 0xA3;
+		static constexpr uint8_t LAlt = 0xA4;
+		static constexpr uint8_t RAlt = 0xA5;
+	} // namespace Keys
+
+	enum Modifier : uint8_t {
+		ModWin = 1 << 0,
+		ModShift = 1 << 1,
+		ModControl = 1 << 2,
+		ModAlt = 1 << 3,
+	};
+
+	/// <summary>
+	/// Parse a shortcut such as "Win+Shift+P" or "Ctrl+Alt+F12"
+	/// </summary>
+	/// <returns>False if the string isn't a valid shortcut</returns>
+	bool ParseHotkey(std::string_view text, uint8_t& modifiers, uint8_t& key);
+
+	/// <summary>
+	/// Tracks keyboard state from the key events themselves (no polling) and recognises
+	/// a Win key tap and registered shortcuts. Every event is O(1), so it's safe to run
+	/// inside a low level keyboard hook.
+	/// </summary>
+	class HotkeyEngine {
+	public:
+		using Action = std::function<void()>;
+
+		/// <summary>
+		/// Whether a key is physically down, as it was before the event being handled
+		/// </summary>
+		using KeyQuery = std::function<bool(uint8_t key)>;
+
+		HotkeyEngine();
+
+		/// <summary>
+		/// Called when a Win key is pressed and released without any other key in between
+		/// </summary>
+		void OnWinTap(Action action) { this->winTap = std::move(action); }
+
+		/// <summary>
+		/// Run `action` when `key` is pressed while exactly `modifiers` are held
+		/// </summary>
+		/// <returns>False if the table is full</returns>
+		bool Register(uint8_t modifiers, uint8_t key, Action action);
+		bool Register(std::string_view shortcut, Action action);
+		void Unregister(uint8_t modifiers, uint8_t key);
+
+		/// <summary>
+		/// Feed a key event
+		/// </summary>
+		/// <returns>True if a shortcut consumed the event and it shouldn't reach other applications</returns>
+		bool OnKey(uint8_t key, bool down);
+
+		/// <summary>
+		/// Forget the key state, for when key events may have been missed (e.g. the secure desktop was up)
+		/// </summary>
+		void Reset();
+
+		/// <summary>
+		/// Check keys marked down against `query` whenever the events look out of step with the keyboard:
+		/// a key pressed that is already down is checked on its own, Win pressed while other keys are down
+		/// checks every key. Keys the query reports up are released. Null to trust the events alone.
+		/// </summary>
+		void SetKeyQuery(KeyQuery query) { this->keyQuery = std::move(query); }
+
+		bool IsDown(uint8_t key) const { return this->down.test(key); }
+		uint8_t Modifiers() const;
+
+	private:
+		enum class State : uint8_t {
+			Idle,
+			WinHeld,  // Win is down and nothing else was pressed yet, releasing it is a tap
+			WinCombo, // Something was pressed while Win was down
+		};
+
+		static constexpr size_t kModifierCombinations = 16;
+
+		static bool IsWin(uint8_t key) { return key == Keys::LWin || key == Keys::RWin; }
+
+		void Resync();
+
+		std::bitset<256> down;
+		std::bitset<256> consumed; // Keys whose press triggered a shortcut, their release is swallowed too
+		State state = State::Idle;
+		uint32_t pressed = 0;
+
+		// (modifiers, key) -> index into actions + 1, 0 means unbound
+		std::array<uint8_t, kModifierCombinations * 256> table{};
+		std::vector<Action> actions;
+		Action winTap;
+		KeyQuery keyQuery;
+	};
+} // namespace IMS
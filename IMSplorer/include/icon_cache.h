@@ -0,0 +1,200 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	struct AtlasRect {
+		uint16_t x = 0;
+		uint16_t y = 0;
+		uint16_t width = 0;
+		uint16_t height = 0;
+	};
+
+	/// <summary>
+	/// Skyline bottom-left rectangle packer: the top edge of everything placed so far is kept as a list
+	/// of horizontal segments, a rectangle goes wherever it ends up lowest (least wasted width on ties).
+	/// </summary>
+	class SkylinePacker {
+	public:
+		SkylinePacker(int width = 0, int height = 0) { this->Reset(width, height); }
+
+		/// <summary>
+		/// Forget every rectangle, optionally with a new size
+		/// </summary>
+		void Reset(int width, int height);
+
+		/// <returns>Nothing if there's no room left</returns>
+		std::optional<AtlasRect> Insert(int width, int height);
+
+		int Width() const { return this->width; }
+		int Height() const { return this->height; }
+
+		/// <summary>
+		/// Area below the skyline, placed rectangles and the gaps under them
+		/// </summary>
+		size_t UsedArea() const;
+
+	private:
+		struct Segment {
+			int x = 0;
+			int y = 0;
+			int width = 0;
+		};
+
+		/// <returns>The y the rectangle would rest at if placed on segment `index`, -1 if it doesn't fit</returns>
+		int Fit(size_t index, int width, int height) const;
+
+		int width = 0;
+		int height = 0;
+		std::vector<Segment> skyline;
+	};
+
+	/// <summary>
+	/// RGBA8 pixels, straight alpha, rows top to bottom
+	/// </summary>
+	struct IconImage {
+		int width = 0;
+		int height = 0;
+		std::vector<uint32_t> pixels;
+	};
+
+	/// <summary>
+	/// Where icons come from and where they go. Extract runs on the icon worker, everything else on the UI thread.
+	/// </summary>
+	class IIconBackend {
+	public:
+		virtual ~IIconBackend() = default;
+
+		/// <summary>
+		/// Load icon `index` of a file (exe, dll, ico) at `size` x `size` pixels
+		/// </summary>
+		/// <returns>False if the file has no such icon</returns>
+		virtual bool Extract(const std::string& path, int32_t index, int size, IconImage& out) = 0;
+
+		/// <returns>A null texture on failure</returns>
+		virtual ImTextureID CreateTexture(int width, int height) = 0;
+		virtual void UpdateTexture(ImTextureID texture, const AtlasRect& rect, const uint32_t* pixels) = 0;
+		virtual void DestroyTexture(ImTextureID texture) = 0;
+	};
+
+#ifdef _WIN32
+	/// <summary>
+	/// PrivateExtractIconsW into a D3D11 texture
+	/// </summary>
+	class Win32IconBackend : public IIconBackend {
+	public:
+		/// <summary>
+		/// Holds on to the platform's pointers rather than their values, the backend can be created before the device
+		/// </summary>
+		/// <param name="textureUpdates">Counted up on every upload, pixels changing under unchanged draw data have to be presented</param>
+		Win32IconBackend(ID3D11Device* const& device, ID3D11DeviceContext* const& deviceContext, uint64_t& textureUpdates)
+			: device(device), deviceContext(deviceContext), textureUpdates(textureUpdates) {}
+
+		bool Extract(const std::string& path, int32_t index, int size, IconImage& out) override;
+
+		ImTextureID CreateTexture(int width, int height) override;
+		void UpdateTexture(ImTextureID texture, const AtlasRect& rect, const uint32_t* pixels) override;
+		void DestroyTexture(ImTextureID texture) override;
+
+	private:
+		ID3D11Device* const& device;
+		ID3D11DeviceContext* const& deviceContext;
+		uint64_t& textureUpdates;
+	};
+#endif
+
+	/// <summary>
+	/// Application icons, extracted on a background thread and packed into one texture atlas so
+	/// everything drawn with them shares a texture. Icons are keyed by file path (case-insensitive)
+	/// and icon index, when the atlas is full the least recently drawn icons make room.
+	/// UI thread only, apart from the worker it owns.
+	/// </summary>
+	class IconCache {
+	public:
+		struct Options {
+			int atlasSize = 512; // Square, in pixels
+			int iconSize = 32;
+		};
+
+		struct Icon {
+			ImTextureID texture = {};
+			ImVec2 uv0;
+			ImVec2 uv1;
+		};
+
+		/// <param name="backend">Can be null, no icons then</param>
+		/// <param name="onReady">Called on the worker thread once icons are ready to be uploaded (to wake the UI)</param>
+		IconCache(std::unique_ptr<IIconBackend> backend, std::function<void()> onReady, Options options);
+		IconCache(std::unique_ptr<IIconBackend> backend, std::function<void()> onReady = nullptr) : IconCache(std::move(backend), std::move(onReady), Options()) {}
+		~IconCache();
+
+		IconCache(const IconCache&) = delete;
+		IconCache& operator=(const IconCache&) = delete;
+
+		/// <summary>
+		/// Look up an icon and mark it as used, a missing one is queued for extraction
+		/// </summary>
+		/// <returns>Null until the icon is in the atlas, or if there is none</returns>
+		const Icon* Get(std::string_view path, int32_t index = 0);
+
+		/// <summary>
+		/// Pack and upload what the worker extracted since the last call, once per frame before building it
+		/// </summary>
+		/// <returns>Number of icons that became available</returns>
+		size_t Upload();
+
+		int IconSize() const { return this->options.iconSize; }
+		size_t Size() const { return this->entries.size(); }
+		size_t Resident() const { return this->lru.size(); }
+		uint64_t Evictions() const { return this->evictions; }
+
+	private:
+		enum class State : uint8_t {
+			Pending,
+			Ready,
+			Missing,
+		};
+
+		struct Entry {
+			State state = State::Pending;
+			Icon icon;
+			AtlasRect rect;
+			std::list<const std::string*>::iterator lru; // Ready entries only
+		};
+
+		struct Request {
+			std::string key; // Lowercased path, then the index after a null
+			std::string path;
+			int32_t index = 0;
+		};
+
+		struct Result {
+			std::string key;
+			IconImage image;
+			bool found = false;
+		};
+
+		std::optional<AtlasRect> Allocate();
+		void Work(std::stop_token stop);
+
+		std::unique_ptr<IIconBackend> backend;
+		std::function<void()> onReady;
+		Options options;
+
+		ImTextureID texture = {};
+		bool hasTexture = false;
+		SkylinePacker packer;
+
+		std::unordered_map<std::string, Entry> entries;
+		std::list<const std::string*> lru; // Keys of the icons in the atlas, least recently used first
+		std::string lookupKey;             // Reused by Get
+		uint64_t evictions = 0;
+
+		std::mutex mutex;
+		std::condition_variable_any wake;
+		std::deque<Request> requests;
+		std::vector<Result> results;
+
+		std::jthread thread;
+	};
+} // namespace IMS
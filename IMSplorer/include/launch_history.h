@@ -0,0 +1,119 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	/// <summary>
+	/// On-disk layout of the launch log, native endianness: the header, then fixed size records appended
+	/// one per launch. Compaction rewrites it with one record per app carrying its decayed score.
+	/// </summary>
+	struct LaunchFileHeader {
+		static constexpr char kMagic[8] = { 'I', 'M', 'S', 'L', 'A', 'U', 'N', 'C' };
+		static constexpr uint32_t kVersion = 1;
+
+		char magic[8] = {};
+		uint32_t version = 0;
+		uint32_t headerSize = 0; // sizeof(LaunchFileHeader)
+		uint32_t recordSize = 0; // sizeof(LaunchRecord)
+		uint32_t halfLife = 0;   // Seconds, compacted weights only hold for the half-life they were decayed with
+	};
+
+	struct LaunchRecord {
+		uint64_t key = 0;    // LaunchHistory::Key of what was launched
+		int64_t time = 0;    // Seconds since the Unix epoch
+		float weight = 1;    // Score at `time`, 1 for a single launch
+		uint32_t count = 1;  // Launches folded into the record
+	};
+
+	/// <summary>
+	/// Which Start menu entries get launched, ranked by frecency: every launch adds 1 to an app's score
+	/// and scores halve every kHalfLife, so both how often and how recently count. Scores are kept as
+	/// log2(score) + time / kHalfLife, which decays every app alike and so never has to be updated as
+	/// time passes; an ordered set keeps the ranking at O(log n) per launch.
+	/// Launches are appended to a log by a background flusher, the UI thread never touches the file.
+	/// Everything but Load is UI thread only.
+	/// </summary>
+	class LaunchHistory {
+	public:
+		static constexpr int64_t kHalfLife = 7 * 24 * 60 * 60;
+
+		struct Entry {
+			double rank = 0;    // log2(score) + time / kHalfLife
+			int64_t last = 0;   // Seconds since the Unix epoch
+			uint32_t count = 0;
+		};
+
+		LaunchHistory() = default;
+		~LaunchHistory();
+
+		LaunchHistory(const LaunchHistory&) = delete;
+		LaunchHistory& operator=(const LaunchHistory&) = delete;
+
+		/// <summary>
+		/// Case-insensitive hash of a launched path
+		/// </summary>
+		static uint64_t Key(std::string_view path);
+
+		/// <summary>
+		/// Read the log at `path` and persist every launch recorded from now on into it. Call once, before
+		/// anything is recorded. Without it the history only lives in memory.
+		/// </summary>
+		/// <returns>False if there was no usable log, the history starts empty then</returns>
+		bool Load(const std::filesystem::path& path);
+
+		void Record(std::string_view path, std::chrono::system_clock::time_point when);
+		void Record(uint64_t key, int64_t time);
+
+		const Entry* Find(uint64_t key) const;
+
+		/// <summary>
+		/// Decayed launch count at `now` (seconds since the Unix epoch)
+		/// </summary>
+		static double Score(const Entry& entry, int64_t now) { return std::exp2(entry.rank - (double)now / kHalfLife); }
+
+		/// <summary>
+		/// (rank, key) of every app, best first
+		/// </summary>
+		const std::set<std::pair<double, uint64_t>, std::greater<>>& Ranked() const { return this->ranked; }
+
+		size_t Size() const { return this->entries.size(); }
+
+		/// <summary>
+		/// Bumped by every launch and by Load, to tell when rankings built on the history are stale
+		/// </summary>
+		uint64_t Generation() const { return this->generation; }
+
+		/// <summary>
+		/// Wait until every launch recorded so far is on disk
+		/// </summary>
+		void Flush();
+
+		uint64_t Compactions() const { return this->compactions.load(std::memory_order_relaxed); }
+
+	private:
+		Entry& Apply(std::unordered_map<uint64_t, Entry>& into, const LaunchRecord& record);
+		void Work(std::stop_token stop);
+		bool Compact();
+
+		// UI thread
+		std::unordered_map<uint64_t, Entry> entries;
+		std::set<std::pair<double, uint64_t>, std::greater<>> ranked;
+		uint64_t generation = 0;
+
+		// Flusher, which keeps its own copy of what the file holds to compact it
+		std::filesystem::path path;
+		std::unordered_map<uint64_t, Entry> stored;
+		std::ofstream log;
+		size_t logRecords = 0;
+		bool needsCompaction = false; // The file is missing, invalid, has a torn record at its end or an append failed
+		std::atomic<uint64_t> compactions = 0;
+
+		std::mutex mutex;
+		std::condition_variable_any wake;
+		std::condition_variable_any written;
+		std::vector<LaunchRecord> queue;
+		uint64_t queued = 0;
+		uint64_t flushed = 0;
+		std::jthread thread; // Last, so it stops before the rest goes away
+	};
+} // namespace IMS
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	/// <summary>
+	/// Read-only memory mapping of a whole file. Pages are loaded on first touch, nothing is read up front.
+	/// </summary>
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/// <returns>False if the file doesn't exist, is empty or can't be mapped</returns>
+		bool Open(const std::filesystem::path& path);
+		void Close();
+
+		const uint8_t* Data() const { return this->data; }
+		size_t Size() const { return this->size; }
+
+	private:
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#else
+		int fd = -1;
+#endif
+	};
+
+	/// <summary>
+	/// Write a file through a temporary next to it and rename it into place, so readers never see a half
+	/// written file. On Windows this fails while the file is mapped.
+	/// </summary>
+	/// <param name="write">Writes the contents, returns false to abort</param>
+	bool WriteFileAtomic(const std::filesystem::path& path, const std::function<bool(std::ostream&)>& write);
+
+	/// <summary>
+	/// FNV-1a, for cache file checksums and keys. Pass the previous result as `hash` to continue over several buffers.
+	/// </summary>
+	inline uint64_t Fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+		const uint8_t* bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+} // namespace IMS
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	/// <summary>
+	/// Paths as UTF-8, whatever the native encoding (UTF-16 on Windows). path.string() throws on
+	/// characters outside the ANSI code page, everything that logs or stores a path goes through these.
+	/// </summary>
+	std::string PathToUtf8(const std::filesystem::path& path);
+	std::filesystem::path PathFromUtf8(std::string_view utf8);
+} // namespace IMS
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "pch.h"
+
+#include "command_index.h"
+#include "dir_watcher.h"
+#include "frame_scheduler.h"
+#include "icon_cache.h"
+#include "process_cache.h"
+#include "resource_sampler.h"
+#include "shell_events.h"
+#include "window.h"
+#include "window_info_worker.h"
+
+namespace IMS {
+	/// <summary>
+	/// What the platform reports back to the taskbar. Called on the UI thread
+	/// (KeyboardProc included, low level hooks run on the thread that installed them).
+	/// </summary>
+	class IPlatformHost {
+	public:
+		virtual ~IPlatformHost() = default;
+
+		virtual void OnShellEvent(ShellEventType type, WindowHandle handle) = 0;
+
+		/// <returns>True to swallow the key</returns>
+		virtual bool OnKey(uint8_t key, bool down) = 0;
+
+		/// <summary>
+		/// Key events may have been missed (the session was locked, another desktop was active), the key state is stale
+		/// </summary>
+		virtual void OnKeyStateLost() = 0;
+
+		/// <summary>
+		/// Something that may change what's on screen happened (input, resize, ...)
+		/// </summary>
+		virtual void OnInvalidate() = 0;
+
+		/// <summary>
+		/// The user's environment (PATH) was edited, CommandSources may have changed
+		/// </summary>
+		virtual void OnEnvironmentChanged() = 0;
+	};
+
+	/// <summary>
+	/// Everything the taskbar needs from the OS: window enumeration and control, process info,
+	/// time, input, filesystem roots and presenting frames. The Win32/D3D11 implementation is the
+	/// real shell, the headless one drives ImGui without a renderer for benchmarks.
+	/// </summary>
+	class IPlatform {
+	public:
+		virtual ~IPlatform() = default;
+
+		virtual void SetHost(IPlatformHost* host) = 0;
+
+		// Time and waiting
+		virtual IClock& Clock() = 0;
+		virtual IEventSource& Events() = 0;
+
+		/// <summary>
+		/// Dispatch every pending OS message/input event
+		/// </summary>
+		/// <returns>False once the platform wants to quit</returns>
+		virtual bool PumpEvents() = 0;
+
+		/// <summary>
+		/// Whether a key is physically down, for the hotkey engine to resync with after missed events. Called
+		/// from the keyboard hook. Null if the platform can't tell.
+		/// </summary>
+		virtual std::function<bool(uint8_t key)> KeyStateQuery() = 0;
+
+		// Windows
+		virtual void EnumerateWindows(const std::function<void(WindowHandle)>& callback) = 0;
+
+		/// <summary>
+		/// Cheap checks only (style, visibility), the rest happens on the metadata worker
+		/// </summary>
+		virtual bool IsTaskbarWindow(WindowHandle handle) = 0;
+
+		virtual std::string WindowTitle(WindowHandle handle) = 0;
+		virtual void ActivateWindow(WindowHandle handle) = 0;
+		virtual void MinimizeWindow(WindowHandle handle) = 0;
+		virtual void CloseWindow(WindowHandle handle) = 0;
+
+		// Process info
+		virtual std::unique_ptr<IProcessBackend> CreateProcessBackend() = 0;
+		virtual std::unique_ptr<IWindowInfoResolver> CreateWindowResolver(ProcessCache& processes) = 0;
+
+		/// <summary>
+		/// CPU and memory usage of every process, null to show none
+		/// </summary>
+		virtual std::unique_ptr<IResourceBackend> CreateResourceBackend() = 0;
+
+		// Filesystem
+		virtual std::vector<std::filesystem::path> AppRoots() = 0;
+
+		/// <summary>
+		/// Per-user folder for caches (the Start menu index), empty to not persist anything
+		/// </summary>
+		virtual std::filesystem::path CacheDirectory() = 0;
+
+		/// <summary>
+		/// Change notifications for the Start menu folders, null to only refresh when the Start menu opens
+		/// </summary>
+		virtual std::unique_ptr<IDirWatchBackend> CreateDirWatchBackend() = 0;
+
+		/// <summary>
+		/// Open a Start menu entry (UTF-8 path)
+		/// </summary>
+		virtual void Launch(std::string_view path) = 0;
+
+		/// <summary>
+		/// Where the Start menu's Run mode looks for executables
+		/// </summary>
+		virtual CommandSources CommandPaths() = 0;
+
+		/// <summary>
+		/// Run an executable or a command typed into the Run mode (UTF-8), searched on PATH if it isn't a path
+		/// </summary>
+		virtual void LaunchCommand(std::string_view file, std::string_view arguments) = 0;
+
+		// Presenting
+		/// <summary>
+		/// Icon extraction and the atlas texture, null to draw without icons
+		/// </summary>
+		virtual std::unique_ptr<IIconBackend> CreateIconBackend() = 0;
+
+		virtual ImVec2 ScreenSize() = 0;
+		virtual ImVec2 WindowSize() = 0;
+		virtual float TaskbarHeight() = 0;
+
+		/// <summary>
+		/// Start an ImGui frame
+		/// </summary>
+		/// <returns>False if there's nothing to draw to right now (e.g. occluded), no frame was started</returns>
+		virtual bool BeginFrame() = 0;
+
+		/// <summary>
+		/// Render the ImGui frame and present it
+		/// </summary>
+		virtual void EndFrame() = 0;
+	};
+} // namespace IMS
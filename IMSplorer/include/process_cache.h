@@ -0,0 +1,166 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	/// <summary>
+	/// Identifies a process instance, the start time tells apart processes that got the same (reused) id
+	/// </summary>
+	struct ProcessKey {
+		uint32_t pid = 0;
+		uint64_t startTime = 0;
+
+		bool operator==(const ProcessKey&) const = default;
+	};
+
+	struct ProcessKeyHash {
+		size_t operator()(const ProcessKey& key) const {
+			return std::hash<uint64_t>()(key.startTime * 0x9E3779B97F4A7C15ull ^ key.pid);
+		}
+	};
+
+	using StringId = uint32_t;
+
+	/// <summary>
+	/// Thread safe string pool, every distinct string is stored once and never freed,
+	/// so the returned pointers stay valid for the lifetime of the interner. Id 0 is the empty string.
+	/// Interning takes a lock, reading doesn't: strings live in fixed size chunks that never move,
+	/// and a string is published by bumping the count once it's fully written.
+	/// </summary>
+	class StringInterner {
+	public:
+		static constexpr size_t kChunkSize = 1024;
+		static constexpr size_t kMaxChunks = 1024;
+
+		StringInterner();
+
+		/// <returns>The string's id, 0 once the pool is full</returns>
+		StringId Intern(std::string_view str);
+		std::string_view Get(StringId id) const;
+		const char* CStr(StringId id) const { return this->Get(id).data(); }
+		size_t Size() const { return this->count.load(std::memory_order_acquire); }
+
+	private:
+		std::array<std::unique_ptr<std::string[]>, kMaxChunks> chunks; // Chunks are only ever added, before the count covers them
+		std::atomic<size_t> count = 0;
+
+		std::mutex mutex; // Serializes interning
+		std::unordered_map<std::string_view, StringId> lookup;
+	};
+
+	/// <summary>
+	/// OS specific process queries for the ProcessCache. The cache calls them without holding its lock,
+	/// so Unpin can run on the UI thread while a query runs on the worker.
+	/// </summary>
+	class IProcessBackend {
+	public:
+		virtual ~IProcessBackend() = default;
+
+		/// <summary>
+		/// Start time in backend specific units, only compared for equality
+		/// </summary>
+		virtual bool StartTime(uint32_t pid, uint64_t& startTime) = 0;
+
+		/// <summary>
+		/// Full path of the process image, UTF-8
+		/// </summary>
+		virtual bool ImagePath(uint32_t pid, std::string& path) = 0;
+
+		/// <summary>
+		/// Stop the pid from being reused while the process is cached (e.g. by holding a handle to it).
+		/// Backends that can't do that return false and cached entries get revalidated on every lookup.
+		/// </summary>
+		virtual bool Pin(uint32_t /*pid*/, uintptr_t& /*pin*/) { return false; }
+		virtual void Unpin(uintptr_t /*pin*/) {}
+
+		struct Details {
+			uint64_t startTime = 0;
+			std::string imagePath;
+			uintptr_t pin = 0;
+			bool pinned = false;
+		};
+
+		/// <summary>
+		/// Everything a cache miss needs. Asks StartTime, ImagePath and Pin in turn,
+		/// backends that have to open the process should override it to do that once for all three.
+		/// </summary>
+		virtual bool Query(uint32_t pid, Details& details);
+	};
+
+#ifdef _WIN32
+	/// <summary>
+	/// A miss opens the process once, queries it through that handle and keeps the handle as the pin
+	/// </summary>
+	class Win32ProcessBackend : public IProcessBackend {
+	public:
+		bool StartTime(uint32_t pid, uint64_t& startTime) override;
+		bool ImagePath(uint32_t pid, std::string& path) override;
+		void Unpin(uintptr_t pin) override;
+		bool Query(uint32_t pid, Details& details) override;
+	};
+#endif
+
+#ifdef __linux__
+	class ProcFsProcessBackend : public IProcessBackend {
+	public:
+		bool StartTime(uint32_t pid, uint64_t& startTime) override;
+		bool ImagePath(uint32_t pid, std::string& path) override;
+	};
+#endif
+
+	struct ProcessInfo {
+		ProcessKey key;
+		StringId exePath = 0;
+		StringId exe = 0; // File name of exePath
+	};
+
+	/// <summary>
+	/// Process metadata shared by every window of a process. Each window holds a reference
+	/// (Acquire/Release), the entry is evicted once the process has no windows left.
+	/// Thread safe, lookups happen on the window metadata worker while releases come from the UI thread.
+	/// </summary>
+	class ProcessCache {
+	public:
+		explicit ProcessCache(std::unique_ptr<IProcessBackend> backend);
+		~ProcessCache();
+
+		ProcessCache(const ProcessCache&) = delete;
+		ProcessCache& operator=(const ProcessCache&) = delete;
+
+		/// <summary>
+		/// Look up (or resolve) the process and add a window reference to it
+		/// </summary>
+		/// <returns>Nothing if the process is gone or can't be queried</returns>
+		std::optional<ProcessInfo> Acquire(uint32_t pid);
+
+		/// <summary>
+		/// Drop a window reference
+		/// </summary>
+		void Release(const ProcessKey& key);
+
+		std::string_view String(StringId id) const { return this->strings.Get(id); }
+		const char* CStr(StringId id) const { return this->strings.CStr(id); }
+
+		size_t Size() const;
+		uint64_t Hits() const { return this->hits.load(std::memory_order_relaxed); }
+		uint64_t Misses() const { return this->misses.load(std::memory_order_relaxed); }
+
+	private:
+		struct Entry {
+			ProcessInfo info;
+			uint32_t windows = 0;
+			uintptr_t pin = 0;
+			bool pinned = false;
+		};
+
+		std::unique_ptr<IProcessBackend> backend;
+		StringInterner strings;
+
+		mutable std::mutex mutex;
+		std::unordered_map<ProcessKey, Entry, ProcessKeyHash> entries;
+		std::unordered_map<uint32_t, ProcessKey> latest; // Newest cached instance of each pid
+
+		std::atomic<uint64_t> hits = 0;
+		std::atomic<uint64_t> misses = 0;
+	};
+} // namespace IMS
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "pch.h"
+
+// Define IMS_DISABLE_PROFILER to compile every IMS_PROFILE_SCOPE out of the binary
+
+namespace IMS {
+	enum class ProfileZone : uint8_t {
+		Frame,
+		MessagePump,
+		NewFrame,
+		TaskbarBuild,
+		StartMenuBuild,
+		Render,
+		Present,
+		KeyboardProc,
+		WndProc,
+		Count,
+	};
+
+	const char* ProfileZoneName(ProfileZone zone);
+
+	/// <summary>
+	/// Nearest-rank percentile of sorted values, 0 for none
+	/// </summary>
+	float ProfilePercentile(const std::vector<float>& sorted, float q);
+
+	struct ProfileSample {
+		uint64_t start = 0;    // Nanoseconds, steady clock
+		uint64_t duration = 0; // Nanoseconds
+		uint32_t thread = 0;
+		ProfileZone zone = ProfileZone::Frame;
+	};
+
+	/// <summary>
+	/// Collects scoped timings into a fixed size lock-free ring buffer (the oldest samples get overwritten).
+	/// Recording is off until enabled, when it's off a scope costs one relaxed load.
+	/// </summary>
+	class Profiler {
+	public:
+		static constexpr size_t kCapacity = 1 << 14;
+
+		static Profiler& Get();
+
+		static uint64_t Now() {
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		bool Enabled() const { return this->enabled.load(std::memory_order_relaxed); }
+		void SetEnabled(bool enabled) { this->enabled.store(enabled, std::memory_order_relaxed); }
+
+		/// <summary>
+		/// Safe to call from any thread
+		/// </summary>
+		void Record(ProfileZone zone, uint64_t start, uint64_t end);
+
+		/// <summary>
+		/// Copy the samples currently in the ring, oldest first
+		/// </summary>
+		void Snapshot(std::vector<ProfileSample>& out) const;
+
+		bool ExportCsv(const std::filesystem::path& path) const;
+		bool ExportChromeTrace(const std::filesystem::path& path) const;
+
+		/// <summary>
+		/// Percentiles per zone, a frame time graph and export buttons
+		/// </summary>
+		/// <param name="extra">Drawn at the bottom of the overlay window, for extra counters</param>
+		void DrawOverlay(bool* open, const std::function<void()>& extra = nullptr);
+
+	private:
+		Profiler() = default;
+
+		// Seqlock per slot, odd while being written
+		struct Slot {
+			std::atomic<uint64_t> sequence = 0;
+			std::atomic<uint64_t> start = 0;
+			std::atomic<uint64_t> duration = 0;
+			std::atomic<uint64_t> info = 0; // thread << 8 | zone
+		};
+
+		std::atomic<bool> enabled = false;
+		std::atomic<uint64_t> writeIndex = 0;
+		std::unique_ptr<Slot[]> slots = std::make_unique<Slot[]>(kCapacity);
+
+		// Overlay scratch, UI thread only
+		std::vector<ProfileSample> samples;
+		std::vector<float> durations;
+		std::vector<float> frameTimes;
+	};
+
+	class ProfileScope {
+	public:
+		explicit ProfileScope(ProfileZone zone) : zone(zone), start(Profiler::Get().Enabled() ? Profiler::Now() : 0) {}
+
+		~ProfileScope() {
+			if (this->start != 0)
+				Profiler::Get().Record(this->zone, this->start, Profiler::Now());
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+		ProfileZone zone;
+		uint64_t start;
+	};
+} // namespace IMS
+
+#define IMS_PROFILE_CONCAT_INNER(a, b) a##b
+#define IMS_PROFILE_CONCAT(a, b) IMS_PROFILE_CONCAT_INNER(a, b)
+
+#ifndef IMS_DISABLE_PROFILER
+#define IMS_PROFILE_SCOPE(zone) ::IMS::ProfileScope IMS_PROFILE_CONCAT(imsProfileScope, __LINE__)(::IMS::ProfileZone::zone)
+#else
+#define IMS_PROFILE_SCOPE(zone) ((void)0)
+#endif
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "pch.h"
+
+#include "process_cache.h"
+#include "snapshot_buffer.h"
+
+namespace IMS {
+	/// <summary>
+	/// One process in a system wide sample
+	/// </summary>
+	struct ProcessSample {
+		uint32_t pid = 0;
+		uint64_t startTime = 0;  // Same units as the platform's IProcessBackend::StartTime, so it matches ProcessKey
+		uint64_t cpuTime = 0;    // Nanoseconds of CPU time (user and kernel) since the process started
+		uint64_t workingSet = 0; // Bytes
+	};
+
+	/// <summary>
+	/// OS specific system wide process statistics for the ResourceSampler. Only called from the sampler thread.
+	/// </summary>
+	class IResourceBackend {
+	public:
+		virtual ~IResourceBackend() = default;
+
+		/// <summary>
+		/// Every running process, in one batched query where the OS has one
+		/// </summary>
+		/// <param name="out">Cleared first, reused between samples</param>
+		virtual bool Sample(std::vector<ProcessSample>& out) = 0;
+	};
+
+#ifdef _WIN32
+	/// <summary>
+	/// NtQuerySystemInformation(SystemProcessInformation): every process in one call, no process handles opened
+	/// </summary>
+	class Win32ResourceBackend : public IResourceBackend {
+	public:
+		bool Sample(std::vector<ProcessSample>& out) override;
+
+	private:
+		std::vector<uint64_t> buffer; // Grown to fit, 8 byte aligned
+	};
+#endif
+
+#ifdef __linux__
+	/// <summary>
+	/// /proc/[pid]/stat of every process, there's no batched query. For testing the sampler.
+	/// </summary>
+	class ProcFsResourceBackend : public IResourceBackend {
+	public:
+		bool Sample(std::vector<ProcessSample>& out) override;
+	};
+#endif
+
+	struct ProcessUsage {
+		ProcessKey key;
+		float cpu = 0;           // Cores kept busy since the previous sample, 1 is one core
+		uint64_t workingSet = 0; // Bytes
+	};
+
+	/// <summary>
+	/// A published sample
+	/// </summary>
+	struct ResourceSnapshot {
+		std::vector<ProcessUsage> processes; // By pid
+		uint32_t cores = 1;
+		uint64_t sequence = 0; // 0 until the first sample is published
+
+		/// <returns>Null if the process wasn't running at the time of the sample</returns>
+		const ProcessUsage* Find(const ProcessKey& key) const;
+	};
+
+	/// <summary>
+	/// Samples CPU and memory usage of every process on a background thread, one batched query per interval,
+	/// and hands the result to the UI thread through a lock-free SnapshotBuffer. CPU usage is the difference
+	/// of two samples, so the first one is only published once the second is in. The sampler times itself
+	/// and stretches the interval while a sample costs more than kBudget of a core.
+	/// </summary>
+	class ResourceSampler {
+	public:
+		static constexpr std::chrono::milliseconds kInterval{ 2000 };
+		static constexpr std::chrono::milliseconds kMaxInterval{ 16000 };
+		static constexpr double kBudget = 0.005; // Share of one core
+
+		/// <param name="backend">Null to sample nothing, Latest stays empty then</param>
+		/// <param name="onSample">Called on the sampler thread after a snapshot was published (to wake the UI)</param>
+		/// <param name="interval">Zero for no thread, samples are only taken by calling Sample then</param>
+		ResourceSampler(std::unique_ptr<IResourceBackend> backend, std::function<void()> onSample = nullptr, std::chrono::milliseconds interval = kInterval);
+		~ResourceSampler();
+
+		ResourceSampler(const ResourceSampler&) = delete;
+		ResourceSampler& operator=(const ResourceSampler&) = delete;
+
+		/// <summary>
+		/// Take a sample and publish it. The sampler thread's job, only call it on a sampler without one.
+		/// </summary>
+		/// <returns>False if the backend failed</returns>
+		bool Sample();
+
+		/// <summary>
+		/// Pick up the newest snapshot (UI thread)
+		/// </summary>
+		/// <returns>True if Latest changed</returns>
+		bool Update() { return this->buffer.Update(); }
+
+		/// <summary>
+		/// Snapshot picked up by the last Update (UI thread)
+		/// </summary>
+		const ResourceSnapshot& Latest() const { return this->buffer.Front(); }
+
+		std::chrono::milliseconds Interval() const { return std::chrono::milliseconds(this->interval.load(std::memory_order_relaxed)); }
+
+		/// <summary>
+		/// Share of one core spent sampling, averaged over recent samples
+		/// </summary>
+		double Cost() const { return this->cost.load(std::memory_order_relaxed); }
+
+		uint64_t Samples() const { return this->samples.load(std::memory_order_relaxed); }
+
+	private:
+		void Work(std::stop_token stop);
+
+		std::unique_ptr<IResourceBackend> backend;
+		std::function<void()> onSample;
+
+		// Sampler thread, sorted by pid
+		std::vector<ProcessSample> current;
+		std::vector<ProcessSample> previous;
+		std::chrono::steady_clock::time_point previousTime;
+		uint32_t cores = 1;
+
+		SnapshotBuffer<ResourceSnapshot> buffer;
+		std::atomic<int64_t> interval;
+		std::atomic<double> cost = 0;
+		std::atomic<uint64_t> samples = 0;
+
+		std::mutex mutex;
+		std::condition_variable_any wake;
+		std::jthread thread; // Last, so it stops before the rest goes away
+	};
+} // namespace IMS
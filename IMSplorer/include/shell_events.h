@@ -0,0 +1,55 @@
+#pragma once
+
+#include "pch.h"
+
+#include "window.h"
+
+namespace IMS {
+	enum class ShellEventType : uint8_t {
+		Created,
+		Destroyed,
+		Activated,
+		Replacing, // handle is the window doing the replacing
+		Replaced,  // handle is the window being replaced
+		Replace,   // A folded Replaced/Replacing pair, handle is replaced by other
+		Redraw,    // Title (or icon) changed
+	};
+
+	struct ShellEvent {
+		ShellEventType type = ShellEventType::Created;
+		WindowHandle handle = 0;
+		WindowHandle other = 0;
+	};
+
+	/// <summary>
+	/// Collects shell hook events over a frame and coalesces them before they're applied:
+	/// a window created and destroyed within the batch is only destroyed, duplicate
+	/// creations and redraws collapse, only the last activation is kept (and applied last), and
+	/// Replaced/Replacing pairs fold into a single Replace.
+	/// </summary>
+	class ShellEventQueue {
+	public:
+		void Push(ShellEventType type, WindowHandle handle);
+
+		/// <summary>
+		/// Coalesce everything pushed since the last call and clear the queue.
+		/// The returned batch is valid until the next call.
+		/// </summary>
+		const std::vector<ShellEvent>& Coalesce();
+
+		bool Empty() const { return this->pending.empty(); }
+
+		uint64_t Received() const { return this->received; }
+		uint64_t Applied() const { return this->applied; }
+
+	private:
+		std::vector<ShellEvent> pending;
+		std::vector<ShellEvent> batch;
+		std::vector<bool> dropped;
+		std::unordered_map<WindowHandle, size_t> created; // Handle -> index in batch of its pending creation
+		std::unordered_set<WindowHandle> redrawn;
+
+		uint64_t received = 0;
+		uint64_t applied = 0;
+	};
+} // namespace IMS
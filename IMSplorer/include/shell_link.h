@@ -0,0 +1,36 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	/// <summary>
+	/// What a shortcut points at, every string UTF-8. Environment variables (e.g. %windir%)
+	/// are left as stored by ParseShellLink and expanded by ReadShellLink.
+	/// </summary>
+	struct ShellLink {
+		std::string target;           // Full path of the target, empty if only an item id list is stored
+		std::string relativePath;     // Target relative to the .lnk file
+		std::string arguments;
+		std::string workingDirectory;
+		std::string iconLocation;     // File the icon comes from, empty to use the target's
+		int32_t iconIndex = 0;
+	};
+
+	/// <summary>
+	/// Parse a shell link (.lnk, [MS-SHLLINK]) without COM. Only reads `data`, every size and offset
+	/// is checked against it, so any input is safe to parse.
+	/// </summary>
+	/// <returns>Nothing if it's not a shell link or it's truncated</returns>
+	std::optional<ShellLink> ParseShellLink(std::span<const uint8_t> data);
+
+	/// <summary>
+	/// Map and parse a .lnk file. Expands environment variables, and resolves a link that only
+	/// stores a relative path against the folder the file is in.
+	/// </summary>
+	std::optional<ShellLink> ReadShellLink(const std::filesystem::path& path);
+
+	/// <summary>
+	/// Replace %NAME% with the value of the environment variable, unknown variables are left as is
+	/// </summary>
+	std::string ExpandEnvironmentVariables(std::string_view str);
+} // namespace IMS
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "pch.h"
+
+#include "spsc_queue.h" // kCacheLine
+
+namespace IMS {
+	/// <summary>
+	/// Lock-free handoff of the latest value from one writer thread to one reader thread. The writer fills
+	/// Back and publishes it, the reader picks up the newest published value with Update and reads Front.
+	/// It's double buffering with a spare slot in between, so publishing never waits for the reader to let
+	/// go of Front and neither side ever blocks. Slots are reused, values keep their capacity.
+	/// </summary>
+	template <typename T>
+	class SnapshotBuffer {
+	public:
+		/// <summary>
+		/// Slot to fill (writer), holds whatever was in it two publishes ago
+		/// </summary>
+		T& Back() { return this->slots[this->back]; }
+
+		/// <summary>
+		/// Hand Back over to the reader (writer)
+		/// </summary>
+		void Publish() {
+			this->back = this->spare.exchange(this->back | kFresh, std::memory_order_acq_rel) & kIndex;
+		}
+
+		/// <summary>
+		/// Switch Front to the newest published value (reader)
+		/// </summary>
+		/// <returns>False if nothing was published since the last call, Front is unchanged then</returns>
+		bool Update() {
+			if (!(this->spare.load(std::memory_order_relaxed) & kFresh)) return false;
+
+			this->front = this->spare.exchange(this->front, std::memory_order_acq_rel) & kIndex;
+			return true;
+		}
+
+		/// <summary>
+		/// Latest value picked up by Update (reader), default constructed before the first one
+		/// </summary>
+		const T& Front() const { return this->slots[this->front]; }
+
+	private:
+		static constexpr uint8_t kIndex = 3;
+		static constexpr uint8_t kFresh = 4; // Set while the spare slot holds a value the reader hasn't seen
+
+		std::array<T, 3> slots;
+		alignas(kCacheLine) uint8_t back = 0;
+		alignas(kCacheLine) std::atomic<uint8_t> spare = 1;
+		alignas(kCacheLine) uint8_t front = 2;
+	};
+} // namespace IMS
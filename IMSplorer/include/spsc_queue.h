@@ -0,0 +1,70 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	// std::hardware_destructive_interference_size is 64 on every target we care about,
+	// and using it in a header makes GCC warn about ABI stability
+	static constexpr size_t kCacheLine = 64;
+
+	/// <summary>
+	/// Bounded lock-free single producer, single consumer ring buffer.
+	/// Exactly one thread may push and exactly one (other) thread may pop.
+	/// </summary>
+	/// <typeparam name="T">Default constructible, move assignable element</typeparam>
+	/// <typeparam name="Capacity">Power of two</typeparam>
+	template <typename T, size_t Capacity>
+	class SpscQueue {
+		static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	public:
+		/// <returns>False if the queue is full, `value` is left untouched</returns>
+		bool TryPush(T&& value) {
+			size_t tail = this->tail.load(std::memory_order_relaxed);
+			if (tail - this->cachedHead == Capacity) {
+				this->cachedHead = this->head.load(std::memory_order_acquire);
+				if (tail - this->cachedHead == Capacity) return false;
+			}
+
+			this->slots[tail & (Capacity - 1)] = std::move(value);
+			this->tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool TryPush(const T& value) {
+			T copy = value;
+			return this->TryPush(std::move(copy));
+		}
+
+		/// <returns>False if the queue is empty</returns>
+		bool TryPop(T& out) {
+			size_t head = this->head.load(std::memory_order_relaxed);
+			if (head == this->cachedTail) {
+				this->cachedTail = this->tail.load(std::memory_order_acquire);
+				if (head == this->cachedTail) return false;
+			}
+
+			out = std::move(this->slots[head & (Capacity - 1)]);
+			this->head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		/// <summary>
+		/// Approximate, only exact when called from one of the two threads while the other is idle
+		/// </summary>
+		size_t SizeApprox() const {
+			return this->tail.load(std::memory_order_acquire) - this->head.load(std::memory_order_acquire);
+		}
+
+		static constexpr size_t capacity = Capacity;
+
+	private:
+		// Producer and consumer indices live on separate cache lines, each side also
+		// keeps a cached copy of the other's index so it only touches the shared line when needed
+		alignas(kCacheLine) std::atomic<size_t> tail = 0;
+		size_t cachedHead = 0;
+		alignas(kCacheLine) std::atomic<size_t> head = 0;
+		size_t cachedTail = 0;
+		std::unique_ptr<T[]> slots = std::make_unique<T[]>(Capacity);
+	};
+} // namespace IMS
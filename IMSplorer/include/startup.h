@@ -0,0 +1,97 @@
+#pragma once
+
+#include "pch.h"
+
+namespace IMS {
+	/// <summary>
+	/// Dependency graph of startup work. Tasks that have to stay on the calling thread (window, device,
+	/// ImGui context) run there in order of readiness, the rest run on workers at the same time.
+	/// Every task is timed, LogReport prints where the startup time went.
+	/// </summary>
+	class StartupGraph {
+	public:
+		using TaskId = size_t;
+		static constexpr TaskId kNone = SIZE_MAX;
+
+		enum class Affinity : uint8_t {
+			Any,  // Any worker
+			Main, // The thread calling Run
+		};
+
+		enum class Status : uint8_t {
+			Pending,
+			Done,
+			Failed,  // Returned false
+			Skipped, // A dependency failed or was skipped
+		};
+
+		struct Timing {
+			std::string_view name;
+			double start = 0;    // Milliseconds since Run started
+			double duration = 0; // Milliseconds
+			uint32_t thread = 0; // 0 is the main thread, workers count up from 1
+			Status status = Status::Pending;
+		};
+
+		StartupGraph() : epoch(std::chrono::steady_clock::now()) {}
+
+		StartupGraph(const StartupGraph&) = delete;
+		StartupGraph& operator=(const StartupGraph&) = delete;
+
+		/// <summary>
+		/// Add a task that runs once every dependency is done, dependencies have to be added first
+		/// (so there can't be cycles). kNone entries in `dependencies` are ignored.
+		/// </summary>
+		/// <param name="work">Returns false on failure, whatever depends on it is skipped</param>
+		TaskId Add(std::string name, std::function<bool()> work, std::vector<TaskId> dependencies = {}, Affinity affinity = Affinity::Any);
+
+		/// <summary>
+		/// Run every task and wait for them, call once
+		/// </summary>
+		/// <param name="workers">Worker threads, 0 runs everything on the calling thread in order of readiness</param>
+		/// <returns>False if any task failed or was skipped</returns>
+		bool Run(size_t workers = (std::max)(std::thread::hardware_concurrency(), 2u) - 1);
+
+		Status TaskStatus(TaskId id) const { return this->tasks[id].timing.status; }
+		const Timing& TaskTiming(TaskId id) const { return this->tasks[id].timing; }
+		size_t Size() const { return this->tasks.size(); }
+
+		/// <summary>
+		/// When the graph was created, to time later milestones (the first frame) against
+		/// </summary>
+		std::chrono::steady_clock::time_point Epoch() const { return this->epoch; }
+
+		/// <summary>
+		/// Log every task's timing in start order, then the total
+		/// </summary>
+		void LogReport() const;
+
+	private:
+		struct Task {
+			std::string name;
+			std::function<bool()> work;
+			std::vector<TaskId> dependents;
+			size_t waiting = 0; // Dependencies not done yet
+			Affinity affinity = Affinity::Any;
+			Timing timing;
+		};
+
+		void Execute(TaskId id, uint32_t thread, std::unique_lock<std::mutex>& lock);
+		void Ready(TaskId id);
+		void Finish(TaskId id, Status status);
+
+		std::chrono::steady_clock::time_point epoch;
+		std::chrono::steady_clock::time_point begin;
+		double total = 0;
+		bool ran = false;
+		bool inlineOnly = false; // No workers, Any tasks run on the main thread too
+
+		std::vector<Task> tasks;
+
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::deque<TaskId> mainReady;
+		std::deque<TaskId> anyReady;
+		size_t finished = 0;
+	};
+} // namespace IMS
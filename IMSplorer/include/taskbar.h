@@ -2,60 +2,175 @@
 
 #include "pch.h"
 
-namespace IMS {
-	struct Window {
-		std::string exe;
-		bool isFocused = false;
-	};
+#include "allocation_counters.h"
+#include "app_index.h"
+#include "app_search.h"
+#include "command_index.h"
+#include "dir_watcher.h"
+#include "frame_arena.h"
+#include "frame_scheduler.h"
+#include "hotkeys.h"
+#include "icon_cache.h"
+#include "launch_history.h"
+#include "platform.h"
+#include "profiler.h"
+#include "resource_sampler.h"
+#include "shell_events.h"
+#include "startup.h"
+#include "text_cache.h"
+#include "trace.h"
+#include "window.h"
+#include "window_info_worker.h"
+#include "window_registry.h"
 
-	class Taskbar {
+namespace IMS {
+	/// <summary>
+	/// The taskbar and the Start menu. Everything OS specific goes through the platform,
+	/// which has to outlive the taskbar (it owns the ImGui context).
+	/// </summary>
+	class Taskbar : public IPlatformHost {
 	public:
-		Taskbar(const std::string& title);
-		~Taskbar();
+		/// <summary>
+		/// Cheap, nothing is loaded until the startup tasks run
+		/// </summary>
+		explicit Taskbar(IPlatform& platform);
+		~Taskbar() override;
+
+		/// <summary>
+		/// Load the Start menu index and list the open windows on workers, then apply the style once ImGui is up
+		/// </summary>
+		/// <param name="shellReady">Windows are listed after this, so none are missed between the listing and the shell hook</param>
+		/// <param name="uiReady">The ImGui context exists after this</param>
+		void AddStartupTasks(StartupGraph& graph, StartupGraph::TaskId shellReady, StartupGraph::TaskId uiReady);
+
+		/// <summary>
+		/// Run the startup tasks on the calling thread, for platforms that are ready as soon as they're constructed
+		/// </summary>
+		bool Init();
 
+		/// <summary>
+		/// Wait for work, update and render until the platform quits
+		/// </summary>
 		void Run();
 
-		int width = 0;
-		int height = 0;
+		/// <summary>
+		/// Pump events and apply everything that came in since the last call (shell events, resolved windows)
+		/// </summary>
+		/// <returns>False once the platform wants to quit</returns>
+		bool Update();
 
-	//private:
-		HHOOK kbdHook = nullptr;
+		/// <summary>
+		/// Build the ImGui windows, between the platform's BeginFrame and EndFrame
+		/// </summary>
+		void BuildFrame();
+
+		// IPlatformHost
+		void OnShellEvent(ShellEventType type, WindowHandle handle) override;
+		bool OnKey(uint8_t key, bool down) override;
+		void OnKeyStateLost() override;
+		void OnInvalidate() override { this->scheduler.Invalidate(); }
+		void OnEnvironmentChanged() override;
 
-		static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
-		static LRESULT CALLBACK KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
+		/// <summary>
+		/// Record shell events, hook keys and UI input into the trace from now on, null to stop.
+		/// Set it before the startup tasks run so the windows listed at startup are in it.
+		/// </summary>
+		void SetRecorder(TraceRecorder* recorder) { this->recorder = recorder; }
+
+	//private:
+		void AddWindow(WindowHandle handle);
+		void RemoveWindow(WindowHandle handle);
+		void ApplyShellEvents();
+		void OnAppsChanged();
 
-		void InitWindow();
-		void InitShell() const;
-		void InitD3D();
-		void InitImGui();
+		void ApplyStyle();
+		void BuildTaskbar();
+		void UpdateClock();
+		bool BuildTaskButton(std::span<const WindowHandle> handles, float stripEnd);
+		void BuildWindowList(std::span<const WindowHandle> handles);
+		void BuildOverflow(size_t shown, float size);
+		void RebuildGroups();
+		bool GroupUsage(std::span<const WindowHandle> handles, ProcessUsage& total);
+		void BuildStartMenu();
+		void BuildCommandList(bool submitted);
+		void RunCommand(std::string_view command, std::string_view arguments);
+		static int SearchCallback(ImGuiInputTextCallbackData* data);
+		void DrawIcon(const IconCache::Icon& icon, ImVec2 min, float size);
 
-		// DX11
-		ID3D11Device* device = nullptr;
-		ID3D11DeviceContext* deviceContext = nullptr;
-		IDXGISwapChain* swapChain = nullptr;
-		ID3D11RenderTargetView* renderTargetView = nullptr;
+		IPlatform& platform;
+		HotkeyEngine hotkeys;
 
 		// ImGui
-		ImGuiContext* imguiContext = nullptr;
-		ImGuiIO* imguiIO = nullptr;
 		ImGuiStyle* imguiStyle = nullptr;
 
-		// Window
-		HWND hWnd = nullptr;
-		WNDCLASSEX wc = { 0 };
-		std::string title = "";
+		// Window flags
+		bool isRunning = true;
 
-		// Window properties
-		int resizeWidth = 0;
-		int resizeHeight = 0;
-		bool occluded = false;
+		// Startup
+		std::optional<std::chrono::steady_clock::time_point> startupEpoch; // Until the first frame is logged
+		std::vector<WindowHandle> startupWindows;                          // Listed by a worker, added on the UI thread
 
-		// Window flags
-		bool isRunning = false;
+		TraceRecorder* recorder = nullptr;
+
+		// Frame scheduling, only render when something changed
+		FrameScheduler scheduler{ this->platform.Clock(), this->platform.Events() };
 
 		// TB data
-		std::unordered_map<HWND, Window> windows;
+		WindowRegistry<Window> windows;
+		ShellEventQueue shellEvents;
+		ProcessCache processCache{ this->platform.CreateProcessBackend() };
+		WindowInfoWorker windowWorker{ this->platform.CreateWindowResolver(this->processCache), [this]() { this->platform.Events().Wake(); } };
+		IconCache icons{ this->platform.CreateIconBackend(), [this]() { this->platform.Events().Wake(); } };
+		std::vector<WindowHandle> overflowWindows; // Rebuilt while the overflow popup is open
+
+		// CPU and memory per process, shown in button tooltips and optionally as a tint
+		// Samples only wake the UI while usage is on screen, an idle taskbar stays asleep otherwise
+		// usageShown comes first, the sampler's thread reads it from construction until destruction
+		bool showUsageTint = false;
+		std::atomic<bool> usageShown = false; // The last frame showed usage, a new sample redraws it. Read by the sampler.
+		ResourceSampler resources{ this->platform.CreateResourceBackend(), [this]() { if (this->usageShown.load(std::memory_order_relaxed)) this->platform.Events().Wake(); } };
+		std::vector<ProcessKey> usageCounted; // GroupUsage scratch
+
+		// Windows sharing an exe collapse into one button
+		struct AppGroup {
+			StringId exePath = 0; // 0 for a window that isn't resolved yet, alone in its group
+			std::vector<WindowHandle> windows;
+		};
+		bool groupByApp = false;
+		bool groupsDirty = true;
+		std::vector<AppGroup> groups;
+		std::unordered_map<StringId, size_t> groupSlots; // exePath -> index in groups, rebuild scratch
+
+		// Transient strings for the frame being built, reset at its end
+		FrameArena frameArena;
+		AllocationStats frameAllocations; // Heap allocations of the last rendered frame, UI thread
+
+		// The clock is formatted when the displayed second changes, not every frame
+		time_t clockSecond = -1;
+		char clockTime[16] = "";
+		char clockDate[64] = "";
+
+		// Layout
+		TextWidthCache textWidths;
+		TextWidthCache::Slot clockTimeText;
+		TextWidthCache::Slot clockDateText;
+		TextWidthCache::Slot placeholderText;
 		bool showStartMenu = false;
-		float tbHeight = 48.0f;
+		bool startMenuWasOpen = false;
+		bool showProfiler = false;
+
+		// Start menu data
+		AppIndex appIndex;
+		LaunchHistory launchHistory; // Ranks what gets launched higher, loaded by a startup task
+		AppSearch appSearch;
+		std::vector<std::filesystem::path> appRoots;
+		std::atomic<bool> appsChanged = false; // A new snapshot was published off the UI thread
+		DirWatcher appWatcher{ this->platform.CreateDirWatchBackend(), [this](const FileChangeBatch& batch) {
+			if (this->appIndex.ApplyChanges(batch, this->appRoots)) this->OnAppsChanged();
+		} };
+		CommandIndex commandIndex; // Run mode, after what its refresh callback touches
+		char searchBuffer[256] = { 0 };
+		size_t searchRows = 0; // Results ranked for the query, grows by a page when the list is scrolled to the end
+		bool focusSearch = false; // Next frame, with the cursor at the end
 	};
 } // namespace IMS
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "pch.h"
+
+#include "process_cache.h"
+
+namespace IMS {
+	/// <summary>
+	/// Text widths in the current font, so labels that don't change aren't measured every frame.
+	/// Interned strings are cached by id, anything else in a Slot the caller keeps.
+	/// Everything is forgotten when the font or its size changes (DPI). UI thread only.
+	/// </summary>
+	class TextWidthCache {
+	public:
+		/// <summary>
+		/// The last text measured through it and its width
+		/// </summary>
+		struct Slot {
+			std::string text;
+			float width = 0;
+			uint32_t generation = 0; // 0 is never measured
+		};
+
+		/// <summary>
+		/// Forget every width if the current font isn't the one they were measured with, once per frame inside one
+		/// </summary>
+		void Validate();
+
+		/// <param name="text">The string `id` was interned from</param>
+		float Width(StringId id, std::string_view text);
+
+		/// <summary>
+		/// Width of `text`, measured again only if it differs from the slot's last text
+		/// </summary>
+		float Width(Slot& slot, std::string_view text);
+
+		uint64_t Hits() const { return this->hits; }
+		uint64_t Misses() const { return this->misses; }
+
+	private:
+		ImFont* font = nullptr;
+		float fontSize = 0;
+		uint32_t generation = 1;
+
+		std::vector<float> widths; // By StringId, negative until measured
+
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+	};
+} // namespace IMS
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "pch.h"
+
+#include "shell_events.h"
+#include "window.h"
+
+namespace IMS {
+	enum class TraceEventKind : uint8_t {
+		Shell,       // code: ShellEventType
+		Key,         // Low level keyboard hook, code: virtual key
+		Existing,    // A window listed at startup
+		Window,      // A window was resolved. code: title length, x: exe name length, y: exe id (same exe, same id)
+		Title,       // A window's title was read again, code: its length
+		Screen,      // x, y: screen size, code: taskbar height
+		MousePos,    // x, y: screen position, INT16_MIN for none
+		MouseButton, // code: button
+		MouseWheel,  // x, y: horizontal and vertical steps of 1/120
+		UiKey,       // code: ImGuiKey
+		Char,        // code: UTF-16 code unit
+		Frame,       // A frame was built, everything since is on screen
+	};
+
+	/// <summary>
+	/// One fixed size trace record. Input for ImGui (MousePos to Char) is what the frame it's recorded before saw,
+	/// so it's fed in right before that frame when replayed.
+	/// </summary>
+	struct TraceEvent {
+		int64_t time = 0;    // Microseconds since the recording started
+		uint64_t handle = 0; // Window, for Shell, Existing, Window and Title
+		uint16_t code = 0;
+		int16_t x = 0;
+		int16_t y = 0;
+		TraceEventKind kind = TraceEventKind::Frame;
+		uint8_t down = 0;    // Key and MouseButton
+	};
+
+	/// <summary>
+	/// On-disk layout, native endianness: the header, then TraceEvents in the order they happened
+	/// </summary>
+	struct TraceFileHeader {
+		static constexpr char kMagic[8] = { 'I', 'M', 'S', 'T', 'R', 'A', 'C', 'E' };
+		static constexpr uint32_t kVersion = 1;
+
+		char magic[8] = {};
+		uint32_t version = 0;
+		uint32_t headerSize = 0; // sizeof(TraceFileHeader)
+		uint32_t eventSize = 0;  // sizeof(TraceEvent)
+		uint32_t reserved = 0;
+	};
+
+	/// <summary>
+	/// Appends events to a trace file, buffered
+	/// </summary>
+	class TraceWriter {
+	public:
+		TraceWriter() = default;
+		~TraceWriter() { this->Close(); }
+
+		TraceWriter(const TraceWriter&) = delete;
+		TraceWriter& operator=(const TraceWriter&) = delete;
+
+		/// <summary>
+		/// Create (or replace) the file and write the header
+		/// </summary>
+		bool Open(const std::filesystem::path& path);
+
+		void Write(const TraceEvent& event);
+
+		/// <summary>
+		/// Write out whatever is buffered
+		/// </summary>
+		bool Flush();
+
+		bool Close();
+
+		bool IsOpen() const { return this->out.is_open(); }
+		uint64_t Events() const { return this->events; }
+
+	private:
+		static constexpr size_t kBufferSize = 1024;
+
+		std::ofstream out;
+		std::vector<TraceEvent> buffer;
+		uint64_t events = 0;
+	};
+
+	/// <summary>
+	/// Read a whole trace. A record cut short at the end (the recording didn't get to close the file) is dropped.
+	/// </summary>
+	bool LoadTrace(const std::filesystem::path& path, std::vector<TraceEvent>& events);
+
+	/// <summary>
+	/// Records what drives the taskbar: shell events, the keyboard hook, and the mouse and keyboard input ImGui
+	/// sees, with timestamps, so a session can be replayed headlessly. Titles and exe names are only recorded as
+	/// lengths, exes as ids. Keys from the hook are only kept while Win, Ctrl or Alt is held (all a shortcut can
+	/// be), so typing into other applications stays out of the trace. UI thread only.
+	/// </summary>
+	class TraceRecorder {
+	public:
+		bool Open(const std::filesystem::path& path);
+
+		void Shell(ShellEventType type, WindowHandle handle);
+		void Key(uint8_t key, bool down);
+		void Existing(WindowHandle handle);
+		void Window(WindowHandle handle, std::string_view exePath, std::string_view exe, std::string_view title);
+		void Title(WindowHandle handle, std::string_view title);
+
+		/// <summary>
+		/// Record what changed in ImGui's input since the last frame, once per frame after NewFrame
+		/// </summary>
+		void Input(ImVec2 screenSize, float taskbarHeight);
+
+		/// <summary>
+		/// A frame was built
+		/// </summary>
+		void Frame();
+
+		bool Close() { return this->writer.Close(); }
+
+		uint64_t Events() const { return this->writer.Events(); }
+
+	private:
+		static constexpr ImGuiKey kMods[] = { ImGuiMod_Ctrl, ImGuiMod_Shift, ImGuiMod_Alt, ImGuiMod_Super };
+		static constexpr size_t kUiKeys = ImGuiKey_NamedKey_COUNT + std::size(kMods);
+
+		int64_t Now() const;
+		void Write(TraceEventKind kind, uint64_t handle = 0, uint16_t code = 0, int16_t x = 0, int16_t y = 0, bool down = false);
+
+		TraceWriter writer;
+		std::chrono::steady_clock::time_point start;
+		std::chrono::steady_clock::time_point flushed;
+
+		std::bitset<256> hookDown;     // Every key the hook reported down
+		std::bitset<256> hookRecorded; // Keys whose press was recorded, their release is too
+
+		// Input as of the last frame
+		ImVec2 screenSize = ImVec2(0, 0);
+		float taskbarHeight = 0;
+		int16_t mouseX = INT16_MIN;
+		int16_t mouseY = INT16_MIN;
+		std::array<bool, ImGuiMouseButton_COUNT> mouseDown{};
+		std::bitset<kUiKeys> uiKeys;
+
+		std::unordered_map<std::string, uint16_t> exeIds; // Exe path -> id, in order of appearance
+	};
+} // namespace IMS
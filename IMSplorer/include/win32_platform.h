@@ -0,0 +1,127 @@
+#pragma once
+
+#include "pch.h"
+
+#include "font_cache.h"
+#include "frame_diff.h"
+#include "platform.h"
+#include "startup.h"
+
+#ifdef _WIN32
+namespace IMS {
+	/// <summary>
+	/// The real shell: a topmost Win32 window rendered with D3D11, the shell hook and the low level keyboard hook
+	/// </summary>
+	class Win32Platform : public IPlatform {
+	public:
+		struct StartupTasks {
+			StartupGraph::TaskId shell; // Shell hook registered, windows created from here on are reported
+			StartupGraph::TaskId ready; // Everything, a Taskbar can draw
+		};
+
+		Win32Platform() = default;
+		~Win32Platform() override;
+
+		Win32Platform(const Win32Platform&) = delete;
+		Win32Platform& operator=(const Win32Platform&) = delete;
+
+		/// <summary>
+		/// Create the window, the device and the ImGui context, then become the shell
+		/// </summary>
+		/// <returns>False if the window couldn't be created</returns>
+		bool Init(const std::string& title);
+
+		/// <summary>
+		/// Same as Init, as tasks on a startup graph: the font atlas is built on a worker
+		/// while the window and the device are created on the main thread
+		/// </summary>
+		StartupTasks AddStartupTasks(StartupGraph& graph, const std::string& title);
+
+		void SetHost(IPlatformHost* host) override { this->host = host; }
+
+		IClock& Clock() override { return this->clock; }
+		IEventSource& Events() override { return this->events; }
+		bool PumpEvents() override;
+		std::function<bool(uint8_t key)> KeyStateQuery() override;
+
+		void EnumerateWindows(const std::function<void(WindowHandle)>& callback) override;
+		bool IsTaskbarWindow(WindowHandle handle) override;
+		std::string WindowTitle(WindowHandle handle) override;
+		void ActivateWindow(WindowHandle handle) override;
+		void MinimizeWindow(WindowHandle handle) override;
+		void CloseWindow(WindowHandle handle) override;
+
+		std::unique_ptr<IProcessBackend> CreateProcessBackend() override;
+		std::unique_ptr<IWindowInfoResolver> CreateWindowResolver(ProcessCache& processes) override;
+		std::unique_ptr<IResourceBackend> CreateResourceBackend() override { return std::make_unique<Win32ResourceBackend>(); }
+
+		std::vector<std::filesystem::path> AppRoots() override;
+		std::filesystem::path CacheDirectory() override;
+		std::unique_ptr<IDirWatchBackend> CreateDirWatchBackend() override { return std::make_unique<Win32DirWatchBackend>(); }
+		void Launch(std::string_view path) override;
+		CommandSources CommandPaths() override { return CommandIndex::DefaultSources(); }
+		void LaunchCommand(std::string_view file, std::string_view arguments) override;
+
+		std::unique_ptr<IIconBackend> CreateIconBackend() override { return std::make_unique<Win32IconBackend>(this->device, this->deviceContext, this->textureUpdates); }
+		ImVec2 ScreenSize() override;
+		ImVec2 WindowSize() override { return ImVec2((float)this->width, (float)this->height); }
+		float TaskbarHeight() override { return this->tbHeight; }
+
+		bool BeginFrame() override;
+		void EndFrame() override;
+
+	private:
+		static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+		static LRESULT CALLBACK KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
+		static void CALLBACK DesktopSwitchProc(HWINEVENTHOOK hook, DWORD event, HWND hWnd, LONG idObject, LONG idChild, DWORD thread, DWORD time);
+
+		bool InitWindow();
+		void InitShell();
+		void InitD3D();
+		bool BuildFonts();
+		void InitImGui();
+		void SelectFont(float dpiScale);
+		void InitHooks();
+		void RenderViewports();
+
+		IPlatformHost* host = nullptr;
+
+		SystemClock clock;
+		Win32EventSource events;
+
+		HHOOK kbdHook = nullptr;
+		HWINEVENTHOOK desktopHook = nullptr; // Secure desktop (Ctrl+Alt+Del, UAC) on and off
+		bool sessionNotifications = false;   // WM_WTSSESSION_CHANGE for locking and unlocking
+
+		// DX11
+		ID3D11Device* device = nullptr;
+		ID3D11DeviceContext* deviceContext = nullptr;
+		IDXGISwapChain* swapChain = nullptr;
+		ID3D11RenderTargetView* renderTargetView = nullptr;
+
+		// Viewports whose draw data didn't change since they were last drawn aren't submitted or presented again
+		FrameDiff frameDiff;
+		uint64_t textureUpdates = 0; // Icon atlas uploads, part of every viewport's hash
+
+		// ImGui
+		std::unique_ptr<FontAtlasCache> fontCache;
+		ImFontAtlas* fontAtlas = nullptr; // Built before the context exists, so owned by us
+		ImGuiContext* imguiContext = nullptr;
+		ImGuiIO* imguiIO = nullptr;
+
+		// Window
+		HWND hWnd = nullptr;
+		WNDCLASSEX wc = { 0 };
+		std::string title = "";
+		UINT shellHookMessage = 0;
+
+		// Window properties
+		int width = 0;
+		int height = 0;
+		int resizeWidth = 0;
+		int resizeHeight = 0;
+		bool occluded = false;
+		float tbHeight = 48.0f;
+	};
+} // namespace IMS
+#endif
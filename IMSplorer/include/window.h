@@ -0,0 +1,36 @@
+#pragma once
+
+#include "pch.h"
+
+#include "process_cache.h"
+
+namespace IMS {
+	/// <summary>
+	/// Platform window handle (HWND on Windows)
+	/// </summary>
+	using WindowHandle = std::uintptr_t;
+
+	/// <summary>
+	/// A taskbar entry. Entries start out as placeholders and are filled in once the
+	/// metadata worker has resolved the owning process.
+	/// </summary>
+	struct Window {
+		ProcessKey process;
+		StringId exePath = 0; // Interned in the ProcessCache
+		StringId exe = 0;
+		std::string title; // Refreshed when the shell reports a redraw
+		bool resolved = false;
+	};
+
+	/// <summary>
+	/// Everything the metadata worker finds out about a window
+	/// </summary>
+	struct WindowInfo {
+		WindowHandle handle = 0;
+		ProcessKey process; // Holds a ProcessCache reference when valid
+		StringId exePath = 0;
+		StringId exe = 0;
+		std::string title;
+		bool valid = false; // False if the window shouldn't be on the taskbar
+	};
+} // namespace IMS
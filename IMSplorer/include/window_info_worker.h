@@ -0,0 +1,94 @@
+#pragma once
+
+#include "pch.h"
+
+#include "process_cache.h"
+#include "spsc_queue.h"
+#include "window.h"
+
+namespace IMS {
+	/// <summary>
+	/// Looks up the metadata of a window. Runs on the worker thread, so it's allowed to block.
+	/// </summary>
+	class IWindowInfoResolver {
+	public:
+		virtual ~IWindowInfoResolver() = default;
+
+		virtual WindowInfo Resolve(WindowHandle handle) = 0;
+	};
+
+#ifdef _WIN32
+	class Win32WindowResolver : public IWindowInfoResolver {
+	public:
+		explicit Win32WindowResolver(ProcessCache& processes) : processes(processes) {}
+
+		WindowInfo Resolve(WindowHandle handle) override;
+
+	private:
+		ProcessCache& processes;
+	};
+#endif
+
+	/// <summary>
+	/// Resolves window metadata on a background thread. The UI thread submits handles with
+	/// Request and collects finished records with Drain once per frame; both directions go
+	/// through lock-free SPSC queues, so neither side ever waits on the other.
+	/// </summary>
+	class WindowInfoWorker {
+	public:
+		static constexpr size_t kQueueSize = 1024;
+
+		/// <param name="resolver">Used from the worker thread only</param>
+		/// <param name="onReady">Called on the worker thread after results were queued (to wake the UI)</param>
+		WindowInfoWorker(std::unique_ptr<IWindowInfoResolver> resolver, std::function<void()> onReady = nullptr);
+		~WindowInfoWorker();
+
+		WindowInfoWorker(const WindowInfoWorker&) = delete;
+		WindowInfoWorker& operator=(const WindowInfoWorker&) = delete;
+
+		/// <summary>
+		/// Queue a window for resolving (UI thread)
+		/// </summary>
+		void Request(WindowHandle handle);
+
+		/// <summary>
+		/// Hand every finished record to `callback` (UI thread)
+		/// </summary>
+		/// <returns>Number of records drained</returns>
+		template <typename Callback>
+		size_t Drain(Callback&& callback) {
+			this->FlushBacklog();
+
+			size_t count = 0;
+			while (this->results.TryPop(this->drained)) {
+				this->inFlight.fetch_sub(1, std::memory_order_relaxed);
+				callback(this->drained);
+				count++;
+			}
+			return count;
+		}
+
+		/// <summary>
+		/// Requests submitted but not drained yet
+		/// </summary>
+		size_t InFlight() const { return this->inFlight.load(std::memory_order_relaxed); }
+
+	private:
+		void FlushBacklog();
+		void Work(std::stop_token stop);
+
+		std::unique_ptr<IWindowInfoResolver> resolver;
+		std::function<void()> onReady;
+
+		SpscQueue<WindowHandle, kQueueSize> requests;
+		SpscQueue<WindowInfo, kQueueSize> results;
+		std::counting_semaphore<> pending{ 0 };
+		std::atomic<size_t> inFlight = 0;
+
+		// UI thread only: requests that didn't fit in the queue yet, and the record being drained
+		std::vector<WindowHandle> backlog;
+		WindowInfo drained;
+
+		std::jthread thread;
+	};
+} // namespace IMS
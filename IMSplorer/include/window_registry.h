@@ -0,0 +1,197 @@
+#pragma once
+
+#include "pch.h"
+
+#include "window.h"
+
+namespace IMS {
+	/// <summary>
+	/// Ordered set of taskbar windows. Records are stored contiguously in display order
+	/// (insertion order unless moved), a handle -> slot map gives O(1) lookups, and the
+	/// focused window is a single slot index so focus changes are O(1) too.
+	/// Erasing leaves a tombstone, tombstones get compacted away once they're a good share of the slots.
+	/// </summary>
+	template <typename T>
+	class WindowRegistry {
+	public:
+		static constexpr uint32_t kNone = UINT32_MAX;
+
+		struct Record {
+			WindowHandle handle = 0;
+			T value{};
+			bool alive = false;
+		};
+
+		template <typename RecordT>
+		class Iterator {
+		public:
+			Iterator(RecordT* it, RecordT* end) : it(it), end(end) { this->Skip(); }
+
+			RecordT& operator*() const { return *this->it; }
+			RecordT* operator->() const { return this->it; }
+			Iterator& operator++() { ++this->it; this->Skip(); return *this; }
+			bool operator!=(const Iterator& other) const { return this->it != other.it; }
+			bool operator==(const Iterator& other) const { return this->it == other.it; }
+
+		private:
+			void Skip() { while (this->it != this->end && !this->it->alive) ++this->it; }
+
+			RecordT* it;
+			RecordT* end;
+		};
+
+		Iterator<Record> begin() { return { this->records.data(), this->records.data() + this->records.size() }; }
+		Iterator<Record> end() { return { this->records.data() + this->records.size(), this->records.data() + this->records.size() }; }
+		Iterator<const Record> begin() const { return { this->records.data(), this->records.data() + this->records.size() }; }
+		Iterator<const Record> end() const { return { this->records.data() + this->records.size(), this->records.data() + this->records.size() }; }
+
+		size_t Size() const { return this->slots.size(); }
+		bool Empty() const { return this->slots.empty(); }
+		bool Contains(WindowHandle handle) const { return this->slots.contains(handle); }
+
+		T* Find(WindowHandle handle) {
+			auto it = this->slots.find(handle);
+			return it == this->slots.end() ? nullptr : &this->records[it->second].value;
+		}
+
+		const T* Find(WindowHandle handle) const {
+			auto it = this->slots.find(handle);
+			return it == this->slots.end() ? nullptr : &this->records[it->second].value;
+		}
+
+		/// <summary>
+		/// Append a window, or return the existing one
+		/// </summary>
+		T& Insert(WindowHandle handle, T value = {}) {
+			auto [it, inserted] = this->slots.try_emplace(handle, (uint32_t)this->records.size());
+			if (!inserted) return this->records[it->second].value;
+
+			this->records.push_back({ handle, std::move(value), true });
+			return this->records.back().value;
+		}
+
+		bool Erase(WindowHandle handle) {
+			auto it = this->slots.find(handle);
+			if (it == this->slots.end()) return false;
+
+			uint32_t slot = it->second;
+			this->slots.erase(it);
+
+			if (this->focused == slot)
+				this->focused = kNone;
+
+			this->records[slot] = {};
+			this->dead++;
+
+			// Trailing tombstones can go right away, the rest waits for a compaction
+			while (!this->records.empty() && !this->records.back().alive) {
+				this->records.pop_back();
+				this->dead--;
+			}
+
+			if (this->dead > 32 && this->dead * 2 > this->records.size())
+				this->Compact();
+
+			return true;
+		}
+
+		/// <summary>
+		/// Focus a window, an unknown handle clears the focus (something that isn't on the taskbar got focused)
+		/// </summary>
+		/// <returns>True if the window is known</returns>
+		bool Activate(WindowHandle handle) {
+			auto it = this->slots.find(handle);
+			this->focused = it == this->slots.end() ? kNone : it->second;
+			return this->focused != kNone;
+		}
+
+		void ClearFocus() { this->focused = kNone; }
+
+		bool IsFocused(WindowHandle handle) const {
+			return this->focused != kNone && this->records[this->focused].handle == handle;
+		}
+
+		WindowHandle Focused() const {
+			return this->focused == kNone ? 0 : this->records[this->focused].handle;
+		}
+
+		/// <summary>
+		/// Give a window a new handle, keeping its place and focus (e.g. a hung window replaced by its ghost)
+		/// </summary>
+		bool Rekey(WindowHandle from, WindowHandle to) {
+			if (from == to || this->slots.contains(to)) return false;
+
+			auto it = this->slots.find(from);
+			if (it == this->slots.end()) return false;
+
+			uint32_t slot = it->second;
+			this->slots.erase(it);
+			this->slots.emplace(to, slot);
+			this->records[slot].handle = to;
+			return true;
+		}
+
+		/// <summary>
+		/// Move a window to `position` in display order (user reordering)
+		/// </summary>
+		bool Move(WindowHandle handle, size_t position) {
+			if (!this->slots.contains(handle)) return false;
+
+			this->Compact();
+
+			uint32_t from = this->slots[handle];
+			uint32_t to = (uint32_t)(std::min)(position, this->records.size() - 1);
+			if (from == to) return true;
+
+			WindowHandle focusedHandle = this->Focused();
+
+			if (from < to)
+				std::rotate(this->records.begin() + from, this->records.begin() + from + 1, this->records.begin() + to + 1);
+			else
+				std::rotate(this->records.begin() + to, this->records.begin() + from, this->records.begin() + from + 1);
+
+			for (uint32_t i = (std::min)(from, to); i <= (std::max)(from, to); i++)
+				this->slots[this->records[i].handle] = i;
+
+			if (focusedHandle != 0)
+				this->focused = this->slots[focusedHandle];
+
+			return true;
+		}
+
+		void Clear() {
+			this->records.clear();
+			this->slots.clear();
+			this->focused = kNone;
+			this->dead = 0;
+		}
+
+		/// <summary>
+		/// Squeeze out tombstones, keeps order
+		/// </summary>
+		void Compact() {
+			if (this->dead == 0) return;
+
+			uint32_t write = 0;
+			for (uint32_t read = 0; read < this->records.size(); read++) {
+				if (!this->records[read].alive) continue;
+
+				if (read != write) {
+					if (this->focused == read) this->focused = write;
+					this->records[write] = std::move(this->records[read]);
+					this->slots[this->records[write].handle] = write;
+				}
+				write++;
+			}
+
+			this->records.resize(write);
+			this->dead = 0;
+		}
+
+	private:
+		std::vector<Record> records;
+		std::unordered_map<WindowHandle, uint32_t> slots;
+		uint32_t focused = kNone;
+		size_t dead = 0;
+	};
+} // namespace IMS
@@ -1,4 +1,6 @@
 #pragma once
+
+#ifdef _WIN32
 #pragma comment(lib, "d3d11.lib")
 
 // Windows
@@ -9,13 +11,16 @@
 #include <shlobj.h>
 #include <shlwapi.h>
 #include <psapi.h>
+#endif
 
 // GUI
 #include <imgui.h>
+#ifdef _WIN32
 #include <imgui_impl_win32.h>
 #include <imgui_impl_dx11.h>
 
 #include <d3d11.h>
+#endif
 
 // Logging/string formatting
 #include <spdlog/spdlog.h>
@@ -30,3 +35,24 @@
 #include <fstream>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <span>
+#include <optional>
+#include <semaphore>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <set>
+#include <sstream>
+#include <bitset>
+#include <charconv>
@@ -0,0 +1,158 @@
+#include "pch.h"
+
+#include "allocation_counters.h"
+
+#include <cstdlib>
+#include <new>
+
+using namespace IMS;
+
+#ifndef IMS_DISABLE_ALLOCATION_COUNTERS
+// Constant initialized, so operator new can touch them before (and after) anything else runs
+static thread_local uint64_t threadCount = 0;
+static thread_local uint64_t threadBytes = 0;
+static std::atomic<uint64_t> totalCount = 0;
+static std::atomic<uint64_t> totalBytes = 0;
+
+static void countAllocation(size_t size) {
+	threadCount++;
+	threadBytes += size;
+	totalCount.fetch_add(1, std::memory_order_relaxed);
+	totalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+/// <summary>
+/// malloc with the new handler loop operator new is specified to have
+/// </summary>
+static void* allocate(size_t size) {
+	countAllocation(size);
+	if (size == 0) size = 1;
+
+	for (;;) {
+		if (void* memory = std::malloc(size)) return memory;
+
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) return nullptr;
+		handler();
+	}
+}
+
+static void* allocateAligned(size_t size, std::align_val_t alignment) {
+	countAllocation(size);
+	size_t align = (size_t)alignment;
+	// aligned_alloc wants a multiple of the alignment
+	size = (std::max)((size + align - 1) / align * align, align);
+
+	for (;;) {
+#ifdef _WIN32
+		if (void* memory = _aligned_malloc(size, align)) return memory;
+#else
+		if (void* memory = std::aligned_alloc(align, size)) return memory;
+#endif
+
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) return nullptr;
+		handler();
+	}
+}
+
+static void freeAligned(void* memory) {
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+void* operator new(size_t size) {
+	if (void* memory = allocate(size)) return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+	if (void* memory = allocate(size)) return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	try { return allocate(size); }
+	catch (...) { return nullptr; }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	try { return allocate(size); }
+	catch (...) { return nullptr; }
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	if (void* memory = allocateAligned(size, alignment)) return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+	if (void* memory = allocateAligned(size, alignment)) return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	try { return allocateAligned(size, alignment); }
+	catch (...) { return nullptr; }
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	try { return allocateAligned(size, alignment); }
+	catch (...) { return nullptr; }
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(memory); }
+
+static void* imguiAllocate(size_t size, void* /*userData*/) {
+	countAllocation(size);
+	return std::malloc(size);
+}
+
+static void imguiFree(void* memory, void* /*userData*/) {
+	std::free(memory);
+}
+
+AllocationStats IMS::ThreadAllocations() {
+	return { threadCount, threadBytes };
+}
+
+AllocationStats IMS::TotalAllocations() {
+	return { totalCount.load(std::memory_order_relaxed), totalBytes.load(std::memory_order_relaxed) };
+}
+
+void IMS::CountImGuiAllocations() {
+	ImGui::SetAllocatorFunctions(imguiAllocate, imguiFree);
+}
+
+bool IMS::AllocationCountersEnabled() {
+	return true;
+}
+#else
+AllocationStats IMS::ThreadAllocations() {
+	return {};
+}
+
+AllocationStats IMS::TotalAllocations() {
+	return {};
+}
+
+void IMS::CountImGuiAllocations() {}
+
+bool IMS::AllocationCountersEnabled() {
+	return false;
+}
+#endif
@@ -0,0 +1,673 @@
+#include "pch.h"
+
+#include "app_index.h"
+
+#include "app_index_file.h"
+#include "mapped_file.h"
+
+using namespace IMS;
+
+void AppSnapshotBuilder::BeginDirectory(std::string_view path, int64_t modified) {
+	uint32_t parent = this->open.empty() ? kNoDirectory : this->open.back();
+	this->open.push_back((uint32_t)this->directories.size());
+	this->directories.push_back({ std::string(path), modified, parent, 0 });
+}
+
+void AppSnapshotBuilder::EndDirectory() {
+	if (this->open.empty()) return;
+
+	this->directories[this->open.back()].subtreeEnd = (uint32_t)this->directories.size();
+	this->open.pop_back();
+}
+
+void AppSnapshotBuilder::Add(std::string_view name, std::string_view path, ShellLink link) {
+	if (name.size() > UINT16_MAX || path.size() > UINT16_MAX) return;
+
+	// Drop what doesn't fit rather than the whole entry
+	for (std::string* str : { &link.target, &link.arguments, &link.workingDirectory, &link.iconLocation }) {
+		if (str->size() > UINT16_MAX) str->clear();
+	}
+
+	Pending entry{ std::string(name), std::string(name), std::string(path), std::move(link), this->open.empty() ? kNoDirectory : this->open.back() };
+	std::transform(entry.lower.begin(), entry.lower.end(), entry.lower.begin(), ToLowerAscii);
+	this->pending.push_back(std::move(entry));
+}
+
+void AppSnapshotBuilder::AddShortcut(std::string_view name, std::string_view path) {
+	this->Add(name, path);
+	if (!this->pending.empty() && this->pending.back().path == path) this->pending.back().resolve = true;
+}
+
+size_t AppSnapshotBuilder::ResolveShortcuts() {
+	std::vector<Pending*> unresolved;
+	for (Pending& entry : this->pending) {
+		if (entry.resolve) unresolved.push_back(&entry);
+	}
+	if (unresolved.empty()) return 0;
+
+	// Parsing is mostly waiting on the file system, hand out small chunks so slow files don't hold up a thread
+	static constexpr size_t kChunk = 16;
+	size_t threads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, (unresolved.size() + kChunk - 1) / kChunk);
+	std::atomic<size_t> next = 0;
+
+	auto work = [&]() {
+		for (size_t start; (start = next.fetch_add(kChunk, std::memory_order_relaxed)) < unresolved.size();) {
+			for (size_t i = start; i < (std::min)(start + kChunk, unresolved.size()); i++) {
+				Pending& entry = *unresolved[i];
+				if (auto link = ReadShellLink(PathFromUtf8(entry.path))) entry.link = std::move(*link);
+				entry.resolve = false;
+
+				for (std::string* str : { &entry.link.target, &entry.link.arguments, &entry.link.workingDirectory, &entry.link.iconLocation }) {
+					if (str->size() > UINT16_MAX) str->clear();
+				}
+			}
+		}
+	};
+
+	{
+		std::vector<std::jthread> pool;
+		for (size_t i = 1; i < threads; i++)
+			pool.emplace_back(work);
+		work();
+	}
+
+	return unresolved.size();
+}
+
+/// <summary>
+/// The file name of a target without its extension, as [start, end) into it
+/// </summary>
+static std::pair<size_t, size_t> targetName(std::string_view target) {
+	size_t start = target.find_last_of("\\/");
+	start = start == std::string_view::npos ? 0 : start + 1;
+
+	size_t end = target.find_last_of('.');
+	if (end == std::string_view::npos || end <= start) end = target.size();
+	return { start, end };
+}
+
+std::shared_ptr<const AppSnapshot> AppSnapshotBuilder::Build() {
+	while (!this->open.empty())
+		this->EndDirectory();
+
+	std::sort(this->pending.begin(), this->pending.end(), [](const Pending& a, const Pending& b) {
+		return a.lower != b.lower ? a.lower < b.lower : a.path < b.path;
+	});
+
+	// The same program tends to be linked more than once (machine wide and per-user Start menu, vendor folders),
+	// group them under the first one alphabetically. Linked rather than dropped, every name stays searchable
+	// and carrying folders over relies on every shortcut being there.
+	std::vector<uint32_t> primary(this->pending.size());
+	{
+		std::unordered_map<std::string, uint32_t> seen;
+		for (size_t i = 0; i < this->pending.size(); i++) {
+			primary[i] = (uint32_t)i;
+
+			const ShellLink& link = this->pending[i].link;
+			if (link.target.empty()) continue;
+
+			std::string key = link.target;
+			std::transform(key.begin(), key.end(), key.begin(), ToLowerAscii);
+			key.push_back('\0');
+			key.append(link.arguments);
+			primary[i] = seen.emplace(std::move(key), (uint32_t)i).first->second;
+		}
+	}
+
+	struct Storage {
+		std::vector<AppEntry> entries;
+		std::vector<AppDirectory> directories;
+		std::string blob;
+	};
+	auto storage = std::make_shared<Storage>();
+
+	size_t blobSize = 0;
+	for (const Pending& entry : this->pending) {
+		const ShellLink& link = entry.link;
+		blobSize += entry.name.size() * 2 + entry.path.size() + 3;
+		blobSize += link.target.size() * 2 + link.arguments.size() + link.workingDirectory.size() + link.iconLocation.size() + 5;
+	}
+	for (const PendingDirectory& directory : this->directories)
+		blobSize += directory.path.size() + 1;
+
+	storage->entries.reserve(this->pending.size());
+	storage->directories.reserve(this->directories.size());
+	storage->blob.reserve(blobSize);
+
+	auto append = [&](const std::string& str) {
+		uint32_t offset = (uint32_t)storage->blob.size();
+		storage->blob.append(str);
+		storage->blob.push_back('\0');
+		return offset;
+	};
+
+	// Lowercased names go first so they form one contiguous, searchable region
+	for (size_t i = 0; i < this->pending.size(); i++) {
+		const Pending& entry = this->pending[i];
+		AppEntry record;
+		record.lowerOffset = append(entry.lower);
+		record.directory = entry.directory;
+		record.nameLength = (uint16_t)entry.name.size();
+		record.pathLength = (uint16_t)entry.path.size();
+		record.primary = primary[i];
+		storage->entries.push_back(record);
+	}
+	size_t lowerNamesSize = storage->blob.size();
+
+	// Then the lowercased target names, packed the same way
+	for (size_t i = 0; i < this->pending.size(); i++) {
+		auto [start, end] = targetName(this->pending[i].link.target);
+		std::string lower = this->pending[i].link.target.substr(start, end - start);
+		std::transform(lower.begin(), lower.end(), lower.begin(), ToLowerAscii);
+
+		AppEntry& record = storage->entries[i];
+		record.lowerTargetNameOffset = append(lower);
+		record.targetNameStart = (uint16_t)start;
+		record.targetNameLength = (uint16_t)(end - start);
+	}
+	size_t lowerTargetNamesSize = storage->blob.size() - lowerNamesSize;
+
+	for (size_t i = 0; i < this->pending.size(); i++) {
+		const Pending& entry = this->pending[i];
+		AppEntry& record = storage->entries[i];
+		record.nameOffset = append(entry.name);
+		record.pathOffset = append(entry.path);
+		record.targetOffset = append(entry.link.target);
+		record.argumentsOffset = append(entry.link.arguments);
+		record.workingDirectoryOffset = append(entry.link.workingDirectory);
+		record.iconOffset = append(entry.link.iconLocation);
+		record.targetLength = (uint16_t)entry.link.target.size();
+		record.argumentsLength = (uint16_t)entry.link.arguments.size();
+		record.workingDirectoryLength = (uint16_t)entry.link.workingDirectory.size();
+		record.iconLength = (uint16_t)entry.link.iconLocation.size();
+		record.iconIndex = entry.link.iconIndex;
+	}
+
+	for (const PendingDirectory& directory : this->directories) {
+		AppDirectory record;
+		record.pathOffset = append(directory.path);
+		record.pathLength = (uint32_t)directory.path.size();
+		record.modified = directory.modified;
+		record.parent = directory.parent;
+		record.subtreeEnd = directory.subtreeEnd;
+		storage->directories.push_back(record);
+	}
+
+	auto snapshot = std::make_shared<AppSnapshot>();
+	snapshot->entries = storage->entries;
+	snapshot->directories = storage->directories;
+	snapshot->blob = storage->blob;
+	snapshot->lowerNamesSize = lowerNamesSize;
+	snapshot->lowerTargetNamesSize = lowerTargetNamesSize;
+	snapshot->storage = std::move(storage);
+
+	this->pending.clear();
+	this->directories.clear();
+	return snapshot;
+}
+
+ShellLink AppSnapshot::Link(size_t i) const {
+	ShellLink link;
+	link.target = this->Target(i);
+	link.arguments = this->Arguments(i);
+	link.workingDirectory = this->WorkingDirectory(i);
+	link.iconLocation = this->IconLocation(i);
+	link.iconIndex = this->IconIndex(i);
+	return link;
+}
+
+static bool isShortcut(const std::filesystem::path& path) {
+	std::string extension = PathToUtf8(path.extension());
+	std::transform(extension.begin(), extension.end(), extension.begin(), ToLowerAscii);
+	return extension == ".lnk";
+}
+
+/// <summary>
+/// List a single folder
+/// </summary>
+/// <returns>The subfolders, sorted</returns>
+static std::vector<std::filesystem::path> listDirectory(const std::filesystem::path& path, const std::function<void(const std::filesystem::path&)>& onShortcut) {
+	namespace fs = std::filesystem;
+
+	std::vector<fs::path> subdirectories;
+
+	std::error_code ec;
+	fs::directory_iterator entries(path, fs::directory_options::skip_permission_denied, ec);
+	for (const fs::directory_iterator end; !ec && entries != end; entries.increment(ec)) {
+		const fs::directory_entry& entry = *entries;
+
+		// Like the recursive iterator, don't follow directory symlinks
+		std::error_code entryError;
+		if (entry.is_directory(entryError) && !entry.is_symlink(entryError)) {
+			subdirectories.push_back(entry.path());
+			continue;
+		}
+
+		if (isShortcut(entry.path())) onShortcut(entry.path());
+	}
+
+	// Stable record order, whatever order the file system lists them in
+	std::sort(subdirectories.begin(), subdirectories.end());
+	return subdirectories;
+}
+
+ShortcutScanner::ShortcutScanner(std::shared_ptr<const AppSnapshot> previous) : previous(std::move(previous)) {
+	if (!this->previous) return;
+
+	auto directories = this->previous->Directories();
+	for (uint32_t i = 0; i < directories.size(); i++)
+		this->previousDirectories.emplace(this->previous->DirectoryPath(i), i);
+
+	// Bucket the entries by directory (counting sort), so carrying a folder over doesn't search the whole index
+	this->directoryStart.assign(directories.size() + 1, 0);
+	for (const AppEntry& entry : this->previous->Entries()) {
+		if (entry.directory < directories.size())
+			this->directoryStart[entry.directory + 1]++;
+	}
+	for (size_t i = 1; i < this->directoryStart.size(); i++)
+		this->directoryStart[i] += this->directoryStart[i - 1];
+
+	std::vector<uint32_t> cursor(this->directoryStart.begin(), this->directoryStart.end() - 1);
+	this->entriesByDirectory.resize(this->directoryStart.back());
+	auto entries = this->previous->Entries();
+	for (uint32_t i = 0; i < entries.size(); i++) {
+		if (entries[i].directory < directories.size())
+			this->entriesByDirectory[cursor[entries[i].directory]++] = i;
+	}
+}
+
+size_t ShortcutScanner::Scan(const std::filesystem::path& root, AppSnapshotBuilder& builder) {
+	return this->Walk(root, builder);
+}
+
+size_t ShortcutScanner::Walk(const std::filesystem::path& path, AppSnapshotBuilder& builder) {
+	namespace fs = std::filesystem;
+
+	std::error_code ec;
+	fs::file_time_type modifiedTime = fs::last_write_time(path, ec);
+	if (ec) {
+		spdlog::warn("Can't scan {}: {}", PathToUtf8(path), ec.message());
+		return 0;
+	}
+
+	int64_t modified = (int64_t)modifiedTime.time_since_epoch().count();
+	std::string utf8 = PathToUtf8(path);
+	size_t found = 0;
+
+	builder.BeginDirectory(utf8, modified);
+
+	auto it = this->previousDirectories.find(utf8);
+	if (it != this->previousDirectories.end() && this->previous->Directories()[it->second].modified == modified) {
+		// Nothing was added, removed or renamed directly in here, carry it over and check the subfolders
+		uint32_t index = it->second;
+		for (uint32_t i = this->directoryStart[index]; i < this->directoryStart[index + 1]; i++) {
+			uint32_t entry = this->entriesByDirectory[i];
+			builder.Add(this->previous->Name(entry), this->previous->Path(entry), this->previous->Link(entry));
+			found++;
+		}
+
+		auto directories = this->previous->Directories();
+		for (uint32_t child = index + 1; child < directories[index].subtreeEnd; child = directories[child].subtreeEnd)
+			found += this->Walk(PathFromUtf8(this->previous->DirectoryPath(child)), builder);
+
+		this->reused++;
+	}
+	else {
+		std::vector<fs::path> subdirectories = listDirectory(path, [&](const fs::path& shortcut) {
+			builder.AddShortcut(PathToUtf8(shortcut.stem()), PathToUtf8(shortcut));
+			found++;
+		});
+
+		for (const fs::path& subdirectory : subdirectories)
+			found += this->Walk(subdirectory, builder);
+
+		this->rescanned++;
+	}
+
+	builder.EndDirectory();
+	return found;
+}
+
+namespace {
+	/// <summary>
+	/// Mutable copy of a snapshot keyed by path, for applying watcher changes without walking the roots.
+	/// Folders keep the modification time they were listed with, so the ones touched here get listed
+	/// once more by the next Scan, which makes up for notifications that arrive after the index is saved.
+	/// </summary>
+	class IndexEditor {
+	public:
+		explicit IndexEditor(const AppSnapshot& snapshot) {
+			auto directories = snapshot.Directories();
+			for (uint32_t i = 0; i < directories.size(); i++) {
+				std::string path(snapshot.DirectoryPath(i));
+				Directory& directory = this->directories[path];
+				directory.modified = directories[i].modified;
+
+				if (directories[i].parent == kNoDirectory) this->roots.push_back(path);
+				else this->directories[std::string(snapshot.DirectoryPath(directories[i].parent))].children.push_back(path);
+			}
+
+			auto entries = snapshot.Entries();
+			for (uint32_t i = 0; i < entries.size(); i++) {
+				if (entries[i].directory < directories.size())
+					this->directories[std::string(snapshot.DirectoryPath(entries[i].directory))].shortcuts.emplace(snapshot.Path(i), Shortcut{ std::string(snapshot.Name(i)), snapshot.Link(i) });
+				else
+					this->loose.push_back({ std::string(snapshot.Path(i)), Shortcut{ std::string(snapshot.Name(i)), snapshot.Link(i) } });
+			}
+		}
+
+		/// <summary>
+		/// A new or modified shortcut or a new folder, folders get listed and shortcuts read again
+		/// </summary>
+		/// <returns>False if it's not part of the index or an already known folder</returns>
+		bool Add(const std::filesystem::path& path) {
+			namespace fs = std::filesystem;
+
+			std::error_code ec;
+			fs::file_status status = fs::symlink_status(path, ec);
+			if (ec || !fs::exists(status)) return false; // Gone again
+
+			auto parent = this->directories.find(PathToUtf8(path.parent_path()));
+			if (parent == this->directories.end()) return false;
+
+			std::string utf8 = PathToUtf8(path);
+			if (fs::is_directory(status)) {
+				if (this->directories.contains(utf8) || !this->List(path)) return false;
+
+				// References survive rehashing, the iterator might not
+				this->directories[PathToUtf8(path.parent_path())].children.push_back(std::move(utf8));
+				return true;
+			}
+
+			if (!isShortcut(path)) return false;
+
+			// Its target may have changed, read it again
+			Shortcut& shortcut = parent->second.shortcuts[std::move(utf8)];
+			shortcut.name = PathToUtf8(path.stem());
+			shortcut.resolve = true;
+			return true;
+		}
+
+		/// <summary>
+		/// A removed shortcut or folder
+		/// </summary>
+		/// <returns>False if it wasn't in the index</returns>
+		bool Remove(const std::filesystem::path& path) {
+			std::string utf8 = PathToUtf8(path);
+			std::string parent = PathToUtf8(path.parent_path());
+
+			if (this->directories.contains(utf8)) {
+				auto owner = this->directories.find(parent);
+				std::vector<std::string>& siblings = owner != this->directories.end() ? owner->second.children : this->roots;
+				std::erase(siblings, utf8);
+				this->Erase(utf8);
+				return true;
+			}
+
+			auto owner = this->directories.find(parent);
+			return owner != this->directories.end() && owner->second.shortcuts.erase(utf8) > 0;
+		}
+
+		std::shared_ptr<const AppSnapshot> Build() const {
+			AppSnapshotBuilder builder;
+			for (const auto& [path, shortcut] : this->loose)
+				builder.Add(shortcut.name, path, shortcut.link);
+			for (const std::string& root : this->roots)
+				this->Emit(root, builder);
+
+			builder.ResolveShortcuts();
+			return builder.Build();
+		}
+
+	private:
+		struct Shortcut {
+			std::string name;
+			ShellLink link;
+			bool resolve = false; // New or modified, link isn't read yet
+		};
+
+		struct Directory {
+			int64_t modified = 0;
+			std::vector<std::string> children;
+			std::map<std::string, Shortcut, std::less<>> shortcuts; // Path -> shortcut
+		};
+
+		bool List(const std::filesystem::path& path) {
+			std::error_code ec;
+			std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, ec);
+			if (ec) return false;
+
+			std::string utf8 = PathToUtf8(path);
+			Directory& directory = this->directories[utf8];
+			directory.modified = (int64_t)modified.time_since_epoch().count();
+
+			std::vector<std::filesystem::path> subdirectories = listDirectory(path, [&](const std::filesystem::path& shortcut) {
+				directory.shortcuts.emplace(PathToUtf8(shortcut), Shortcut{ PathToUtf8(shortcut.stem()), {}, true });
+			});
+			for (const std::filesystem::path& subdirectory : subdirectories) {
+				if (this->List(subdirectory)) directory.children.push_back(PathToUtf8(subdirectory));
+			}
+			return true;
+		}
+
+		void Erase(const std::string& path) {
+			auto it = this->directories.find(path);
+			if (it == this->directories.end()) return;
+
+			std::vector<std::string> children = std::move(it->second.children);
+			this->directories.erase(it);
+			for (const std::string& child : children)
+				this->Erase(child);
+		}
+
+		void Emit(const std::string& path, AppSnapshotBuilder& builder) const {
+			auto it = this->directories.find(path);
+			if (it == this->directories.end()) return;
+
+			builder.BeginDirectory(path, it->second.modified);
+			for (const auto& [path, shortcut] : it->second.shortcuts) {
+				if (shortcut.resolve) builder.AddShortcut(shortcut.name, path);
+				else builder.Add(shortcut.name, path, shortcut.link);
+			}
+
+			std::vector<std::string> children = it->second.children;
+			std::sort(children.begin(), children.end());
+			for (const std::string& child : children)
+				this->Emit(child, builder);
+			builder.EndDirectory();
+		}
+
+		std::unordered_map<std::string, Directory> directories;
+		std::vector<std::string> roots;
+		std::vector<std::pair<std::string, Shortcut>> loose; // Entries outside any folder (published snapshots)
+	};
+} // namespace
+
+AppIndex::AppIndex() {
+	this->snapshot.store(std::make_shared<const AppSnapshot>());
+}
+
+AppIndex::~AppIndex() {
+	if (this->worker.joinable())
+		this->worker.join();
+}
+
+std::vector<std::filesystem::path> AppIndex::DefaultRoots() {
+	std::vector<std::filesystem::path> roots;
+
+#ifdef _WIN32
+	// C:\ProgramData\Microsoft\Windows\Start Menu and %AppData%\Microsoft\Windows\Start Menu
+	for (const KNOWNFOLDERID& id : { FOLDERID_CommonStartMenu, FOLDERID_StartMenu }) {
+		PWSTR folder = nullptr;
+		if (SUCCEEDED(SHGetKnownFolderPath(id, KF_FLAG_DEFAULT, nullptr, &folder)))
+			roots.emplace_back(folder);
+		CoTaskMemFree(folder);
+	}
+#endif
+
+	return roots;
+}
+
+bool AppIndex::Load() {
+	if (this->cachePath.empty()) return false;
+
+	auto start = std::chrono::steady_clock::now();
+
+	// Even if its file turns out unusable, the next save has to go to a newer one
+	std::ifstream current(this->cachePath);
+	if (!(current >> this->generation))
+		this->generation = 0;
+	if (this->generation == 0) return false;
+
+	auto snapshot = LoadAppIndex(this->GenerationPath(this->generation));
+	if (!snapshot) return false;
+
+	size_t count = snapshot->Size();
+	this->snapshot.store(std::move(snapshot), std::memory_order_release);
+	this->persisted = true;
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+	spdlog::debug("Mapped {} shortcuts from {} in {}us", count, PathToUtf8(this->GenerationPath(this->generation)), elapsed.count());
+	return true;
+}
+
+void AppIndex::Scan(const std::vector<std::filesystem::path>& roots) {
+	std::lock_guard lock(this->writeMutex);
+	this->ScanLocked(roots);
+}
+
+bool AppIndex::ScanLocked(const std::vector<std::filesystem::path>& roots) {
+	auto start = std::chrono::steady_clock::now();
+
+	auto previous = this->Snapshot();
+	size_t previousDirectories = previous->Directories().size();
+
+	AppSnapshotBuilder builder;
+	ShortcutScanner scanner(std::move(previous));
+	for (const auto& root : roots)
+		scanner.Scan(root, builder);
+	size_t resolved = builder.ResolveShortcuts();
+
+	auto snapshot = builder.Build();
+	size_t count = snapshot->Size();
+
+	// Removed folders only show up as a modified parent, unless a whole root went away
+	bool changed = scanner.Rescanned() > 0 || snapshot->Directories().size() != previousDirectories;
+
+	// Unchanged, keep the current snapshot (and the search results cached against it)
+	bool publish = changed || !this->persisted;
+	if (publish)
+		this->snapshot.store(snapshot, std::memory_order_release);
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+	spdlog::debug("Indexed {} shortcuts in {}us ({} folders rescanned, {} reused, {} shortcuts read)", count, elapsed.count(), scanner.Rescanned(), scanner.Reused(), resolved);
+
+	if (publish) this->Persist(*snapshot);
+	return publish;
+}
+
+void AppIndex::Persist(const AppSnapshot& snapshot) {
+	if (this->cachePath.empty()) return;
+
+	// Never over the current file, it's mapped until the snapshot using it goes away
+	uint64_t generation = this->generation + 1;
+	std::filesystem::path path = this->GenerationPath(generation);
+
+	this->persisted = SaveAppIndex(snapshot, path) && WriteFileAtomic(this->cachePath, [&](std::ostream& out) {
+		out << generation << '\n';
+		return (bool)out;
+	});
+	if (!this->persisted) {
+		spdlog::warn("Failed to persist the Start menu index to {}", PathToUtf8(path));
+		std::error_code ec;
+		std::filesystem::remove(path, ec);
+		return;
+	}
+
+	this->generation = generation;
+	this->RemoveOldGenerations();
+}
+
+std::filesystem::path AppIndex::GenerationPath(uint64_t generation) const {
+	std::filesystem::path path = this->cachePath.parent_path() / this->cachePath.stem();
+	path += fmt::format(".{}.bin", generation);
+	return path;
+}
+
+/// <summary>
+/// Delete the index files of older generations. One still mapped by a snapshot somebody holds can't be
+/// deleted on Windows, it's left for a later save.
+/// </summary>
+void AppIndex::RemoveOldGenerations() {
+	std::string prefix = PathToUtf8(this->cachePath.stem()) + ".";
+	std::string_view suffix = ".bin";
+
+	std::error_code ec;
+	for (const auto& file : std::filesystem::directory_iterator(this->cachePath.parent_path(), ec)) {
+		std::string name = PathToUtf8(file.path().filename());
+		if (name.size() <= prefix.size() + suffix.size() || !name.starts_with(prefix) || !name.ends_with(suffix)) continue;
+
+		uint64_t generation = 0;
+		const char* first = name.data() + prefix.size();
+		const char* last = name.data() + name.size() - suffix.size();
+		auto [end, error] = std::from_chars(first, last, generation);
+		if (error != std::errc() || end != last || generation == this->generation) continue;
+
+		std::error_code removeError;
+		std::filesystem::remove(file.path(), removeError);
+	}
+}
+
+void AppIndex::ScanAsync(const std::vector<std::filesystem::path>& roots, std::function<void()> onDone) {
+	if (this->scanning.exchange(true)) return;
+
+	if (this->worker.joinable())
+		this->worker.join();
+
+	this->worker = std::jthread([this, roots, onDone = std::move(onDone)]() {
+		this->Scan(roots);
+		this->scanning = false;
+		if (onDone) onDone();
+	});
+}
+
+bool AppIndex::ApplyChanges(const FileChangeBatch& batch, const std::vector<std::filesystem::path>& roots) {
+	std::lock_guard lock(this->writeMutex);
+
+	// Changes were lost, let the modification times tell
+	if (batch.overflow) return this->ScanLocked(roots);
+
+	auto start = std::chrono::steady_clock::now();
+
+	IndexEditor editor(*this->Snapshot());
+	bool changed = false;
+	for (const FileChange& change : batch.changes) {
+		switch (change.type) {
+		case FileChangeType::Added:
+		case FileChangeType::Modified:
+			changed |= editor.Add(change.path);
+			break;
+		case FileChangeType::Removed:
+			changed |= editor.Remove(change.path);
+			break;
+		case FileChangeType::Renamed:
+			// The display name comes from the file name, so a renamed shortcut is a different entry
+			changed |= editor.Remove(change.oldPath);
+			changed |= editor.Add(change.path);
+			break;
+		default:
+			break;
+		}
+	}
+	if (!changed) return false;
+
+	auto snapshot = editor.Build();
+	size_t count = snapshot->Size();
+	this->snapshot.store(snapshot, std::memory_order_release);
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+	spdlog::debug("Applied {} Start menu changes in {}us ({} shortcuts)", batch.changes.size(), elapsed.count(), count);
+
+	this->Persist(*snapshot);
+	return true;
+}
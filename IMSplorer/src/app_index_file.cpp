@@ -0,0 +1,133 @@
+#include "pch.h"
+
+#include "app_index_file.h"
+
+#include "mapped_file.h"
+
+using namespace IMS;
+
+static_assert(sizeof(AppIndexFileHeader) % alignof(AppDirectory) == 0);
+static_assert(sizeof(AppDirectory) % alignof(AppEntry) == 0);
+static_assert(std::is_trivially_copyable_v<AppEntry> && std::is_trivially_copyable_v<AppDirectory>);
+
+/// <summary>
+/// A string at [offset, offset + length) followed by its null terminator, inside a region of `size` bytes
+/// </summary>
+static bool validString(std::string_view region, uint64_t offset, uint64_t length) {
+	return offset <= region.size() && length < region.size() - offset && region[offset + length] == '\0';
+}
+
+bool IMS::SaveAppIndex(const AppSnapshot& snapshot, const std::filesystem::path& path) {
+	auto directories = snapshot.Directories();
+	auto entries = snapshot.Entries();
+	std::string_view blob = snapshot.Blob();
+
+	AppIndexFileHeader header;
+	std::memcpy(header.magic, AppIndexFileHeader::kMagic, sizeof(header.magic));
+	header.version = AppIndexFileHeader::kVersion;
+	header.headerSize = sizeof(AppIndexFileHeader);
+	header.directorySize = sizeof(AppDirectory);
+	header.entrySize = sizeof(AppEntry);
+	header.directoryCount = (uint32_t)directories.size();
+	header.entryCount = (uint32_t)entries.size();
+	header.lowerNamesSize = snapshot.LowerNames().size();
+	header.lowerTargetNamesSize = snapshot.LowerTargetNames().size();
+	header.blobSize = blob.size();
+	header.fileSize = sizeof(header) + directories.size_bytes() + entries.size_bytes() + blob.size();
+
+	uint64_t checksum = Fnv1a((const uint8_t*)directories.data(), directories.size_bytes());
+	checksum = Fnv1a((const uint8_t*)entries.data(), entries.size_bytes(), checksum);
+	header.checksum = Fnv1a((const uint8_t*)blob.data(), blob.size(), checksum);
+
+	return WriteFileAtomic(path, [&](std::ostream& out) {
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)directories.data(), (std::streamsize)directories.size_bytes());
+		out.write((const char*)entries.data(), (std::streamsize)entries.size_bytes());
+		out.write(blob.data(), (std::streamsize)blob.size());
+		return (bool)out;
+	});
+}
+
+std::shared_ptr<const AppSnapshot> IMS::LoadAppIndex(const std::filesystem::path& path) {
+	auto file = std::make_shared<MappedFile>();
+	if (!file->Open(path)) return nullptr;
+
+	auto reject = [&](const char* reason) -> std::shared_ptr<const AppSnapshot> {
+		spdlog::warn("Ignoring Start menu index {}: {}", PathToUtf8(path), reason);
+		return nullptr;
+	};
+
+	const uint8_t* data = file->Data();
+	size_t size = file->Size();
+
+	AppIndexFileHeader header;
+	if (size < sizeof(header)) return reject("truncated header");
+	std::memcpy(&header, data, sizeof(header));
+
+	if (std::memcmp(header.magic, AppIndexFileHeader::kMagic, sizeof(header.magic)) != 0) return reject("bad magic");
+	if (header.version != AppIndexFileHeader::kVersion) return reject("other version");
+	if (header.headerSize != sizeof(AppIndexFileHeader) || header.directorySize != sizeof(AppDirectory) || header.entrySize != sizeof(AppEntry))
+		return reject("other layout");
+
+	// Counts are 32 bit and record sizes small, none of this can overflow 64 bits
+	uint64_t directoriesBytes = (uint64_t)header.directoryCount * sizeof(AppDirectory);
+	uint64_t entriesBytes = (uint64_t)header.entryCount * sizeof(AppEntry);
+	if (header.blobSize > size) return reject("truncated");
+	if (header.fileSize != size || sizeof(header) + directoriesBytes + entriesBytes + header.blobSize != size)
+		return reject("truncated");
+
+	if (Fnv1a(data + sizeof(header), size - sizeof(header)) != header.checksum) return reject("checksum mismatch");
+
+	auto directories = std::span<const AppDirectory>((const AppDirectory*)(data + sizeof(header)), header.directoryCount);
+	auto entries = std::span<const AppEntry>((const AppEntry*)(data + sizeof(header) + directoriesBytes), header.entryCount);
+	std::string_view blob((const char*)(data + sizeof(header) + directoriesBytes + entriesBytes), (size_t)header.blobSize);
+
+	// The checksum catches accidents, these make sure nothing can ever read out of bounds
+	if (header.lowerNamesSize > blob.size() || header.lowerTargetNamesSize > blob.size() - header.lowerNamesSize) return reject("bad string region");
+	std::string_view lowerNames = blob.substr(0, (size_t)header.lowerNamesSize);
+	std::string_view lowerTargetNames = blob.substr(0, (size_t)(header.lowerNamesSize + header.lowerTargetNamesSize));
+
+	// Lowercased names (then target names) are packed back to back in entry order, searches rely on that to map hits to entries
+	uint64_t lowerOffset = 0;
+	uint64_t lowerTargetOffset = header.lowerNamesSize;
+	for (const AppEntry& entry : entries) {
+		if (entry.lowerOffset != lowerOffset || entry.lowerTargetNameOffset != lowerTargetOffset) return reject("bad entry");
+		lowerOffset += (uint64_t)entry.nameLength + 1;
+		lowerTargetOffset += (uint64_t)entry.targetNameLength + 1;
+
+		if (!validString(lowerNames, entry.lowerOffset, entry.nameLength) ||
+			!validString(lowerTargetNames, entry.lowerTargetNameOffset, entry.targetNameLength) ||
+			!validString(blob, entry.nameOffset, entry.nameLength) ||
+			!validString(blob, entry.pathOffset, entry.pathLength) ||
+			!validString(blob, entry.targetOffset, entry.targetLength) ||
+			!validString(blob, entry.argumentsOffset, entry.argumentsLength) ||
+			!validString(blob, entry.workingDirectoryOffset, entry.workingDirectoryLength) ||
+			!validString(blob, entry.iconOffset, entry.iconLength))
+			return reject("bad entry");
+
+		if ((uint32_t)entry.targetNameStart + entry.targetNameLength > entry.targetLength) return reject("bad entry");
+		if (entry.primary > (uint32_t)(&entry - entries.data())) return reject("bad entry");
+		if (entry.directory != kNoDirectory && entry.directory >= directories.size()) return reject("bad entry");
+	}
+
+	if (lowerOffset != lowerNames.size() || lowerTargetOffset != lowerTargetNames.size()) return reject("bad string region");
+
+	for (uint32_t i = 0; i < directories.size(); i++) {
+		const AppDirectory& directory = directories[i];
+		if (!validString(blob, directory.pathOffset, directory.pathLength)) return reject("bad directory");
+
+		// Depth first: the subtree follows the directory, and nests inside its parent's
+		if (directory.subtreeEnd <= i || directory.subtreeEnd > directories.size()) return reject("bad directory");
+		if (directory.parent != kNoDirectory && (directory.parent >= i || directory.subtreeEnd > directories[directory.parent].subtreeEnd))
+			return reject("bad directory");
+	}
+
+	auto snapshot = std::make_shared<AppSnapshot>();
+	snapshot->entries = entries;
+	snapshot->directories = directories;
+	snapshot->blob = blob;
+	snapshot->lowerNamesSize = (size_t)header.lowerNamesSize;
+	snapshot->lowerTargetNamesSize = (size_t)header.lowerTargetNamesSize;
+	snapshot->storage = std::move(file);
+	return snapshot;
+}
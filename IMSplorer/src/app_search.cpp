@@ -0,0 +1,290 @@
+#include "pch.h"
+
+#include "app_search.h"
+
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMS_SEARCH_SSE2 1
+#endif
+
+using namespace IMS;
+
+static constexpr int32_t kScoreMatch = 16;
+static constexpr int32_t kBonusBoundary = 8;
+static constexpr int32_t kBonusCamelCase = 7;
+static constexpr int32_t kBonusConsecutive = 6;
+static constexpr int32_t kBonusPrefix = 12;
+static constexpr int32_t kBonusExact = 32;
+static constexpr int32_t kPenaltyGapStart = 3;
+static constexpr int32_t kPenaltyGapExtension = 1;
+static constexpr int32_t kPenaltyTargetName = 8; // A match on what the shortcut is called beats one on the file it runs
+static constexpr int32_t kBonusLaunched = 12;    // Per doubling of an app's frecency score
+static constexpr int32_t kBonusLaunchedMax = 48;
+
+static bool isSeparator(char c) {
+	return c == ' ' || c == '-' || c == '_' || c == '.' || c == '(' || c == '/' || c == '\\';
+}
+
+/// <summary>
+/// Bonus for a match at position i, based on what comes before it in the original name
+/// </summary>
+static int32_t boundaryBonus(std::string_view name, size_t i) {
+	if (i == 0) return kBonusBoundary;
+
+	char prev = name[i - 1], cur = name[i];
+	if (isSeparator(prev)) return kBonusBoundary;
+	if (prev >= 'a' && prev <= 'z' && cur >= 'A' && cur <= 'Z') return kBonusCamelCase;
+	if (!(prev >= '0' && prev <= '9') && cur >= '0' && cur <= '9') return kBonusCamelCase;
+
+	return 0;
+}
+
+int32_t IMS::FuzzyScore(std::string_view name, std::string_view lower, std::string_view query) {
+	if (query.empty()) return 0;
+	if (query.size() > lower.size()) return kNoMatch;
+
+	// Forward pass, find where the leftmost subsequence match ends
+	size_t qi = 0, end = 0;
+	for (size_t i = 0; i < lower.size(); i++) {
+		if (lower[i] == query[qi] && ++qi == query.size()) {
+			end = i + 1;
+			break;
+		}
+	}
+	if (qi != query.size()) return kNoMatch;
+
+	// Backward pass, tighten the window so "ab" in "a_xab" matches the trailing "ab"
+	size_t start = end;
+	for (qi = query.size(); qi > 0;) {
+		start--;
+		if (lower[start] == query[qi - 1]) qi--;
+	}
+
+	int32_t score = 0;
+	bool inRun = false, inGap = false;
+	qi = 0;
+	for (size_t i = start; i < end; i++) {
+		if (qi < query.size() && lower[i] == query[qi]) {
+			int32_t bonus = boundaryBonus(name, i);
+			score += kScoreMatch + (qi == 0 ? bonus * 2 : bonus);
+			if (inRun) score += kBonusConsecutive;
+
+			inRun = true;
+			inGap = false;
+			qi++;
+		}
+		else {
+			score -= inGap ? kPenaltyGapExtension : kPenaltyGapStart;
+			inRun = false;
+			inGap = true;
+		}
+	}
+
+	if (start == 0) score += kBonusPrefix;
+	if (lower.size() == query.size()) score += kBonusExact;
+
+	// Prefer shorter names when everything else is equal
+	score -= (int32_t)((lower.size() - query.size()) >> 3);
+
+	return score;
+}
+
+/// <summary>
+/// Scan one packed region of lowercased strings, `offset` and `length` pick the entry's string in it
+/// </summary>
+template <auto offset, auto length>
+static void filterRegion(const AppSnapshot& apps, std::string_view names, size_t base, char c, std::vector<uint32_t>& out) {
+	std::span<const AppEntry> entries = apps.Entries();
+
+	// Entries are laid out in order, so mapping a hit back to its entry is a forward walk.
+	// Returns the offset of the next entry so the rest of this one can be skipped.
+	size_t entry = 0;
+	auto mark = [&](size_t pos) -> size_t {
+		while (entries[entry].*offset - base + entries[entry].*length <= pos) entry++;
+		out.push_back((uint32_t)entry);
+		return entries[entry].*offset - base + entries[entry].*length + 1;
+	};
+
+	size_t i = 0;
+
+#ifdef IMS_SEARCH_SSE2
+	const __m128i needle = _mm_set1_epi8(c);
+	while (i + 16 <= names.size()) {
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(names.data() + i));
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+
+		size_t resume = i + 16;
+		while (mask) {
+			size_t next = mark(i + std::countr_zero(mask));
+			if (next >= i + 16) {
+				resume = next;
+				break;
+			}
+			mask &= ~((1u << (next - i)) - 1);
+		}
+		i = resume;
+	}
+#endif
+
+	for (; i < names.size(); i++) {
+		if (names[i] == c)
+			i = mark(i) - 1;
+	}
+}
+
+void IMS::FilterByChar(const AppSnapshot& apps, char c, std::vector<uint32_t>& out) {
+	size_t start = out.size();
+	filterRegion<&AppEntry::lowerOffset, &AppEntry::nameLength>(apps, apps.LowerNames(), 0, c, out);
+
+	std::vector<uint32_t> targets;
+	filterRegion<&AppEntry::lowerTargetNameOffset, &AppEntry::targetNameLength>(apps, apps.LowerTargetNames(), apps.LowerNames().size(), c, targets);
+	if (targets.empty()) return;
+
+	// Both are in entry order, merge them
+	size_t middle = out.size();
+	out.insert(out.end(), targets.begin(), targets.end());
+	std::inplace_merge(out.begin() + start, out.begin() + middle, out.end());
+	out.erase(std::unique(out.begin() + start, out.end()), out.end());
+}
+
+const std::vector<SearchResult>& AppSearch::Query(const std::shared_ptr<const AppSnapshot>& apps, std::string_view query, size_t limit) {
+	uint64_t generation = this->history ? this->history->Generation() : 0;
+	if (this->valid && apps == this->apps && generation == this->historyGeneration && query == this->lastQuery && limit == this->lastLimit)
+		return this->results;
+
+	// Narrowing is only correct against the same snapshot, every match of "abc" is also a match of "ab"
+	bool narrow = this->valid && apps == this->apps && !this->lastQuery.empty() && query.starts_with(this->lastQuery);
+	bool remap = !this->valid || apps != this->apps || generation != this->historyGeneration;
+	if (apps != this->apps) this->keyed = false;
+
+	this->apps = apps;
+	this->lastQuery.assign(query);
+	this->lastLimit = limit;
+	this->historyGeneration = generation;
+	this->valid = true;
+
+	if (remap)
+		this->MapHistory(*apps);
+
+	this->lowerQuery.assign(query);
+	std::transform(this->lowerQuery.begin(), this->lowerQuery.end(), this->lowerQuery.begin(), ToLowerAscii);
+
+	this->results.clear();
+	if (this->lowerQuery.empty()) {
+		this->candidates.clear();
+		this->seenPrimaries.clear();
+
+		// The most frecent apps on top, then everything else in index order
+		if (this->keyed) {
+			for (const auto& [rank, key] : this->history->Ranked()) {
+				if (this->results.size() >= (std::min)(limit, kRecentCount)) break;
+
+				auto it = this->keys.find(key);
+				if (it != this->keys.end() && this->seenPrimaries.insert(it->second).second)
+					this->results.push_back({ it->second, this->Boost(it->second) });
+			}
+		}
+
+		for (size_t i = 0; i < apps->Size() && this->results.size() < limit; i++) {
+			if (!apps->IsDuplicate(i) && (this->seenPrimaries.empty() || !this->seenPrimaries.contains((uint32_t)i)))
+				this->results.push_back({ (uint32_t)i, 0 });
+		}
+		return this->results;
+	}
+
+	if (!narrow) {
+		this->candidates.clear();
+		FilterByChar(*apps, this->lowerQuery[0], this->candidates);
+	}
+
+	this->Rank(*apps, limit);
+	return this->results;
+}
+
+void AppSearch::Rank(const AppSnapshot& apps, size_t limit) {
+	// Min-heap on score holding the best `limit` results seen so far.
+	// Ties go to the lower index, which is alphabetical order.
+	auto worse = [](const SearchResult& a, const SearchResult& b) {
+		return a.score != b.score ? a.score > b.score : a.index < b.index;
+	};
+
+	this->scratch.clear();
+	this->seenPrimaries.clear(); // Primaries of what's in the heap
+	for (uint32_t index : this->candidates) {
+		int32_t score = FuzzyScore(apps.Name(index), apps.LowerName(index), this->lowerQuery);
+		if (!apps.LowerTargetName(index).empty()) {
+			int32_t targetScore = FuzzyScore(apps.TargetName(index), apps.LowerTargetName(index), this->lowerQuery);
+			if (targetScore != kNoMatch) score = (std::max)(score, targetScore - kPenaltyTargetName);
+		}
+		if (score == kNoMatch) continue;
+		score += this->Boost(apps.Primary(index));
+
+		this->scratch.push_back(index);
+		if (limit == 0) continue;
+
+		// Shortcuts to the same program take one slot, under the name that matched best
+		SearchResult result{ index, score };
+		uint32_t primary = apps.Primary(index);
+		if (this->seenPrimaries.contains(primary)) {
+			auto listed = std::find_if(this->results.begin(), this->results.end(), [&](const SearchResult& other) { return apps.Primary(other.index) == primary; });
+			if (worse(result, *listed)) {
+				*listed = result;
+				std::make_heap(this->results.begin(), this->results.end(), worse);
+			}
+		}
+		else if (this->results.size() < limit) {
+			this->results.push_back(result);
+			std::push_heap(this->results.begin(), this->results.end(), worse);
+			this->seenPrimaries.insert(primary);
+		}
+		else if (worse(result, this->results.front())) {
+			std::pop_heap(this->results.begin(), this->results.end(), worse);
+			this->seenPrimaries.erase(apps.Primary(this->results.back().index));
+			this->results.back() = result;
+			std::push_heap(this->results.begin(), this->results.end(), worse);
+			this->seenPrimaries.insert(primary);
+		}
+	}
+
+	// Only the entries that still match are candidates for the next, longer query
+	this->candidates.swap(this->scratch);
+
+	std::sort_heap(this->results.begin(), this->results.end(), worse);
+}
+
+/// <summary>
+/// Find the launched apps in the snapshot and work out their bonus. Every path is hashed once per snapshot,
+/// and only once something was launched; after that a launch costs a pass over the launched apps.
+/// </summary>
+void AppSearch::MapHistory(const AppSnapshot& apps) {
+	this->boosts.clear();
+	if (!this->history || !this->clock || this->history->Size() == 0) return;
+
+	if (!this->keyed) {
+		this->keys.clear();
+		this->keys.reserve(apps.Size());
+		for (size_t i = 0; i < apps.Size(); i++)
+			this->keys.try_emplace(LaunchHistory::Key(apps.Path(i)), apps.Primary(i));
+		this->keyed = true;
+	}
+
+	int64_t now = std::chrono::duration_cast<std::chrono::seconds>(this->clock->WallNow().time_since_epoch()).count();
+	for (const auto& [rank, key] : this->history->Ranked()) {
+		auto it = this->keys.find(key);
+		if (it == this->keys.end()) continue;
+
+		double score = std::exp2(rank - (double)now / LaunchHistory::kHalfLife);
+		int32_t bonus = (int32_t)(std::min)((double)kBonusLaunchedMax, kBonusLaunched * std::log2(1.0 + score));
+		// Ranked best first, a program launched through several shortcuts keeps its best one
+		this->boosts.try_emplace(it->second, bonus);
+	}
+}
+
+int32_t AppSearch::Boost(uint32_t primary) const {
+	if (this->boosts.empty()) return 0;
+
+	auto it = this->boosts.find(primary);
+	return it != this->boosts.end() ? it->second : 0;
+}
@@ -0,0 +1,198 @@
+#include "pch.h"
+
+#include "async_log.h"
+
+#include "path_utf8.h"
+
+#include <spdlog/sinks/rotating_file_sink.h>
+
+using namespace IMS;
+
+AsyncLog& AsyncLog::Get() {
+	static AsyncLog log;
+	return log;
+}
+
+AsyncLog::~AsyncLog() {
+	this->Stop();
+}
+
+bool AsyncLog::Start(spdlog::sink_ptr sink, size_t capacity) {
+	if (this->Running() || !sink || capacity < 2 || !std::has_single_bit(capacity)) return false;
+
+	// A fresh ring every time, a call that raced with the last Stop may still be writing into the old one
+	this->rings.push_back(std::make_unique<Ring>(capacity));
+	this->draining = this->rings.back().get();
+
+	this->dequeue = 0;
+	this->drainedTo = 0;
+	this->flushRequested = false;
+	this->reportedDrops = 0;
+	this->written.store(0, std::memory_order_relaxed);
+	this->dropped.store(0, std::memory_order_relaxed);
+	this->truncated.store(0, std::memory_order_relaxed);
+
+	this->sink = std::move(sink);
+	this->systemEpoch = std::chrono::system_clock::now();
+	this->steadyEpoch = std::chrono::steady_clock::now();
+
+	this->wakeAt.store(kAwake, std::memory_order_relaxed);
+
+	this->thread = std::jthread([this](std::stop_token stop) { this->Work(stop); });
+	this->ring.store(this->draining, std::memory_order_release);
+	return true;
+}
+
+bool AsyncLog::Start(const std::filesystem::path& path, size_t capacity) {
+	spdlog::sink_ptr sink;
+	try {
+#ifdef SPDLOG_WCHAR_FILENAMES
+		sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(path.wstring(), kMaxFileSize, kMaxFiles);
+#else
+		sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(PathToUtf8(path), kMaxFileSize, kMaxFiles);
+#endif
+	}
+	catch (const spdlog::spdlog_ex& e) {
+		spdlog::error("Can't open log file: {}", e.what());
+		return false;
+	}
+
+	sink->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] [thread %t] [%s:%#] %v");
+	return this->Start(std::move(sink), capacity);
+}
+
+void AsyncLog::Stop() {
+	if (!this->Running()) return;
+
+	// The thread drains what's left on its way out
+	this->ring.store(nullptr, std::memory_order_relaxed);
+	this->thread.request_stop();
+	this->thread.join();
+
+	this->sink.reset();
+}
+
+void AsyncLog::Flush() {
+	Ring* ring = this->ring.load(std::memory_order_acquire);
+	if (!ring) return;
+
+	uint64_t target = ring->enqueue.load(std::memory_order_relaxed);
+	std::unique_lock lock(this->mutex);
+	this->flushRequested = true;
+	this->wake.notify_all();
+	this->wake.wait(lock, [&] { return this->drainedTo >= target; });
+}
+
+/// <summary>
+/// Called by the producer whose message the drain thread is waiting for, only the first one takes the lock
+/// </summary>
+void AsyncLog::Wake() {
+	if (this->wakeAt.exchange(kAwake, std::memory_order_relaxed) == kAwake) return;
+
+	// Under the lock, so it can't slip in between the drain thread checking wakeAt and going to sleep
+	std::lock_guard lock(this->mutex);
+	this->wake.notify_all();
+}
+
+/// <summary>
+/// The next slot to drain is committed
+/// </summary>
+bool AsyncLog::Pending() const {
+	return this->draining->slots[this->dequeue & this->draining->mask].sequence.load(std::memory_order_relaxed) == this->dequeue + 1;
+}
+
+/// <summary>
+/// Format and write everything committed so far, in ring order. Stops at the first slot still being written,
+/// the next pass picks it up.
+/// </summary>
+size_t AsyncLog::Drain() {
+	Ring& ring = *this->draining;
+	const uint64_t capacity = ring.mask + 1;
+	size_t count = 0;
+
+	for (;; this->dequeue++, count++) {
+		Slot& slot = ring.slots[this->dequeue & ring.mask];
+		if (slot.sequence.load(std::memory_order_acquire) != this->dequeue + 1) break;
+
+		const Header& header = slot.header;
+		this->buffer.clear();
+		header.decode(slot.payload, fmt::string_view(header.format, header.formatSize), this->buffer);
+
+		auto elapsed = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(header.time)) - this->steadyEpoch;
+		auto time = this->systemEpoch + std::chrono::duration_cast<std::chrono::system_clock::duration>(elapsed);
+
+		spdlog::details::log_msg message(time, spdlog::source_loc{ header.site->file, header.site->line, "" }, "", header.site->level,
+			spdlog::string_view_t(this->buffer.data(), this->buffer.size()));
+		message.thread_id = header.thread;
+
+		if (header.truncated)
+			this->truncated.fetch_add(1, std::memory_order_relaxed);
+
+		// Losing a line to a full disk is better than losing the drain thread
+		try {
+			this->sink->log(message);
+		}
+		catch (const spdlog::spdlog_ex&) {}
+
+		slot.sequence.store(this->dequeue + capacity, std::memory_order_release);
+	}
+
+	this->written.fetch_add(count, std::memory_order_relaxed);
+	return count;
+}
+
+void AsyncLog::ReportDrops() {
+	uint64_t drops = this->dropped.load(std::memory_order_relaxed);
+	if (drops == this->reportedDrops) return;
+
+	this->buffer.clear();
+	fmt::format_to(std::back_inserter(this->buffer), "{} messages dropped, the log couldn't keep up", drops - this->reportedDrops);
+	this->reportedDrops = drops;
+
+	spdlog::details::log_msg message(std::chrono::system_clock::now(), spdlog::source_loc{}, "", spdlog::level::warn,
+		spdlog::string_view_t(this->buffer.data(), this->buffer.size()));
+	try {
+		this->sink->log(message);
+	}
+	catch (const spdlog::spdlog_ex&) {}
+}
+
+void AsyncLog::Work(std::stop_token stop) {
+	for (;;) {
+		bool stopping = stop.stop_requested();
+
+		uint64_t drops = this->reportedDrops;
+		if (this->Drain() > 0 || this->dropped.load(std::memory_order_relaxed) != drops) {
+			this->ReportDrops();
+			try {
+				this->sink->flush();
+			}
+			catch (const spdlog::spdlog_ex&) {}
+		}
+
+		{
+			std::lock_guard lock(this->mutex);
+			this->drainedTo = this->dequeue;
+			this->flushRequested = false;
+		}
+		this->wake.notify_all();
+
+		if (stopping) return;
+
+		std::unique_lock lock(this->mutex);
+		auto woken = [this] { return this->wakeAt.load(std::memory_order_relaxed) == kAwake || this->flushRequested; };
+
+		// Nothing to write: sleep until the next message, Flush or Stop, no timer. Pairs with the fence in Write.
+		this->wakeAt.store(this->dequeue, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!this->Pending())
+			this->wake.wait(lock, stop, woken);
+
+		// Let a burst pile up and go out in one batch, cut short by Flush or a half full ring
+		if (!this->flushRequested && !stop.stop_requested()) {
+			this->wakeAt.store(this->dequeue + (this->draining->mask + 1) / 2, std::memory_order_relaxed);
+			this->wake.wait_for(lock, stop, kBatchInterval, woken);
+		}
+		this->wakeAt.store(kAwake, std::memory_order_relaxed);
+	}
+}
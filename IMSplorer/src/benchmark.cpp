@@ -0,0 +1,1380 @@
+#include "pch.h"
+
+#include "benchmark.h"
+
+#include "allocation_counters.h"
+#include "app_index.h"
+#include "app_search.h"
+#include "async_log.h"
+#include "command_index.h"
+#include "font_cache.h"
+#include "frame_diff.h"
+#include "headless_platform.h"
+#include "hotkeys.h"
+#include "launch_history.h"
+#include "profiler.h"
+#include "resource_sampler.h"
+#include "shell_link.h"
+#include "taskbar.h"
+#include "trace.h"
+#include "window_registry.h"
+
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/sinks/basic_file_sink.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace IMS;
+
+struct Scenario {
+	const char* name;
+	size_t windows;
+	size_t apps;        // Start menu entries, 0 keeps the Start menu closed
+	const char* query;
+	bool grouped = false; // Taskbar buttons grouped by application
+	size_t commands = 0;  // Executables for the Run mode, with a query starting with '>'
+	bool tinted = false;  // Buttons tinted by CPU usage, once the first sample is in
+};
+
+/// <summary>
+/// xorshift64*, seeded per scenario so every run sees the same data
+/// </summary>
+struct Random {
+	explicit Random(uint64_t seed = 0x9E3779B97F4A7C15ull) : state(seed) {}
+
+	uint64_t Next() {
+		this->state ^= this->state >> 12; this->state ^= this->state << 25; this->state ^= this->state >> 27;
+		return this->state * 0x2545F4914F6CDD1Dull;
+	}
+
+	size_t Below(size_t bound) { return (size_t)(this->Next() % bound); }
+
+	/// <summary>
+	/// Uniform in [0, 1)
+	/// </summary>
+	double Unit() { return (double)(this->Next() >> 11) * 0x1.0p-53; }
+
+	uint64_t state;
+};
+
+/// <summary>
+/// Nanoseconds a pair of steady_clock reads takes with nothing in between, subtracted from single call timings
+/// </summary>
+static float clockOverhead() {
+	double overhead = std::numeric_limits<double>::max();
+	for (int i = 0; i < 1000; i++) {
+		auto start = std::chrono::steady_clock::now();
+		overhead = (std::min)(overhead, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+	}
+	return (float)overhead;
+}
+
+static std::shared_ptr<const AppSnapshot> syntheticApps(size_t count) {
+	static constexpr std::string_view words[] = {
+		"Visual", "Studio", "Code", "Microsoft", "Edge", "Word", "Excel", "Paint", "Notepad", "Terminal",
+		"Calculator", "Settings", "Photos", "Media", "Player", "Control", "Panel", "Task", "Manager", "Explorer",
+	};
+
+	AppSnapshotBuilder builder;
+	for (size_t i = 0; i < count; i++) {
+		std::string name = fmt::format("{} {} {}", words[i % std::size(words)], words[(i / 7) % std::size(words)], i);
+		builder.Add(name, fmt::format("C:\\ProgramData\\Microsoft\\Windows\\Start Menu\\Programs\\{}.lnk", name));
+	}
+	return builder.Build();
+}
+
+/// <summary>
+/// Names shaped like a crowded PATH: a few dozen tool families, each with many variants sharing a long prefix
+/// </summary>
+static std::shared_ptr<const CommandSnapshot> syntheticCommands(size_t count) {
+	static constexpr std::string_view families[] = {
+		"git", "git-credential-", "python3.", "pip", "node", "npm", "clang", "clang-tidy-", "llvm-", "x86_64-linux-gnu-",
+		"gcc-", "dotnet", "docker", "kubectl", "java", "perl5.", "ruby", "cargo-", "rustc", "VsDevCmd",
+	};
+
+	Random random(0xD1B54A32D192ED03ull);
+	CommandSnapshotBuilder builder;
+	for (size_t i = 0; i < count; i++) {
+		std::string name(families[random.Below(std::size(families))]);
+		for (size_t length = 2 + random.Below(8); length > 0; length--)
+			name.push_back("abcdefghijklmnopqrstuvwxyz0123456789"[random.Below(36)]);
+		builder.Add(name, fmt::format("/opt/tools{}/bin/{}", i % 64, name));
+	}
+	return builder.Build();
+}
+
+/// <summary>
+/// Shortcuts named like syntheticApps, a third of them at the top and the rest in folders, every other one of those
+/// in a subfolder. Each is a minimal shell link holding only a relative path, resolved against the folder it's in.
+/// </summary>
+static void syntheticStartMenu(const std::filesystem::path& root, size_t count) {
+	// [MS-SHLLINK] header with only HasRelativePath set, the path follows as an ANSI counted string
+	static constexpr uint8_t header[0x4C] = {
+		0x4C, 0x00, 0x00, 0x00, 0x01, 0x14, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46, 0x08,
+	};
+
+	std::error_code ec;
+	std::filesystem::remove_all(root, ec);
+	std::filesystem::create_directories(root, ec);
+
+	auto apps = syntheticApps(count);
+	for (size_t i = 0; i < apps->Size(); i++) {
+		std::filesystem::path folder = root;
+		if (i % 3 != 0) {
+			folder /= fmt::format("Folder {}", i % 29);
+			if (i % 2 == 0) folder /= "Tools";
+			std::filesystem::create_directories(folder, ec);
+		}
+
+		std::string relative = fmt::format("..\\Programs\\app{}.exe", i);
+		std::ofstream out(folder / PathFromUtf8(fmt::format("{}.lnk", apps->Name(i))), std::ios::binary);
+		out.write((const char*)header, sizeof(header));
+		out.put((char)(relative.size() & 0xFF)).put((char)(relative.size() >> 8));
+		out.write(relative.data(), (std::streamsize)relative.size());
+		out.write("\0\0\0\0", 4); // Terminal extra data block
+	}
+}
+
+static bool runScenario(const Scenario& scenario, size_t frames) {
+	HeadlessPlatform platform;
+	platform.SetCommandPaths({}); // The Run mode only sees synthetic commands
+
+	// A few dozen programs with many windows each, like a real session
+	for (size_t i = 0; i < scenario.windows; i++)
+		platform.AddWindow(fmt::format("Window {}", i), fmt::format("C:\\Program Files\\App{}\\app{}.exe", i % 40, i % 40));
+
+	Taskbar taskbar(platform);
+	taskbar.Init();
+	taskbar.groupByApp = scenario.grouped;
+
+	if (scenario.commands > 0) {
+		taskbar.commandIndex.Wait(); // The startup refresh would replace them
+		taskbar.commandIndex.Publish(syntheticCommands(scenario.commands));
+	}
+
+	if (scenario.apps > 0 || scenario.commands > 0) {
+		taskbar.appIndex.Publish(syntheticApps(scenario.apps));
+		std::snprintf(taskbar.searchBuffer, sizeof(taskbar.searchBuffer), "%s", scenario.query);
+		taskbar.showStartMenu = true;
+		taskbar.startMenuWasOpen = true; // Keep the synthetic index, skip the rescan on open
+	}
+
+	// Usage is published from the second sample on
+	taskbar.showUsageTint = scenario.tinted;
+	while (scenario.tinted && taskbar.resources.Samples() == 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	// Let the metadata worker resolve every window first
+	while (taskbar.windowWorker.InFlight() > 0) {
+		taskbar.Update();
+		std::this_thread::yield();
+	}
+	taskbar.Update();
+
+	auto frame = [&]() {
+		platform.BeginFrame();
+		taskbar.BuildFrame();
+		platform.EndFrame();
+	};
+
+	// Warm up (window creation, text measuring, first search)
+	for (int i = 0; i < 10; i++)
+		frame();
+
+	// Steady state from here on, nothing may touch the heap
+	std::vector<float> durations;
+	durations.reserve(frames);
+	uint64_t skipped = platform.Diff().Skipped();
+	AllocationStats before = ThreadAllocations();
+	for (size_t i = 0; i < frames; i++) {
+		auto start = std::chrono::steady_clock::now();
+		frame();
+		durations.push_back(std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count());
+	}
+	AllocationStats allocations = ThreadAllocations() - before;
+	skipped = platform.Diff().Skipped() - skipped;
+
+	std::sort(durations.begin(), durations.end());
+	double total = 0;
+	for (float duration : durations) total += duration;
+
+	spdlog::info("{:<28} mean {:8.1f} us  p50 {:8.1f} us  p95 {:8.1f} us  p99 {:8.1f} us  max {:8.1f} us  ({} vertices, {} allocations, {} frames unchanged)",
+		scenario.name, total / durations.size(), ProfilePercentile(durations, 0.50f), ProfilePercentile(durations, 0.95f), ProfilePercentile(durations, 0.99f), durations.back(), platform.LastVertexCount(), allocations.count, skipped);
+
+	if (platform.LastVertexCount() == 0) {
+		spdlog::error("{} didn't draw anything", scenario.name);
+		return false;
+	}
+	if (allocations.count > 0) {
+		spdlog::error("{} allocated {} times ({} bytes) over {} steady frames", scenario.name, allocations.count, allocations.bytes, frames);
+		return false;
+	}
+	return true;
+}
+
+/// <summary>
+/// Time the startup graph with sleeping mock tasks shaped like the real startup and log its report
+/// </summary>
+static void runStartupGraph() {
+	using Affinity = StartupGraph::Affinity;
+	auto sleep = [](int milliseconds) {
+		return [milliseconds]() { std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds)); return true; };
+	};
+
+	StartupGraph graph;
+	auto window = graph.Add("Window", sleep(5), {}, Affinity::Main);
+	auto device = graph.Add("Device", sleep(40), { window }, Affinity::Main);
+	auto fonts = graph.Add("Fonts", sleep(30));
+	auto index = graph.Add("Index", sleep(30));
+	graph.Add("Enumeration", sleep(1), { window });
+	graph.Add("UI", sleep(1), { device, fonts }, Affinity::Main);
+	graph.Add("Shortcuts", sleep(1), { index });
+
+	auto start = std::chrono::steady_clock::now();
+	graph.Run(3);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	spdlog::info("Startup graph, 108 ms of mock work in {:.1f} ms", elapsed);
+	graph.LogReport();
+}
+
+/// <summary>
+/// Time ImGui's built-in font at four sizes, rasterized into the cache and then loaded back from it
+/// </summary>
+static void runFontCache() {
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "imsplorer-bench-fonts.bin";
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+
+	FontAtlasSpec spec;
+	spec.sizes = { 13.0f, 16.25f, 19.5f, 26.0f };
+
+	auto build = [&](FontAtlasCache& cache, ImFontAtlas& atlas) {
+		auto start = std::chrono::steady_clock::now();
+		cache.Build(atlas, spec);
+		unsigned char* pixels = nullptr;
+		int width = 0, height = 0;
+		atlas.GetTexDataAsRGBA32(&pixels, &width, &height);
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	FontAtlasCache coldCache(path), warmCache(path);
+	ImFontAtlas cold, warm;
+	double coldTime = build(coldCache, cold);
+	double warmTime = build(warmCache, warm);
+	bool hit = warmCache.Hit();
+	warmCache.Release(warm);
+	std::filesystem::remove(path, ec);
+
+	spdlog::info("Font atlas, {} sizes, {}x{}: rasterized in {:.2f} ms, from the cache in {:.2f} ms{}", cold.Fonts.Size, cold.TexWidth, cold.TexHeight,
+		coldTime, warmTime, hit ? "" : " (missed)");
+}
+
+/// <summary>
+/// Index a synthetic Start menu of 5000 shortcuts in nested folders on disk. The cold scan lists every folder,
+/// reads every shortcut and persists the index, a rescan of the unchanged tree only checks the folders'
+/// modification times and keeps the published snapshot. Every shortcut has to come out with its target.
+/// </summary>
+static bool runAppIndexScan() {
+	static constexpr size_t count = 5000;
+	static constexpr size_t rescans = 20;
+
+	std::filesystem::path root = std::filesystem::temp_directory_path() / "imsplorer-bench-start-menu";
+	std::filesystem::path cache = std::filesystem::temp_directory_path() / "imsplorer-bench-index";
+	syntheticStartMenu(root, count);
+	std::error_code ec;
+	std::filesystem::remove_all(cache, ec);
+	std::filesystem::create_directories(cache, ec);
+
+	size_t shortcuts = 0, folders = 0, resolved = 0;
+	double coldTime = 0, rescanTime = 0;
+	bool kept = true;
+	{
+		AppIndex index;
+		index.SetCachePath(cache / "appindex.current");
+
+		auto start = std::chrono::steady_clock::now();
+		index.Scan({ root });
+		coldTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		auto snapshot = index.Snapshot();
+		shortcuts = snapshot->Size();
+		folders = snapshot->Directories().size();
+		for (size_t i = 0; i < snapshot->Size(); i++)
+			resolved += snapshot->TargetName(i).starts_with("app");
+
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < rescans; i++) {
+			index.Scan({ root });
+			kept = kept && index.Snapshot() == snapshot;
+		}
+		rescanTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / rescans;
+	}
+
+	std::filesystem::remove_all(root, ec);
+	std::filesystem::remove_all(cache, ec);
+
+	spdlog::info("Start menu scan, {} shortcuts in {} folders: {:.2f} ms cold, {:.3f} ms rescanning the unchanged tree{}", shortcuts, folders, coldTime, rescanTime,
+		kept ? "" : " (republished)");
+	return shortcuts == count && resolved == count && kept;
+}
+
+/// <summary>
+/// Two million synthetic launches over 5000 apps of a 100k entry Start menu, a few of them taking most of the
+/// launches, through a persisted history. The ranking has to survive the compactions and reading the log back,
+/// and the most frecent app has to top the empty query.
+/// </summary>
+static bool runLaunchHistory() {
+	static constexpr size_t launches = 2'000'000;
+	static constexpr size_t launched = 5000;
+	static constexpr size_t compared = 20;
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "imsplorer-bench-launches.bin";
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+
+	auto apps = syntheticApps(100000);
+	std::vector<uint64_t> keys(launched);
+	for (size_t i = 0; i < launched; i++)
+		keys[i] = LaunchHistory::Key(apps->Path(i * (apps->Size() / launched)));
+
+	// Cubed so the first apps get most of the launches
+	Random random;
+	auto pick = [&]() {
+		double u = random.Unit();
+		return (size_t)((double)launched * u * u * u);
+	};
+
+	// One launch every 15 seconds, the last one now
+	int64_t now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	int64_t time = now - (int64_t)launches * 15;
+
+	std::vector<std::pair<uint64_t, LaunchHistory::Entry>> top;
+	double recordTime = 0, flushTime = 0, loadTime = 0, firstQuery = 0, launchQuery = 0;
+	uint64_t compactions = 0;
+	bool topFirst = false;
+	{
+		LaunchHistory history;
+		history.Load(path);
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < launches; i++)
+			history.Record(keys[pick()], time += 15);
+		recordTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		history.Flush();
+		flushTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		compactions = history.Compactions();
+
+		for (const auto& [rank, key] : history.Ranked()) {
+			if (top.size() == compared) break;
+			top.push_back({ key, *history.Find(key) });
+		}
+
+		// Every path gets hashed the first time, a launch after that only remaps the launched apps
+		SystemClock clock;
+		AppSearch search;
+		search.SetHistory(&history, &clock);
+		start = std::chrono::steady_clock::now();
+		const auto& results = search.Query(apps, "", apps->Size());
+		firstQuery = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		topFirst = !results.empty() && LaunchHistory::Key(apps->Path(results.front().index)) == top.front().first;
+
+		history.Record(keys[launched - 1], now);
+		start = std::chrono::steady_clock::now();
+		search.Query(apps, "", apps->Size());
+		launchQuery = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	LaunchHistory reloaded;
+	auto start = std::chrono::steady_clock::now();
+	bool loaded = reloaded.Load(path);
+	loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// Compacted scores are stored as floats, so the ranks only have to be close
+	bool same = loaded && top.size() == compared;
+	for (const auto& [key, entry] : top) {
+		const LaunchHistory::Entry* other = reloaded.Find(key);
+		same = same && other && other->count == entry.count && other->last == entry.last && std::abs(other->rank - entry.rank) < 1e-3;
+	}
+
+	uintmax_t size = std::filesystem::file_size(path, ec);
+	std::filesystem::remove(path, ec);
+
+	spdlog::info("Launch history, {} launches of {} apps: {:.1f} ns per launch, flushed after {:.2f} ms, {} compactions, {} apps and {} bytes on disk, loaded in {:.2f} ms",
+		launches, launched, recordTime * 1e6 / launches, flushTime, compactions, reloaded.Size(), size, loadTime);
+	spdlog::info("Empty query over {} apps with the history: {:.2f} ms, {:.3f} ms after a launch", apps->Size(), firstQuery, launchQuery);
+	return same && topFirst;
+}
+
+/// <summary>
+/// Build a trie over a million synthetic executables, then time prefix lookups of 1 to 8 characters
+/// </summary>
+static void runCommandIndex() {
+	static constexpr size_t count = 1'000'000;
+	static constexpr size_t lookups = 200'000;
+
+	auto start = std::chrono::steady_clock::now();
+	auto commands = syntheticCommands(count);
+	double buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// Prefixes of existing names, every other one uppercased since lookups fold case
+	Random random;
+	std::vector<std::string> prefixes(lookups);
+	std::array<double, 9> perLength{};
+	size_t matched = 0;
+	for (size_t length = 1; length <= 8; length++) {
+		for (size_t i = 0; i < lookups; i++) {
+			std::string_view name = commands->Name(random.Below(commands->Size()));
+			prefixes[i].assign(name.substr(0, length));
+			if (i % 2 == 1)
+				std::transform(prefixes[i].begin(), prefixes[i].end(), prefixes[i].begin(), [](char c) { return (char)std::toupper((unsigned char)c); });
+		}
+
+		start = std::chrono::steady_clock::now();
+		for (const std::string& prefix : prefixes)
+			matched += commands->Complete(prefix).Size();
+		perLength[length] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+	}
+
+	spdlog::info("Command index, {} executables: built in {:.2f} ms, {} trie nodes, {} KB of trie", commands->Size(), buildTime,
+		commands->Trie().NodeCount(), commands->Trie().MemoryUsage() / 1024);
+	spdlog::info("Completion by prefix length: {:.0f} / {:.0f} / {:.0f} / {:.0f} / {:.0f} / {:.0f} / {:.0f} / {:.0f} ns, {} matches",
+		perLength[1], perLength[2], perLength[3], perLength[4], perLength[5], perLength[6], perLength[7], perLength[8], matched);
+}
+
+/// <summary>
+/// Churn a registry holding 1k, then 10k windows: every round closes a random window, opens a new one and focuses
+/// a random one, so tombstones pile up and get compacted about once every `count` rounds like on a busy taskbar.
+/// The registry has to end up with exactly the open windows, in the order they were opened, the last one focused.
+/// </summary>
+static bool runWindowRegistry() {
+	static constexpr size_t rounds = 1'000'000;
+
+	bool ok = true;
+	for (size_t count : { 1000, 10000 }) {
+		WindowRegistry<Window> registry;
+		std::vector<WindowHandle> open(count);
+		WindowHandle next = 1;
+		for (WindowHandle& handle : open) {
+			handle = next++;
+			registry.Insert(handle);
+		}
+
+		Random random;
+		WindowHandle focused = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < rounds; i++) {
+			size_t closed = random.Below(open.size());
+			registry.Erase(open[closed]);
+			open[closed] = next;
+			registry.Insert(next++);
+
+			focused = open[random.Below(open.size())];
+			registry.Activate(focused);
+		}
+		double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		// Handles are handed out in increasing order, so the open ones sorted are the display order
+		std::sort(open.begin(), open.end());
+		auto it = open.begin();
+		bool same = registry.Size() == count && registry.Focused() == focused;
+		for (const auto& record : registry)
+			same = same && it != open.end() && record.handle == *it++;
+
+		spdlog::info("Window registry, {:>5} windows: {:.1f} ns per insert, erase or activate over {} rounds", count, elapsed / (rounds * 3), rounds);
+		ok = ok && same;
+	}
+
+	return ok;
+}
+
+/// <summary>
+/// Feed four million synthetic key events through the hotkey engine, once trusting the events and once with a
+/// key query answered from the simulated keyboard, and log the latency percentiles per event. The stream mixes
+/// typing with and without Shift and with auto-repeat, Win taps, unbound Win+key combos and registered shortcuts,
+/// every tap and shortcut has to fire exactly once and every key has to end up released.
+/// </summary>
+static bool runHotkeys() {
+	static constexpr size_t events = 4'000'000;
+
+	struct Shortcut {
+		const char* text;
+		std::array<uint8_t, 2> modifiers; // Pressed in order, 0 for none
+		uint8_t key;
+	};
+	static constexpr Shortcut shortcuts[] = {
+		{ "Win+E", { Keys::LWin, 0 }, 'E' },
+		{ "Win+Shift+S", { Keys::LWin, Keys::LShift }, 'S' },
+		{ "Ctrl+Alt+T", { Keys::LControl, Keys::LAlt }, 'T' },
+		{ "Ctrl+Shift+Esc", { Keys::LControl, Keys::LShift }, 0x1B },
+	};
+
+	Random random;
+	std::vector<std::pair<uint8_t, bool>> stream;
+	stream.reserve(events + 8);
+	size_t expectedTaps = 0, expectedFired = 0;
+	auto press = [&](uint8_t key) { stream.push_back({ key, true }); };
+	auto release = [&](uint8_t key) { stream.push_back({ key, false }); };
+	while (stream.size() < events) {
+		uint64_t r = random.Next();
+		uint8_t letter = (uint8_t)('A' + (r >> 8) % 26);
+		switch (r % 16) {
+		case 10: case 11: {
+			uint8_t win = r & 0x10000 ? Keys::RWin : Keys::LWin;
+			press(win);
+			release(win);
+			expectedTaps++;
+			break;
+		}
+		case 12: case 13:
+			press(Keys::LWin);
+			press(letter == 'E' ? 'X' : letter);
+			release(letter == 'E' ? 'X' : letter);
+			release(Keys::LWin);
+			break;
+		case 14: case 15: {
+			const Shortcut& shortcut = shortcuts[(r >> 16) % std::size(shortcuts)];
+			for (uint8_t modifier : shortcut.modifiers)
+				if (modifier != 0) press(modifier);
+			press(shortcut.key);
+			release(shortcut.key);
+			for (auto it = shortcut.modifiers.rbegin(); it != shortcut.modifiers.rend(); ++it)
+				if (*it != 0) release(*it);
+			expectedFired++;
+			break;
+		}
+		default: {
+			bool shifted = r & 0x10000, repeated = r & 0x20000;
+			if (shifted) press(Keys::LShift);
+			press(letter);
+			if (repeated) press(letter);
+			release(letter);
+			if (shifted) release(Keys::LShift);
+			break;
+		}
+		}
+	}
+
+	// steady_clock reads around each event
+	float overhead = clockOverhead();
+	bool ok = true;
+	std::vector<float> latencies(stream.size());
+	for (bool queried : { false, true }) {
+		size_t taps = 0, fired = 0;
+		std::bitset<256> keyboard;
+
+		HotkeyEngine engine;
+		engine.OnWinTap([&]() { taps++; });
+		for (const Shortcut& shortcut : shortcuts)
+			engine.Register(shortcut.text, [&]() { fired++; });
+		if (queried)
+			engine.SetKeyQuery([&](uint8_t key) { return keyboard.test(key); });
+
+		auto begin = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < stream.size(); i++) {
+			auto [key, down] = stream[i];
+			auto start = std::chrono::steady_clock::now();
+			engine.OnKey(key, down);
+			latencies[i] = std::chrono::duration<float, std::nano>(std::chrono::steady_clock::now() - start).count() - overhead;
+			keyboard.set(key, down);
+		}
+		double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+		std::sort(latencies.begin(), latencies.end());
+		spdlog::info("Hotkeys{}, {} events in {:.1f} ms: {:.1f} ns p50, {:.1f} ns p99, {:.1f} ns p99.9, {:.0f} ns max per event, {} of {} taps and {} of {} shortcuts",
+			queried ? " with a key query" : "", stream.size(), total, ProfilePercentile(latencies, 0.50f), ProfilePercentile(latencies, 0.99f), ProfilePercentile(latencies, 0.999f), latencies.back(),
+			taps, expectedTaps, fired, expectedFired);
+
+		ok = ok && taps == expectedTaps && fired == expectedFired && engine.Modifiers() == 0;
+		for (size_t key = 0; key < 256; key++)
+			ok = ok && !engine.IsDown((uint8_t)key);
+	}
+
+	return ok;
+}
+
+/// <summary>
+/// Type queries into the Start menu search one key at a time over a synthetic index of 100k names published
+/// like a scan would, then delete the last key, and log the latency of each keystroke. Only the first key
+/// scans the whole index, the following ones narrow the previous matches. Typed out, a query has to rank
+/// exactly like a fresh search for the whole text.
+/// </summary>
+static bool runAppSearch() {
+	static constexpr size_t count = 100'000;
+	static constexpr size_t rounds = 20;
+	static constexpr size_t rows = 12; // What fits in the Start menu
+	static constexpr std::string_view queries[] = { "visual code", "control panel 42", "setngs", "zzz" };
+
+	AppIndex index;
+	index.Publish(syntheticApps(count));
+	std::shared_ptr<const AppSnapshot> apps = index.Snapshot();
+
+	bool ok = apps->Size() == count;
+	for (std::string_view query : queries) {
+		std::vector<float> first, narrowing, backspace;
+		size_t matches = 0;
+
+		for (size_t round = 0; round < rounds && ok; round++) {
+			AppSearch search;
+			for (size_t length = 1; length <= query.size(); length++) {
+				auto start = std::chrono::steady_clock::now();
+				search.Query(apps, query.substr(0, length), rows);
+				float duration = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+				(length == 1 ? first : narrowing).push_back(duration);
+			}
+
+			AppSearch fresh;
+			const std::vector<SearchResult>& expected = fresh.Query(apps, query, rows);
+			ok = search.MatchCount() == fresh.MatchCount() && std::equal(search.Results().begin(), search.Results().end(), expected.begin(), expected.end(),
+				[](const SearchResult& a, const SearchResult& b) { return a.index == b.index && a.score == b.score; });
+			matches = search.MatchCount();
+
+			auto start = std::chrono::steady_clock::now();
+			search.Query(apps, query.substr(0, query.size() - 1), rows);
+			backspace.push_back(std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count());
+		}
+		if (!ok) {
+			spdlog::error("Typing \"{}\" a key at a time ranked differently than searching for it at once", query);
+			break;
+		}
+
+		std::sort(first.begin(), first.end());
+		std::sort(narrowing.begin(), narrowing.end());
+		std::sort(backspace.begin(), backspace.end());
+
+		spdlog::info("Search \"{}\" over {} apps, {} matches: first key p50 {:.1f} us, next keys p50 {:.1f} us p95 {:.1f} us max {:.1f} us, backspace p50 {:.1f} us",
+			query, apps->Size(), matches, ProfilePercentile(first, 0.5f), ProfilePercentile(narrowing, 0.5f), ProfilePercentile(narrowing, 0.95f), narrowing.back(),
+			ProfilePercentile(backspace, 0.5f));
+	}
+
+	return ok;
+}
+
+/// <summary>
+/// Hash draw data of 100 to 100k rectangles (about 9 KB to 9 MB of vertices and indices) and log the cost
+/// against the size. The same frame built twice has to hash the same, and moving one rectangle by a pixel,
+/// recolouring it or clipping the list differently has to change the hash.
+/// </summary>
+static bool runFrameDiff() {
+	enum class Variant { Same, Moved, Recoloured, Clipped };
+
+	HeadlessPlatform platform;
+	ImGui::GetIO().BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset; // Lists past 64k vertices get split, no renderer to mind
+
+	auto build = [&](size_t rects, Variant variant) {
+		platform.BeginFrame();
+		ImDrawList* list = ImGui::GetForegroundDrawList();
+		if (variant == Variant::Clipped)
+			list->PushClipRect(ImVec2(0, 0), ImVec2(1000, 1000));
+		for (size_t i = 0; i < rects; i++) {
+			float x = (float)(i % 1000 * 2), y = (float)(i / 1000 % 1000);
+			if (i == rects / 2 && variant == Variant::Moved) x += 1;
+			ImU32 color = i == rects / 2 && variant == Variant::Recoloured ? 0xFF00FF00 : 0xFF000000 | (ImU32)i;
+			list->AddRectFilled(ImVec2(x, y), ImVec2(x + 8, y + 8), color);
+		}
+		if (variant == Variant::Clipped)
+			list->PopClipRect();
+		platform.EndFrame();
+		return HashDrawData(*ImGui::GetDrawData());
+	};
+
+	bool ok = true;
+	for (size_t rects : { 100, 1000, 10000, 100000 }) {
+		uint64_t hash = build(rects, Variant::Same);
+		uint64_t skipped = platform.Diff().Skipped();
+		ok = ok && build(rects, Variant::Same) == hash && platform.Diff().Skipped() == skipped + 1;
+
+		const ImDrawData& data = *ImGui::GetDrawData();
+		size_t bytes = (size_t)data.TotalVtxCount * sizeof(ImDrawVert) + (size_t)data.TotalIdxCount * sizeof(ImDrawIdx);
+		size_t iterations = (std::max)((size_t)20, (size_t)(256 * 1024 * 1024) / bytes);
+		uint64_t checksum = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; i++)
+			checksum += HashDrawData(data, checksum);
+		double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+		spdlog::info("Draw data hash, {:>6} rects, {:>5} KB: {:9.2f} us, {:5.2f} GB/s (checksum {:x})", rects, bytes / 1024, elapsed, bytes / elapsed / 1000, checksum & 0xFFFF);
+
+		ok = ok && build(rects, Variant::Moved) != hash && build(rects, Variant::Recoloured) != hash && build(rects, Variant::Clipped) != hash;
+	}
+
+	return ok;
+}
+
+/// <summary>
+/// Time a SnapshotBuffer handoff between two threads, then sample the real machine at the default interval
+/// and log the sampler's cost against its budget
+/// </summary>
+static void runResourceSampler() {
+	static constexpr uint64_t publishes = 1'000'000;
+
+	SnapshotBuffer<uint64_t> buffer;
+	std::atomic<bool> done = false;
+	auto start = std::chrono::steady_clock::now();
+	std::jthread writer([&]() {
+		for (uint64_t i = 1; i <= publishes; i++) {
+			buffer.Back() = i;
+			buffer.Publish();
+		}
+		done = true;
+	});
+
+	uint64_t updates = 0;
+	for (;;) {
+		bool finished = done.load();
+		if (buffer.Update())
+			updates++;
+		else if (finished)
+			break;
+	}
+	writer.join();
+	double handoffTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+#if defined(_WIN32)
+	uint32_t self = GetCurrentProcessId();
+	ResourceSampler sampler(std::make_unique<Win32ResourceBackend>(), nullptr, std::chrono::milliseconds(0));
+#elif defined(__linux__)
+	uint32_t self = (uint32_t)getpid();
+	ResourceSampler sampler(std::make_unique<ProcFsResourceBackend>(), nullptr, std::chrono::milliseconds(0));
+#else
+	uint32_t self = 0;
+	ResourceSampler sampler(nullptr, nullptr, std::chrono::milliseconds(0));
+#endif
+
+	// Keep a core busy between the baseline and the sample
+	sampler.Sample();
+	start = std::chrono::steady_clock::now();
+	volatile uint64_t spin = 0;
+	while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200))
+		spin = spin + 1;
+	sampler.Sample();
+	sampler.Update();
+
+	const ResourceSnapshot& snapshot = sampler.Latest();
+	auto it = std::find_if(snapshot.processes.begin(), snapshot.processes.end(), [&](const ProcessUsage& usage) { return usage.key.pid == self; });
+	float cpu = it != snapshot.processes.end() ? it->cpu : 0.0f;
+
+	static constexpr int samples = 20;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < samples; i++)
+		sampler.Sample();
+	double sampleTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / samples;
+	double cost = sampleTime / (double)ResourceSampler::kInterval.count();
+
+	spdlog::info("Snapshot buffer: {} publishes in {:.2f} ms, {} picked up", publishes, handoffTime, updates);
+	spdlog::info("Resource sampler: {} processes in {:.3f} ms, {:.4f}% of a core every {} ms (budget {}%), this process at {:.2f} cores",
+		snapshot.processes.size(), sampleTime, cost * 100, ResourceSampler::kInterval.count(), ResourceSampler::kBudget * 100, cpu);
+}
+
+/// <summary>
+/// Counts what reaches it and keeps the first line, for the async log checks
+/// </summary>
+class CountingSink : public spdlog::sinks::base_sink<std::mutex> {
+public:
+	size_t Lines() {
+		std::lock_guard lock(this->mutex_);
+		return this->lines;
+	}
+
+	std::string First() {
+		std::lock_guard lock(this->mutex_);
+		return this->first;
+	}
+
+protected:
+	void sink_it_(const spdlog::details::log_msg& msg) override {
+		if (this->lines++ == 0)
+			this->first.assign(msg.payload.data(), msg.payload.size());
+	}
+
+	void flush_() override {}
+
+private:
+	size_t lines = 0;
+	std::string first;
+};
+
+/// <summary>
+/// Time a million async log calls (an int, a double and a short string each) one by one and log the
+/// latency percentiles, next to a synchronous spdlog file logger. Every call has to be either written or
+/// counted as dropped, a message has to come out formatted as it went in, a string too long for a slot has
+/// to be cut short, and a rotating file has to get every line when the ring keeps up.
+/// </summary>
+static bool runAsyncLog() {
+#if IMS_LOG_LEVEL > IMS_LOG_LEVEL_INFO
+	spdlog::info("Async log: info calls compiled out (IMS_LOG_LEVEL {}), skipped", IMS_LOG_LEVEL);
+	return true;
+#else
+	static constexpr size_t calls = 1'000'000;
+	static constexpr size_t syncCalls = 100'000;
+	static constexpr size_t fileLines = 1000;
+
+	AsyncLog& log = AsyncLog::Get();
+	if (log.Running()) {
+		spdlog::info("Async log: already running, skipped");
+		return true;
+	}
+
+	auto sink = std::make_shared<CountingSink>();
+	if (!log.Start(sink)) return false;
+
+	IMS_LOG_INFO("window {:x} at {:.1f}% CPU, {}", 0x1234, 12.5, "explorer.exe");
+	IMS_LOG_INFO("{}", std::string(1000, 'x'));
+	log.Flush();
+	bool formatted = sink->First() == "window 1234 at 12.5% CPU, explorer.exe" && log.Truncated() == 1;
+	uint64_t before = log.Written() + log.Dropped();
+
+	// steady_clock reads around each call
+	std::vector<float> latencies(calls);
+	float overhead = clockOverhead();
+
+	const char* exes[] = { "explorer.exe", "code.exe", "firefox.exe", "wt.exe" };
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < calls; i++) {
+		auto start = std::chrono::steady_clock::now();
+		IMS_LOG_INFO("window {} at {:.1f}% CPU, {}", (int)i, i * 0.01, exes[i % std::size(exes)]);
+		latencies[i] = std::chrono::duration<float, std::nano>(std::chrono::steady_clock::now() - start).count() - overhead;
+	}
+	double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+	log.Flush();
+
+	uint64_t accounted = log.Written() + log.Dropped() - before;
+	uint64_t dropped = log.Dropped();
+	log.Stop();
+
+	std::sort(latencies.begin(), latencies.end());
+
+	// The same calls formatted and written on the calling thread
+	std::filesystem::path syncPath = std::filesystem::temp_directory_path() / "imsplorer-bench-sync.log";
+	double syncTime = 0;
+	{
+#ifdef SPDLOG_WCHAR_FILENAMES
+		auto syncSink = std::make_shared<spdlog::sinks::basic_file_sink_st>(syncPath.wstring(), true);
+#else
+		auto syncSink = std::make_shared<spdlog::sinks::basic_file_sink_st>(PathToUtf8(syncPath), true);
+#endif
+		spdlog::logger logger("sync", syncSink);
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < syncCalls; i++)
+			logger.info("window {} at {:.1f}% CPU, {}", (int)i, i * 0.01, exes[i % std::size(exes)]);
+		logger.flush();
+		syncTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / syncCalls;
+	}
+
+	// A burst the ring holds whole, every line has to reach the file
+	std::filesystem::path filePath = std::filesystem::temp_directory_path() / "imsplorer-bench-async.log";
+	std::error_code ec;
+	std::filesystem::remove(filePath, ec);
+	size_t lines = 0;
+	if (log.Start(filePath)) {
+		for (size_t i = 0; i < fileLines; i++)
+			IMS_LOG_INFO("line {}", (int)i);
+		log.Stop();
+
+		std::ifstream in(filePath);
+		for (std::string line; std::getline(in, line);)
+			lines++;
+	}
+	std::filesystem::remove(filePath, ec);
+	std::filesystem::remove(syncPath, ec);
+
+	spdlog::info("Async log: {} calls in {:.1f} ms, {:.1f} ns p50, {:.1f} ns p99, {:.1f} ns p99.9, {:.0f} ns max per call, {} dropped; synchronous file logger {:.1f} ns per call",
+		calls, total, ProfilePercentile(latencies, 0.50f), ProfilePercentile(latencies, 0.99f), ProfilePercentile(latencies, 0.999f), latencies.back(), dropped, syncTime);
+	spdlog::info("Async log: {}, {} of {} calls accounted for, {} of {} lines in the rotating file",
+		formatted ? "formatted and truncated as expected" : "WRONG OUTPUT", accounted, calls, lines, fileLines);
+
+	return formatted && accounted == calls && lines == fileLines;
+#endif
+}
+
+/// <summary>
+/// What a replay measured, and the state it left the taskbar in
+/// </summary>
+struct ReplayResult {
+	// Latency categories: shell events, keys from the hook, UI input
+	static constexpr size_t kCategories = 3;
+	static constexpr const char* kCategoryNames[kCategories] = { "shell", "hook keys", "input" };
+
+	size_t frames = 0;
+	std::vector<float> frameTimes;                            // Microseconds, BeginFrame to EndFrame
+	std::array<std::vector<float>, kCategories> recorded;     // Milliseconds from an event to the end of the frame showing it, as recorded
+	std::array<std::vector<float>, kCategories> replayed;     // The same, replayed
+	double updateTime = 0;                                    // Milliseconds in Update, waiting for windows to resolve included
+	double elapsed = 0;                                       // Milliseconds for the whole replay
+	AllocationStats allocations;                              // Made by the replayed frames
+	size_t vertices = 0;                                      // In the last frame
+
+	size_t windows = 0;
+	bool startMenu = false;
+	std::string search;
+};
+
+/// <summary>
+/// Feed a trace to a taskbar on the headless platform as fast as it goes. Windows are created with synthetic titles
+/// and exe names of the recorded lengths, every recorded frame is built once every window known by then is resolved.
+/// </summary>
+static void replayTrace(std::span<const TraceEvent> events, ReplayResult& result) {
+	// The first screen the recording saw, and what each window was resolved to (a handle can come back as another window)
+	ImVec2 screen(1920, 1080);
+	float taskbarHeight = 48;
+	bool screenFound = false;
+	std::unordered_map<uint64_t, std::vector<size_t>> descriptions; // Recorded handle -> indices of its Window events
+	for (size_t i = 0; i < events.size(); i++) {
+		if (events[i].kind == TraceEventKind::Screen && !screenFound) {
+			screen = ImVec2(events[i].x, events[i].y);
+			taskbarHeight = events[i].code;
+			screenFound = true;
+		}
+		else if (events[i].kind == TraceEventKind::Window) {
+			descriptions[events[i].handle].push_back(i);
+		}
+	}
+
+	HeadlessPlatform platform(screen, taskbarHeight);
+	platform.SetCommandPaths({});
+
+	std::filesystem::path startMenu = std::filesystem::temp_directory_path() / "imsplorer-replay-apps";
+	syntheticStartMenu(startMenu, 1000);
+	platform.SetAppRoots({ startMenu });
+
+	// Every recorded change reaches the frame it was recorded before
+	ImGuiIO& io = ImGui::GetIO();
+	io.ConfigInputTrickleEventQueue = false;
+
+	std::unordered_map<uint64_t, WindowHandle> handles;
+	WindowHandle unknown = 0;
+	size_t titles = 0;
+	auto pad = [](std::string text, size_t length) { text.resize(length, 'x'); return text; };
+
+	// Map a recorded handle, creating the window if the recording resolved it after `index`
+	auto map = [&](uint64_t recorded, size_t index, bool create) {
+		auto it = handles.find(recorded);
+		if (it != handles.end()) return it->second;
+
+		WindowHandle handle = ++unknown; // Below the headless platform's handles, never a taskbar window
+		auto described = descriptions.find(recorded);
+		if (create && described != descriptions.end()) {
+			auto next = std::upper_bound(described->second.begin(), described->second.end(), index);
+			if (next != described->second.end()) {
+				const TraceEvent& window = events[*next];
+				std::string exe = pad(fmt::format("{:04x}", (uint16_t)window.y), (size_t)(std::max)(window.x - 4, 4)) + ".exe";
+				handle = platform.AddWindow(pad(fmt::format("Window {}", titles++), window.code), "C:\\Apps\\" + exe);
+			}
+		}
+		handles.emplace(recorded, handle);
+		return handle;
+	};
+
+	// The windows listed at startup exist before the taskbar
+	for (size_t i = 0; i < events.size(); i++) {
+		if (events[i].kind == TraceEventKind::Existing)
+			map(events[i].handle, i, true);
+	}
+
+	auto replayStart = std::chrono::steady_clock::now();
+
+	Taskbar taskbar(platform);
+	taskbar.Init();
+
+	struct Pending {
+		size_t category;
+		int64_t time;
+		std::chrono::steady_clock::time_point fed;
+	};
+	std::vector<Pending> pending;
+
+	for (size_t i = 0; i < events.size(); i++) {
+		const TraceEvent& event = events[i];
+		auto fed = std::chrono::steady_clock::now();
+
+		switch (event.kind) {
+		case TraceEventKind::Shell: {
+			if (event.code > (uint16_t)ShellEventType::Redraw) break;
+
+			auto type = (ShellEventType)event.code;
+			bool creates = type == ShellEventType::Created || type == ShellEventType::Replacing;
+			WindowHandle handle = map(event.handle, i, creates);
+			if (type == ShellEventType::Destroyed) {
+				// A later window may get the same handle
+				handles.erase(event.handle);
+				if (platform.IsTaskbarWindow(handle))
+					platform.CloseWindow(handle);
+				else
+					taskbar.OnShellEvent(type, handle);
+			}
+			else {
+				taskbar.OnShellEvent(type, handle);
+			}
+			pending.push_back({ 0, event.time, fed });
+			break;
+		}
+
+		case TraceEventKind::Key:
+			taskbar.OnKey((uint8_t)event.code, event.down != 0);
+			pending.push_back({ 1, event.time, fed });
+			break;
+
+		case TraceEventKind::Title: {
+			auto it = handles.find(event.handle);
+			if (it != handles.end())
+				platform.SetWindowTitle(it->second, pad(fmt::format("Title {}", titles++), event.code), false);
+			break;
+		}
+
+		case TraceEventKind::MousePos:
+			if (event.x == INT16_MIN)
+				io.AddMousePosEvent(-FLT_MAX, -FLT_MAX);
+			else
+				io.AddMousePosEvent(event.x, event.y);
+			pending.push_back({ 2, event.time, fed });
+			break;
+
+		case TraceEventKind::MouseButton:
+			if (event.code < ImGuiMouseButton_COUNT)
+				io.AddMouseButtonEvent(event.code, event.down != 0);
+			pending.push_back({ 2, event.time, fed });
+			break;
+
+		case TraceEventKind::MouseWheel:
+			io.AddMouseWheelEvent(event.x / 120.0f, event.y / 120.0f);
+			pending.push_back({ 2, event.time, fed });
+			break;
+
+		case TraceEventKind::UiKey:
+			io.AddKeyEvent((ImGuiKey)event.code, event.down != 0);
+			pending.push_back({ 2, event.time, fed });
+			break;
+
+		case TraceEventKind::Char:
+			io.AddInputCharacterUTF16(event.code);
+			pending.push_back({ 2, event.time, fed });
+			break;
+
+		case TraceEventKind::Frame: {
+			// Resolving is asynchronous when recording, here every window is in before the frame so runs match
+			auto start = std::chrono::steady_clock::now();
+			taskbar.Update();
+			while (taskbar.windowWorker.InFlight() > 0) {
+				std::this_thread::yield();
+				taskbar.Update();
+			}
+			auto built = std::chrono::steady_clock::now();
+
+			AllocationStats before = ThreadAllocations();
+			platform.BeginFrame();
+			taskbar.BuildFrame();
+			platform.EndFrame();
+			AllocationStats allocations = ThreadAllocations() - before;
+			auto end = std::chrono::steady_clock::now();
+
+			result.frames++;
+			result.allocations.count += allocations.count;
+			result.allocations.bytes += allocations.bytes;
+			result.updateTime += std::chrono::duration<double, std::milli>(built - start).count();
+			result.frameTimes.push_back(std::chrono::duration<float, std::micro>(end - built).count());
+
+			for (const Pending& input : pending) {
+				result.recorded[input.category].push_back((float)(event.time - input.time) / 1000);
+				result.replayed[input.category].push_back(std::chrono::duration<float, std::milli>(end - input.fed).count());
+			}
+			pending.clear();
+			break;
+		}
+
+		// Existing windows were created up front, resolutions are what map creates windows from,
+		// and the taskbar follows the screen the replay started with
+		case TraceEventKind::Existing:
+		case TraceEventKind::Window:
+		case TraceEventKind::Screen:
+			break;
+		}
+	}
+
+	result.elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - replayStart).count();
+	result.vertices = platform.LastVertexCount();
+	result.windows = taskbar.windows.Size();
+	result.startMenu = taskbar.showStartMenu;
+	result.search = taskbar.searchBuffer;
+
+	std::error_code ec;
+	std::filesystem::remove_all(startMenu, ec);
+}
+
+static void logReplay(size_t events, int64_t recordedTime, ReplayResult& result) {
+	std::vector<float>& frames = result.frameTimes;
+	std::sort(frames.begin(), frames.end());
+	for (size_t i = 0; i < ReplayResult::kCategories; i++) {
+		std::sort(result.recorded[i].begin(), result.recorded[i].end());
+		std::sort(result.replayed[i].begin(), result.replayed[i].end());
+	}
+
+	double total = 0;
+	for (float frame : frames) total += frame;
+
+	spdlog::info("Replayed {} events and {} frames in {:.1f} ms, recorded over {:.1f} s ({:.1f} ms updating, {} allocations in frames)",
+		events, result.frames, result.elapsed, (double)recordedTime / 1e6, result.updateTime, result.allocations.count);
+	spdlog::info("{:<28} mean {:8.1f} us  p50 {:8.1f} us  p95 {:8.1f} us  p99 {:8.1f} us  max {:8.1f} us  ({} vertices)", "Replayed frames",
+		frames.empty() ? 0.0 : total / frames.size(), ProfilePercentile(frames, 0.50f), ProfilePercentile(frames, 0.95f), ProfilePercentile(frames, 0.99f),
+		ProfilePercentile(frames, 1.0f), result.vertices);
+
+	for (size_t i = 0; i < ReplayResult::kCategories; i++) {
+		if (result.recorded[i].empty()) continue;
+		spdlog::info("Latency to the frame, {:<10} ({:>6} events): recorded p50 {:8.2f} ms  p95 {:8.2f} ms  max {:8.2f} ms, replayed p50 {:8.3f} ms  p95 {:8.3f} ms  max {:8.3f} ms",
+			ReplayResult::kCategoryNames[i], result.recorded[i].size(),
+			ProfilePercentile(result.recorded[i], 0.50f), ProfilePercentile(result.recorded[i], 0.95f), ProfilePercentile(result.recorded[i], 1.0f),
+			ProfilePercentile(result.replayed[i], 0.50f), ProfilePercentile(result.replayed[i], 0.95f), ProfilePercentile(result.replayed[i], 1.0f));
+	}
+}
+
+/// <summary>
+/// A synthetic trace of a window storm, rapid focus switching, title changes, Win+R and typing, written and
+/// read back (a torn last record included), then replayed: the taskbar has to end up with the surviving
+/// windows and the typed command.
+/// </summary>
+static bool runTraceReplay() {
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "imsplorer-bench-trace.bin";
+
+	std::vector<TraceEvent> written;
+	int64_t time = 0;
+	auto add = [&](TraceEventKind kind, uint64_t handle = 0, uint16_t code = 0, int16_t x = 0, int16_t y = 0, bool down = false) {
+		TraceEvent event;
+		event.time = time += 500;
+		event.handle = handle;
+		event.code = code;
+		event.x = x;
+		event.y = y;
+		event.kind = kind;
+		event.down = down ? 1 : 0;
+		written.push_back(event);
+	};
+	auto shell = [&](ShellEventType type, uint64_t handle) { add(TraceEventKind::Shell, handle, (uint16_t)type); };
+	auto window = [&](uint64_t handle, size_t i) { add(TraceEventKind::Window, handle, (uint16_t)(12 + i % 40), (int16_t)(8 + i % 5), (int16_t)(i % 7)); };
+	auto handle = [](size_t i) { return (uint64_t)(0x40000 + i * 4); };
+
+	add(TraceEventKind::Screen, 0, 48, 2560, 1440);
+	for (size_t i = 0; i < 20; i++) {
+		add(TraceEventKind::Existing, handle(i));
+		window(handle(i), i);
+	}
+	add(TraceEventKind::Frame);
+
+	// 200 windows in a burst, resolved a few at a time, then 50 of them gone
+	for (size_t i = 20; i < 220; i++) {
+		shell(ShellEventType::Created, handle(i));
+		window(handle(i), i);
+		if (i % 10 == 0) add(TraceEventKind::Frame);
+	}
+	for (size_t i = 100; i < 150; i++)
+		shell(ShellEventType::Destroyed, handle(i));
+	add(TraceEventKind::Frame);
+
+	// Alt+Tab through everything, with the odd title change and a window the taskbar doesn't show
+	for (size_t i = 0; i < 2000; i++) {
+		shell(ShellEventType::Activated, i % 50 == 7 ? 0x99990 : handle((i * 37) % 220));
+		if (i % 9 == 0) {
+			shell(ShellEventType::Redraw, handle(i % 100));
+			add(TraceEventKind::Title, handle(i % 100), (uint16_t)(i % 60));
+		}
+		if (i % 25 == 0) {
+			add(TraceEventKind::MousePos, 0, 0, (int16_t)(i % 2560), 1420);
+			add(TraceEventKind::Frame);
+		}
+	}
+
+	// Win+R opens the Run mode with the search box focused, then a command gets typed
+	add(TraceEventKind::Key, 0, Keys::LWin, 0, 0, true);
+	add(TraceEventKind::Key, 0, 'R', 0, 0, true);
+	add(TraceEventKind::Key, 0, 'R', 0, 0, false);
+	add(TraceEventKind::Key, 0, Keys::LWin, 0, 0, false);
+	add(TraceEventKind::Frame);
+	add(TraceEventKind::Frame);
+	for (char c : std::string_view("git")) {
+		add(TraceEventKind::Char, 0, (uint16_t)c);
+		add(TraceEventKind::Frame);
+	}
+	add(TraceEventKind::Frame);
+
+	TraceWriter writer;
+	bool saved = writer.Open(path);
+	for (const TraceEvent& event : written)
+		writer.Write(event);
+	saved = saved && writer.Close();
+
+	// A record cut short by a crash is dropped, everything before it stays
+	std::ofstream(path, std::ios::binary | std::ios::app).write("torn", 4);
+
+	std::vector<TraceEvent> loaded;
+	bool roundTrip = saved && LoadTrace(path, loaded) && loaded.size() == written.size() &&
+		std::memcmp(loaded.data(), written.data(), written.size() * sizeof(TraceEvent)) == 0;
+
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+
+	ReplayResult result;
+	replayTrace(loaded, result);
+	logReplay(loaded.size(), loaded.empty() ? 0 : loaded.back().time, result);
+
+	bool replayed = result.windows == 170 && result.startMenu && result.search == ">git" && result.vertices > 0;
+	if (!replayed)
+		spdlog::error("The replay left {} windows, the Start menu {} and \"{}\" in the search box", result.windows, result.startMenu ? "open" : "closed", result.search);
+	return roundTrip && replayed;
+}
+
+int IMS::RunBenchmarks(size_t frames) {
+	static constexpr Scenario scenarios[] = {
+		// Only what fits on screen is built, these should stay flat as the counts grow
+		{ "10 windows", 10, 0, "" },
+		{ "100 windows", 100, 0, "" },
+		{ "1000 windows", 1000, 0, "" },
+		{ "10k windows", 10000, 0, "" },
+		{ "500 windows, ungrouped", 500, 0, "" },
+		{ "500 windows, grouped", 500, 0, "", true },
+		{ "500 windows, grouped, tinted", 500, 0, "", true, 0, true },
+		{ "Start menu, 100 apps", 10, 100, "" },
+		{ "Start menu, 1k apps", 10, 1000, "" },
+		{ "Start menu, 10k apps", 10, 10000, "" },
+		{ "Start menu, 100k apps", 10, 100000, "" },
+		{ "Start menu, 10k apps, query", 10, 10000, "sc" },
+		{ "Start menu, 100k apps, query", 10, 100000, "vsc" },
+		{ "Run mode, 1M commands", 10, 0, ">", false, 1000000 },
+		{ "Run mode, 1M commands, query", 10, 0, ">clang-t", false, 1000000 },
+	};
+
+	frames = (std::max)(frames, (size_t)1);
+	spdlog::info("Frame build benchmark, {} frames per scenario", frames);
+
+	int failed = 0;
+	runStartupGraph();
+	runFontCache();
+
+	if (!runAppIndexScan()) {
+		spdlog::error("The Start menu scan missed a shortcut or its target, or republished an unchanged tree");
+		failed++;
+	}
+
+	if (!runLaunchHistory()) {
+		spdlog::error("The launch history didn't read back the ranking it wrote");
+		failed++;
+	}
+
+	runResourceSampler();
+	runCommandIndex();
+
+	if (!runWindowRegistry()) {
+		spdlog::error("The window registry lost a window, its order or the focus while churning");
+		failed++;
+	}
+
+	if (!runHotkeys()) {
+		spdlog::error("The hotkey engine missed or repeated a Win tap or a shortcut, or left a key down");
+		failed++;
+	}
+
+	if (!runAppSearch()) {
+		spdlog::error("The Start menu search narrowed a query differently than it searched it");
+		failed++;
+	}
+
+	if (!runFrameDiff()) {
+		spdlog::error("The draw data hash missed a change or an unchanged frame wasn't skipped");
+		failed++;
+	}
+
+	if (!runAsyncLog()) {
+		spdlog::error("The async log lost or garbled a message");
+		failed++;
+	}
+
+	if (!runTraceReplay()) {
+		spdlog::error("The trace didn't read back as written or the replay didn't end where the recording did");
+		failed++;
+	}
+
+	for (const Scenario& scenario : scenarios) {
+		if (!runScenario(scenario, frames))
+			failed++;
+	}
+
+	return failed == 0 ? 0 : 1;
+}
+
+int IMS::ReplayTrace(const std::filesystem::path& path) {
+	std::vector<TraceEvent> events;
+	if (!LoadTrace(path, events)) {
+		spdlog::error("{} isn't a trace", PathToUtf8(path));
+		return 1;
+	}
+	if (events.empty()) {
+		spdlog::error("{} has no events", PathToUtf8(path));
+		return 1;
+	}
+
+	ReplayResult result;
+	replayTrace(events, result);
+	logReplay(events.size(), events.back().time, result);
+	return 0;
+}
+
+int IMS::RunShellLinkBenchmark(const std::filesystem::path& corpus, size_t iterations) {
+	std::vector<std::vector<uint8_t>> files;
+	size_t bytes = 0;
+
+	std::error_code ec;
+	for (std::filesystem::recursive_directory_iterator it(corpus, std::filesystem::directory_options::skip_permission_denied, ec), end; !ec && it != end; it.increment(ec)) {
+		std::error_code entryError;
+		if (!it->is_regular_file(entryError)) continue;
+
+		std::ifstream in(it->path(), std::ios::binary);
+		std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		bytes += data.size();
+		files.push_back(std::move(data));
+	}
+
+	if (files.empty()) {
+		spdlog::error("No files in {}", PathToUtf8(corpus));
+		return 1;
+	}
+
+	size_t parsed = 0, targets = 0;
+	for (const auto& file : files) {
+		if (auto link = ParseShellLink(file)) {
+			parsed++;
+			if (!link->target.empty()) targets++;
+		}
+	}
+
+	iterations = (std::max)(iterations, (size_t)1);
+	auto start = std::chrono::steady_clock::now();
+	size_t checksum = 0;
+	for (size_t i = 0; i < iterations; i++) {
+		for (const auto& file : files) {
+			if (auto link = ParseShellLink(file)) checksum += link->target.size();
+		}
+	}
+	double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+	spdlog::info("Parsed {} of {} files ({} with a target), {:.2f} us per file, {:.1f} MB/s (checksum {})",
+		parsed, files.size(), targets, elapsed / (iterations * files.size()), bytes * iterations / elapsed, checksum);
+
+	// Every prefix, then every byte flipped, the parser must neither crash nor read out of bounds
+	start = std::chrono::steady_clock::now();
+	size_t mutations = 0;
+	for (auto file : files) {
+		for (size_t length = 0; length < file.size(); length++, mutations++)
+			(void)ParseShellLink(std::span<const uint8_t>(file.data(), length));
+
+		for (size_t i = 0; i < file.size(); i++, mutations++) {
+			file[i] ^= 0xFF;
+			(void)ParseShellLink(file);
+			file[i] ^= 0xFF;
+		}
+	}
+	elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	spdlog::info("Parsed {} truncated and corrupted variants in {:.1f} ms", mutations, elapsed / 1000);
+
+	return 0;
+}
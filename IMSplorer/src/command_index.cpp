@@ -0,0 +1,346 @@
+#include "pch.h"
+
+#include "command_index.h"
+
+#include "app_index.h"
+
+using namespace IMS;
+
+void PrefixTrie::Build(std::span<const std::string_view> keys) {
+	this->nodes.clear();
+	this->firstChars.clear();
+	this->labels.clear();
+
+	Node root;
+	root.end = (uint32_t)keys.size();
+	this->nodes.push_back(root);
+	this->firstChars.push_back('\0');
+
+	// Breadth first: a node's children are created together, so they end up next to each other.
+	// Depth is how many key bytes the path down to and including the node spells.
+	std::deque<std::pair<uint32_t, size_t>> queue = { { 0, 0 } };
+	while (!queue.empty()) {
+		auto [index, depth] = queue.front();
+		queue.pop_front();
+
+		uint32_t begin = this->nodes[index].begin, end = this->nodes[index].end;
+		uint32_t firstChild = (uint32_t)this->nodes.size();
+		uint16_t childCount = 0;
+
+		for (uint32_t i = begin; i < end;) {
+			// A key ending here sorts first, it's the node itself
+			if (keys[i].size() == depth) {
+				i++;
+				continue;
+			}
+
+			char c = keys[i][depth];
+			uint32_t j = i + 1;
+			while (j < end && keys[j][depth] == c)
+				j++;
+
+			// Sorted, so what the first and the last key of the group share, all of them share
+			std::string_view first = keys[i], last = keys[j - 1];
+			size_t shared = depth + 1;
+			while (shared < first.size() && shared < last.size() && first[shared] == last[shared])
+				shared++;
+
+			Node child;
+			child.labelOffset = (uint32_t)this->labels.size();
+			child.labelLength = (uint16_t)(shared - depth);
+			child.begin = i;
+			child.end = j;
+			this->labels.append(first.substr(depth, shared - depth));
+			this->nodes.push_back(child);
+			this->firstChars.push_back(c);
+			queue.emplace_back((uint32_t)this->nodes.size() - 1, shared);
+
+			childCount++;
+			i = j;
+		}
+
+		this->nodes[index].firstChild = firstChild;
+		this->nodes[index].childCount = childCount;
+	}
+}
+
+PrefixTrie::Range PrefixTrie::Find(std::string_view prefix) const {
+	if (this->nodes.empty()) return {};
+
+	uint32_t index = 0;
+	size_t depth = 0;
+	while (depth < prefix.size()) {
+		const Node& node = this->nodes[index];
+		const char* first = this->firstChars.data() + node.firstChild;
+		const void* found = node.childCount > 0 ? std::memchr(first, ToLowerAscii(prefix[depth]), node.childCount) : nullptr;
+		if (!found) return {};
+
+		index = (uint32_t)((const char*)found - this->firstChars.data());
+		const Node& child = this->nodes[index];
+
+		// The prefix can end inside the label, everything below still matches
+		size_t length = (std::min)((size_t)child.labelLength, prefix.size() - depth);
+		const char* label = this->labels.data() + child.labelOffset;
+		for (size_t i = 1; i < length; i++) {
+			if (label[i] != ToLowerAscii(prefix[depth + i])) return {};
+		}
+		depth += length;
+	}
+
+	return { this->nodes[index].begin, this->nodes[index].end };
+}
+
+void CommandSnapshotBuilder::Add(std::string_view name, std::string_view path) {
+	if (name.empty() || name.size() > UINT16_MAX || path.size() > UINT16_MAX) return;
+
+	Pending entry;
+	entry.name.assign(name);
+	entry.lower.assign(name);
+	std::transform(entry.lower.begin(), entry.lower.end(), entry.lower.begin(), ToLowerAscii);
+	entry.path.assign(path);
+	this->pending.push_back(std::move(entry));
+}
+
+size_t CommandSnapshotBuilder::Scan(const CommandSources& sources) {
+	size_t found = 0;
+
+	for (const std::filesystem::path& directory : sources.directories) {
+		std::error_code ec;
+		for (std::filesystem::directory_iterator it(directory, std::filesystem::directory_options::skip_permission_denied, ec), end; !ec && it != end; it.increment(ec)) {
+			std::error_code entryError;
+			if (!it->is_regular_file(entryError)) continue;
+
+			std::string name = PathToUtf8(it->path().filename());
+			if (!sources.extensions.empty()) {
+				size_t dot = name.rfind('.');
+				if (dot == std::string::npos) continue;
+
+				std::string extension = name.substr(dot);
+				std::transform(extension.begin(), extension.end(), extension.begin(), ToLowerAscii);
+				if (std::find(sources.extensions.begin(), sources.extensions.end(), extension) == sources.extensions.end()) continue;
+			}
+			else {
+				using std::filesystem::perms;
+				perms permissions = it->status(entryError).permissions();
+				if ((permissions & (perms::owner_exec | perms::group_exec | perms::others_exec)) == perms::none) continue;
+			}
+
+			this->Add(name, PathToUtf8(it->path()));
+			found++;
+		}
+	}
+
+	for (const auto& [name, path] : sources.registered) {
+		this->Add(name, path);
+		found++;
+	}
+
+	return found;
+}
+
+std::shared_ptr<const CommandSnapshot> CommandSnapshotBuilder::Build() {
+	// By name, and among equal names in the order they were added, so the first one is kept
+	std::stable_sort(this->pending.begin(), this->pending.end(), [](const Pending& a, const Pending& b) { return a.lower < b.lower; });
+	this->pending.erase(std::unique(this->pending.begin(), this->pending.end(), [](const Pending& a, const Pending& b) { return a.lower == b.lower; }), this->pending.end());
+
+	auto snapshot = std::make_shared<CommandSnapshot>();
+	snapshot->entries.resize(this->pending.size());
+
+	size_t blobSize = 0;
+	for (const Pending& entry : this->pending)
+		blobSize += entry.lower.size() + entry.name.size() + entry.path.size() + 3;
+	snapshot->blob.reserve(blobSize);
+
+	// Lowercased names back to back first, the trie is built over them
+	for (size_t i = 0; i < this->pending.size(); i++) {
+		snapshot->entries[i].lowerOffset = (uint32_t)snapshot->blob.size();
+		snapshot->blob.append(this->pending[i].lower).push_back('\0');
+	}
+	for (size_t i = 0; i < this->pending.size(); i++) {
+		const Pending& pending = this->pending[i];
+		CommandEntry& entry = snapshot->entries[i];
+
+		entry.nameOffset = (uint32_t)snapshot->blob.size();
+		entry.nameLength = (uint16_t)pending.name.size();
+		snapshot->blob.append(pending.name).push_back('\0');
+
+		entry.pathOffset = (uint32_t)snapshot->blob.size();
+		entry.pathLength = (uint16_t)pending.path.size();
+		snapshot->blob.append(pending.path).push_back('\0');
+	}
+
+	std::vector<std::string_view> keys;
+	keys.reserve(snapshot->entries.size());
+	for (size_t i = 0; i < snapshot->entries.size(); i++)
+		keys.push_back(snapshot->LowerName(i));
+	snapshot->trie.Build(keys);
+
+	this->pending.clear();
+	return snapshot;
+}
+
+std::vector<std::filesystem::path> IMS::SplitSearchPath(std::string_view value, char separator) {
+	std::vector<std::filesystem::path> directories;
+	std::unordered_set<std::string> seen;
+
+	while (!value.empty()) {
+		size_t end = value.find(separator);
+		std::string entry(value.substr(0, end));
+		value = end == std::string_view::npos ? std::string_view() : value.substr(end + 1);
+
+		std::erase(entry, '"');
+		while (!entry.empty() && (entry.back() == ' ' || entry.back() == '\t')) entry.pop_back();
+		while (!entry.empty() && (entry.front() == ' ' || entry.front() == '\t')) entry.erase(entry.begin());
+
+		if (!entry.empty() && seen.insert(entry).second)
+			directories.push_back(PathFromUtf8(entry));
+	}
+
+	return directories;
+}
+
+#ifdef _WIN32
+/// <summary>
+/// A REG_SZ or REG_EXPAND_SZ value, expanded. Empty if it's missing.
+/// </summary>
+static std::wstring readRegistryString(HKEY root, const wchar_t* key, const wchar_t* value) {
+	static constexpr DWORD flags = RRF_RT_REG_SZ | RRF_RT_REG_EXPAND_SZ | RRF_NOEXPAND;
+
+	DWORD size = 0;
+	if (RegGetValueW(root, key, value, flags, nullptr, nullptr, &size) != ERROR_SUCCESS || size == 0) return {};
+
+	std::wstring text(size / sizeof(wchar_t), L'\0');
+	if (RegGetValueW(root, key, value, flags, nullptr, text.data(), &size) != ERROR_SUCCESS) return {};
+	text.resize(wcsnlen(text.data(), text.size()));
+
+	// %SystemRoot% and the like
+	DWORD length = ExpandEnvironmentStringsW(text.c_str(), nullptr, 0);
+	std::wstring expanded(length, L'\0');
+	if (length == 0 || ExpandEnvironmentStringsW(text.c_str(), expanded.data(), length) == 0) return text;
+	expanded.resize(wcsnlen(expanded.data(), expanded.size()));
+	return expanded;
+}
+
+/// <summary>
+/// App Paths registrations: a key per executable name, its default value is the executable
+/// </summary>
+static void readAppPaths(HKEY root, std::vector<std::pair<std::string, std::string>>& out) {
+	HKEY key = nullptr;
+	if (RegOpenKeyExW(root, L"SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\App Paths", 0, KEY_READ, &key) != ERROR_SUCCESS) return;
+
+	wchar_t name[256];
+	for (DWORD i = 0;; i++) {
+		DWORD length = (DWORD)std::size(name);
+		if (RegEnumKeyExW(key, i, name, &length, nullptr, nullptr, nullptr, nullptr) != ERROR_SUCCESS) break;
+
+		std::wstring path = readRegistryString(key, name, nullptr);
+		std::erase(path, L'"');
+		if (!path.empty())
+			out.emplace_back(PathToUtf8(std::filesystem::path(name)), PathToUtf8(std::filesystem::path(path)));
+	}
+
+	RegCloseKey(key);
+}
+
+static std::wstring environmentVariable(const wchar_t* name) {
+	DWORD length = GetEnvironmentVariableW(name, nullptr, 0);
+	if (length == 0) return {};
+
+	std::wstring value(length, L'\0');
+	value.resize(GetEnvironmentVariableW(name, value.data(), length));
+	return value;
+}
+#endif
+
+CommandSources CommandIndex::DefaultSources() {
+	CommandSources sources;
+
+#ifdef _WIN32
+	// What a new process would get: the machine's PATH, then the user's. The process' own copy is only a fallback,
+	// it doesn't change when the user edits their environment.
+	std::wstring path = readRegistryString(HKEY_LOCAL_MACHINE, L"SYSTEM\\CurrentControlSet\\Control\\Session Manager\\Environment", L"Path");
+	std::wstring user = readRegistryString(HKEY_CURRENT_USER, L"Environment", L"Path");
+	if (!user.empty()) path += L";" + user;
+	if (path.empty()) path = environmentVariable(L"PATH");
+	sources.directories = SplitSearchPath(PathToUtf8(std::filesystem::path(path)), ';');
+
+	std::wstring pathext = environmentVariable(L"PATHEXT");
+	for (const std::filesystem::path& extension : SplitSearchPath(pathext.empty() ? ".COM;.EXE;.BAT;.CMD" : PathToUtf8(std::filesystem::path(pathext)), ';')) {
+		std::string lower = PathToUtf8(extension);
+		std::transform(lower.begin(), lower.end(), lower.begin(), ToLowerAscii);
+		sources.extensions.push_back(std::move(lower));
+	}
+
+	// Per-user registrations win over machine wide ones
+	readAppPaths(HKEY_CURRENT_USER, sources.registered);
+	readAppPaths(HKEY_LOCAL_MACHINE, sources.registered);
+#else
+	if (const char* path = std::getenv("PATH"))
+		sources.directories = SplitSearchPath(path, ':');
+#endif
+
+	return sources;
+}
+
+CommandIndex::CommandIndex() {
+	this->snapshot.store(std::make_shared<const CommandSnapshot>());
+}
+
+CommandIndex::~CommandIndex() {
+	if (this->worker.joinable())
+		this->worker.join();
+}
+
+void CommandIndex::Refresh(const CommandSources& sources) {
+	auto start = std::chrono::steady_clock::now();
+
+	CommandSnapshotBuilder builder;
+	size_t found = builder.Scan(sources);
+	auto snapshot = builder.Build();
+
+	size_t count = snapshot->Size();
+	size_t nodes = snapshot->Trie().NodeCount();
+	this->snapshot.store(std::move(snapshot), std::memory_order_release);
+
+	spdlog::info("Indexed {} commands ({} found in {} folders, {} trie nodes) in {:.2f} ms", count, found, sources.directories.size(), nodes,
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+void CommandIndex::RefreshAsync(CommandSources sources, std::function<void()> onDone) {
+	{
+		std::lock_guard lock(this->mutex);
+		this->queued = std::move(sources);
+		this->onDone = std::move(onDone);
+		if (this->running) return; // Picked up once the current refresh is done
+		this->running = true;
+	}
+
+	if (this->worker.joinable())
+		this->worker.join();
+
+	this->worker = std::jthread([this]() {
+		for (;;) {
+			CommandSources sources;
+			std::function<void()> done;
+			{
+				std::lock_guard lock(this->mutex);
+				if (!this->queued) {
+					this->running = false;
+					this->idle.notify_all();
+					return;
+				}
+				sources = std::move(*this->queued);
+				this->queued.reset();
+				done = this->onDone;
+			}
+
+			this->Refresh(sources);
+			if (done) done();
+		}
+	});
+}
+
+void CommandIndex::Wait() {
+	std::unique_lock lock(this->mutex);
+	this->idle.wait(lock, [this]() { return !this->running; });
+}
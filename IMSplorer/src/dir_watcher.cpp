@@ -0,0 +1,449 @@
+#include "pch.h"
+
+#include "dir_watcher.h"
+
+#include "path_utf8.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace IMS;
+
+#ifdef _WIN32
+Win32DirWatchBackend::Win32DirWatchBackend() {
+	this->interrupt = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+}
+
+Win32DirWatchBackend::~Win32DirWatchBackend() {
+	for (auto& watch : this->watches) {
+		// The kernel writes into the buffer until the cancellation completes
+		DWORD bytes = 0;
+		if (CancelIoEx(watch->directory, &watch->overlapped) || GetLastError() != ERROR_NOT_FOUND)
+			GetOverlappedResult(watch->directory, &watch->overlapped, &bytes, TRUE);
+
+		CloseHandle(watch->directory);
+		CloseHandle(watch->overlapped.hEvent);
+	}
+
+	if (this->interrupt) CloseHandle(this->interrupt);
+}
+
+bool Win32DirWatchBackend::Add(const std::filesystem::path& root) {
+	// One slot is taken by the interrupt event
+	if (this->watches.size() + 1 >= MAXIMUM_WAIT_OBJECTS) {
+		spdlog::warn("Too many watched directories, ignoring {}", PathToUtf8(root));
+		return false;
+	}
+
+	auto watch = std::make_unique<Watch>();
+	watch->root = root;
+	watch->directory = CreateFileW(root.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+	if (watch->directory == INVALID_HANDLE_VALUE) {
+		spdlog::warn("Can't watch {}: error {}", PathToUtf8(root), GetLastError());
+		return false;
+	}
+
+	watch->overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	if (!this->Issue(*watch)) {
+		spdlog::warn("Can't watch {}: error {}", PathToUtf8(root), GetLastError());
+		CloseHandle(watch->directory);
+		CloseHandle(watch->overlapped.hEvent);
+		return false;
+	}
+
+	this->watches.push_back(std::move(watch));
+	return true;
+}
+
+bool Win32DirWatchBackend::Issue(Watch& watch) {
+	ResetEvent(watch.overlapped.hEvent);
+	return ReadDirectoryChangesW(watch.directory, watch.buffer.get(), (DWORD)kBufferSize, TRUE,
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE,
+		nullptr, &watch.overlapped, nullptr);
+}
+
+void Win32DirWatchBackend::Poll(std::chrono::milliseconds timeout, std::vector<FileChange>& out) {
+	std::array<HANDLE, MAXIMUM_WAIT_OBJECTS> handles = {};
+	DWORD count = 0;
+	for (auto& watch : this->watches)
+		handles[count++] = watch->overlapped.hEvent;
+	handles[count++] = this->interrupt;
+
+	DWORD ms = timeout.count() >= (std::chrono::milliseconds::rep)INFINITE ? INFINITE : (DWORD)(std::max)(timeout.count(), (std::chrono::milliseconds::rep)0);
+	DWORD result = WaitForMultipleObjects(count, handles.data(), FALSE, ms);
+	if (result < WAIT_OBJECT_0 || result >= WAIT_OBJECT_0 + this->watches.size()) return;
+
+	Watch& watch = *this->watches[result - WAIT_OBJECT_0];
+
+	// Zero bytes means the buffer overflowed and the system threw the changes away
+	DWORD bytes = 0;
+	if (!GetOverlappedResult(watch.directory, &watch.overlapped, &bytes, FALSE)) {
+		if (GetLastError() != ERROR_NOTIFY_ENUM_DIR) spdlog::warn("Watching {} failed: error {}", PathToUtf8(watch.root), GetLastError());
+		bytes = 0;
+	}
+
+	if (bytes == 0) {
+		out.push_back({ FileChangeType::Overflow, {}, {} });
+	}
+	else {
+		const uint8_t* data = (const uint8_t*)watch.buffer.get();
+		std::filesystem::path renamedFrom;
+		for (size_t offset = 0; offset + sizeof(FILE_NOTIFY_INFORMATION) <= bytes;) {
+			const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)(data + offset);
+			std::filesystem::path path = watch.root / std::wstring_view(info->FileName, info->FileNameLength / sizeof(WCHAR));
+
+			switch (info->Action) {
+			case FILE_ACTION_ADDED:
+				out.push_back({ FileChangeType::Added, std::move(path), {} });
+				break;
+			case FILE_ACTION_REMOVED:
+				out.push_back({ FileChangeType::Removed, std::move(path), {} });
+				break;
+			case FILE_ACTION_MODIFIED:
+				out.push_back({ FileChangeType::Modified, std::move(path), {} });
+				break;
+			case FILE_ACTION_RENAMED_OLD_NAME:
+				renamedFrom = std::move(path);
+				break;
+			case FILE_ACTION_RENAMED_NEW_NAME:
+				if (renamedFrom.empty()) out.push_back({ FileChangeType::Added, std::move(path), {} });
+				else out.push_back({ FileChangeType::Renamed, std::move(path), std::move(renamedFrom) });
+				renamedFrom.clear();
+				break;
+			}
+
+			if (info->NextEntryOffset == 0) break;
+			offset += info->NextEntryOffset;
+		}
+
+		if (!renamedFrom.empty()) out.push_back({ FileChangeType::Removed, std::move(renamedFrom), {} });
+	}
+
+	if (!this->Issue(watch)) {
+		spdlog::warn("Can't keep watching {}: error {}", PathToUtf8(watch.root), GetLastError());
+		out.push_back({ FileChangeType::Overflow, {}, {} });
+	}
+}
+
+void Win32DirWatchBackend::Interrupt() {
+	SetEvent(this->interrupt);
+}
+#endif
+
+#ifdef __linux__
+static constexpr uint32_t kInotifyMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+static bool isWithin(const std::filesystem::path& path, const std::filesystem::path& directory) {
+	const std::string& p = path.native();
+	const std::string& d = directory.native();
+	return p.starts_with(d) && (p.size() == d.size() || p[d.size()] == '/');
+}
+
+InotifyDirWatchBackend::InotifyDirWatchBackend() {
+	this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	this->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (this->fd < 0 || this->wakeFd < 0) spdlog::warn("Can't create an inotify instance: {}", strerror(errno));
+}
+
+InotifyDirWatchBackend::~InotifyDirWatchBackend() {
+	if (this->fd >= 0) close(this->fd);
+	if (this->wakeFd >= 0) close(this->wakeFd);
+}
+
+bool InotifyDirWatchBackend::Add(const std::filesystem::path& root) {
+	if (this->fd < 0 || this->wakeFd < 0) return false;
+	return this->AddRecursive(root);
+}
+
+bool InotifyDirWatchBackend::AddRecursive(const std::filesystem::path& directory) {
+	int wd = inotify_add_watch(this->fd, directory.c_str(), kInotifyMask);
+	if (wd < 0) {
+		spdlog::warn("Can't watch {}: {}", PathToUtf8(directory), strerror(errno));
+		return false;
+	}
+	this->watches[wd] = directory;
+
+	std::error_code ec;
+	for (std::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+		std::error_code entryError;
+		if (it->is_directory(entryError) && !it->is_symlink(entryError)) this->AddRecursive(it->path());
+	}
+	return true;
+}
+
+void InotifyDirWatchBackend::RemoveBelow(const std::filesystem::path& directory) {
+	std::erase_if(this->watches, [&](const auto& watch) {
+		if (!isWithin(watch.second, directory)) return false;
+		inotify_rm_watch(this->fd, watch.first);
+		return true;
+	});
+}
+
+void InotifyDirWatchBackend::Rebase(const std::filesystem::path& from, const std::filesystem::path& to) {
+	// A moved directory keeps its watch descriptors, only the names change
+	for (auto& [wd, path] : this->watches) {
+		if (isWithin(path, from)) path = to.native() + path.native().substr(from.native().size());
+	}
+}
+
+void InotifyDirWatchBackend::Poll(std::chrono::milliseconds timeout, std::vector<FileChange>& out) {
+	pollfd fds[2] = { { this->fd, POLLIN, 0 }, { this->wakeFd, POLLIN, 0 } };
+	int ms = timeout.count() > INT_MAX ? -1 : (int)(std::max)(timeout.count(), (std::chrono::milliseconds::rep)0);
+	if (poll(fds, 2, ms) <= 0) return;
+
+	if (fds[1].revents & POLLIN) {
+		uint64_t value;
+		(void)!read(this->wakeFd, &value, sizeof(value));
+	}
+	if (!(fds[0].revents & POLLIN)) return;
+
+	struct PendingMove {
+		uint32_t cookie;
+		std::filesystem::path path;
+		bool directory;
+	};
+	std::vector<PendingMove> moves;
+
+	alignas(inotify_event) char buffer[64 * 1024];
+	for (;;) {
+		ssize_t length = read(this->fd, buffer, sizeof(buffer));
+		if (length <= 0) break;
+
+		for (ssize_t offset = 0; offset + (ssize_t)sizeof(inotify_event) <= length;) {
+			const inotify_event* event = (const inotify_event*)(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW) {
+				out.push_back({ FileChangeType::Overflow, {}, {} });
+				continue;
+			}
+			if (event->mask & IN_IGNORED) {
+				this->watches.erase(event->wd);
+				continue;
+			}
+
+			auto watch = this->watches.find(event->wd);
+			if (watch == this->watches.end() || event->len == 0) continue;
+
+			std::filesystem::path path = watch->second / event->name;
+			bool directory = event->mask & IN_ISDIR;
+
+			if (event->mask & IN_CREATE) {
+				if (directory) this->AddRecursive(path);
+				out.push_back({ FileChangeType::Added, std::move(path), {} });
+			}
+			else if (event->mask & IN_DELETE) {
+				out.push_back({ FileChangeType::Removed, std::move(path), {} });
+			}
+			else if (event->mask & IN_MOVED_FROM) {
+				moves.push_back({ event->cookie, std::move(path), directory });
+			}
+			else if (event->mask & IN_MOVED_TO) {
+				auto from = std::find_if(moves.begin(), moves.end(), [&](const PendingMove& move) { return move.cookie == event->cookie; });
+				if (from != moves.end()) {
+					if (directory) this->Rebase(from->path, path);
+					out.push_back({ FileChangeType::Renamed, std::move(path), std::move(from->path) });
+					moves.erase(from);
+				}
+				else {
+					// Moved in from outside the watched trees
+					if (directory) this->AddRecursive(path);
+					out.push_back({ FileChangeType::Added, std::move(path), {} });
+				}
+			}
+			else if (event->mask & IN_CLOSE_WRITE) {
+				out.push_back({ FileChangeType::Modified, std::move(path), {} });
+			}
+		}
+	}
+
+	// Moved out of the watched trees
+	for (PendingMove& move : moves) {
+		if (move.directory) this->RemoveBelow(move.path);
+		out.push_back({ FileChangeType::Removed, std::move(move.path), {} });
+	}
+}
+
+void InotifyDirWatchBackend::Interrupt() {
+	uint64_t value = 1;
+	(void)!write(this->wakeFd, &value, sizeof(value));
+}
+#endif
+
+void FileChangeCoalescer::Push(const FileChange& change) {
+	if (change.type == FileChangeType::Overflow) {
+		this->batch.changes.clear();
+		this->dropped.clear();
+		this->last.clear();
+		this->live = 0;
+		this->batch.overflow = true;
+		return;
+	}
+
+	// Everything gets rescanned anyway
+	if (this->batch.overflow) return;
+
+	auto it = this->last.find(change.path.native());
+	FileChange* previous = it != this->last.end() ? &this->batch.changes[it->second] : nullptr;
+
+	switch (change.type) {
+	case FileChangeType::Added:
+		// Replaced by a new file, which is a modification as far as readers go
+		if (previous && previous->type == FileChangeType::Removed) previous->type = FileChangeType::Modified;
+		if (previous) return;
+		break;
+
+	case FileChangeType::Removed:
+		if (previous) {
+			switch (previous->type) {
+			case FileChangeType::Added:
+				this->Drop(it->second);
+				return;
+			case FileChangeType::Renamed: {
+				std::filesystem::path from = previous->oldPath;
+				this->Drop(it->second);
+				this->Push({ FileChangeType::Removed, std::move(from), {} });
+				return;
+			}
+			case FileChangeType::Modified:
+				this->Drop(it->second);
+				break;
+			default:
+				return;
+			}
+		}
+		break;
+
+	case FileChangeType::Renamed: {
+		auto from = this->last.find(change.oldPath.native());
+		if (from != this->last.end()) {
+			FileChange& source = this->batch.changes[from->second];
+			if (source.type == FileChangeType::Added) {
+				this->Drop(from->second);
+				this->Push({ FileChangeType::Added, change.path, {} });
+				return;
+			}
+			if (source.type == FileChangeType::Renamed) {
+				std::filesystem::path origin = source.oldPath;
+				this->Drop(from->second);
+				if (origin != change.path) this->Push({ FileChangeType::Renamed, change.path, std::move(origin) });
+				return;
+			}
+		}
+
+		// Later changes to the old name are about a different file
+		this->last.erase(change.oldPath.native());
+		break;
+	}
+
+	case FileChangeType::Modified:
+		if (previous && previous->type != FileChangeType::Removed) return;
+		break;
+
+	default:
+		return;
+	}
+
+	this->last[change.path.native()] = this->batch.changes.size();
+	this->batch.changes.push_back(change);
+	this->dropped.push_back(false);
+	this->live++;
+}
+
+void FileChangeCoalescer::Drop(size_t index) {
+	this->dropped[index] = true;
+	this->live--;
+
+	auto it = this->last.find(this->batch.changes[index].path.native());
+	if (it != this->last.end() && it->second == index) this->last.erase(it);
+}
+
+FileChangeBatch FileChangeCoalescer::Take() {
+	FileChangeBatch result;
+	result.overflow = this->batch.overflow;
+	for (size_t i = 0; i < this->batch.changes.size(); i++) {
+		if (!this->dropped[i]) result.changes.push_back(std::move(this->batch.changes[i]));
+	}
+
+	this->batch = FileChangeBatch();
+	this->dropped.clear();
+	this->last.clear();
+	this->live = 0;
+	return result;
+}
+
+DirWatcher::DirWatcher(std::unique_ptr<IDirWatchBackend> backend, BatchCallback onBatch, Options options)
+	: backend(std::move(backend)), onBatch(std::move(onBatch)), options(options) {
+}
+
+DirWatcher::~DirWatcher() {
+	// Stops and joins before the backend goes away
+	this->thread = std::jthread();
+}
+
+std::unique_ptr<IDirWatchBackend> DirWatcher::CreateDefaultBackend() {
+#if defined(_WIN32)
+	return std::make_unique<Win32DirWatchBackend>();
+#elif defined(__linux__)
+	return std::make_unique<InotifyDirWatchBackend>();
+#else
+	return nullptr;
+#endif
+}
+
+bool DirWatcher::Watch(const std::vector<std::filesystem::path>& roots) {
+	if (!this->backend || this->active) return false;
+
+	size_t watched = 0;
+	for (const auto& root : roots) {
+		if (this->backend->Add(root)) watched++;
+	}
+	if (watched == 0) return false;
+
+	spdlog::debug("Watching {} of {} Start menu roots", watched, roots.size());
+	this->active = true;
+	this->thread = std::jthread([this](std::stop_token stop) { this->Work(stop); });
+	return true;
+}
+
+void DirWatcher::Work(std::stop_token stop) {
+	using Clock = std::chrono::steady_clock;
+
+	std::stop_callback interrupt(stop, [this] { this->backend->Interrupt(); });
+
+	FileChangeCoalescer coalescer;
+	std::vector<FileChange> changes;
+	Clock::time_point first, latest;
+
+	while (!stop.stop_requested()) {
+		// Sleep until something happens, or until the pending batch is due
+		std::chrono::milliseconds timeout = std::chrono::milliseconds::max();
+		if (!coalescer.Empty()) {
+			Clock::time_point due = (std::min)(latest + this->options.quiet, first + this->options.maxDelay);
+			timeout = std::chrono::ceil<std::chrono::milliseconds>((std::max)(due - Clock::now(), Clock::duration::zero()));
+		}
+
+		changes.clear();
+		this->backend->Poll(timeout, changes);
+
+		Clock::time_point now = Clock::now();
+		if (!changes.empty()) {
+			if (coalescer.Empty()) first = now;
+			latest = now;
+			for (const FileChange& change : changes)
+				coalescer.Push(change);
+		}
+
+		if (coalescer.Empty()) continue;
+		if (now - latest < this->options.quiet && now - first < this->options.maxDelay) continue;
+
+		FileChangeBatch batch = coalescer.Take();
+		spdlog::debug("Start menu changed: {} changes{}", batch.changes.size(), batch.overflow ? ", overflowed" : "");
+		this->onBatch(batch);
+	}
+}
@@ -0,0 +1,320 @@
+#include "pch.h"
+
+#include "font_cache.h"
+
+#include "path_utf8.h"
+
+using namespace IMS;
+
+static_assert(sizeof(FontAtlasFileHeader) % alignof(FontAtlasFileFont) == 0);
+static_assert(sizeof(FontAtlasFileFont) % alignof(FontAtlasFileGlyph) == 0 && sizeof(FontAtlasFileGlyph) % alignof(float) == 0);
+static_assert(std::is_trivially_copyable_v<FontAtlasFileFont> && std::is_trivially_copyable_v<FontAtlasFileGlyph>);
+
+static constexpr uint32_t kLineCount = IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1;
+static constexpr uint32_t kMaxAtlasSize = 16384;
+
+uint64_t IMS::FontAtlasKey(const FontAtlasSpec& spec, std::span<const uint8_t> fontData, std::span<const ImWchar> glyphRanges) {
+	static constexpr std::string_view builtin = "ProggyClean";
+
+	uint64_t hash = Fnv1a(&FontAtlasFileHeader::kVersion, sizeof(FontAtlasFileHeader::kVersion));
+	hash = fontData.empty() ? Fnv1a(builtin.data(), builtin.size(), hash) : Fnv1a(fontData.data(), fontData.size(), hash);
+
+	uint32_t count = (uint32_t)spec.sizes.size();
+	hash = Fnv1a(&count, sizeof(count), hash);
+	hash = Fnv1a(spec.sizes.data(), spec.sizes.size() * sizeof(float), hash);
+
+	int32_t options[] = { spec.oversampleH, spec.oversampleV, spec.pixelSnapH };
+	hash = Fnv1a(options, sizeof(options), hash);
+
+	count = (uint32_t)glyphRanges.size();
+	hash = Fnv1a(&count, sizeof(count), hash);
+	return Fnv1a(glyphRanges.data(), glyphRanges.size_bytes(), hash);
+}
+
+bool IMS::SaveFontAtlas(const BakedFontAtlas& atlas, uint64_t key, const std::filesystem::path& path) {
+	if (atlas.lines.size() != (size_t)kLineCount * 4 || atlas.pixels.size() != (size_t)atlas.width * atlas.height) return false;
+
+	FontAtlasFileHeader header;
+	std::memcpy(header.magic, FontAtlasFileHeader::kMagic, sizeof(header.magic));
+	header.version = FontAtlasFileHeader::kVersion;
+	header.headerSize = sizeof(FontAtlasFileHeader);
+	header.fontSize = sizeof(FontAtlasFileFont);
+	header.glyphSize = sizeof(FontAtlasFileGlyph);
+	header.imguiVersion = IMGUI_VERSION_NUM;
+	header.lineCount = kLineCount;
+	header.key = key;
+	header.width = atlas.width;
+	header.height = atlas.height;
+	header.fontCount = (uint32_t)atlas.fonts.size();
+	header.glyphCount = (uint32_t)atlas.glyphs.size();
+	std::memcpy(header.uvScale, atlas.uvScale, sizeof(header.uvScale));
+	std::memcpy(header.uvWhitePixel, atlas.uvWhitePixel, sizeof(header.uvWhitePixel));
+	header.fileSize = sizeof(header) + atlas.fonts.size_bytes() + atlas.glyphs.size_bytes() + atlas.lines.size_bytes() + atlas.pixels.size_bytes();
+
+	uint64_t checksum = Fnv1a(atlas.fonts.data(), atlas.fonts.size_bytes());
+	checksum = Fnv1a(atlas.glyphs.data(), atlas.glyphs.size_bytes(), checksum);
+	checksum = Fnv1a(atlas.lines.data(), atlas.lines.size_bytes(), checksum);
+	header.checksum = Fnv1a(atlas.pixels.data(), atlas.pixels.size_bytes(), checksum);
+
+	return WriteFileAtomic(path, [&](std::ostream& out) {
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)atlas.fonts.data(), (std::streamsize)atlas.fonts.size_bytes());
+		out.write((const char*)atlas.glyphs.data(), (std::streamsize)atlas.glyphs.size_bytes());
+		out.write((const char*)atlas.lines.data(), (std::streamsize)atlas.lines.size_bytes());
+		out.write((const char*)atlas.pixels.data(), (std::streamsize)atlas.pixels.size_bytes());
+		return (bool)out;
+	});
+}
+
+std::optional<BakedFontAtlas> IMS::LoadFontAtlas(const std::filesystem::path& path, uint64_t key, MappedFile& file) {
+	if (!file.Open(path)) return std::nullopt;
+
+	auto reject = [&](const char* reason) -> std::optional<BakedFontAtlas> {
+		spdlog::warn("Ignoring font atlas cache {}: {}", PathToUtf8(path), reason);
+		file.Close();
+		return std::nullopt;
+	};
+
+	const uint8_t* data = file.Data();
+	size_t size = file.Size();
+
+	FontAtlasFileHeader header;
+	if (size < sizeof(header)) return reject("truncated header");
+	std::memcpy(&header, data, sizeof(header));
+
+	if (std::memcmp(header.magic, FontAtlasFileHeader::kMagic, sizeof(header.magic)) != 0) return reject("bad magic");
+	if (header.version != FontAtlasFileHeader::kVersion || header.imguiVersion != IMGUI_VERSION_NUM) return reject("other version");
+	if (header.headerSize != sizeof(FontAtlasFileHeader) || header.fontSize != sizeof(FontAtlasFileFont) ||
+		header.glyphSize != sizeof(FontAtlasFileGlyph) || header.lineCount != kLineCount)
+		return reject("other layout");
+
+	// Another font, size or glyph range, not an error
+	if (header.key != key) {
+		file.Close();
+		return std::nullopt;
+	}
+
+	if (header.width == 0 || header.height == 0 || header.width > kMaxAtlasSize || header.height > kMaxAtlasSize) return reject("bad size");
+
+	// Counts are 32 bit and record sizes small, none of this can overflow 64 bits
+	uint64_t fontsBytes = (uint64_t)header.fontCount * sizeof(FontAtlasFileFont);
+	uint64_t glyphsBytes = (uint64_t)header.glyphCount * sizeof(FontAtlasFileGlyph);
+	uint64_t linesBytes = (uint64_t)kLineCount * 4 * sizeof(float);
+	uint64_t pixelsBytes = (uint64_t)header.width * header.height * sizeof(uint32_t);
+	if (header.fileSize != size || sizeof(header) + fontsBytes + glyphsBytes + linesBytes + pixelsBytes != size) return reject("truncated");
+
+	if (Fnv1a(data + sizeof(header), size - sizeof(header)) != header.checksum) return reject("checksum mismatch");
+
+	BakedFontAtlas atlas;
+	atlas.width = header.width;
+	atlas.height = header.height;
+	std::memcpy(atlas.uvScale, header.uvScale, sizeof(atlas.uvScale));
+	std::memcpy(atlas.uvWhitePixel, header.uvWhitePixel, sizeof(atlas.uvWhitePixel));
+
+	const uint8_t* cursor = data + sizeof(header);
+	atlas.fonts = std::span<const FontAtlasFileFont>((const FontAtlasFileFont*)cursor, header.fontCount);
+	cursor += fontsBytes;
+	atlas.glyphs = std::span<const FontAtlasFileGlyph>((const FontAtlasFileGlyph*)cursor, header.glyphCount);
+	cursor += glyphsBytes;
+	atlas.lines = std::span<const float>((const float*)cursor, (size_t)kLineCount * 4);
+	cursor += linesBytes;
+	atlas.pixels = std::span<const uint32_t>((const uint32_t*)cursor, (size_t)header.width * header.height);
+
+	// Fonts own consecutive runs of glyphs, in order
+	if (atlas.fonts.empty()) return reject("no fonts");
+	uint64_t nextGlyph = 0;
+	for (const FontAtlasFileFont& font : atlas.fonts) {
+		if (font.firstGlyph != nextGlyph || !(font.size > 0)) return reject("bad font");
+		nextGlyph += font.glyphCount;
+	}
+	if (nextGlyph != atlas.glyphs.size()) return reject("bad font");
+
+	for (const FontAtlasFileGlyph& glyph : atlas.glyphs) {
+		if (glyph.codepoint > IM_UNICODE_CODEPOINT_MAX) return reject("bad glyph");
+	}
+
+	return atlas;
+}
+
+bool FontAtlasCache::Build(ImFontAtlas& atlas, const FontAtlasSpec& spec) {
+	this->hit = false;
+	if (spec.sizes.empty()) return false;
+
+	std::span<const uint8_t> fontData;
+	if (!spec.path.empty()) {
+		if (!this->fontFile.Open(spec.path)) {
+			spdlog::warn("Can't open font {}", PathToUtf8(spec.path));
+			return false;
+		}
+		fontData = std::span<const uint8_t>(this->fontFile.Data(), this->fontFile.Size());
+	}
+
+	const ImWchar* ranges = spec.glyphRanges.empty() ? atlas.GetGlyphRangesDefault() : spec.glyphRanges.data();
+	size_t rangeCount = 0;
+	while (ranges[rangeCount] != 0) rangeCount++;
+
+	uint64_t key = FontAtlasKey(spec, fontData, std::span<const ImWchar>(ranges, rangeCount));
+
+	if (!this->path.empty()) {
+		if (auto baked = LoadFontAtlas(this->path, key, this->cacheFile)) {
+			this->Apply(atlas, *baked, spec);
+			this->fontFile.Close(); // Only needed for the key
+			this->hit = true;
+			return true;
+		}
+	}
+
+	for (float size : spec.sizes) {
+		ImFontConfig config;
+		config.OversampleH = spec.oversampleH;
+		config.OversampleV = spec.oversampleV;
+		config.PixelSnapH = spec.pixelSnapH;
+		config.SizePixels = size;
+		config.GlyphRanges = ranges;
+
+		if (fontData.empty()) {
+			atlas.AddFontDefault(&config);
+		}
+		else {
+			// Stays mapped for as long as we do
+			config.FontDataOwnedByAtlas = false;
+			std::snprintf(config.Name, sizeof(config.Name), "%s, %.0fpx", PathToUtf8(spec.path.filename()).c_str(), size);
+			atlas.AddFontFromMemoryTTF((void*)fontData.data(), (int)fontData.size(), size, &config, ranges);
+		}
+	}
+
+	if (!atlas.Build()) return false;
+
+	if (!this->path.empty())
+		this->Save(atlas, key);
+	return true;
+}
+
+void FontAtlasCache::Apply(ImFontAtlas& atlas, const BakedFontAtlas& baked, const FontAtlasSpec& spec) {
+	// Stand-ins for the configs ImGui keeps after building, only their names and sizes are ever read
+	std::string file = spec.path.empty() ? std::string("ProggyClean.ttf") : PathToUtf8(spec.path.filename());
+	atlas.ConfigData.resize((int)baked.fonts.size());
+	for (size_t i = 0; i < baked.fonts.size(); i++) {
+		ImFontConfig& config = atlas.ConfigData[(int)i];
+		config = ImFontConfig();
+		config.FontDataOwnedByAtlas = false;
+		config.SizePixels = baked.fonts[i].size;
+		config.OversampleH = spec.oversampleH;
+		config.OversampleV = spec.oversampleV;
+		config.PixelSnapH = spec.pixelSnapH;
+		std::snprintf(config.Name, sizeof(config.Name), "%s, %.0fpx", file.c_str(), baked.fonts[i].size);
+	}
+
+	for (size_t i = 0; i < baked.fonts.size(); i++) {
+		const FontAtlasFileFont& record = baked.fonts[i];
+
+		ImFont* font = IM_NEW(ImFont)();
+		font->FontSize = record.size;
+		font->Ascent = record.ascent;
+		font->Descent = record.descent;
+		font->FallbackChar = (ImWchar)record.fallbackChar;
+		font->EllipsisChar = (ImWchar)record.ellipsisChar;
+		font->ContainerAtlas = &atlas;
+		font->ConfigData = &atlas.ConfigData[(int)i];
+		font->ConfigDataCount = 1;
+
+		font->Glyphs.resize((int)record.glyphCount);
+		for (uint32_t j = 0; j < record.glyphCount; j++) {
+			const FontAtlasFileGlyph& source = baked.glyphs[record.firstGlyph + j];
+			ImFontGlyph& glyph = font->Glyphs[(int)j];
+			glyph.Codepoint = source.codepoint;
+			glyph.Visible = (source.flags & FontAtlasFileGlyph::kVisible) != 0;
+			glyph.Colored = (source.flags & FontAtlasFileGlyph::kColored) != 0;
+			glyph.AdvanceX = source.advanceX;
+			glyph.X0 = source.x0;
+			glyph.Y0 = source.y0;
+			glyph.X1 = source.x1;
+			glyph.Y1 = source.y1;
+			glyph.U0 = source.u0;
+			glyph.V0 = source.v0;
+			glyph.U1 = source.u1;
+			glyph.V1 = source.v1;
+		}
+
+		font->BuildLookupTable();
+		atlas.Fonts.push_back(font);
+	}
+
+	atlas.TexWidth = (int)baked.width;
+	atlas.TexHeight = (int)baked.height;
+	atlas.TexUvScale = ImVec2(baked.uvScale[0], baked.uvScale[1]);
+	atlas.TexUvWhitePixel = ImVec2(baked.uvWhitePixel[0], baked.uvWhitePixel[1]);
+	for (uint32_t i = 0; i < kLineCount; i++)
+		atlas.TexUvLines[i] = ImVec4(baked.lines[4 * i], baked.lines[4 * i + 1], baked.lines[4 * i + 2], baked.lines[4 * i + 3]);
+
+	// Never written to, the backend only reads it to create the texture
+	this->mappedPixels = (unsigned int*)baked.pixels.data();
+	atlas.TexPixelsRGBA32 = this->mappedPixels;
+	atlas.TexPixelsUseColors = false;
+	atlas.TexReady = true;
+}
+
+void FontAtlasCache::Save(ImFontAtlas& atlas, uint64_t key) {
+	unsigned char* pixels = nullptr;
+	int width = 0, height = 0;
+	atlas.GetTexDataAsRGBA32(&pixels, &width, &height);
+	if (!pixels) return;
+
+	std::vector<FontAtlasFileFont> fonts;
+	std::vector<FontAtlasFileGlyph> glyphs;
+	for (const ImFont* font : atlas.Fonts) {
+		FontAtlasFileFont record;
+		record.size = font->FontSize;
+		record.ascent = font->Ascent;
+		record.descent = font->Descent;
+		record.firstGlyph = (uint32_t)glyphs.size();
+		record.glyphCount = (uint32_t)font->Glyphs.Size;
+		record.fallbackChar = font->FallbackChar;
+		record.ellipsisChar = font->EllipsisChar;
+		fonts.push_back(record);
+
+		for (const ImFontGlyph& glyph : font->Glyphs) {
+			FontAtlasFileGlyph out;
+			out.codepoint = glyph.Codepoint;
+			out.flags = (glyph.Visible ? FontAtlasFileGlyph::kVisible : 0) | (glyph.Colored ? FontAtlasFileGlyph::kColored : 0);
+			out.advanceX = glyph.AdvanceX;
+			out.x0 = glyph.X0;
+			out.y0 = glyph.Y0;
+			out.x1 = glyph.X1;
+			out.y1 = glyph.Y1;
+			out.u0 = glyph.U0;
+			out.v0 = glyph.V0;
+			out.u1 = glyph.U1;
+			out.v1 = glyph.V1;
+			glyphs.push_back(out);
+		}
+	}
+
+	std::vector<float> lines;
+	lines.reserve((size_t)kLineCount * 4);
+	for (uint32_t i = 0; i < kLineCount; i++) {
+		const ImVec4& uv = atlas.TexUvLines[i];
+		lines.insert(lines.end(), { uv.x, uv.y, uv.z, uv.w });
+	}
+
+	BakedFontAtlas baked;
+	baked.width = (uint32_t)width;
+	baked.height = (uint32_t)height;
+	baked.uvScale[0] = atlas.TexUvScale.x;
+	baked.uvScale[1] = atlas.TexUvScale.y;
+	baked.uvWhitePixel[0] = atlas.TexUvWhitePixel.x;
+	baked.uvWhitePixel[1] = atlas.TexUvWhitePixel.y;
+	baked.fonts = fonts;
+	baked.glyphs = glyphs;
+	baked.lines = lines;
+	baked.pixels = std::span<const uint32_t>((const uint32_t*)pixels, (size_t)width * height);
+
+	if (!SaveFontAtlas(baked, key, this->path))
+		spdlog::warn("Can't write font atlas cache {}", PathToUtf8(this->path));
+}
+
+void FontAtlasCache::Release(ImFontAtlas& atlas) {
+	if (this->mappedPixels && atlas.TexPixelsRGBA32 == this->mappedPixels)
+		atlas.TexPixelsRGBA32 = nullptr;
+	this->mappedPixels = nullptr;
+}
@@ -0,0 +1,60 @@
+#include "pch.h"
+
+#include "frame_arena.h"
+
+using namespace IMS;
+
+FrameArena::FrameArena(size_t capacity) : block(std::make_unique<char[]>(capacity)), capacity(capacity) {}
+
+void* FrameArena::Allocate(size_t size, size_t alignment) {
+	uintptr_t base = (uintptr_t)this->block.get();
+	uintptr_t start = (base + this->used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	if (start + size <= base + this->capacity) {
+		this->used = start + size - base;
+		return (void*)start;
+	}
+
+	// Its own block, new[] is aligned for anything up to max_align_t
+	if (this->spills.empty())
+		this->overflows++;
+	this->spills.push_back(std::make_unique<char[]>(size));
+	this->spilled += size;
+	return this->spills.back().get();
+}
+
+const char* FrameArena::Copy(std::string_view text) {
+	char* copy = (char*)this->Allocate(text.size() + 1, 1);
+	std::memcpy(copy, text.data(), text.size());
+	copy[text.size()] = '\0';
+	return copy;
+}
+
+const char* FrameArena::VFormat(fmt::string_view format, fmt::format_args args) {
+	// Straight into the free space, the size it reports is what it would have needed if it didn't fit
+	char* out = this->block.get() + this->used;
+	size_t available = this->capacity - this->used;
+	size_t size = fmt::vformat_to_n(out, available > 0 ? available - 1 : 0, format, args).size;
+	if (size < available) {
+		out[size] = '\0';
+		this->used += size + 1;
+		return out;
+	}
+
+	char* text = (char*)this->Allocate(size + 1, 1);
+	fmt::vformat_to_n(text, size, format, args);
+	text[size] = '\0';
+	return text;
+}
+
+void FrameArena::Reset() {
+	if (!this->spills.empty()) {
+		// Big enough for this frame next time
+		size_t needed = this->used + this->spilled;
+		this->spills.clear();
+		this->capacity = (std::max)(this->capacity * 2, needed);
+		this->block = std::make_unique<char[]>(this->capacity);
+	}
+
+	this->used = 0;
+	this->spilled = 0;
+}
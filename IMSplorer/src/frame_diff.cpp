@@ -0,0 +1,186 @@
+#include "pch.h"
+
+#include "frame_diff.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMS_HASH_SSE2
+#endif
+
+using namespace IMS;
+
+namespace {
+	constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+	constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+	constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+
+	// Lane keys, advanced by kStep every stripe
+	alignas(16) constexpr uint64_t kKeys[8] = {
+		0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull, 0xDB979083E96DD4DEull, 0x1F67B3B7A4A44072ull,
+		0x78E5C0CC4EE679CBull, 0x2172FFCC7DD05A82ull, 0x8E2443F7744608B8ull, 0x4C263A81E69035E0ull,
+	};
+	constexpr uint64_t kStep = 0x9FB21C651E98DF25ull;
+
+	constexpr size_t kStripe = 64;
+
+	inline uint64_t read64(const uint8_t* data) {
+		uint64_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	inline uint64_t rotl(uint64_t value, int bits) {
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	inline uint64_t avalanche(uint64_t hash) {
+		hash ^= hash >> 33;
+		hash *= kPrime2;
+		hash ^= hash >> 29;
+		hash *= kPrime3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
+	inline uint64_t combine(uint64_t hash, uint64_t value) {
+		return rotl(hash ^ avalanche(value), 27) * kPrime1 + kPrime3;
+	}
+
+	/// <summary>
+	/// Per lane: the other lane of the pair gets the data, this one the product of the keyed data's halves
+	/// </summary>
+	void accumulateScalar(uint64_t (&acc)[8], const uint8_t* data, size_t stripes) {
+		uint64_t keys[8];
+		std::memcpy(keys, kKeys, sizeof(keys));
+
+		for (size_t stripe = 0; stripe < stripes; stripe++, data += kStripe) {
+			for (int lane = 0; lane < 8; lane++) {
+				uint64_t value = read64(data + lane * 8);
+				uint64_t keyed = value ^ keys[lane];
+				acc[lane ^ 1] += value;
+				acc[lane] += (keyed & 0xFFFFFFFFull) * (keyed >> 32);
+				keys[lane] += kStep;
+			}
+		}
+	}
+
+#ifdef IMS_HASH_SSE2
+	/// <summary>
+	/// accumulateScalar two lanes per register
+	/// </summary>
+	void accumulateSse2(uint64_t (&acc)[8], const uint8_t* data, size_t stripes) {
+		__m128i lanes[4], keys[4];
+		const __m128i step = _mm_set1_epi64x((long long)kStep);
+		for (int i = 0; i < 4; i++) {
+			lanes[i] = _mm_loadu_si128((const __m128i*)&acc[i * 2]);
+			keys[i] = _mm_load_si128((const __m128i*)&kKeys[i * 2]);
+		}
+
+		for (size_t stripe = 0; stripe < stripes; stripe++, data += kStripe) {
+			for (int i = 0; i < 4; i++) {
+				__m128i value = _mm_loadu_si128((const __m128i*)(data + i * 16));
+				__m128i keyed = _mm_xor_si128(value, keys[i]);
+				__m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(2, 3, 0, 1)));
+				__m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+				lanes[i] = _mm_add_epi64(lanes[i], _mm_add_epi64(product, swapped));
+				keys[i] = _mm_add_epi64(keys[i], step);
+			}
+		}
+
+		for (int i = 0; i < 4; i++)
+			_mm_storeu_si128((__m128i*)&acc[i * 2], lanes[i]);
+	}
+#endif
+
+	template <void (*Accumulate)(uint64_t (&)[8], const uint8_t*, size_t)>
+	uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+		const uint8_t* bytes = (const uint8_t*)data;
+		uint64_t hash = seed ^ (size * kPrime1);
+
+		size_t stripes = size / kStripe;
+		if (stripes > 0) {
+			uint64_t acc[8] = { kPrime3, kPrime1, kPrime2, kPrime3 ^ seed, kPrime1 ^ seed, kPrime2, kPrime3, kPrime1 };
+			Accumulate(acc, bytes, stripes);
+			for (uint64_t lane : acc)
+				hash = combine(hash, lane);
+
+			bytes += stripes * kStripe;
+			size -= stripes * kStripe;
+		}
+
+		// The tail, 8 bytes at a time and then whatever is left zero padded
+		for (size_t lane = 0; size >= 8; lane++, bytes += 8, size -= 8)
+			hash = combine(hash, read64(bytes) ^ kKeys[lane]);
+		if (size > 0) {
+			uint64_t last = 0;
+			std::memcpy(&last, bytes, size);
+			hash = combine(hash, last ^ kStep);
+		}
+
+		return avalanche(hash);
+	}
+}
+
+uint64_t IMS::HashBytes(const void* data, size_t size, uint64_t seed) {
+#ifdef IMS_HASH_SSE2
+	return hashBytes<accumulateSse2>(data, size, seed);
+#else
+	return hashBytes<accumulateScalar>(data, size, seed);
+#endif
+}
+
+uint64_t IMS::HashBytesScalar(const void* data, size_t size, uint64_t seed) {
+	return hashBytes<accumulateScalar>(data, size, seed);
+}
+
+uint64_t IMS::HashDrawData(const ImDrawData& data, uint64_t seed) {
+	const float display[6] = { data.DisplayPos.x, data.DisplayPos.y, data.DisplaySize.x, data.DisplaySize.y, data.FramebufferScale.x, data.FramebufferScale.y };
+	uint64_t hash = HashBytes(display, sizeof(display), seed ^ (uint64_t)data.CmdListsCount);
+
+	for (int i = 0; i < data.CmdListsCount; i++) {
+		const ImDrawList* list = data.CmdLists[i];
+		hash = HashBytes(list->VtxBuffer.Data, (size_t)list->VtxBuffer.Size * sizeof(ImDrawVert), hash);
+		hash = HashBytes(list->IdxBuffer.Data, (size_t)list->IdxBuffer.Size * sizeof(ImDrawIdx), hash);
+
+		// Field by field, the commands' padding isn't ours to read
+		for (const ImDrawCmd& command : list->CmdBuffer) {
+			uint64_t clip[2];
+			std::memcpy(clip, &command.ClipRect, sizeof(clip));
+			hash = combine(hash, clip[0]);
+			hash = combine(hash, clip[1]);
+			hash = combine(hash, (uint64_t)(uintptr_t)command.GetTexID());
+			hash = combine(hash, ((uint64_t)command.VtxOffset << 32) | command.IdxOffset);
+			hash = combine(hash, command.ElemCount);
+			hash = combine(hash, (uint64_t)(uintptr_t)command.UserCallback ^ rotl((uint64_t)(uintptr_t)command.UserCallbackData, 32));
+		}
+	}
+
+	return avalanche(hash);
+}
+
+bool FrameDiff::Changed(ImGuiID viewport, const ImDrawData& data, uint64_t salt) {
+	uint64_t hash = HashDrawData(data, salt);
+
+	auto it = std::find_if(this->viewports.begin(), this->viewports.end(), [&](const Entry& entry) { return entry.viewport == viewport; });
+	if (it == this->viewports.end()) {
+		this->viewports.push_back({ viewport, hash, true });
+		this->drawn++;
+		return true;
+	}
+
+	it->seen = true;
+	if (it->hash == hash) {
+		this->skipped++;
+		return false;
+	}
+
+	it->hash = hash;
+	this->drawn++;
+	return true;
+}
+
+void FrameDiff::EndFrame() {
+	std::erase_if(this->viewports, [](const Entry& entry) { return !entry.seen; });
+	for (Entry& entry : this->viewports)
+		entry.seen = false;
+}
@@ -0,0 +1,96 @@
+#include "pch.h"
+
+#include "frame_scheduler.h"
+
+using namespace IMS;
+
+#ifdef _WIN32
+Win32EventSource::Win32EventSource() : threadId(GetCurrentThreadId()) {}
+
+bool Win32EventSource::Wait(std::chrono::milliseconds timeout) {
+	DWORD ms = INFINITE;
+	if (timeout != kInfinite)
+		ms = (DWORD)std::clamp<int64_t>(timeout.count(), 0, INFINITE - 1);
+
+	// MWMO_INPUTAVAILABLE so input that arrived before the wait still wakes us
+	DWORD res = MsgWaitForMultipleObjectsEx(0, nullptr, ms, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+	return res != WAIT_TIMEOUT;
+}
+
+void Win32EventSource::Wake() {
+	PostThreadMessage(this->threadId, WM_NULL, 0, 0);
+}
+#endif
+
+FrameScheduler::FrameScheduler(IClock& clock, IEventSource& events) : clock(clock), events(events) {}
+
+void FrameScheduler::Invalidate(int frames) {
+	this->pendingFrames = (std::max)(this->pendingFrames, frames);
+}
+
+void FrameScheduler::AnimateFor(std::chrono::steady_clock::duration duration) {
+	this->animateUntil = (std::max)(this->animateUntil, this->clock.Now() + duration);
+}
+
+void FrameScheduler::RequestFrameIn(std::chrono::steady_clock::duration duration) {
+	this->deadline = (std::min)(this->deadline, this->clock.Now() + duration);
+}
+
+void FrameScheduler::Postpone(std::chrono::steady_clock::duration duration) {
+	this->pendingFrames = 0;
+	this->animateUntil = TimePoint::min();
+	this->RequestFrameIn(duration);
+}
+
+void FrameScheduler::SetTickInterval(std::chrono::milliseconds interval) {
+	this->tickInterval = interval;
+	this->nextTick = interval > std::chrono::milliseconds::zero() ? this->NextTick() : TimePoint::max();
+}
+
+FrameScheduler::TimePoint FrameScheduler::NextTick() const {
+	auto wall = std::chrono::duration_cast<std::chrono::milliseconds>(this->clock.WallNow().time_since_epoch());
+	auto remaining = this->tickInterval - wall % this->tickInterval;
+	return this->clock.Now() + remaining;
+}
+
+void FrameScheduler::Update(TimePoint now) {
+	if (now >= this->nextTick) {
+		this->pendingFrames = (std::max)(this->pendingFrames, 1);
+		this->nextTick = this->NextTick();
+	}
+
+	if (now >= this->deadline) {
+		this->pendingFrames = (std::max)(this->pendingFrames, 1);
+		this->deadline = TimePoint::max();
+	}
+}
+
+bool FrameScheduler::Due(TimePoint now) const {
+	return this->pendingFrames > 0 || now < this->animateUntil;
+}
+
+void FrameScheduler::WaitForWork() {
+	TimePoint now = this->clock.Now();
+	this->Update(now);
+	if (this->Due(now)) return;
+
+	TimePoint wakeAt = (std::min)(this->nextTick, this->deadline);
+	std::chrono::milliseconds timeout = IEventSource::kInfinite;
+	if (wakeAt != TimePoint::max())
+		timeout = std::chrono::ceil<std::chrono::milliseconds>(wakeAt - now);
+
+	this->wakeups++;
+	this->events.Wait(timeout);
+}
+
+bool FrameScheduler::BeginFrame() {
+	TimePoint now = this->clock.Now();
+	this->Update(now);
+	if (!this->Due(now)) return false;
+
+	if (this->pendingFrames > 0)
+		this->pendingFrames--;
+
+	this->framesRendered++;
+	return true;
+}
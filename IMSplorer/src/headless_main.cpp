@@ -0,0 +1,35 @@
+#include "pch.h"
+
+#include "allocation_counters.h"
+#include "benchmark.h"
+
+// Entry point of the CMake build: the benchmarks and the trace replay without the shell, on any OS
+int main(int argc, char** argv) {
+	auto logger = spdlog::stdout_color_mt("console");
+	logger->set_pattern("[%H:%M:%S] [%^%l%$] [thread %t] %v"); // [year-month-day hour:minute:second] [log level] [thread id] log message
+	logger->set_level(spdlog::level::trace);
+	spdlog::set_default_logger(logger);
+
+	// Before anything is allocated through ImGui, the font atlas included
+	IMS::CountImGuiAllocations();
+
+	std::string_view flag = argc > 1 ? argv[1] : "--bench";
+
+	// Shortcut parser timings over a folder of .lnk files
+	if (flag == "--bench-lnk" && argc > 2)
+		return IMS::RunShellLinkBenchmark(argv[2]);
+
+	// Replay a trace recorded by the shell with --record
+	if (flag == "--replay" && argc > 2)
+		return IMS::ReplayTrace(argv[2]);
+
+	// Frame build timings, an optional frame count follows
+	if (flag == "--bench") {
+		size_t frames = 500;
+		if (argc > 2) std::from_chars(argv[2], argv[2] + std::strlen(argv[2]), frames);
+		return IMS::RunBenchmarks(frames);
+	}
+
+	spdlog::error("Usage: {} [--bench [frames] | --replay <trace> | --bench-lnk <folder>]", argv[0]);
+	return 2;
+}
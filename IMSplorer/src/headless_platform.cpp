@@ -0,0 +1,260 @@
+#include "pch.h"
+
+#include "headless_platform.h"
+
+#include "profiler.h"
+
+using namespace IMS;
+
+bool ConditionEventSource::Wait(std::chrono::milliseconds timeout) {
+	std::unique_lock lock(this->mutex);
+
+	if (timeout == kInfinite)
+		this->condition.wait(lock, [this]() { return this->woken; });
+	else
+		this->condition.wait_for(lock, timeout, [this]() { return this->woken; });
+
+	bool woken = this->woken;
+	this->woken = false;
+	return woken;
+}
+
+void ConditionEventSource::Wake() {
+	{
+		std::lock_guard lock(this->mutex);
+		this->woken = true;
+	}
+	this->condition.notify_one();
+}
+
+class HeadlessPlatform::ProcessBackend : public IProcessBackend {
+public:
+	explicit ProcessBackend(HeadlessPlatform& platform) : platform(platform) {}
+
+	bool StartTime(uint32_t pid, uint64_t& startTime) override {
+		std::lock_guard lock(this->platform.mutex);
+		if (pid == 0 || pid > this->platform.processes.size()) return false;
+
+		startTime = 1; // Fake processes never exit
+		return true;
+	}
+
+	bool ImagePath(uint32_t pid, std::string& path) override {
+		std::lock_guard lock(this->platform.mutex);
+		for (auto& [exePath, id] : this->platform.processes) {
+			if (id == pid) {
+				path = exePath;
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	HeadlessPlatform& platform;
+};
+
+class HeadlessPlatform::WindowResolver : public IWindowInfoResolver {
+public:
+	WindowResolver(HeadlessPlatform& platform, ProcessCache& processes) : platform(platform), processes(processes) {}
+
+	WindowInfo Resolve(WindowHandle handle) override {
+		WindowInfo info;
+		info.handle = handle;
+
+		uint32_t pid = 0;
+		{
+			std::lock_guard lock(this->platform.mutex);
+			const FakeWindow* window = this->platform.Find(handle);
+			if (!window) return info;
+
+			info.title = window->title;
+			pid = window->pid;
+		}
+
+		auto process = this->processes.Acquire(pid);
+		if (!process) return info;
+
+		info.process = process->key;
+		info.exePath = process->exePath;
+		info.exe = process->exe;
+		info.valid = true;
+
+		return info;
+	}
+
+private:
+	HeadlessPlatform& platform;
+	ProcessCache& processes;
+};
+
+/// <summary>
+/// Solid squares, a colour per path. Textures are just ids, nothing is drawn with them.
+/// </summary>
+class HeadlessPlatform::IconBackend : public IIconBackend {
+public:
+	bool Extract(const std::string& path, int32_t index, int size, IconImage& out) override {
+		uint32_t color = (uint32_t)std::hash<std::string>()(path) ^ (uint32_t)index;
+		out.width = size;
+		out.height = size;
+		out.pixels.assign((size_t)size * size, color | 0xFF000000);
+		return true;
+	}
+
+	ImTextureID CreateTexture(int /*width*/, int /*height*/) override { return (ImTextureID)(intptr_t)++this->textures; }
+	void UpdateTexture(ImTextureID /*texture*/, const AtlasRect& /*rect*/, const uint32_t* /*pixels*/) override {}
+	void DestroyTexture(ImTextureID /*texture*/) override {}
+
+private:
+	intptr_t textures = 0;
+};
+
+/// <summary>
+/// Every fake process keeps a steady share of a core busy (pid 5 a whole one) and uses pid * 32 MB
+/// </summary>
+class HeadlessPlatform::ResourceBackend : public IResourceBackend {
+public:
+	explicit ResourceBackend(HeadlessPlatform& platform) : platform(platform) {}
+
+	bool Sample(std::vector<ProcessSample>& out) override {
+		uint64_t elapsed = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start).count();
+
+		out.clear();
+		std::lock_guard lock(this->platform.mutex);
+		for (auto& [exePath, pid] : this->platform.processes)
+			out.push_back({ pid, 1, elapsed / 5 * (pid % 6), (uint64_t)pid * 32 * 1024 * 1024 });
+		return true;
+	}
+
+private:
+	HeadlessPlatform& platform;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+HeadlessPlatform::HeadlessPlatform(ImVec2 screenSize, float taskbarHeight) : screenSize(screenSize), taskbarHeight(taskbarHeight) {
+	IMGUI_CHECKVERSION();
+	this->imguiContext = ImGui::CreateContext();
+
+	ImGuiIO& io = ImGui::GetIO();
+	io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+	io.IniFilename = nullptr;
+
+	// Nothing gets uploaded, the atlas only has to exist for NewFrame
+	unsigned char* pixels = nullptr;
+	int width = 0, height = 0;
+	io.Fonts->AddFontDefault();
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+}
+
+HeadlessPlatform::~HeadlessPlatform() {
+	ImGui::DestroyContext(this->imguiContext);
+}
+
+WindowHandle HeadlessPlatform::AddWindow(std::string title, std::string exePath) {
+	std::lock_guard lock(this->mutex);
+
+	auto [it, inserted] = this->processes.try_emplace(std::move(exePath), (uint32_t)this->processes.size() + 1);
+
+	// Increasing, so the list stays sorted by handle
+	WindowHandle handle = 0x10000 + this->windows.size() * 0x10;
+	if (!this->windows.empty())
+		handle = (std::max)(handle, this->windows.back().handle + 0x10);
+
+	this->windows.push_back({ handle, it->second, std::move(title), it->first });
+	return handle;
+}
+
+void HeadlessPlatform::SetWindowTitle(WindowHandle handle, std::string title, bool notify) {
+	{
+		std::lock_guard lock(this->mutex);
+		FakeWindow* window = const_cast<FakeWindow*>(this->Find(handle));
+		if (!window) return;
+
+		window->title = std::move(title);
+	}
+
+	if (notify && this->host) this->host->OnShellEvent(ShellEventType::Redraw, handle);
+}
+
+const HeadlessPlatform::FakeWindow* HeadlessPlatform::Find(WindowHandle handle) const {
+	auto it = std::lower_bound(this->windows.begin(), this->windows.end(), handle, [](const FakeWindow& window, WindowHandle handle) {
+		return window.handle < handle;
+	});
+	return it != this->windows.end() && it->handle == handle ? &*it : nullptr;
+}
+
+void HeadlessPlatform::EnumerateWindows(const std::function<void(WindowHandle)>& callback) {
+	std::vector<WindowHandle> handles;
+	{
+		std::lock_guard lock(this->mutex);
+		handles.reserve(this->windows.size());
+		for (const FakeWindow& window : this->windows)
+			handles.push_back(window.handle);
+	}
+
+	for (WindowHandle handle : handles)
+		callback(handle);
+}
+
+bool HeadlessPlatform::IsTaskbarWindow(WindowHandle handle) {
+	std::lock_guard lock(this->mutex);
+	return this->Find(handle) != nullptr;
+}
+
+std::string HeadlessPlatform::WindowTitle(WindowHandle handle) {
+	std::lock_guard lock(this->mutex);
+	const FakeWindow* window = this->Find(handle);
+	return window ? window->title : std::string();
+}
+
+void HeadlessPlatform::ActivateWindow(WindowHandle handle) {
+	if (this->host) this->host->OnShellEvent(ShellEventType::Activated, handle);
+}
+
+void HeadlessPlatform::CloseWindow(WindowHandle handle) {
+	{
+		std::lock_guard lock(this->mutex);
+		const FakeWindow* window = this->Find(handle);
+		if (!window) return;
+
+		this->windows.erase(this->windows.begin() + (window - this->windows.data()));
+	}
+
+	if (this->host) this->host->OnShellEvent(ShellEventType::Destroyed, handle);
+}
+
+std::unique_ptr<IProcessBackend> HeadlessPlatform::CreateProcessBackend() {
+	return std::make_unique<ProcessBackend>(*this);
+}
+
+std::unique_ptr<IWindowInfoResolver> HeadlessPlatform::CreateWindowResolver(ProcessCache& processes) {
+	return std::make_unique<WindowResolver>(*this, processes);
+}
+
+std::unique_ptr<IResourceBackend> HeadlessPlatform::CreateResourceBackend() {
+	return std::make_unique<ResourceBackend>(*this);
+}
+
+std::unique_ptr<IIconBackend> HeadlessPlatform::CreateIconBackend() {
+	return std::make_unique<IconBackend>();
+}
+
+bool HeadlessPlatform::BeginFrame() {
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = this->screenSize;
+	io.DeltaTime = 1.0f / 60.0f;
+
+	IMS_PROFILE_SCOPE(NewFrame);
+	ImGui::NewFrame();
+	return true;
+}
+
+void HeadlessPlatform::EndFrame() {
+	IMS_PROFILE_SCOPE(Render);
+	ImGui::Render();
+	this->lastVertexCount = (size_t)ImGui::GetDrawData()->TotalVtxCount;
+
+	// Nothing to submit, but the hashing costs what it costs on a real renderer
+	this->frameDiff.Changed(ImGui::GetMainViewport()->ID, *ImGui::GetDrawData());
+	this->frameDiff.EndFrame();
+}
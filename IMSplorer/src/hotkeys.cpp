@@ -0,0 +1,201 @@
+#include "pch.h"
+
+#include "hotkeys.h"
+
+using namespace IMS;
+
+static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); i++) {
+		if (std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i])) return false;
+	}
+	return true;
+}
+
+bool IMS::ParseHotkey(std::string_view text, uint8_t& modifiers, uint8_t& key) {
+	static constexpr std::pair<std::string_view, uint8_t> modifierNames[] = {
+		{ "win", ModWin }, { "shift", ModShift }, { "ctrl", ModControl }, { "control", ModControl }, { "alt", ModAlt },
+	};
+	static constexpr std::pair<std::string_view, uint8_t> keyNames[] = {
+		{ "backspace", 0x08 }, { "tab", 0x09 }, { "enter", 0x0D }, { "esc", 0x1B }, { "escape", 0x1B },
+		{ "space", 0x20 }, { "pageup", 0x21 }, { "pagedown", 0x22 }, { "end", 0x23 }, { "home", 0x24 },
+		{ "left", 0x25 }, { "up", 0x26 }, { "right", 0x27 }, { "down", 0x28 }, { "insert", 0x2D }, { "delete", 0x2E },
+	};
+
+	modifiers = 0;
+	key = 0;
+
+	while (!text.empty()) {
+		size_t plus = text.find('+');
+		std::string_view part = text.substr(0, plus);
+		text = plus == std::string_view::npos ? std::string_view() : text.substr(plus + 1);
+
+		if (key != 0) return false; // The key has to come last
+
+		bool isModifier = false;
+		for (auto& [name, mod] : modifierNames) {
+			if (equalsIgnoreCase(part, name)) {
+				modifiers |= mod;
+				isModifier = true;
+				break;
+			}
+		}
+		if (isModifier) continue;
+
+		if (part.size() == 1 && std::isalnum((unsigned char)part[0])) {
+			key = (uint8_t)std::toupper((unsigned char)part[0]); // VK_A..VK_Z and VK_0..VK_9 match ASCII
+			continue;
+		}
+
+		if (part.size() >= 2 && (part[0] == 'F' || part[0] == 'f')) {
+			int number = 0;
+			auto [end, ec] = std::from_chars(part.data() + 1, part.data() + part.size(), number);
+			if (ec == std::errc() && end == part.data() + part.size() && number >= 1 && number <= 24) {
+				key = (uint8_t)(0x70 + number - 1); // VK_F1
+				continue;
+			}
+		}
+
+		for (auto& [name, vk] : keyNames) {
+			if (equalsIgnoreCase(part, name)) {
+				key = vk;
+				break;
+			}
+		}
+		if (key == 0) return false;
+	}
+
+	return key != 0;
+}
+
+HotkeyEngine::HotkeyEngine() {
+	this->actions.reserve(UINT8_MAX);
+}
+
+bool HotkeyEngine::Register(uint8_t modifiers, uint8_t key, Action action) {
+	if (modifiers >= kModifierCombinations) return false;
+
+	uint8_t& slot = this->table[modifiers * 256 + key];
+	if (slot != 0) {
+		this->actions[slot - 1] = std::move(action);
+		return true;
+	}
+
+	if (this->actions.size() >= UINT8_MAX) return false;
+
+	this->actions.push_back(std::move(action));
+	slot = (uint8_t)this->actions.size();
+	return true;
+}
+
+bool HotkeyEngine::Register(std::string_view shortcut, Action action) {
+	uint8_t modifiers = 0, key = 0;
+	if (!ParseHotkey(shortcut, modifiers, key)) {
+		spdlog::warn("Invalid shortcut \"{}\"", shortcut);
+		return false;
+	}
+
+	return this->Register(modifiers, key, std::move(action));
+}
+
+void HotkeyEngine::Unregister(uint8_t modifiers, uint8_t key) {
+	if (modifiers >= kModifierCombinations) return;
+
+	uint8_t& slot = this->table[modifiers * 256 + key];
+	if (slot != 0)
+		this->actions[slot - 1] = nullptr;
+	slot = 0;
+}
+
+uint8_t HotkeyEngine::Modifiers() const {
+	uint8_t modifiers = 0;
+	if (this->down.test(Keys::LWin) || this->down.test(Keys::RWin)) modifiers |= ModWin;
+	if (this->down.test(Keys::Shift) || this->down.test(Keys::LShift) || this->down.test(Keys::RShift)) modifiers |= ModShift;
+	if (this->down.test(Keys::Control) || this->down.test(Keys::LControl) || this->down.test(Keys::RControl)) modifiers |= ModControl;
+	if (this->down.test(Keys::Alt) || this->down.test(Keys::LAlt) || this->down.test(Keys::RAlt)) modifiers |= ModAlt;
+	return modifiers;
+}
+
+bool HotkeyEngine::OnKey(uint8_t key, bool down) {
+	bool wasDown = this->down.test(key);
+
+	if (!down) {
+		if (wasDown) {
+			this->down.reset(key);
+			this->pressed--;
+		}
+
+		if (IsWin(key) && !this->down.test(Keys::LWin) && !this->down.test(Keys::RWin)) {
+			if (this->state == State::WinHeld && this->winTap)
+				this->winTap();
+			this->state = State::Idle;
+		}
+
+		if (this->consumed.test(key)) {
+			this->consumed.reset(key);
+			return true;
+		}
+		return false;
+	}
+
+	// A key up we never saw (Win+L, Ctrl+Alt+Del and UAC prompts swallow them) would make Win look like part
+	// of a combo, so check every key then. Otherwise it would make this press look like auto-repeat: repeats
+	// only ask about the key itself, a single query instead of one per held key on every repeat.
+	if (this->keyQuery && IsWin(key) && this->pressed > 0) {
+		this->Resync();
+		wasDown = this->down.test(key);
+	}
+	else if (this->keyQuery && wasDown && !this->keyQuery(key)) {
+		this->down.reset(key);
+		this->consumed.reset(key);
+		this->pressed--;
+		wasDown = false;
+	}
+
+	// Auto-repeat sends more key downs, only the first one counts
+	if (wasDown) return this->consumed.test(key);
+
+	this->down.set(key);
+	this->pressed++;
+
+	if (IsWin(key)) {
+		// Only a Win press on its own can turn into a tap
+		if (this->state == State::Idle)
+			this->state = this->pressed == 1 ? State::WinHeld : State::WinCombo;
+		return false;
+	}
+
+	if (this->state == State::WinHeld)
+		this->state = State::WinCombo;
+
+	uint8_t slot = this->table[this->Modifiers() * 256 + key];
+	if (slot == 0 || !this->actions[slot - 1]) return false;
+
+	this->consumed.set(key);
+	this->actions[slot - 1]();
+	return true;
+}
+
+void HotkeyEngine::Reset() {
+	this->down.reset();
+	this->consumed.reset();
+	this->pressed = 0;
+	this->state = State::Idle;
+}
+
+/// <summary>
+/// Release every key marked down that the keyboard says is up. The key being handled is still reported with
+/// its state from before the event, so a repeat stays down and a press after a missed release doesn't.
+/// </summary>
+void HotkeyEngine::Resync() {
+	for (size_t key = 0; key < this->down.size(); key++) {
+		if (!this->down.test(key) || this->keyQuery((uint8_t)key)) continue;
+
+		this->down.reset(key);
+		this->consumed.reset(key);
+		this->pressed--;
+	}
+
+	if (!this->down.test(Keys::LWin) && !this->down.test(Keys::RWin))
+		this->state = State::Idle;
+}
@@ -0,0 +1,312 @@
+#include "pch.h"
+
+#include "icon_cache.h"
+
+#include "app_index.h"
+
+using namespace IMS;
+
+void SkylinePacker::Reset(int width, int height) {
+	this->width = width;
+	this->height = height;
+	this->skyline.clear();
+	if (width > 0 && height > 0)
+		this->skyline.push_back({ 0, 0, width });
+}
+
+int SkylinePacker::Fit(size_t index, int width, int height) const {
+	int x = this->skyline[index].x;
+	if (x + width > this->width) return -1;
+
+	// Rests on the highest segment it spans
+	int y = 0;
+	for (int remaining = width; remaining > 0; index++) {
+		if (index >= this->skyline.size()) return -1;
+
+		y = (std::max)(y, this->skyline[index].y);
+		if (y + height > this->height) return -1;
+		remaining -= this->skyline[index].width;
+	}
+	return y;
+}
+
+std::optional<AtlasRect> SkylinePacker::Insert(int width, int height) {
+	if (width <= 0 || height <= 0) return std::nullopt;
+
+	size_t best = SIZE_MAX;
+	int bestTop = INT_MAX, bestWidth = INT_MAX, bestY = 0;
+	for (size_t i = 0; i < this->skyline.size(); i++) {
+		int y = this->Fit(i, width, height);
+		if (y < 0) continue;
+
+		if (y + height < bestTop || (y + height == bestTop && this->skyline[i].width < bestWidth)) {
+			best = i;
+			bestTop = y + height;
+			bestWidth = this->skyline[i].width;
+			bestY = y;
+		}
+	}
+	if (best == SIZE_MAX) return std::nullopt;
+
+	AtlasRect rect{ (uint16_t)this->skyline[best].x, (uint16_t)bestY, (uint16_t)width, (uint16_t)height };
+	this->skyline.insert(this->skyline.begin() + best, { rect.x, bestTop, width });
+
+	// Cut the segments the new one covers
+	for (size_t i = best + 1; i < this->skyline.size();) {
+		const Segment& previous = this->skyline[i - 1];
+		Segment& segment = this->skyline[i];
+
+		int overlap = previous.x + previous.width - segment.x;
+		if (overlap <= 0) break;
+
+		segment.x += overlap;
+		segment.width -= overlap;
+		if (segment.width > 0) break;
+		this->skyline.erase(this->skyline.begin() + i);
+	}
+
+	// Neighbours at the same height become one segment
+	for (size_t i = 1; i < this->skyline.size();) {
+		if (this->skyline[i - 1].y == this->skyline[i].y) {
+			this->skyline[i - 1].width += this->skyline[i].width;
+			this->skyline.erase(this->skyline.begin() + i);
+		}
+		else {
+			i++;
+		}
+	}
+
+	return rect;
+}
+
+size_t SkylinePacker::UsedArea() const {
+	size_t area = 0;
+	for (const Segment& segment : this->skyline)
+		area += (size_t)segment.y * segment.width;
+	return area;
+}
+
+#ifdef _WIN32
+bool Win32IconBackend::Extract(const std::string& path, int32_t index, int size, IconImage& out) {
+	HICON icon = nullptr;
+	UINT id = 0;
+	if (PrivateExtractIconsW(PathFromUtf8(path).c_str(), index, size, size, &icon, &id, 1, 0) != 1 || !icon)
+		return false;
+
+	ICONINFO info = {};
+	bool ok = GetIconInfo(icon, &info);
+	DestroyIcon(icon);
+	if (!ok) return false;
+
+	BITMAPINFO bmi = {};
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = size;
+	bmi.bmiHeader.biHeight = -size; // Top down
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+
+	out.width = size;
+	out.height = size;
+	out.pixels.assign((size_t)size * size, 0);
+
+	HDC dc = GetDC(nullptr);
+	BITMAP color = {};
+	ok = info.hbmColor && GetObject(info.hbmColor, sizeof(color), &color) && color.bmWidth == size && color.bmHeight == size &&
+		GetDIBits(dc, info.hbmColor, 0, size, out.pixels.data(), &bmi, DIB_RGB_COLORS) == size;
+
+	// Icons without an alpha channel use the AND mask, set bits are transparent
+	bool hasAlpha = std::any_of(out.pixels.begin(), out.pixels.end(), [](uint32_t pixel) { return (pixel >> 24) != 0; });
+	if (ok && !hasAlpha && info.hbmMask) {
+		std::vector<uint32_t> mask((size_t)size * size);
+		if (GetDIBits(dc, info.hbmMask, 0, size, mask.data(), &bmi, DIB_RGB_COLORS) == size) {
+			for (size_t i = 0; i < mask.size(); i++)
+				out.pixels[i] |= (mask[i] & 0xFFFFFF) ? 0 : 0xFF000000;
+		}
+	}
+	ReleaseDC(nullptr, dc);
+
+	if (info.hbmColor) DeleteObject(info.hbmColor);
+	if (info.hbmMask) DeleteObject(info.hbmMask);
+	if (!ok) return false;
+
+	// BGRA to RGBA
+	for (uint32_t& pixel : out.pixels)
+		pixel = (pixel & 0xFF00FF00) | (pixel >> 16 & 0xFF) | (pixel & 0xFF) << 16;
+	return true;
+}
+
+ImTextureID Win32IconBackend::CreateTexture(int width, int height) {
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = width;
+	desc.Height = height;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	// Cleared, so unused parts of the atlas are transparent
+	std::vector<uint32_t> clear((size_t)width * height, 0);
+	D3D11_SUBRESOURCE_DATA data = { clear.data(), (UINT)width * 4, 0 };
+
+	ID3D11Texture2D* texture = nullptr;
+	if (FAILED(this->device->CreateTexture2D(&desc, &data, &texture))) return ImTextureID();
+
+	ID3D11ShaderResourceView* view = nullptr;
+	this->device->CreateShaderResourceView(texture, nullptr, &view);
+	texture->Release(); // The view keeps it alive
+
+	return (ImTextureID)(intptr_t)view;
+}
+
+void Win32IconBackend::UpdateTexture(ImTextureID texture, const AtlasRect& rect, const uint32_t* pixels) {
+	ID3D11ShaderResourceView* view = (ID3D11ShaderResourceView*)(intptr_t)texture;
+	if (!view) return;
+
+	ID3D11Resource* resource = nullptr;
+	view->GetResource(&resource);
+
+	D3D11_BOX box = { rect.x, rect.y, 0, (UINT)rect.x + rect.width, (UINT)rect.y + rect.height, 1 };
+	this->deviceContext->UpdateSubresource(resource, 0, &box, pixels, (UINT)rect.width * 4, 0);
+	resource->Release();
+	this->textureUpdates++;
+}
+
+void Win32IconBackend::DestroyTexture(ImTextureID texture) {
+	ID3D11ShaderResourceView* view = (ID3D11ShaderResourceView*)(intptr_t)texture;
+	if (view) view->Release();
+}
+#endif
+
+IconCache::IconCache(std::unique_ptr<IIconBackend> backend, std::function<void()> onReady, Options options)
+	: backend(std::move(backend)), onReady(std::move(onReady)), options(options), packer(options.atlasSize, options.atlasSize) {
+	if (this->backend)
+		this->thread = std::jthread([this](std::stop_token stop) { this->Work(stop); });
+}
+
+IconCache::~IconCache() {
+	// Stops and joins before the backend goes away
+	this->thread = std::jthread();
+
+	if (this->hasTexture)
+		this->backend->DestroyTexture(this->texture);
+}
+
+const IconCache::Icon* IconCache::Get(std::string_view path, int32_t index) {
+	if (!this->backend || path.empty()) return nullptr;
+
+	// Paths are case-insensitive on Windows, different spellings share an icon
+	this->lookupKey.assign(path);
+	std::transform(this->lookupKey.begin(), this->lookupKey.end(), this->lookupKey.begin(), ToLowerAscii);
+	this->lookupKey.push_back('\0');
+	char digits[16];
+	auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), index);
+	this->lookupKey.append(digits, end);
+
+	auto it = this->entries.find(this->lookupKey);
+	if (it != this->entries.end()) {
+		if (it->second.state != State::Ready) return nullptr;
+
+		this->lru.splice(this->lru.end(), this->lru, it->second.lru);
+		return &it->second.icon;
+	}
+
+	this->entries.emplace(this->lookupKey, Entry());
+	{
+		std::lock_guard lock(this->mutex);
+		this->requests.push_back({ this->lookupKey, std::string(path), index });
+	}
+	this->wake.notify_one();
+	return nullptr;
+}
+
+std::optional<AtlasRect> IconCache::Allocate() {
+	if (auto rect = this->packer.Insert(this->options.iconSize, this->options.iconSize))
+		return rect;
+
+	// Full, take over the slot of the icon that hasn't been drawn for the longest.
+	// It's forgotten entirely, so it's extracted again if it's ever needed.
+	if (this->lru.empty()) return std::nullopt;
+
+	auto victim = this->entries.find(*this->lru.front());
+	this->lru.pop_front();
+	AtlasRect rect = victim->second.rect;
+	this->entries.erase(victim);
+	this->evictions++;
+	return rect;
+}
+
+size_t IconCache::Upload() {
+	std::vector<Result> ready;
+	{
+		std::lock_guard lock(this->mutex);
+		if (this->results.empty()) return 0;
+		ready.swap(this->results);
+	}
+
+	size_t uploaded = 0;
+	for (Result& result : ready) {
+		auto it = this->entries.find(result.key);
+		if (it == this->entries.end()) continue;
+
+		Entry& entry = it->second;
+		const IconImage& image = result.image;
+		bool usable = result.found && image.width == this->options.iconSize && image.height == this->options.iconSize &&
+			image.pixels.size() == (size_t)image.width * image.height;
+
+		// Created with the first icon, a failure is tried again with the next one
+		if (usable && !this->hasTexture) {
+			this->texture = this->backend->CreateTexture(this->options.atlasSize, this->options.atlasSize);
+			this->hasTexture = this->texture != ImTextureID();
+		}
+
+		// Allocated once the texture exists, so a failure doesn't evict anything
+		std::optional<AtlasRect> rect = usable && this->hasTexture ? this->Allocate() : std::nullopt;
+		if (!rect) {
+			entry.state = State::Missing;
+			continue;
+		}
+
+		this->backend->UpdateTexture(this->texture, *rect, image.pixels.data());
+
+		float scale = 1.0f / (float)this->options.atlasSize;
+		entry.rect = *rect;
+		entry.icon.texture = this->texture;
+		entry.icon.uv0 = ImVec2(rect->x * scale, rect->y * scale);
+		entry.icon.uv1 = ImVec2((rect->x + rect->width) * scale, (rect->y + rect->height) * scale);
+		entry.state = State::Ready;
+		entry.lru = this->lru.insert(this->lru.end(), &it->first);
+		uploaded++;
+	}
+
+	return uploaded;
+}
+
+void IconCache::Work(std::stop_token stop) {
+	while (!stop.stop_requested()) {
+		Request request;
+		{
+			std::unique_lock lock(this->mutex);
+			if (!this->wake.wait(lock, stop, [this]() { return !this->requests.empty(); })) return;
+
+			request = std::move(this->requests.front());
+			this->requests.pop_front();
+		}
+
+		Result result;
+		result.key = std::move(request.key);
+		result.found = this->backend->Extract(request.path, request.index, this->options.iconSize, result.image);
+
+		bool more = false;
+		{
+			std::lock_guard lock(this->mutex);
+			this->results.push_back(std::move(result));
+			more = !this->requests.empty();
+		}
+
+		// Wake the UI once per burst rather than per icon
+		if (!more && this->onReady) this->onReady();
+	}
+}
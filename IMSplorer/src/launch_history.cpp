@@ -0,0 +1,214 @@
+#include "pch.h"
+
+#include "launch_history.h"
+
+#include "app_index.h"
+#include "mapped_file.h"
+#include "path_utf8.h"
+
+using namespace IMS;
+
+// A compaction once the log holds this many records and several times as many as there are apps
+static constexpr size_t kCompactMinimum = 4096;
+static constexpr size_t kCompactFactor = 4;
+
+// Apps whose score fell below this are dropped when compacting, a single launch about six half-lives ago
+static constexpr double kForgetScore = 1.0 / 64;
+
+/// <summary>
+/// log2(2^a + 2^b) without overflowing
+/// </summary>
+static double addLog2(double a, double b) {
+	double high = (std::max)(a, b), low = (std::min)(a, b);
+	return high + std::log2(1.0 + std::exp2(low - high));
+}
+
+LaunchHistory::~LaunchHistory() {
+	// Whatever is still queued gets written before the thread stops
+	if (this->thread.joinable())
+		this->Flush();
+}
+
+uint64_t LaunchHistory::Key(std::string_view path) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (char c : path) {
+		char lower = ToLowerAscii(c);
+		hash = Fnv1a(&lower, 1, hash);
+	}
+	return hash;
+}
+
+bool LaunchHistory::Load(const std::filesystem::path& path) {
+	this->path = path;
+	this->needsCompaction = true;
+
+	bool ok = false;
+	MappedFile file;
+	if (file.Open(path)) {
+		const uint8_t* data = file.Data();
+		size_t size = file.Size();
+
+		LaunchFileHeader header;
+		if (size >= sizeof(header))
+			std::memcpy(&header, data, sizeof(header));
+
+		if (size < sizeof(header) || std::memcmp(header.magic, LaunchFileHeader::kMagic, sizeof(header.magic)) != 0 ||
+			header.version != LaunchFileHeader::kVersion || header.headerSize != sizeof(LaunchFileHeader) ||
+			header.recordSize != sizeof(LaunchRecord) || header.halfLife != kHalfLife) {
+			spdlog::warn("Ignoring launch history {}: other version or layout", PathToUtf8(path));
+		}
+		else {
+			// An append cut short leaves a partial record at the end, it's dropped by compacting right away
+			size_t count = (size - sizeof(header)) / sizeof(LaunchRecord);
+			this->needsCompaction = sizeof(header) + count * sizeof(LaunchRecord) != size;
+
+			// Clocks jump, but nothing launched far in the future
+			int64_t limit = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count() + kHalfLife;
+
+			for (size_t i = 0; i < count; i++) {
+				LaunchRecord record;
+				std::memcpy(&record, data + sizeof(header) + i * sizeof(LaunchRecord), sizeof(record));
+				if (!(record.weight > 0) || !std::isfinite(record.weight) || record.time > limit) continue;
+
+				this->Apply(this->entries, record);
+			}
+			this->logRecords = count;
+			ok = true;
+		}
+	}
+
+	for (auto& [key, entry] : this->entries)
+		this->ranked.emplace(entry.rank, key);
+	this->stored = this->entries;
+	this->generation++;
+
+	this->thread = std::jthread([this](std::stop_token stop) { this->Work(stop); });
+	return ok;
+}
+
+LaunchHistory::Entry& LaunchHistory::Apply(std::unordered_map<uint64_t, Entry>& into, const LaunchRecord& record) {
+	double rank = std::log2((double)record.weight) + (double)record.time / kHalfLife;
+
+	auto [it, inserted] = into.try_emplace(record.key);
+	Entry& entry = it->second;
+	entry.rank = inserted ? rank : addLog2(entry.rank, rank);
+	entry.last = (std::max)(entry.last, record.time);
+	entry.count += record.count;
+	return entry;
+}
+
+void LaunchHistory::Record(std::string_view path, std::chrono::system_clock::time_point when) {
+	this->Record(Key(path), std::chrono::duration_cast<std::chrono::seconds>(when.time_since_epoch()).count());
+}
+
+void LaunchHistory::Record(uint64_t key, int64_t time) {
+	LaunchRecord record{ key, time, 1.0f, 1 };
+
+	auto it = this->entries.find(key);
+	if (it != this->entries.end())
+		this->ranked.erase({ it->second.rank, key });
+
+	this->ranked.emplace(this->Apply(this->entries, record).rank, key);
+	this->generation++;
+
+	if (!this->thread.joinable()) return;
+	{
+		std::lock_guard lock(this->mutex);
+		this->queue.push_back(record);
+		this->queued++;
+	}
+	this->wake.notify_one();
+}
+
+const LaunchHistory::Entry* LaunchHistory::Find(uint64_t key) const {
+	auto it = this->entries.find(key);
+	return it != this->entries.end() ? &it->second : nullptr;
+}
+
+void LaunchHistory::Flush() {
+	std::unique_lock lock(this->mutex);
+	this->written.wait(lock, [this]() { return this->flushed == this->queued; });
+}
+
+void LaunchHistory::Work(std::stop_token stop) {
+	if (this->needsCompaction)
+		this->needsCompaction = !this->Compact();
+
+	std::vector<LaunchRecord> batch;
+	for (;;) {
+		{
+			std::unique_lock lock(this->mutex);
+			this->wake.wait(lock, stop, [this]() { return !this->queue.empty(); });
+			if (this->queue.empty()) return; // Stopped with nothing left
+			batch.swap(this->queue);
+		}
+
+		for (const LaunchRecord& record : batch)
+			this->Apply(this->stored, record);
+
+		size_t threshold = (std::max)(kCompactMinimum, this->stored.size() * kCompactFactor);
+		if (this->needsCompaction || this->logRecords + batch.size() >= threshold) {
+			// Rewritten from `stored`, which already holds the batch
+			this->needsCompaction = !this->Compact();
+		}
+		else {
+			if (!this->log.is_open())
+				this->log.open(this->path, std::ios::binary | std::ios::app);
+			this->log.write((const char*)batch.data(), (std::streamsize)(batch.size() * sizeof(LaunchRecord)));
+			this->log.flush();
+			if (!this->log) {
+				// Appending failed part way, the file is written again as a whole next time
+				this->log.close();
+				this->needsCompaction = true;
+			}
+			this->logRecords += batch.size();
+		}
+
+		{
+			std::lock_guard lock(this->mutex);
+			this->flushed += batch.size();
+		}
+		this->written.notify_all();
+		batch.clear();
+	}
+}
+
+/// <summary>
+/// Replace the log with one record per app, dropping apps that haven't been launched for long
+/// </summary>
+bool LaunchHistory::Compact() {
+	int64_t latest = 0;
+	for (auto& [key, entry] : this->stored)
+		latest = (std::max)(latest, entry.last);
+
+	std::erase_if(this->stored, [&](const auto& item) { return Score(item.second, latest) < kForgetScore; });
+
+	LaunchFileHeader header;
+	std::memcpy(header.magic, LaunchFileHeader::kMagic, sizeof(header.magic));
+	header.version = LaunchFileHeader::kVersion;
+	header.headerSize = sizeof(LaunchFileHeader);
+	header.recordSize = sizeof(LaunchRecord);
+	header.halfLife = (uint32_t)kHalfLife;
+
+	std::vector<LaunchRecord> records;
+	records.reserve(this->stored.size());
+	for (auto& [key, entry] : this->stored)
+		records.push_back({ key, entry.last, (float)Score(entry, entry.last), entry.count });
+
+	// The append handle would keep writing to the replaced file
+	this->log.close();
+	bool ok = WriteFileAtomic(this->path, [&](std::ostream& out) {
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)records.data(), (std::streamsize)(records.size() * sizeof(LaunchRecord)));
+		return (bool)out;
+	});
+
+	if (!ok) {
+		spdlog::error("Failed to write the launch history to {}", PathToUtf8(this->path));
+		return false;
+	}
+
+	this->logRecords = records.size();
+	this->compactions.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
@@ -1,6 +1,10 @@
 #include "pch.h"
 
+#include "allocation_counters.h"
+#include "async_log.h"
+#include "benchmark.h"
 #include "taskbar.h"
+#include "win32_platform.h"
 
 // WinMain
 int APIENTRY wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow) {
@@ -18,9 +22,65 @@ int APIENTRY wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLi
 	logger->info("Starting IMSplorer");
 	spdlog::set_default_logger(logger);
 
+	// Before anything is allocated through ImGui, the font atlas included
+	IMS::CountImGuiAllocations();
+
+	// Split like a console program's argv, one argument per flag and quoted paths come out whole
+	std::vector<std::wstring> args;
+	int argc = 0;
+	if (LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc)) {
+		if (argc > 1) args.assign(argv + 1, argv + argc);
+		LocalFree(argv);
+	}
+
+	auto hasFlag = [&](std::wstring_view flag) { return std::find(args.begin(), args.end(), flag) != args.end(); };
+	auto flagValue = [&](std::wstring_view flag) -> const std::wstring* {
+		auto it = std::find(args.begin(), args.end(), flag);
+		return it != args.end() && it + 1 != args.end() ? &*(it + 1) : nullptr;
+	};
+
+	// Shortcut parser timings over a folder of .lnk files
+	if (const std::wstring* corpus = flagValue(L"--bench-lnk"))
+		return IMS::RunShellLinkBenchmark(*corpus);
+
+	// Replay a recorded session headlessly
+	if (const std::wstring* trace = flagValue(L"--replay"))
+		return IMS::ReplayTrace(*trace);
+
+	// Frame build timings on the headless platform, no shell involved
+	if (hasFlag(L"--bench"))
+		return IMS::RunBenchmarks();
+
 	// Check if a window named "IMSplorerTB" already exists
 	if (!FindWindowA("ImSplorerTB", nullptr)) {
-		IMS::Taskbar taskbar("ImSplorerTB");
+		IMS::Win32Platform platform;
+		IMS::TraceRecorder recorder; // Outlives the taskbar
+		IMS::Taskbar taskbar(platform);
+
+		// Record the session for --replay
+		if (const std::wstring* trace = flagValue(L"--record")) {
+			if (recorder.Open(*trace))
+				taskbar.SetRecorder(&recorder);
+			else
+				spdlog::error("Can't write a trace to {}", IMS::PathToUtf8(*trace));
+		}
+
+		// Diagnostics from the window procedure, the keyboard hook and the render loop
+		if (const std::wstring* log = flagValue(L"--log")) {
+			if (IMS::AsyncLog::Get().Start(std::filesystem::path(*log)))
+				spdlog::info("Logging to {}", IMS::PathToUtf8(*log));
+		}
+
+		// Device creation overlaps with the font atlas, the Start menu index and the window list
+		IMS::StartupGraph startup;
+		auto platformTasks = platform.AddStartupTasks(startup, "ImSplorerTB");
+		taskbar.AddStartupTasks(startup, platformTasks.shell, platformTasks.ready);
+
+		bool started = startup.Run();
+		spdlog::info("Startup report:");
+		startup.LogReport();
+		if (!started)
+			return 1;
 
 		taskbar.Run();
 	}
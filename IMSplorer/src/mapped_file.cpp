@@ -0,0 +1,121 @@
+#include "pch.h"
+
+#include "mapped_file.h"
+
+#include "path_utf8.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace IMS;
+
+MappedFile::~MappedFile() {
+	this->Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::filesystem::path& path) {
+	this->Close();
+
+	// Windows refuses to replace or delete a file while a view of it is mapped, whatever the share mode.
+	// Writers that may run while a mapping is alive write to a new file instead (see AppIndex::Persist).
+	this->file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (this->file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size = { 0 };
+	if (!GetFileSizeEx(this->file, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > SIZE_MAX) {
+		this->Close();
+		return false;
+	}
+
+	this->mapping = CreateFileMappingW(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!this->mapping) {
+		this->Close();
+		return false;
+	}
+
+	this->data = (const uint8_t*)MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!this->data) {
+		this->Close();
+		return false;
+	}
+
+	this->size = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (this->data) UnmapViewOfFile(this->data);
+	if (this->mapping) CloseHandle(this->mapping);
+	if (this->file != INVALID_HANDLE_VALUE) CloseHandle(this->file);
+
+	this->data = nullptr;
+	this->size = 0;
+	this->mapping = nullptr;
+	this->file = INVALID_HANDLE_VALUE;
+}
+#else
+bool MappedFile::Open(const std::filesystem::path& path) {
+	this->Close();
+
+	this->fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (this->fd < 0) return false;
+
+	struct stat info = {};
+	if (fstat(this->fd, &info) != 0 || info.st_size <= 0) {
+		this->Close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, this->fd, 0);
+	if (data == MAP_FAILED) {
+		this->Close();
+		return false;
+	}
+
+	this->data = (const uint8_t*)data;
+	this->size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (this->data) munmap((void*)this->data, this->size);
+	if (this->fd >= 0) close(this->fd);
+
+	this->data = nullptr;
+	this->size = 0;
+	this->fd = -1;
+}
+#endif
+
+bool IMS::WriteFileAtomic(const std::filesystem::path& path, const std::function<bool(std::ostream&)>& write) {
+	namespace fs = std::filesystem;
+
+	std::error_code ec;
+	fs::create_directories(path.parent_path(), ec);
+
+	fs::path temp = path;
+	temp += ".tmp";
+
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		if (!file || !write(file) || !file.flush()) {
+			file.close();
+			fs::remove(temp, ec);
+			return false;
+		}
+	}
+
+	fs::rename(temp, path, ec);
+	if (ec) {
+		spdlog::warn("Can't replace {}: {}", PathToUtf8(path), ec.message());
+		fs::remove(temp, ec);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,14 @@
+#include "pch.h"
+
+#include "path_utf8.h"
+
+using namespace IMS;
+
+std::string IMS::PathToUtf8(const std::filesystem::path& path) {
+	std::u8string utf8 = path.u8string();
+	return std::string(reinterpret_cast<const char*>(utf8.data()), utf8.size());
+}
+
+std::filesystem::path IMS::PathFromUtf8(std::string_view utf8) {
+	return std::filesystem::path(std::u8string(reinterpret_cast<const char8_t*>(utf8.data()), utf8.size()));
+}
@@ -0,0 +1,242 @@
+#include "pch.h"
+
+#include "process_cache.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace IMS;
+
+StringInterner::StringInterner() {
+	this->chunks[0] = std::make_unique<std::string[]>(kChunkSize);
+	this->lookup.emplace(std::string_view(this->chunks[0][0]), 0);
+	this->count.store(1, std::memory_order_release);
+}
+
+StringId StringInterner::Intern(std::string_view str) {
+	std::lock_guard lock(this->mutex);
+
+	auto it = this->lookup.find(str);
+	if (it != this->lookup.end()) return it->second;
+
+	size_t id = this->count.load(std::memory_order_relaxed);
+	if (id >= kChunkSize * kMaxChunks) {
+		spdlog::warn("String pool is full, \"{}\" isn't stored", str);
+		return 0;
+	}
+
+	std::unique_ptr<std::string[]>& chunk = this->chunks[id / kChunkSize];
+	if (!chunk) chunk = std::make_unique<std::string[]>(kChunkSize);
+
+	std::string& stored = chunk[id % kChunkSize];
+	stored.assign(str);
+	this->lookup.emplace(std::string_view(stored), (StringId)id);
+
+	// Readers see the string (and its chunk) once they see the count covering it
+	this->count.store(id + 1, std::memory_order_release);
+	return (StringId)id;
+}
+
+std::string_view StringInterner::Get(StringId id) const {
+	if (id >= this->count.load(std::memory_order_acquire)) return this->chunks[0][0];
+	return this->chunks[id / kChunkSize][id % kChunkSize];
+}
+
+#ifdef _WIN32
+static bool processStartTime(HANDLE process, uint64_t& startTime) {
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(process, &creation, &exit, &kernel, &user)) return false;
+
+	startTime = ((uint64_t)creation.dwHighDateTime << 32) | creation.dwLowDateTime;
+	return true;
+}
+
+static bool processImagePath(HANDLE process, std::string& path) {
+	wchar_t exePath[MAX_PATH] = { 0 };
+	DWORD length = MAX_PATH;
+	if (!QueryFullProcessImageNameW(process, 0, exePath, &length)) return false;
+
+	int size = WideCharToMultiByte(CP_UTF8, 0, exePath, (int)length, nullptr, 0, nullptr, nullptr);
+	path.assign(size, '\0');
+	WideCharToMultiByte(CP_UTF8, 0, exePath, (int)length, path.data(), size, nullptr, nullptr);
+	return true;
+}
+
+bool Win32ProcessBackend::StartTime(uint32_t pid, uint64_t& startTime) {
+	HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+	if (!process) return false;
+
+	bool ok = processStartTime(process, startTime);
+	CloseHandle(process);
+	return ok;
+}
+
+bool Win32ProcessBackend::ImagePath(uint32_t pid, std::string& path) {
+	HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+	if (!process) return false;
+
+	bool ok = processImagePath(process, path);
+	CloseHandle(process);
+	return ok;
+}
+
+void Win32ProcessBackend::Unpin(uintptr_t pin) {
+	CloseHandle((HANDLE)pin);
+}
+
+bool Win32ProcessBackend::Query(uint32_t pid, Details& details) {
+	HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+	if (!process) return false;
+
+	if (!processStartTime(process, details.startTime) || !processImagePath(process, details.imagePath)) {
+		CloseHandle(process);
+		return false;
+	}
+
+	// A process id isn't reused while a handle to the process is open
+	details.pin = (uintptr_t)process;
+	details.pinned = true;
+	return true;
+}
+#endif
+
+#ifdef __linux__
+bool ProcFsProcessBackend::StartTime(uint32_t pid, uint64_t& startTime) {
+	std::ifstream file(fmt::format("/proc/{}/stat", pid));
+	if (!file) return false;
+
+	std::string stat;
+	std::getline(file, stat);
+
+	// The command name is in parentheses and may contain spaces, start parsing after the last ')'
+	size_t pos = stat.rfind(')');
+	if (pos == std::string::npos) return false;
+
+	// Fields after the name start at 3 (state), starttime is field 22
+	std::istringstream fields(stat.substr(pos + 2));
+	std::string field;
+	for (int i = 3; i < 22; i++)
+		fields >> field;
+
+	return (bool)(fields >> startTime);
+}
+
+bool ProcFsProcessBackend::ImagePath(uint32_t pid, std::string& path) {
+	std::error_code ec;
+	auto target = std::filesystem::read_symlink(fmt::format("/proc/{}/exe", pid), ec);
+	if (ec) return false;
+
+	path = target.string();
+	return true;
+}
+#endif
+
+bool IProcessBackend::Query(uint32_t pid, Details& details) {
+	if (!this->StartTime(pid, details.startTime) || !this->ImagePath(pid, details.imagePath)) return false;
+
+	details.pinned = this->Pin(pid, details.pin);
+	return true;
+}
+
+ProcessCache::ProcessCache(std::unique_ptr<IProcessBackend> backend) : backend(std::move(backend)) {}
+
+ProcessCache::~ProcessCache() {
+	for (auto& [_, entry] : this->entries) {
+		if (entry.pinned)
+			this->backend->Unpin(entry.pin);
+	}
+}
+
+std::optional<ProcessInfo> ProcessCache::Acquire(uint32_t pid) {
+	// The backend is only called unlocked, a release from the UI thread never waits on it opening a process
+	std::optional<ProcessKey> cached;
+	{
+		std::lock_guard lock(this->mutex);
+
+		auto latest = this->latest.find(pid);
+		if (latest != this->latest.end()) {
+			Entry& entry = this->entries.at(latest->second);
+
+			// A pinned pid can't have been reused
+			if (entry.pinned) {
+				entry.windows++;
+				this->hits.fetch_add(1, std::memory_order_relaxed);
+				return entry.info;
+			}
+			cached = latest->second;
+		}
+	}
+
+	// Otherwise make sure it's still the same process, and that its entry wasn't released meanwhile
+	uint64_t startTime = 0;
+	if (cached && this->backend->StartTime(pid, startTime) && startTime == cached->startTime) {
+		std::lock_guard lock(this->mutex);
+
+		auto entry = this->entries.find(*cached);
+		if (entry != this->entries.end()) {
+			entry->second.windows++;
+			this->hits.fetch_add(1, std::memory_order_relaxed);
+			return entry->second.info;
+		}
+	}
+
+	this->misses.fetch_add(1, std::memory_order_relaxed);
+
+	IProcessBackend::Details details;
+	if (!this->backend->Query(pid, details))
+		return std::nullopt;
+
+	const std::string& exePath = details.imagePath;
+	size_t separator = exePath.find_last_of("\\/");
+	std::string_view exe = separator == std::string::npos ? std::string_view(exePath) : std::string_view(exePath).substr(separator + 1);
+
+	std::lock_guard lock(this->mutex);
+
+	// The revalidation failed but the process turned out to be the cached one, keep its references and pin
+	auto existing = this->entries.find({ pid, details.startTime });
+	if (existing != this->entries.end()) {
+		if (details.pinned)
+			this->backend->Unpin(details.pin);
+
+		existing->second.windows++;
+		this->latest[pid] = existing->first;
+		return existing->second.info;
+	}
+
+	Entry entry;
+	entry.info.key = { pid, details.startTime };
+	entry.info.exePath = this->strings.Intern(exePath);
+	entry.info.exe = this->strings.Intern(exe);
+	entry.windows = 1;
+	entry.pin = details.pin;
+	entry.pinned = details.pinned;
+
+	// An older instance with the same pid stays around until its windows release it
+	this->entries[entry.info.key] = entry;
+	this->latest[pid] = entry.info.key;
+
+	return entry.info;
+}
+
+void ProcessCache::Release(const ProcessKey& key) {
+	std::lock_guard lock(this->mutex);
+
+	auto it = this->entries.find(key);
+	if (it == this->entries.end()) return;
+
+	if (--it->second.windows > 0) return;
+
+	if (it->second.pinned)
+		this->backend->Unpin(it->second.pin);
+	this->entries.erase(it);
+
+	auto latest = this->latest.find(key.pid);
+	if (latest != this->latest.end() && latest->second == key)
+		this->latest.erase(latest);
+}
+
+size_t ProcessCache::Size() const {
+	std::lock_guard lock(this->mutex);
+	return this->entries.size();
+}
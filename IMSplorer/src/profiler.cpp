@@ -0,0 +1,207 @@
+#include "pch.h"
+
+#include "profiler.h"
+
+#include "path_utf8.h"
+
+using namespace IMS;
+
+static constexpr const char* zoneNames[] = {
+	"Frame",
+	"MessagePump",
+	"NewFrame",
+	"TaskbarBuild",
+	"StartMenuBuild",
+	"Render",
+	"Present",
+	"KeyboardProc",
+	"WndProc",
+};
+static_assert(std::size(zoneNames) == (size_t)ProfileZone::Count);
+
+const char* IMS::ProfileZoneName(ProfileZone zone) {
+	return zone < ProfileZone::Count ? zoneNames[(size_t)zone] : "Unknown";
+}
+
+/// <summary>
+/// Small sequential ids read better in a trace viewer than OS thread ids
+/// </summary>
+static uint32_t currentThread() {
+	static std::atomic<uint32_t> next = 1;
+	static thread_local uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+	return id;
+}
+
+float IMS::ProfilePercentile(const std::vector<float>& sorted, float q) {
+	if (sorted.empty()) return 0.0f;
+	size_t rank = (size_t)(q * (float)(sorted.size() - 1) + 0.5f);
+	return sorted[(std::min)(rank, sorted.size() - 1)];
+}
+
+static std::filesystem::path exportPath(std::string_view extension) {
+	std::error_code error;
+	std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+	if (error) directory = std::filesystem::current_path(error);
+
+	time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	return directory / fmt::format("imsplorer-profile-{:%Y%m%d-%H%M%S}.{}", fmt::localtime(now), extension);
+}
+
+Profiler& Profiler::Get() {
+	static Profiler profiler;
+	return profiler;
+}
+
+void Profiler::Record(ProfileZone zone, uint64_t start, uint64_t end) {
+	uint64_t index = this->writeIndex.fetch_add(1, std::memory_order_relaxed);
+	Slot& slot = this->slots[index & (kCapacity - 1)];
+
+	slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.start.store(start, std::memory_order_relaxed);
+	slot.duration.store(end - start, std::memory_order_relaxed);
+	slot.info.store((uint64_t)currentThread() << 8 | (uint64_t)zone, std::memory_order_relaxed);
+
+	slot.sequence.store(index * 2 + 2, std::memory_order_release);
+}
+
+void Profiler::Snapshot(std::vector<ProfileSample>& out) const {
+	out.clear();
+
+	uint64_t end = this->writeIndex.load(std::memory_order_acquire);
+	uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+	out.reserve((size_t)(end - begin));
+
+	for (uint64_t index = begin; index < end; index++) {
+		const Slot& slot = this->slots[index & (kCapacity - 1)];
+
+		uint64_t before = slot.sequence.load(std::memory_order_acquire);
+		if (before != index * 2 + 2) continue; // Still being written, or already overwritten
+
+		ProfileSample sample;
+		sample.start = slot.start.load(std::memory_order_relaxed);
+		sample.duration = slot.duration.load(std::memory_order_relaxed);
+		uint64_t info = slot.info.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != before) continue; // Torn
+
+		sample.thread = (uint32_t)(info >> 8);
+		sample.zone = (ProfileZone)(info & 0xFF);
+		out.push_back(sample);
+	}
+}
+
+bool Profiler::ExportCsv(const std::filesystem::path& path) const {
+	std::vector<ProfileSample> samples;
+	this->Snapshot(samples);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		spdlog::error("Failed to open {} for the profile export", PathToUtf8(path));
+		return false;
+	}
+
+	file << "zone,thread,start_us,duration_us\n";
+	for (const ProfileSample& sample : samples)
+		file << fmt::format("{},{},{:.3f},{:.3f}\n", ProfileZoneName(sample.zone), sample.thread, sample.start / 1000.0, sample.duration / 1000.0);
+
+	spdlog::info("Exported {} profile samples to {}", samples.size(), PathToUtf8(path));
+	return (bool)file;
+}
+
+bool Profiler::ExportChromeTrace(const std::filesystem::path& path) const {
+	std::vector<ProfileSample> samples;
+	this->Snapshot(samples);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		spdlog::error("Failed to open {} for the profile export", PathToUtf8(path));
+		return false;
+	}
+
+	// Trace Event Format, complete ("X") events in microseconds. Opens in chrome://tracing or Perfetto
+	uint64_t origin = samples.empty() ? 0 : samples.front().start;
+	for (const ProfileSample& sample : samples)
+		origin = (std::min)(origin, sample.start);
+
+	file << "{\"traceEvents\":[";
+	for (size_t i = 0; i < samples.size(); i++) {
+		const ProfileSample& sample = samples[i];
+		file << fmt::format("{}\n{{\"name\":\"{}\",\"cat\":\"imsplorer\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+			i == 0 ? "" : ",", ProfileZoneName(sample.zone), sample.thread, (sample.start - origin) / 1000.0, sample.duration / 1000.0);
+	}
+	file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	spdlog::info("Exported {} profile samples to {}", samples.size(), PathToUtf8(path));
+	return (bool)file;
+}
+
+void Profiler::DrawOverlay(bool* open, const std::function<void()>& extra) {
+	ImGui::SetNextWindowSize(ImVec2(460, 380), ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Profiler", open, ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoSavedSettings)) {
+		ImGui::End();
+		return;
+	}
+
+	this->Snapshot(this->samples);
+
+	// Frame time graph, most recent frames
+	static constexpr size_t graphFrames = 240;
+	this->frameTimes.clear();
+	for (const ProfileSample& sample : this->samples) {
+		if (sample.zone == ProfileZone::Frame)
+			this->frameTimes.push_back(sample.duration / 1e6f);
+	}
+
+	size_t graphStart = this->frameTimes.size() > graphFrames ? this->frameTimes.size() - graphFrames : 0;
+	size_t graphCount = this->frameTimes.size() - graphStart;
+	char graphLabel[32] = "No frames";
+	if (graphCount > 0)
+		*fmt::format_to_n(graphLabel, sizeof(graphLabel) - 1, "{:.2f} ms", this->frameTimes.back()).out = '\0';
+	ImGui::PlotLines("##Frames", this->frameTimes.data() + graphStart, (int)graphCount, 0, graphLabel, 0.0f, FLT_MAX, ImVec2(-1, 60));
+
+	// Percentiles per zone over everything in the ring
+	if (ImGui::BeginTable("##Zones", 6, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV)) {
+		ImGui::TableSetupColumn("Zone");
+		ImGui::TableSetupColumn("Count");
+		ImGui::TableSetupColumn("p50 ms");
+		ImGui::TableSetupColumn("p95 ms");
+		ImGui::TableSetupColumn("p99 ms");
+		ImGui::TableSetupColumn("Max ms");
+		ImGui::TableHeadersRow();
+
+		for (size_t zone = 0; zone < (size_t)ProfileZone::Count; zone++) {
+			this->durations.clear();
+			for (const ProfileSample& sample : this->samples) {
+				if ((size_t)sample.zone == zone)
+					this->durations.push_back(sample.duration / 1e6f);
+			}
+			std::sort(this->durations.begin(), this->durations.end());
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(zoneNames[zone]);
+			ImGui::TableNextColumn(); ImGui::Text("%zu", this->durations.size());
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", ProfilePercentile(this->durations, 0.50f));
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", ProfilePercentile(this->durations, 0.95f));
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", ProfilePercentile(this->durations, 0.99f));
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", this->durations.empty() ? 0.0f : this->durations.back());
+		}
+
+		ImGui::EndTable();
+	}
+
+	if (ImGui::Button("Export CSV"))
+		this->ExportCsv(exportPath("csv"));
+	ImGui::SameLine();
+	if (ImGui::Button("Export trace"))
+		this->ExportChromeTrace(exportPath("json"));
+
+	if (extra) {
+		ImGui::Separator();
+		extra();
+	}
+
+	ImGui::End();
+}
@@ -0,0 +1,237 @@
+#include "pch.h"
+
+#include "resource_sampler.h"
+
+#ifdef _WIN32
+#include <winternl.h>
+#endif
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace IMS;
+
+#ifdef _WIN32
+namespace {
+	/// <summary>
+	/// SYSTEM_PROCESS_INFORMATION with the fields winternl.h leaves reserved spelled out, up to the working set
+	/// </summary>
+	struct SystemProcessEntry {
+		ULONG nextEntryOffset;
+		ULONG numberOfThreads;
+		LARGE_INTEGER workingSetPrivateSize;
+		ULONG hardFaultCount;
+		ULONG numberOfThreadsHighWatermark;
+		ULONGLONG cycleTime;
+		LARGE_INTEGER createTime; // What GetProcessTimes reports, so it matches Win32ProcessBackend::StartTime
+		LARGE_INTEGER userTime;   // 100 ns units
+		LARGE_INTEGER kernelTime;
+		UNICODE_STRING imageName;
+		LONG basePriority;
+		HANDLE uniqueProcessId;
+		HANDLE inheritedFromUniqueProcessId;
+		ULONG handleCount;
+		ULONG sessionId;
+		ULONG_PTR uniqueProcessKey;
+		SIZE_T peakVirtualSize;
+		SIZE_T virtualSize;
+		ULONG pageFaultCount;
+		SIZE_T peakWorkingSetSize;
+		SIZE_T workingSetSize;
+	};
+
+	using NtQuerySystemInformationFn = LONG(NTAPI*)(ULONG, PVOID, ULONG, PULONG);
+
+	constexpr ULONG kSystemProcessInformation = 5;
+	constexpr LONG kStatusInfoLengthMismatch = (LONG)0xC0000004;
+}
+
+bool Win32ResourceBackend::Sample(std::vector<ProcessSample>& out) {
+	static const auto query = (NtQuerySystemInformationFn)GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQuerySystemInformation");
+	if (!query) return false;
+
+	out.clear();
+	if (this->buffer.empty())
+		this->buffer.resize(64 * 1024);
+
+	// Processes come and go between the size query and the copy, so there's some slack on top
+	for (;;) {
+		ULONG needed = 0;
+		LONG status = query(kSystemProcessInformation, this->buffer.data(), (ULONG)(this->buffer.size() * sizeof(uint64_t)), &needed);
+		if (status == kStatusInfoLengthMismatch) {
+			this->buffer.resize((std::max)((size_t)needed / sizeof(uint64_t) + 8 * 1024, this->buffer.size() * 2));
+			continue;
+		}
+		if (status < 0) return false;
+		break;
+	}
+
+	const uint8_t* data = (const uint8_t*)this->buffer.data();
+	for (size_t offset = 0;;) {
+		const auto* entry = (const SystemProcessEntry*)(data + offset);
+
+		// The idle process has no creation time and isn't anyone's window
+		uint32_t pid = (uint32_t)(uintptr_t)entry->uniqueProcessId;
+		if (pid != 0) {
+			uint64_t cpuTime = (uint64_t)(entry->userTime.QuadPart + entry->kernelTime.QuadPart) * 100;
+			out.push_back({ pid, (uint64_t)entry->createTime.QuadPart, cpuTime, (uint64_t)entry->workingSetSize });
+		}
+
+		if (entry->nextEntryOffset == 0) break;
+		offset += entry->nextEntryOffset;
+	}
+
+	return true;
+}
+#endif
+
+#ifdef __linux__
+bool ProcFsResourceBackend::Sample(std::vector<ProcessSample>& out) {
+	static const uint64_t ticks = (uint64_t)sysconf(_SC_CLK_TCK);
+	static const uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+
+	out.clear();
+
+	DIR* proc = opendir("/proc");
+	if (!proc) return false;
+
+	// Plain reads into stack buffers, this runs for every process on every sample
+	char path[64];
+	char stat[1024];
+	while (dirent* entry = readdir(proc)) {
+		char* end = nullptr;
+		unsigned long pid = std::strtoul(entry->d_name, &end, 10);
+		if (pid == 0 || *end != '\0') continue;
+
+		std::snprintf(path, sizeof(path), "/proc/%lu/stat", pid);
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0) continue; // Exited in the meantime
+
+		ssize_t size = read(fd, stat, sizeof(stat) - 1);
+		close(fd);
+		if (size <= 0) continue;
+		stat[size] = '\0';
+
+		// The command name is in parentheses and may contain spaces, fields start after the last ')' at 3 (state)
+		const char* cursor = std::strrchr(stat, ')');
+		if (!cursor) continue;
+		cursor++;
+
+		// utime and stime are fields 14 and 15, starttime 22 and rss 24
+		uint64_t fields[25] = {};
+		int field = 3;
+		for (; field < 25 && *cursor; field++) {
+			while (*cursor == ' ') cursor++;
+			char* next = nullptr;
+			fields[field] = std::strtoull(cursor, &next, 10);
+			if (next == cursor) {
+				// Not a number (the state)
+				while (*cursor && *cursor != ' ') cursor++;
+			}
+			else {
+				cursor = next;
+			}
+		}
+		if (field < 25) continue;
+
+		out.push_back({ (uint32_t)pid, fields[22], (fields[14] + fields[15]) * 1'000'000'000ull / ticks, fields[24] * pageSize });
+	}
+
+	closedir(proc);
+	return true;
+}
+#endif
+
+const ProcessUsage* ResourceSnapshot::Find(const ProcessKey& key) const {
+	auto it = std::lower_bound(this->processes.begin(), this->processes.end(), key.pid, [](const ProcessUsage& usage, uint32_t pid) { return usage.key.pid < pid; });
+	if (it == this->processes.end() || it->key != key) return nullptr;
+	return &*it;
+}
+
+ResourceSampler::ResourceSampler(std::unique_ptr<IResourceBackend> backend, std::function<void()> onSample, std::chrono::milliseconds interval)
+	: backend(std::move(backend)), onSample(std::move(onSample)), interval(interval.count()) {
+	this->cores = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+	if (this->backend && interval.count() > 0)
+		this->thread = std::jthread([this](std::stop_token stop) { this->Work(stop); });
+}
+
+ResourceSampler::~ResourceSampler() {
+	if (this->thread.joinable()) {
+		this->thread.request_stop();
+		this->thread.join();
+	}
+}
+
+bool ResourceSampler::Sample() {
+	if (!this->backend) return false;
+
+	auto start = std::chrono::steady_clock::now();
+	if (!this->backend->Sample(this->current)) return false;
+
+	std::sort(this->current.begin(), this->current.end(), [](const ProcessSample& a, const ProcessSample& b) { return a.pid < b.pid; });
+
+	// CPU usage is the difference to the previous sample, the very first one only sets the baseline
+	bool publish = !this->previous.empty();
+	if (publish) {
+		double elapsed = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(start - this->previousTime).count();
+
+		ResourceSnapshot& snapshot = this->buffer.Back();
+		snapshot.processes.clear();
+		snapshot.cores = this->cores;
+		snapshot.sequence = this->samples.load(std::memory_order_relaxed) + 1;
+
+		// Both sorted by pid, a process only has a delta if it's the same instance as last time
+		auto last = this->previous.begin();
+		for (const ProcessSample& process : this->current) {
+			while (last != this->previous.end() && last->pid < process.pid)
+				++last;
+
+			float cpu = 0;
+			if (last != this->previous.end() && last->pid == process.pid && last->startTime == process.startTime && process.cpuTime >= last->cpuTime && elapsed > 0)
+				cpu = (float)((double)(process.cpuTime - last->cpuTime) / elapsed);
+
+			snapshot.processes.push_back({ { process.pid, process.startTime }, cpu, process.workingSet });
+		}
+
+		this->buffer.Publish();
+		this->samples.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	this->previous.swap(this->current);
+	this->previousTime = start;
+
+	// Wall time, an upper bound of the CPU time the sample took
+	double duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	int64_t interval = this->interval.load(std::memory_order_relaxed);
+	double share = duration / (double)(interval > 0 ? interval : kInterval.count());
+	double average = this->cost.load(std::memory_order_relaxed);
+	this->cost.store(average == 0 ? share : average * 0.75 + share * 0.25, std::memory_order_relaxed);
+
+	if (publish && this->onSample)
+		this->onSample();
+	return true;
+}
+
+void ResourceSampler::Work(std::stop_token stop) {
+	int64_t base = this->interval.load(std::memory_order_relaxed);
+
+	while (!stop.stop_requested()) {
+		this->Sample();
+
+		// Back off while over budget, come back once well under it
+		int64_t interval = this->interval.load(std::memory_order_relaxed);
+		double cost = this->cost.load(std::memory_order_relaxed);
+		if (cost > kBudget && interval < kMaxInterval.count())
+			interval = (std::min)(interval * 2, (int64_t)kMaxInterval.count());
+		else if (cost < kBudget / 4 && interval > base)
+			interval = (std::max)(interval / 2, base);
+		this->interval.store(interval, std::memory_order_relaxed);
+
+		std::unique_lock lock(this->mutex);
+		this->wake.wait_for(lock, stop, std::chrono::milliseconds(interval), []() { return false; });
+	}
+}
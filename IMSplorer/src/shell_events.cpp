@@ -0,0 +1,100 @@
+#include "pch.h"
+
+#include "shell_events.h"
+
+using namespace IMS;
+
+void ShellEventQueue::Push(ShellEventType type, WindowHandle handle) {
+	this->pending.push_back({ type, handle, 0 });
+	this->received++;
+}
+
+const std::vector<ShellEvent>& ShellEventQueue::Coalesce() {
+	this->batch.clear();
+	this->dropped.clear();
+	this->created.clear();
+	this->redrawn.clear();
+
+	bool activated = false;
+	WindowHandle lastActivated = 0;
+
+	// Index in batch of an unpaired Replaced/Replacing
+	constexpr size_t none = SIZE_MAX;
+	size_t replaced = none, replacing = none;
+
+	auto emit = [&](const ShellEvent& event) {
+		this->batch.push_back(event);
+		this->dropped.push_back(false);
+		return this->batch.size() - 1;
+	};
+
+	for (const ShellEvent& event : this->pending) {
+		switch (event.type) {
+		case ShellEventType::Created:
+			if (this->created.contains(event.handle)) break; // Duplicate
+			this->created[event.handle] = emit(event);
+			break;
+
+		case ShellEventType::Destroyed: {
+			// The creation is pointless, but the window may have been on the taskbar before the batch
+			// (enumerated at startup, or a Created that arrived late): removing an unknown window is a no-op
+			auto it = this->created.find(event.handle);
+			if (it != this->created.end()) {
+				this->dropped[it->second] = true;
+				this->created.erase(it);
+			}
+			emit(event);
+			break;
+		}
+
+		case ShellEventType::Activated:
+			// Applied after everything else, activating a window that's gone just clears the focus
+			activated = true;
+			lastActivated = event.handle;
+			break;
+
+		case ShellEventType::Replacing:
+			if (replaced != none) {
+				this->batch[replaced] = { ShellEventType::Replace, this->batch[replaced].handle, event.handle };
+				replaced = none;
+				break;
+			}
+			replacing = emit(event);
+			break;
+
+		case ShellEventType::Replaced:
+			if (replacing != none) {
+				this->batch[replacing] = { ShellEventType::Replace, event.handle, this->batch[replacing].handle };
+				replacing = none;
+				break;
+			}
+			replaced = emit(event);
+			break;
+
+		case ShellEventType::Replace:
+			emit(event);
+			break;
+
+		case ShellEventType::Redraw:
+			// Titles are read when applied, once is enough
+			if (this->redrawn.insert(event.handle).second)
+				emit(event);
+			break;
+		}
+	}
+
+	size_t write = 0;
+	for (size_t read = 0; read < this->batch.size(); read++) {
+		if (!this->dropped[read])
+			this->batch[write++] = this->batch[read];
+	}
+	this->batch.resize(write);
+
+	if (activated)
+		this->batch.push_back({ ShellEventType::Activated, lastActivated, 0 });
+
+	this->applied += this->batch.size();
+	this->pending.clear();
+
+	return this->batch;
+}
@@ -0,0 +1,329 @@
+#include "pch.h"
+
+#include "shell_link.h"
+
+#include "mapped_file.h"
+
+using namespace IMS;
+
+namespace {
+	namespace LinkFlags {
+		static constexpr uint32_t HasLinkTargetIDList = 1u << 0;
+		static constexpr uint32_t HasLinkInfo = 1u << 1;
+		static constexpr uint32_t HasName = 1u << 2;
+		static constexpr uint32_t HasRelativePath = 1u << 3;
+		static constexpr uint32_t HasWorkingDir = 1u << 4;
+		static constexpr uint32_t HasArguments = 1u << 5;
+		static constexpr uint32_t HasIconLocation = 1u << 6;
+		static constexpr uint32_t IsUnicode = 1u << 7;
+		static constexpr uint32_t HasExpString = 1u << 9;
+		static constexpr uint32_t HasExpIcon = 1u << 14;
+	}
+
+	static constexpr uint32_t kHeaderSize = 0x4C;
+	static constexpr uint8_t kLinkClsid[16] = { 0x01, 0x14, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 };
+
+	static constexpr uint32_t kVolumeIDAndLocalBasePath = 1u << 0;
+	static constexpr uint32_t kCommonNetworkRelativeLinkAndPathSuffix = 1u << 1;
+
+	static constexpr uint32_t kEnvironmentVariableDataBlock = 0xA0000001;
+	static constexpr uint32_t kIconEnvironmentDataBlock = 0xA0000007;
+	static constexpr uint32_t kEnvironmentBlockSize = 0x314; // Signature, then 260 ANSI chars and 260 UTF-16 chars
+
+	/// <summary>
+	/// Little endian reads from a byte range, anything out of range reads as zero/empty and sets `failed`
+	/// </summary>
+	class ByteReader {
+	public:
+		explicit ByteReader(std::span<const uint8_t> data) : data(data) {}
+
+		size_t Size() const { return this->data.size(); }
+		bool Failed() const { return this->failed; }
+
+		bool Has(size_t offset, size_t size) const { return offset <= this->data.size() && size <= this->data.size() - offset; }
+
+		uint16_t U16(size_t offset) {
+			if (!this->Has(offset, 2)) return this->Fail(), 0;
+			return (uint16_t)(this->data[offset] | this->data[offset + 1] << 8);
+		}
+
+		uint32_t U32(size_t offset) {
+			if (!this->Has(offset, 4)) return this->Fail(), 0;
+			return (uint32_t)this->data[offset] | (uint32_t)this->data[offset + 1] << 8 | (uint32_t)this->data[offset + 2] << 16 | (uint32_t)this->data[offset + 3] << 24;
+		}
+
+		std::span<const uint8_t> Bytes(size_t offset, size_t size) {
+			if (!this->Has(offset, size)) return this->Fail(), std::span<const uint8_t>();
+			return this->data.subspan(offset, size);
+		}
+
+		/// <summary>
+		/// Null terminated ANSI string at offset, no further than `limit`
+		/// </summary>
+		std::span<const uint8_t> AnsiZ(size_t offset, size_t limit) {
+			limit = (std::min)(limit, this->data.size());
+			if (offset >= limit) return this->Fail(), std::span<const uint8_t>();
+
+			size_t end = offset;
+			while (end < limit && this->data[end] != 0) end++;
+			return this->data.subspan(offset, end - offset);
+		}
+
+		/// <summary>
+		/// Null terminated UTF-16 string at offset, no further than `limit`
+		/// </summary>
+		std::span<const uint8_t> Utf16Z(size_t offset, size_t limit) {
+			limit = (std::min)(limit, this->data.size());
+			if (offset >= limit) return this->Fail(), std::span<const uint8_t>();
+
+			size_t end = offset;
+			while (end + 1 < limit && (this->data[end] | this->data[end + 1]) != 0) end += 2;
+			return this->data.subspan(offset, end - offset);
+		}
+
+	private:
+		void Fail() { this->failed = true; }
+
+		std::span<const uint8_t> data;
+		bool failed = false;
+	};
+}
+
+static void appendUtf8(std::string& out, uint32_t codepoint) {
+	if (codepoint < 0x80) {
+		out.push_back((char)codepoint);
+	}
+	else if (codepoint < 0x800) {
+		out.push_back((char)(0xC0 | codepoint >> 6));
+		out.push_back((char)(0x80 | (codepoint & 0x3F)));
+	}
+	else if (codepoint < 0x10000) {
+		out.push_back((char)(0xE0 | codepoint >> 12));
+		out.push_back((char)(0x80 | (codepoint >> 6 & 0x3F)));
+		out.push_back((char)(0x80 | (codepoint & 0x3F)));
+	}
+	else {
+		out.push_back((char)(0xF0 | codepoint >> 18));
+		out.push_back((char)(0x80 | (codepoint >> 12 & 0x3F)));
+		out.push_back((char)(0x80 | (codepoint >> 6 & 0x3F)));
+		out.push_back((char)(0x80 | (codepoint & 0x3F)));
+	}
+}
+
+/// <summary>
+/// UTF-16LE to UTF-8, unpaired surrogates become U+FFFD
+/// </summary>
+static std::string utf16ToUtf8(std::span<const uint8_t> bytes) {
+	std::string out;
+	out.reserve(bytes.size() / 2);
+
+	for (size_t i = 0; i + 1 < bytes.size(); i += 2) {
+		uint32_t unit = bytes[i] | bytes[i + 1] << 8;
+		if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < bytes.size()) {
+			uint32_t low = bytes[i + 2] | bytes[i + 3] << 8;
+			if (low >= 0xDC00 && low < 0xE000) {
+				appendUtf8(out, 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+				i += 2;
+				continue;
+			}
+		}
+		appendUtf8(out, unit >= 0xD800 && unit < 0xE000 ? 0xFFFD : unit);
+	}
+	return out;
+}
+
+/// <summary>
+/// Strings in the system code page. On other systems, where there's no such thing,
+/// they are read as Latin-1, which is right for ASCII (nearly every path) and close for Windows-1252.
+/// </summary>
+static std::string ansiToUtf8(std::span<const uint8_t> bytes) {
+	if (bytes.empty()) return {};
+
+#ifdef _WIN32
+	int length = MultiByteToWideChar(CP_ACP, 0, (const char*)bytes.data(), (int)bytes.size(), nullptr, 0);
+	std::wstring wide(length, L'\0');
+	MultiByteToWideChar(CP_ACP, 0, (const char*)bytes.data(), (int)bytes.size(), wide.data(), length);
+	return utf16ToUtf8(std::span<const uint8_t>((const uint8_t*)wide.data(), wide.size() * sizeof(wchar_t)));
+#else
+	std::string out;
+	out.reserve(bytes.size());
+	for (uint8_t c : bytes)
+		appendUtf8(out, c);
+	return out;
+#endif
+}
+
+/// <summary>
+/// Target path from a LinkInfo structure, Unicode variants preferred
+/// </summary>
+static std::string parseLinkInfo(ByteReader& reader, size_t start, size_t size) {
+	size_t end = start + size;
+	uint32_t headerSize = reader.U32(start + 0x04);
+	uint32_t flags = reader.U32(start + 0x08);
+	uint32_t suffixOffset = reader.U32(start + 0x18);
+	bool hasUnicode = headerSize >= 0x24;
+
+	std::string suffix = hasUnicode && reader.U32(start + 0x20) != 0
+		? utf16ToUtf8(reader.Utf16Z(start + reader.U32(start + 0x20), end))
+		: ansiToUtf8(reader.AnsiZ(start + suffixOffset, end));
+
+	if (flags & kVolumeIDAndLocalBasePath) {
+		std::string base = hasUnicode && reader.U32(start + 0x1C) != 0
+			? utf16ToUtf8(reader.Utf16Z(start + reader.U32(start + 0x1C), end))
+			: ansiToUtf8(reader.AnsiZ(start + reader.U32(start + 0x10), end));
+		return base + suffix;
+	}
+
+	if (flags & kCommonNetworkRelativeLinkAndPathSuffix) {
+		size_t network = start + reader.U32(start + 0x14);
+		uint32_t networkSize = reader.U32(network);
+		if (networkSize < 0x14 || !reader.Has(network, networkSize) || network + networkSize > end) return {};
+
+		uint32_t nameOffset = reader.U32(network + 0x08);
+		std::string name = nameOffset > 0x14 && reader.U32(network + 0x14) != 0
+			? utf16ToUtf8(reader.Utf16Z(network + reader.U32(network + 0x14), network + networkSize))
+			: ansiToUtf8(reader.AnsiZ(network + nameOffset, network + networkSize));
+
+		if (suffix.empty()) return name;
+		return name + "\\" + suffix;
+	}
+
+	return {};
+}
+
+/// <summary>
+/// The string of an EnvironmentVariableDataBlock or IconEnvironmentDataBlock
+/// </summary>
+static std::string parseEnvironmentBlock(ByteReader& reader, size_t block) {
+	std::string unicode = utf16ToUtf8(reader.Utf16Z(block + 0x10C, block + kEnvironmentBlockSize));
+	if (!unicode.empty()) return unicode;
+	return ansiToUtf8(reader.AnsiZ(block + 0x08, block + 0x10C));
+}
+
+std::optional<ShellLink> IMS::ParseShellLink(std::span<const uint8_t> data) {
+	ByteReader reader(data);
+	if (reader.U32(0) != kHeaderSize || reader.Size() < kHeaderSize) return std::nullopt;
+	if (std::memcmp(reader.Bytes(0x04, sizeof(kLinkClsid)).data(), kLinkClsid, sizeof(kLinkClsid)) != 0) return std::nullopt;
+
+	ShellLink link;
+	uint32_t flags = reader.U32(0x14);
+	link.iconIndex = (int32_t)reader.U32(0x38);
+
+	size_t offset = kHeaderSize;
+
+	// Shell item ids, only needed for targets that aren't files (control panel, store apps)
+	if (flags & LinkFlags::HasLinkTargetIDList)
+		offset += 2 + (size_t)reader.U16(offset);
+
+	if (flags & LinkFlags::HasLinkInfo) {
+		uint32_t size = reader.U32(offset);
+		if (size < 0x1C || !reader.Has(offset, size)) return std::nullopt;
+		link.target = parseLinkInfo(reader, offset, size);
+		offset += size;
+	}
+
+	// Counted strings, in this order when present
+	auto countedString = [&](uint32_t flag) -> std::string {
+		if (!(flags & flag)) return {};
+
+		size_t count = reader.U16(offset);
+		size_t bytes = (flags & LinkFlags::IsUnicode) ? count * 2 : count;
+		std::span<const uint8_t> chars = reader.Bytes(offset + 2, bytes);
+		offset += 2 + bytes;
+		return (flags & LinkFlags::IsUnicode) ? utf16ToUtf8(chars) : ansiToUtf8(chars);
+	};
+	countedString(LinkFlags::HasName);
+	link.relativePath = countedString(LinkFlags::HasRelativePath);
+	link.workingDirectory = countedString(LinkFlags::HasWorkingDir);
+	link.arguments = countedString(LinkFlags::HasArguments);
+	link.iconLocation = countedString(LinkFlags::HasIconLocation);
+	if (reader.Failed()) return std::nullopt;
+
+	// Extra data blocks, until the terminal block (size < 4). A broken one just ends the list.
+	while (reader.Has(offset, 8)) {
+		uint32_t size = reader.U32(offset);
+		if (size < 8 || !reader.Has(offset, size)) break;
+
+		uint32_t signature = reader.U32(offset + 4);
+		if (size >= kEnvironmentBlockSize) {
+			// The unexpanded paths win, the ones above may point at the machine the link was made on
+			if (signature == kEnvironmentVariableDataBlock && (flags & LinkFlags::HasExpString)) {
+				std::string target = parseEnvironmentBlock(reader, offset);
+				if (!target.empty()) link.target = std::move(target);
+			}
+			else if (signature == kIconEnvironmentDataBlock && (flags & LinkFlags::HasExpIcon)) {
+				std::string icon = parseEnvironmentBlock(reader, offset);
+				if (!icon.empty()) link.iconLocation = std::move(icon);
+			}
+		}
+
+		offset += size;
+	}
+
+	return link;
+}
+
+std::optional<ShellLink> IMS::ReadShellLink(const std::filesystem::path& path) {
+	MappedFile file;
+	if (!file.Open(path)) return std::nullopt;
+
+	auto link = ParseShellLink(std::span<const uint8_t>(file.Data(), file.Size()));
+	if (!link) return std::nullopt;
+
+	link->target = ExpandEnvironmentVariables(link->target);
+	link->workingDirectory = ExpandEnvironmentVariables(link->workingDirectory);
+	link->iconLocation = ExpandEnvironmentVariables(link->iconLocation);
+
+	if (link->target.empty() && !link->relativePath.empty()) {
+		std::string relative = link->relativePath;
+		std::replace(relative.begin(), relative.end(), '\\', (char)std::filesystem::path::preferred_separator);
+
+		std::u8string utf8 = (path.parent_path() / std::filesystem::path(std::u8string(relative.begin(), relative.end()))).lexically_normal().u8string();
+		link->target.assign(utf8.begin(), utf8.end());
+	}
+
+	return link;
+}
+
+std::string IMS::ExpandEnvironmentVariables(std::string_view str) {
+	if (str.find('%') == std::string_view::npos) return std::string(str);
+
+	std::string out;
+	out.reserve(str.size());
+
+	size_t i = 0;
+	while (i < str.size()) {
+		size_t open = str.find('%', i);
+		size_t close = open == std::string_view::npos ? open : str.find('%', open + 1);
+		if (close == std::string_view::npos) break;
+
+		out.append(str.substr(i, open - i));
+		std::string name(str.substr(open + 1, close - open - 1));
+
+		std::optional<std::string> value;
+#ifdef _WIN32
+		std::wstring wide(name.begin(), name.end()); // Variable names are ASCII
+		DWORD length = name.empty() ? 0 : GetEnvironmentVariableW(wide.c_str(), nullptr, 0);
+		if (length > 0) {
+			std::wstring buffer(length, L'\0');
+			buffer.resize(GetEnvironmentVariableW(wide.c_str(), buffer.data(), length));
+			value = utf16ToUtf8(std::span<const uint8_t>((const uint8_t*)buffer.data(), buffer.size() * sizeof(wchar_t)));
+		}
+#else
+		if (const char* env = name.empty() ? nullptr : std::getenv(name.c_str())) value = env;
+#endif
+
+		if (value) {
+			out.append(*value);
+			i = close + 1;
+		}
+		else {
+			// Keep the text, the closing % may start the next variable
+			out.append(str.substr(open, close - open));
+			i = close;
+		}
+	}
+
+	out.append(str.substr(i));
+	return out;
+}
@@ -0,0 +1,146 @@
+#include "pch.h"
+
+#include "startup.h"
+
+using namespace IMS;
+
+StartupGraph::TaskId StartupGraph::Add(std::string name, std::function<bool()> work, std::vector<TaskId> dependencies, Affinity affinity) {
+	TaskId id = this->tasks.size();
+
+	Task task;
+	task.name = std::move(name);
+	task.work = std::move(work);
+	task.affinity = affinity;
+	this->tasks.push_back(std::move(task));
+
+	for (TaskId dependency : dependencies) {
+		if (dependency == kNone) continue;
+		if (dependency >= id) {
+			spdlog::error("Startup task {} depends on a later task, ignoring the dependency", this->tasks[id].name);
+			continue;
+		}
+
+		this->tasks[dependency].dependents.push_back(id);
+		this->tasks[id].waiting++;
+	}
+
+	return id;
+}
+
+bool StartupGraph::Run(size_t workers) {
+	if (this->ran) return false;
+	this->ran = true;
+	this->begin = std::chrono::steady_clock::now();
+
+	this->inlineOnly = workers == 0;
+
+	for (TaskId id = 0; id < this->tasks.size(); id++) {
+		Task& task = this->tasks[id];
+		task.timing.name = task.name; // Names don't move anymore
+
+		if (task.waiting == 0)
+			this->Ready(id);
+	}
+
+	std::vector<std::jthread> pool;
+	if (workers > 0) {
+		pool.reserve(workers);
+		for (size_t i = 0; i < workers; i++) {
+			pool.emplace_back([this, thread = (uint32_t)i + 1]() {
+				std::unique_lock lock(this->mutex);
+				for (;;) {
+					this->changed.wait(lock, [this]() { return !this->anyReady.empty() || this->finished == this->tasks.size(); });
+					if (this->anyReady.empty()) return;
+
+					TaskId id = this->anyReady.front();
+					this->anyReady.pop_front();
+					this->Execute(id, thread, lock);
+				}
+			});
+		}
+	}
+
+	{
+		std::unique_lock lock(this->mutex);
+		for (;;) {
+			this->changed.wait(lock, [this]() { return !this->mainReady.empty() || this->finished == this->tasks.size(); });
+			if (this->mainReady.empty()) break;
+
+			TaskId id = this->mainReady.front();
+			this->mainReady.pop_front();
+			this->Execute(id, 0, lock);
+		}
+	}
+
+	pool.clear();
+	this->total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->begin).count();
+
+	return std::all_of(this->tasks.begin(), this->tasks.end(), [](const Task& task) { return task.timing.status == Status::Done; });
+}
+
+void StartupGraph::Execute(TaskId id, uint32_t thread, std::unique_lock<std::mutex>& lock) {
+	Task& task = this->tasks[id];
+
+	lock.unlock();
+	auto start = std::chrono::steady_clock::now();
+	bool ok = task.work ? task.work() : true;
+	auto end = std::chrono::steady_clock::now();
+	lock.lock();
+
+	task.timing.start = std::chrono::duration<double, std::milli>(start - this->begin).count();
+	task.timing.duration = std::chrono::duration<double, std::milli>(end - start).count();
+	task.timing.thread = thread;
+	this->Finish(id, ok ? Status::Done : Status::Failed);
+	this->changed.notify_all();
+}
+
+void StartupGraph::Ready(TaskId id) {
+	// Without workers, everything goes through the main thread's queue
+	bool main = this->tasks[id].affinity == Affinity::Main || this->inlineOnly;
+	(main ? this->mainReady : this->anyReady).push_back(id);
+}
+
+void StartupGraph::Finish(TaskId id, Status status) {
+	Task& task = this->tasks[id];
+	task.timing.status = status;
+	this->finished++;
+
+	for (TaskId dependent : task.dependents) {
+		Task& next = this->tasks[dependent];
+		if (next.timing.status != Status::Pending) continue;
+
+		if (status != Status::Done) {
+			spdlog::warn("Skipping startup task {}, {} didn't finish", next.name, task.name);
+			this->Finish(dependent, Status::Skipped);
+		}
+		else if (--next.waiting == 0) {
+			this->Ready(dependent);
+		}
+	}
+}
+
+void StartupGraph::LogReport() const {
+	std::vector<const Timing*> order;
+	for (const Task& task : this->tasks)
+		order.push_back(&task.timing);
+	// Skipped tasks never started, they go last
+	std::stable_sort(order.begin(), order.end(), [](const Timing* a, const Timing* b) {
+		return std::make_pair(a->status == Status::Skipped, a->start) < std::make_pair(b->status == Status::Skipped, b->start);
+	});
+
+	double busy = 0;
+	for (const Timing* timing : order) {
+		static constexpr const char* statusNames[] = { "pending", "", "failed", "skipped" };
+		busy += timing->duration;
+
+		if (timing->status == Status::Skipped) {
+			spdlog::info("  {:<24} skipped", timing->name);
+			continue;
+		}
+
+		std::string thread = timing->thread == 0 ? std::string("main") : fmt::format("worker {}", timing->thread);
+		spdlog::info("  {:<24} {:8.2f} ms  at {:8.2f} ms  {:<9} {}", timing->name, timing->duration, timing->start, thread, statusNames[(size_t)timing->status]);
+	}
+
+	spdlog::info("Startup took {:.2f} ms for {:.2f} ms of work ({} tasks)", this->total, busy, this->tasks.size());
+}
@@ -2,212 +2,118 @@
 
 #include "taskbar.h"
 
-using namespace IMS;
-
-static Taskbar* g_Taskbar = nullptr;
+#include "async_log.h"
 
-extern LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
-
-#define SAFE_CLEANUP(x) if (x) { x->Release(); x = nullptr; }
+using namespace IMS;
 
-/// <summary>
-/// Check if a window is valid (wants to be shown, not a tool window, not invisible, etc)
-/// </summary>
-/// <param name="hWnd"></param>
-/// <returns>True if the window is valid</returns>
-static bool validateWindow(HWND hWnd) {
-	if (GetWindowLong(hWnd, GWL_EXSTYLE) & WS_EX_TOOLWINDOW) return false;
-	if (!IsWindowVisible(hWnd)) return false;
-	if (GetWindowLong(hWnd, GWLP_HWNDPARENT) != 0) return false;
-
-	if (g_Taskbar->windows.find(hWnd) != g_Taskbar->windows.end()) return false;
-
-	char name[256] = { 0 };
-	GetWindowTextA(hWnd, name, 256);
-	if (strstr(name, "ImSplorer") != nullptr || memcmp(name, "Start", 5) == 0)
-		return false;
+Taskbar::Taskbar(IPlatform& platform) : platform(platform) {
+	this->platform.SetHost(this);
+
+	// Shortcuts, fed by the platform's keyboard hook
+	this->hotkeys.SetKeyQuery(this->platform.KeyStateQuery());
+	this->hotkeys.OnWinTap([this]() {
+		this->showStartMenu = !this->showStartMenu;
+		this->scheduler.Invalidate();
+	});
+	// Hidden, only meant for tracking down lag. Samples are only recorded while the overlay is open
+	this->hotkeys.Register("Win+Ctrl+Shift+F12", [this]() {
+		this->showProfiler = !this->showProfiler;
+		Profiler::Get().SetEnabled(this->showProfiler);
+		this->scheduler.Invalidate();
+	});
+	// The Run dialog's shortcut opens the Start menu in Run mode
+	this->hotkeys.Register("Win+R", [this]() {
+		this->showStartMenu = true;
+		std::snprintf(this->searchBuffer, sizeof(this->searchBuffer), ">");
+		this->focusSearch = true;
+		this->scheduler.Invalidate();
+	});
+
+	// The clock shows seconds
+	this->scheduler.SetTickInterval(std::chrono::seconds(1));
+
+	this->appSearch.SetHistory(&this->launchHistory, &this->platform.Clock());
+}
 
-	return true;
+Taskbar::~Taskbar() {
+	this->platform.SetHost(nullptr);
 }
 
-void Taskbar::InitWindow() {
-	// Set window properties
-	this->title = title;
-	std::wstring titleW(title.begin(), title.end());
-
-	// Create window
-	this->wc.cbSize = sizeof(WNDCLASSEX);
-	this->wc.style = CS_CLASSDC;
-	this->wc.lpfnWndProc = WndProc;
-	this->wc.cbClsExtra = 0L;
-	this->wc.cbWndExtra = 0L;
-	this->wc.hInstance = GetModuleHandle(nullptr);
-	this->wc.hIcon = nullptr;
-	this->wc.hCursor = nullptr;
-	this->wc.hbrBackground = nullptr;
-	this->wc.lpszMenuName = nullptr;
-	this->wc.lpszClassName = L"ImSplorerTB";
-	this->wc.style = CS_DBLCLKS; // Double click messages
-	this->wc.hIconSm = nullptr;
-	RegisterClassEx(&this->wc);
-
-	DWORD dwStyle = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
-	DWORD dwExStyle = WS_EX_LEFT | WS_EX_LTRREADING | WS_EX_RIGHTSCROLLBAR |
-		WS_EX_TOPMOST | WS_EX_TOOLWINDOW;
-
-	int screenWidth = GetSystemMetrics(SM_CXSCREEN);
-	int screenHeight = GetSystemMetrics(SM_CYSCREEN);
-
-	RECT workArea = { 0 };
-	if (SystemParametersInfo(SPI_GETWORKAREA, 0, &workArea, 0)) {
-		int taskbarHeight = screenHeight - (workArea.bottom - workArea.top);
-		if (taskbarHeight != (float)this->tbHeight) {
-			spdlog::info("Taskbar height changed from {} to {}", this->tbHeight, this->tbHeight);
-			this->tbHeight = (float)taskbarHeight;
-		}
-	}
-	else {
-		spdlog::warn("SystemParametersInfo failed, can't calculate taskbar height");
-	}
-
-	this->hWnd = CreateWindowExW(
-		dwExStyle,
-		wc.lpszClassName,
-		titleW.c_str(),
-		dwStyle,
-		0, screenHeight - this->tbHeight, // X, Y position (bottom of screen)
-		screenWidth, this->tbHeight,        // Width, Height
-		nullptr,
-		nullptr,
-		wc.hInstance,
-		nullptr
-	);
-
-	// Check for errors
-	if (this->hWnd == nullptr) {
-		// Get error message
-		LPSTR messageBuffer = nullptr;
-		size_t size = FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr, GetLastError(), MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPSTR)&messageBuffer, 0, nullptr);
-		std::string message(messageBuffer, size);
-		LocalFree(messageBuffer);
-
-		spdlog::error("Failed to create window: {}", message);
+void Taskbar::AddStartupTasks(StartupGraph& graph, StartupGraph::TaskId shellReady, StartupGraph::TaskId uiReady) {
+	using Affinity = StartupGraph::Affinity;
 
-		return;
-	}
-
-	this->width = screenWidth;
-	this->height = this->tbHeight;
+	this->startupEpoch = graph.Epoch();
 
-	// Show window
-	ShowWindow(this->hWnd, SW_SHOWDEFAULT);
-	UpdateWindow(this->hWnd);
+	// Map the index persisted by the last run so the Start menu is ready right away, then bring it
+	// up to date in the background (only folders modified since get listed again). Without one,
+	// index up front. From then on the watcher applies changes as they happen, the watch starts
+	// first so nothing slips in between; without a watcher it's refreshed whenever the Start menu opens.
+	// Nothing else touches the index until startup is over.
+	graph.Add("Start menu index", [this]() {
+		this->appRoots = this->platform.AppRoots();
+		std::filesystem::path cacheDirectory = this->platform.CacheDirectory();
+		if (!cacheDirectory.empty())
+			this->appIndex.SetCachePath(cacheDirectory / "appindex.current");
 
-	this->isRunning = true;
-}
+		this->appWatcher.Watch(this->appRoots);
 
-void Taskbar::InitShell() const {
-	auto user32 = LoadLibrary(L"user32.dll");
-	if (user32) {
-		auto SetShellWindow = (BOOL(WINAPI*)(HWND))GetProcAddress(user32, "SetShellWindow");
-		SetShellWindow ? SetShellWindow(this->hWnd) : false;
-		auto SetTaskmanWindow = (BOOL(WINAPI*)(HWND))GetProcAddress(user32, "SetTaskmanWindow");
-		SetTaskmanWindow ? SetTaskmanWindow(this->hWnd) : false;
+		if (this->appIndex.Load())
+			this->appIndex.ScanAsync(this->appRoots, [this]() { this->OnAppsChanged(); });
+		else
+			this->appIndex.Scan(this->appRoots);
+		return true;
+	});
 
-		if (!SetShellWindow || !SetTaskmanWindow)
-			spdlog::error("SetShellWindow/SetTaskmanTaskbar not found or failed");
-	}
-	else {
-		spdlog::error("user32.dll not found");
-	}
+	// Read next to the index, only the flusher writes to it afterwards
+	graph.Add("Launch history", [this]() {
+		std::filesystem::path cacheDirectory = this->platform.CacheDirectory();
+		if (!cacheDirectory.empty())
+			this->launchHistory.Load(cacheDirectory / "launches.bin");
+		return true;
+	});
 
-	if (!RegisterShellHookWindow(this->hWnd)) {
-		spdlog::error("RegisterShellHookTaskbar failed");
-	}
-}
+	// Executables on PATH for the Run mode, indexed in the background so it never holds up the first frame
+	graph.Add("Command index", [this]() {
+		this->commandIndex.RefreshAsync(this->platform.CommandPaths(), [this]() { this->OnAppsChanged(); });
+		return true;
+	});
+
+	// Filter the windows on a worker, then fill in the windows map so the process lookups
+	// run on the metadata worker while the device is still being created
+	auto enumeration = graph.Add("Window enumeration", [this]() {
+		this->platform.EnumerateWindows([this](WindowHandle handle) {
+			if (this->platform.IsTaskbarWindow(handle))
+				this->startupWindows.push_back(handle);
+		});
+		return true;
+	}, { shellReady });
 
-void Taskbar::InitD3D() {
-	// Before creating the device, we need to create the window
-	if (!this->hWnd) {
-		spdlog::error("Failed to create window");
-		return;
-	}
+	graph.Add("Windows", [this]() {
+		for (WindowHandle handle : this->startupWindows) {
+			if (this->recorder) this->recorder->Existing(handle);
+			this->AddWindow(handle);
+		}
+		this->startupWindows = {};
+		return true;
+	}, { enumeration }, Affinity::Main);
 
-	// Create DX11
-	DXGI_SWAP_CHAIN_DESC scd = { 0 };
-	scd.BufferDesc.Width = this->width;
-	scd.BufferDesc.Height = this->height;
-	scd.BufferDesc.RefreshRate.Numerator = 60;
-	scd.BufferDesc.RefreshRate.Denominator = 1;
-	scd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	scd.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;
-	scd.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;
-	scd.SampleDesc.Count = 1;
-	scd.SampleDesc.Quality = 0;
-	scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	scd.BufferCount = 1;
-	scd.OutputWindow = this->hWnd;
-	scd.Windowed = TRUE;
-	scd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
-	scd.Flags = 0;
-
-#ifdef _DEBUG
-	UINT createDeviceFlags = D3D11_CREATE_DEVICE_DEBUG;
-#else
-	UINT createDeviceFlags = 0;
-#endif
-
-	D3D_FEATURE_LEVEL featureLevel;
-	HRESULT res = D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, createDeviceFlags, nullptr, 0, D3D11_SDK_VERSION, &scd, &this->swapChain, &this->device, &featureLevel, &this->deviceContext);
-
-	if (FAILED(res)) {
-		// Format error message
-		LPSTR messageBuffer = nullptr;
-		size_t size = FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr, res, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPSTR)&messageBuffer, 0, nullptr);
-		std::string message(messageBuffer, size);
-		LocalFree(messageBuffer);
-
-		std::ofstream file("error.txt");
-		file << message;
-		file.close();
-	}
-
-	ID3D11Texture2D* pBackBuffer;
-	this->swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&pBackBuffer);
-	this->device->CreateRenderTargetView(pBackBuffer, nullptr, &this->renderTargetView);
-	pBackBuffer->Release();
+	graph.Add("Style", [this]() { this->ApplyStyle(); return true; }, { uiReady }, Affinity::Main);
 }
 
-void Taskbar::InitImGui() {
-	// Create ImGui
-	IMGUI_CHECKVERSION();
-	this->imguiContext = ImGui::CreateContext();
-	this->imguiIO = &ImGui::GetIO();
-	this->imguiStyle = &ImGui::GetStyle();
-
-	// Set ImGui io
-	this->imguiIO->ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
-	this->imguiIO->ConfigFlags |= ImGuiConfigFlags_DockingEnable;
-	this->imguiIO->ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
-	this->imguiIO->IniFilename = nullptr;
-
-	ImGui_ImplWin32_Init(this->hWnd);
-	ImGui_ImplDX11_Init(this->device, this->deviceContext);
+bool Taskbar::Init() {
+	StartupGraph graph;
+	this->AddStartupTasks(graph, StartupGraph::kNone, StartupGraph::kNone);
+	return graph.Run(0);
+}
 
+void Taskbar::ApplyStyle() {
 	// Set ImGui style
+	this->imguiStyle = &ImGui::GetStyle();
 	ImGui::StyleColorsDark();
 	this->imguiStyle->WindowRounding = 0.0f;
-    this->imguiStyle->Colors[ImGuiCol_WindowBg].w = 1.0f;
+	this->imguiStyle->Colors[ImGuiCol_WindowBg].w = 1.0f;
 	this->imguiStyle->FrameRounding = 4.0f;
 
-	// Load font (C:\Taskbars\Fonts\segoeui.ttf)
-	ImFontConfig fontConfig;
-	fontConfig.OversampleH = 1;
-	fontConfig.OversampleV = 1;
-	fontConfig.PixelSnapH = true;
-	this->imguiIO->Fonts->AddFontFromFileTTF("C:\\Windows\\Fonts\\segoeui.ttf", 16.0f, &fontConfig);
-	this->imguiIO->Fonts->Build();
-
 	// set all hue values to 0
 	for (int i = 0; i < ImGuiCol_COUNT; i++) {
 		ImVec4& col = this->imguiStyle->Colors[i];
@@ -218,354 +124,801 @@ void Taskbar::InitImGui() {
 	}
 }
 
-Taskbar::Taskbar(const std::string& title) {
-	g_Taskbar = this;
-
-	this->InitWindow();
-	this->InitShell();
-	this->InitD3D();
-	this->InitImGui();
-
-	// Fill in the windows map
-	EnumWindows([](HWND hWnd, LPARAM lParam) -> BOOL {
-		Taskbar* taskbar = (Taskbar*)lParam;
+/// <summary>
+/// Add a placeholder for the window and have the worker resolve the rest
+/// </summary>
+void Taskbar::AddWindow(WindowHandle handle) {
+	// Validate (not a tool window, not invisible, not already there)
+	if (this->windows.Contains(handle) || !this->platform.IsTaskbarWindow(handle)) return;
 
-		DWORD processId;
-		GetWindowThreadProcessId(hWnd, &processId);
-		HANDLE iterProc = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, processId);
-		if (!iterProc) return TRUE;
-		char exePath[MAX_PATH];
-		GetModuleFileNameExA(iterProc, nullptr, exePath, MAX_PATH);
-		CloseHandle(iterProc);
+	this->windows.Insert(handle);
+	this->windowWorker.Request(handle);
+	this->groupsDirty = true;
+}
 
-		// Validate (not a tool window, not us, not invisible)
-		if (!validateWindow(hWnd)) return TRUE;
+void Taskbar::RemoveWindow(WindowHandle handle) {
+	Window* window = this->windows.Find(handle);
+	if (!window) return;
 
-		std::string exeFileName = std::filesystem::path(exePath).filename().string();
-		taskbar->windows[hWnd] = { exeFileName, false };
-		}, (LPARAM)this);
+	if (window->resolved)
+		this->processCache.Release(window->process);
+	this->windows.Erase(handle);
+	this->groupsDirty = true;
+}
 
-	// Set the hook
-	this->kbdHook = SetWindowsHookEx(WH_KEYBOARD_LL, KeyboardProc, GetModuleHandle(nullptr), 0);
+/// <summary>
+/// Called from the index worker or the watcher thread
+/// </summary>
+void Taskbar::OnAppsChanged() {
+	this->appsChanged = true;
+	this->platform.Events().Wake();
 }
 
-Taskbar::~Taskbar() {
-	// Destroy ImGui
-	ImGui_ImplDX11_Shutdown();
-	ImGui_ImplWin32_Shutdown();
-	ImGui::DestroyContext(this->imguiContext);
-
-	// Destroy DX11
-	this->renderTargetView->Release();
-	this->swapChain->Release();
-	this->deviceContext->Release();
-	this->device->Release();
-
-	// Destroy window
-	DestroyWindow(this->hWnd);
-	UnregisterClass(this->wc.lpszClassName, this->wc.hInstance);
-
-	// Unhook
-	UnhookWindowsHookEx(this->kbdHook);
+/// <summary>
+/// PATH may have been edited, index it again
+/// </summary>
+void Taskbar::OnEnvironmentChanged() {
+	this->commandIndex.RefreshAsync(this->platform.CommandPaths(), [this]() { this->OnAppsChanged(); });
 }
 
 void Taskbar::Run() {
-	MSG msg = { 0 };
 	while (this->isRunning) {
-		if (PeekMessage(&msg, nullptr, 0U, 0U, PM_REMOVE)) {
-			TranslateMessage(&msg);
-			DispatchMessage(&msg);
+		// Sleep until there's a message or a frame is due
+		this->scheduler.WaitForWork();
 
-			if (msg.message == WM_QUIT) {
-				spdlog::info("WM_QUIT received, stopping taskbar");
-				this->isRunning = false;
-			}
-		}
+		AllocationStats before = ThreadAllocations();
 
-		if (!this->isRunning)
+		if (!this->Update())
 			break;
 
-		if (this->occluded && this->swapChain->Present(0, DXGI_PRESENT_TEST) == DXGI_STATUS_OCCLUDED) {
-			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		if (!this->scheduler.BeginFrame())
+			continue;
+
+		if (!this->platform.BeginFrame()) {
+			// Occluded, check back later
+			this->scheduler.Postpone(std::chrono::milliseconds(100));
 			continue;
 		}
 
-		this->occluded = false;
+		// Everything from here to Present, skipped iterations don't count as frames
+		IMS_PROFILE_SCOPE(Frame);
 
-		if (this->resizeWidth != 0 && this->resizeHeight != 0) {
-			SAFE_CLEANUP(this->renderTargetView);
+		this->BuildFrame();
+		this->platform.EndFrame();
+		this->frameAllocations = ThreadAllocations() - before;
 
-			this->swapChain->ResizeBuffers(0, this->resizeWidth, this->resizeHeight, DXGI_FORMAT_UNKNOWN, 0);
+		if (this->startupEpoch) {
+			spdlog::info("First frame after {:.2f} ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - *this->startupEpoch).count());
+			this->startupEpoch.reset();
+		}
+	}
+}
+
+bool Taskbar::Update() {
+	{
+		IMS_PROFILE_SCOPE(MessagePump);
+		if (!this->platform.PumpEvents()) {
+			this->isRunning = false;
+			return false;
+		}
+	}
 
-			ID3D11Texture2D* pBackBuffer;
-			this->swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&pBackBuffer);
-			this->device->CreateRenderTargetView(pBackBuffer, nullptr, &this->renderTargetView);
-			pBackBuffer->Release();
+	this->ApplyShellEvents();
 
-			this->width = this->resizeWidth;
-			this->height = this->resizeHeight;
-			this->resizeWidth = 0; this->resizeHeight = 0;
+	// Fill in placeholders with whatever the metadata worker resolved since the last frame
+	size_t resolved = this->windowWorker.Drain([this](WindowInfo& info) {
+		Window* window = this->windows.Find(info.handle);
+		if (!window || window->resolved) {
+			// Destroyed (or already resolved) while it was being resolved
+			if (info.valid) this->processCache.Release(info.process);
+			return;
 		}
 
-		// Render
-		static ImVec4 clear_color = ImVec4(0.0f, 0.0f, 0.0f, 1.00f);
-		this->deviceContext->ClearRenderTargetView(this->renderTargetView, (float*)&clear_color);
+		if (!info.valid) {
+			this->windows.Erase(info.handle);
+			return;
+		}
 
-		// ImGui
-		ImGui_ImplDX11_NewFrame();
-		ImGui_ImplWin32_NewFrame();
-		ImGui::NewFrame();
+		window->process = info.process;
+		window->exePath = info.exePath;
+		window->exe = info.exe;
+		window->title = std::move(info.title);
+		window->resolved = true;
 
-		float screenWidth = (float)GetSystemMetrics(SM_CXSCREEN);
-		float screenHeight = (float)GetSystemMetrics(SM_CYSCREEN);
+		if (this->recorder) this->recorder->Window(info.handle, this->processCache.String(window->exePath), this->processCache.String(window->exe), window->title);
+	});
 
-		{
-			ImGui::SetNextWindowPos(ImVec2(0, screenHeight - this->height));
-			ImGui::SetNextWindowSize(ImVec2(this->width, this->height));
-			ImGui::SetNextWindowViewport(ImGui::GetMainViewport()->ID);
-			ImGui::Begin("IMSplorer", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoNavFocus | ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoNav);
+	if (resolved > 0) {
+		this->groupsDirty = true;
+		this->scheduler.Invalidate();
+	}
 
-			float windowPadding = ImGui::GetStyle().WindowPadding.y * 2;
-			//float width = ImGui::CalcTextSize("Start").x + windowPadding;
-			if (ImGui::Button(" ", ImVec2(this->tbHeight - windowPadding, this->tbHeight - windowPadding))) {
-				this->showStartMenu = !this->showStartMenu;
-			}
+	// Icons extracted since the last frame go into the atlas
+	if (this->icons.Upload() > 0)
+		this->scheduler.Invalidate();
 
-			ImGui::SameLine();
-
-			const auto end = this->windows.end();
-			for (auto it = this->windows.begin(); it != end; ++it) {
-				ImGui::PushID(reinterpret_cast<void*>(it->first));
-
-				if (!it->second.isFocused)
-					ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.2f, 0.2f, 0.2f, 1.0f));
-
-				float width = ImGui::CalcTextSize(it->second.exe.c_str()).x + windowPadding;
-				if (ImGui::Button(it->second.exe.c_str(), ImVec2(width, this->tbHeight - windowPadding))) {
-					HWND hWnd = it->first;
-
-					if (!it->second.isFocused) {
-						AllowSetForegroundWindow(ASFW_ANY);
-						SetForegroundWindow(hWnd);
-						if (IsIconic(hWnd)) ShowWindow(hWnd, SW_RESTORE);
-					}
-					else {
-						AllowSetForegroundWindow(ASFW_ANY);
-						SetForegroundWindow(hWnd);
-						ShowWindow(hWnd, SW_MINIMIZE);
-					}
-				}
+	// New usage figures only matter if they're on screen
+	if (this->resources.Update() && this->usageShown)
+		this->scheduler.Invalidate();
 
-				if (ImGui::IsItemHovered()) {
-					ImGui::BeginTooltip();
-					char title[256] = { 0 };
-					GetWindowTextA(it->first, title, 256);
-					ImGui::Text(title);
-					ImGui::EndTooltip();
-				}
+	// Redraw with the new Start menu index
+	if (this->appsChanged.exchange(false) && this->showStartMenu)
+		this->scheduler.Invalidate();
 
-				if (!it->second.isFocused)
-					ImGui::PopStyleColor();
+	return true;
+}
 
-				if (ImGui::BeginPopupContextWindow()) {
-					if (ImGui::MenuItem("Close")) {
-						PostMessage(it->first, WM_CLOSE, 0, 0);
-					}
-					ImGui::EndPopup();
-				}
+void Taskbar::BuildFrame() {
+	if (this->recorder) this->recorder->Input(this->platform.ScreenSize(), this->platform.TaskbarHeight());
+
+	this->usageShown = false;
+	this->BuildTaskbar();
+	this->BuildStartMenu();
+
+	// Keep the text cursor blinking while typing
+	if (ImGui::GetIO().WantTextInput)
+		this->scheduler.RequestFrameIn(std::chrono::milliseconds(400));
+
+	if (this->showProfiler) {
+		Profiler::Get().DrawOverlay(&this->showProfiler, [this]() {
+			ImGui::Text("Shell events: %llu received, %llu applied", (unsigned long long)this->shellEvents.Received(), (unsigned long long)this->shellEvents.Applied());
+			ImGui::Text("Process cache: %zu entries, %llu hits, %llu misses", this->processCache.Size(), (unsigned long long)this->processCache.Hits(), (unsigned long long)this->processCache.Misses());
+			ImGui::Text("Frames rendered: %llu, wakeups: %llu", (unsigned long long)this->scheduler.FramesRendered(), (unsigned long long)this->scheduler.Wakeups());
+			ImGui::Text("Icons: %zu known, %zu in the atlas, %llu evicted", this->icons.Size(), this->icons.Resident(), (unsigned long long)this->icons.Evictions());
+			ImGui::Text("Text widths: %llu cached, %llu measured", (unsigned long long)this->textWidths.Hits(), (unsigned long long)this->textWidths.Misses());
+			if (AllocationCountersEnabled())
+				ImGui::Text("Heap: %llu allocations (%llu bytes) last frame, %llu in total", (unsigned long long)this->frameAllocations.count, (unsigned long long)this->frameAllocations.bytes, (unsigned long long)TotalAllocations().count);
+			auto commands = this->commandIndex.Snapshot();
+			ImGui::Text("Commands: %zu indexed, %zu trie nodes (%zu bytes)", commands->Size(), commands->Trie().NodeCount(), commands->Trie().MemoryUsage());
+			ImGui::Text("Resources: %zu processes, sampled every %lld ms at %.3f%% of a core", this->resources.Latest().processes.size(), (long long)this->resources.Interval().count(), this->resources.Cost() * 100);
+			ImGui::Text("Launch history: %zu apps, %llu compactions", this->launchHistory.Size(), (unsigned long long)this->launchHistory.Compactions());
+			ImGui::Text("Frame arena: %zu of %zu bytes, %llu overflows", this->frameArena.Used(), this->frameArena.Capacity(), (unsigned long long)this->frameArena.Overflows());
+		});
+
+		// Closed from its title bar
+		if (!this->showProfiler)
+			Profiler::Get().SetEnabled(false);
+	}
 
-				if (it != end)
-					ImGui::SameLine();
+	// ImGui copied whatever it was handed
+	this->frameArena.Reset();
 
-				ImGui::PopID();
-			}
+	if (this->recorder) this->recorder->Frame();
+}
 
-			float windowWidth = ImGui::GetWindowContentRegionMax().x - this->imguiStyle->WindowPadding.x;
-			auto now = std::chrono::system_clock::now();
-			time_t now_t = std::chrono::system_clock::to_time_t(now);
-			std::string time = fmt::format("{:%H:%M:%S}", fmt::localtime(now_t));
-			std::string date = fmt::format("{:%A, %B %d, %Y}", fmt::localtime(now_t));
-
-			float timeWidth = ImGui::CalcTextSize(time.c_str()).x;
-			float dateWidth = ImGui::CalcTextSize(date.c_str()).x;
-			ImGui::SameLine(windowWidth - max(timeWidth, dateWidth));
-			ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 0));
-			ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
-			ImGui::BeginChild("Clock");
-			ImGui::Text(date.c_str());
-			ImGui::SetCursorPosX(dateWidth - timeWidth);
-			ImGui::Text(time.c_str());
-			ImGui::EndChild();
-			ImGui::PopStyleVar(2);
-
-			ImGui::End();
-		}
+/// <summary>
+/// Format the clock into its buffers, only when the second on display changed
+/// </summary>
+void Taskbar::UpdateClock() {
+	time_t now = std::chrono::system_clock::to_time_t(this->platform.Clock().WallNow());
+	if (now == this->clockSecond) return;
+	this->clockSecond = now;
+
+	std::tm local = fmt::localtime(now);
+	auto time = fmt::format_to_n(this->clockTime, sizeof(this->clockTime) - 1, "{:%H:%M:%S}", local);
+	*time.out = '\0';
+	auto date = fmt::format_to_n(this->clockDate, sizeof(this->clockDate) - 1, "{:%A, %B %d, %Y}", local);
+	*date.out = '\0';
+}
 
-		{
-			if (!this->showStartMenu) goto RENDER;
-
-			static constexpr float startMenuWidth = 400;
-			static constexpr float startMenuHeight = 400;
-			ImGui::SetNextWindowPos(ImVec2(0, screenHeight - startMenuHeight - this->tbHeight));
-			ImGui::SetNextWindowSize(ImVec2(400, 400));
-			ImGui::Begin("Start", &this->showStartMenu, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoNavFocus | ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoNav);
-
-			static char buffer[256] = { 0 };
-			ImGui::SetNextItemWidth(ImGui::GetWindowContentRegionMax().x - this->imguiStyle->WindowPadding.x);
-			ImGui::InputText("##Search", buffer, IM_ARRAYSIZE(buffer));
-
-			// Go through C:\ProgramData\Microsoft\Windows\Start Menu\Programs
-			// TODO: This code is extremely slow and inefficient, fix it
-			ImGui::BeginChild("##Display", ImVec2(0, 0), false);
-			for (auto& file : std::filesystem::recursive_directory_iterator("C:\\ProgramData\\Microsoft\\Windows\\Start Menu\\")) {
-				if (file.is_directory() || file.path().extension() != ".lnk") continue;
-
-				std::string fileName = file.path().filename().string();
-				std::string jsFileName = fileName.substr(0, fileName.find(".lnk"));
-
-				// Check if the file name contains the search query (case insensitive)
-				std::string searchQuery = buffer;
-				std::transform(searchQuery.begin(), searchQuery.end(), searchQuery.begin(), ::tolower);
-				std::string jsFileNameLower = jsFileName;
-				std::transform(jsFileNameLower.begin(), jsFileNameLower.end(), jsFileNameLower.begin(), ::tolower);
-				if (searchQuery != "" && jsFileNameLower.find(searchQuery) == std::string::npos) continue;
-
-				float windowWidth = ImGui::GetWindowContentRegionMax().x - this->imguiStyle->WindowPadding.x;
-				if (ImGui::Button(jsFileName.c_str(), ImVec2(windowWidth, this->tbHeight))) {
-					ShellExecuteA(nullptr, "open", file.path().string().c_str(), nullptr, nullptr, SW_SHOWNORMAL);
-				}
-			}
-			ImGui::EndChild();
+void Taskbar::BuildTaskbar() {
+	IMS_PROFILE_SCOPE(TaskbarBuild);
 
-			ImGui::End();
-		}
+	ImVec2 screen = this->platform.ScreenSize();
+	ImVec2 size = this->platform.WindowSize();
+	float tbHeight = this->platform.TaskbarHeight();
+
+	ImGui::SetNextWindowPos(ImVec2(0, screen.y - size.y));
+	ImGui::SetNextWindowSize(size);
+	ImGui::SetNextWindowViewport(ImGui::GetMainViewport()->ID);
+	ImGui::Begin("IMSplorer", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoNavFocus | ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoNav);
 
-	RENDER:
+	// Labels are measured once per font, not once per frame
+	this->textWidths.Validate();
 
-		ImGui::Render();
-		this->deviceContext->OMSetRenderTargets(1, &this->renderTargetView, nullptr);
-		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	float windowPadding = ImGui::GetStyle().WindowPadding.y * 2;
+	//float width = ImGui::CalcTextSize("Start").x + windowPadding;
+	if (ImGui::Button(" ", ImVec2(tbHeight - windowPadding, tbHeight - windowPadding))) {
+		this->showStartMenu = !this->showStartMenu;
+	}
 
-		if (this->imguiIO->ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
-			ImGui::UpdatePlatformWindows();
-			ImGui::RenderPlatformWindowsDefault();
+	ImGui::SameLine();
+
+	// The clock is laid out first, the window strip gets the room left between it and the Start button
+	float windowWidth = ImGui::GetWindowContentRegionMax().x - this->imguiStyle->WindowPadding.x;
+	this->UpdateClock();
+
+	float timeWidth = this->textWidths.Width(this->clockTimeText, this->clockTime);
+	float dateWidth = this->textWidths.Width(this->clockDateText, this->clockDate);
+	float clockX = windowWidth - (std::max)(timeWidth, dateWidth);
+
+	float spacing = ImGui::GetStyle().ItemSpacing.x;
+	float overflowWidth = tbHeight - windowPadding;
+	float stripEnd = clockX - spacing;
+
+	// Icons go to their own channel, so they end up in one draw call instead of alternating with the font atlas
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->ChannelsSplit(2);
+
+	// Buttons are measured and submitted until the strip is full, whatever doesn't fit
+	// goes behind the overflow button without being measured at all
+	size_t shown = 0;
+	size_t count = 0;
+	if (this->groupByApp) {
+		this->RebuildGroups();
+		count = this->groups.size();
+		for (const AppGroup& group : this->groups) {
+			float reserve = shown + 1 == count ? 0.0f : spacing + overflowWidth;
+			if (!this->BuildTaskButton(group.windows, stripEnd - reserve))
+				break;
+			shown++;
+		}
+	}
+	else {
+		count = this->windows.Size();
+		for (auto& record : this->windows) {
+			float reserve = shown + 1 == count ? 0.0f : spacing + overflowWidth;
+			if (!this->BuildTaskButton(std::span<const WindowHandle>(&record.handle, 1), stripEnd - reserve))
+				break;
+			shown++;
 		}
+	}
+
+	drawList->ChannelsMerge();
+
+	if (shown < count)
+		this->BuildOverflow(shown, overflowWidth);
 
-		// Swap buffers
-		if (this->swapChain->Present(1, 0) == DXGI_STATUS_OCCLUDED)
-			this->occluded = true;
+	// Right click on the empty part of the strip
+	if (ImGui::BeginPopupContextWindow("Taskbar", ImGuiPopupFlags_MouseButtonRight | ImGuiPopupFlags_NoOpenOverItems)) {
+		if (ImGui::MenuItem("Group by application", nullptr, &this->groupByApp))
+			this->scheduler.Invalidate();
+		if (ImGui::MenuItem("Tint by CPU usage", nullptr, &this->showUsageTint))
+			this->scheduler.Invalidate();
+		ImGui::EndPopup();
 	}
+
+	ImGui::SameLine(clockX);
+	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 0));
+	ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
+	ImGui::BeginChild("Clock");
+	ImGui::TextUnformatted(this->clockDate);
+	ImGui::SetCursorPosX(dateWidth - timeWidth);
+	ImGui::TextUnformatted(this->clockTime);
+	ImGui::EndChild();
+	ImGui::PopStyleVar(2);
+
+	ImGui::End();
 }
 
-LRESULT WINAPI Taskbar::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
-	//RegisterTaskbarMessageW(TEXT("SHELLHOOK"));
+/// <summary>
+/// One button on the strip: a window, or with grouping every window of an application (with a count badge
+/// and a picker). Windows in a group share an exe, so the first one stands for the label and the icon.
+/// </summary>
+/// <returns>False if it doesn't fit before `stripEnd`, nothing is submitted then</returns>
+bool Taskbar::BuildTaskButton(std::span<const WindowHandle> handles, float stripEnd) {
+	WindowHandle handle = handles.front();
+	const Window& window = *this->windows.Find(handle);
+
+	float tbHeight = this->platform.TaskbarHeight();
+	float windowPadding = ImGui::GetStyle().WindowPadding.y * 2;
+	float iconSize = (float)this->icons.IconSize();
+
+	const char* label = "...";
+	float labelWidth = this->textWidths.Width(this->placeholderText, label);
+	if (window.resolved) {
+		label = this->processCache.CStr(window.exe);
+		labelWidth = this->textWidths.Width(window.exe, this->processCache.String(window.exe));
+	}
+	const IconCache::Icon* icon = window.resolved ? this->icons.Get(this->processCache.String(window.exePath)) : nullptr;
+
+	// Room for the count in front of the label
+	const char* badge = "";
+	float badgeWidth = 0;
+	if (handles.size() > 1) {
+		badge = this->frameArena.Format("{}", handles.size());
+		badgeWidth = ImGui::CalcTextSize(badge).x + ImGui::GetStyle().ItemInnerSpacing.x;
+	}
 
-	if (ImGui_ImplWin32_WndProcHandler(hWnd, msg, wParam, lParam))
-		return true;
+	// The label is pushed right, the icon sits in front of it
+	float iconSpace = icon ? iconSize + ImGui::GetStyle().ItemInnerSpacing.x : 0.0f;
+	float width = labelWidth + windowPadding + iconSpace + badgeWidth;
+	if (ImGui::GetCursorPosX() + width > stripEnd)
+		return false;
 
-	switch (msg) {
-	case WM_SIZE:
-		if (wParam == SIZE_MINIMIZED)
-			return 0;
+	WindowHandle focused = this->windows.Focused();
+	bool isFocused = std::find(handles.begin(), handles.end(), focused) != handles.end();
 
-		g_Taskbar->resizeWidth = (UINT)LOWORD(lParam); // Queue resize
-		g_Taskbar->resizeHeight = (UINT)HIWORD(lParam);
+	// Summed up for the tint, otherwise only for the tooltip
+	ProcessUsage usage;
+	bool hasUsage = this->showUsageTint && this->GroupUsage(handles, usage);
 
-		return 0;
+	ImGui::PushID(reinterpret_cast<void*>(handle));
 
-	case WM_SYSCOMMAND:
-		if ((wParam & 0xfff0) == SC_KEYMENU) // Disable ALT application menu
-			return 0;
+	// Warmer the more of a core the processes keep busy, fully red at one core
+	ImVec4 color = isFocused ? ImGui::GetStyleColorVec4(ImGuiCol_Button) : ImVec4(0.2f, 0.2f, 0.2f, 1.0f);
+	if (hasUsage) {
+		const ImVec4 hot(0.75f, 0.15f, 0.1f, 1.0f);
+		float heat = std::clamp(usage.cpu, 0.0f, 1.0f);
+		color = ImVec4(color.x + (hot.x - color.x) * heat, color.y + (hot.y - color.y) * heat, color.z + (hot.z - color.z) * heat, color.w);
+		this->usageShown = true;
+	}
+	ImGui::PushStyleColor(ImGuiCol_Button, color);
+
+	ImGui::PushStyleVar(ImGuiStyleVar_ButtonTextAlign, ImVec2(icon || badgeWidth > 0 ? 1.0f : 0.5f, 0.5f));
+	if (ImGui::Button(label, ImVec2(width, tbHeight - windowPadding))) {
+		if (handles.size() > 1)
+			ImGui::OpenPopup("Windows");
+		else if (!isFocused)
+			this->platform.ActivateWindow(handle);
+		else
+			this->platform.MinimizeWindow(handle);
+	}
+	ImGui::PopStyleVar();
+	ImGui::PopStyleColor();
+
+	ImVec2 min = ImGui::GetItemRectMin();
+	float height = ImGui::GetItemRectSize().y;
+	float x = min.x + ImGui::GetStyle().FramePadding.x;
+	if (icon) {
+		this->DrawIcon(*icon, ImVec2(x, min.y + (height - iconSize) * 0.5f), iconSize);
+		x += iconSpace;
+	}
+	if (badgeWidth > 0)
+		ImGui::GetWindowDrawList()->AddText(ImVec2(x, min.y + (height - ImGui::GetFontSize()) * 0.5f), ImGui::GetColorU32(ImGuiCol_TextDisabled), badge);
+
+	if (ImGui::IsItemHovered()) {
+		ImGui::BeginTooltip();
+		if (handles.size() > 1)
+			ImGui::Text("%s, %zu windows", label, handles.size());
+		else
+			ImGui::TextUnformatted(window.title.c_str());
+		if (hasUsage || this->GroupUsage(handles, usage)) {
+			// Of the whole machine, like Task Manager
+			ImGui::TextDisabled("CPU %.1f%%, memory %.1f MB", usage.cpu * 100.0f / (float)this->resources.Latest().cores, (double)usage.workingSet / (1024.0 * 1024.0));
+			this->usageShown = true;
+		}
+		ImGui::EndTooltip();
+	}
 
-		break;
+	if (ImGui::BeginPopupContextItem()) {
+		if (ImGui::MenuItem(handles.size() > 1 ? "Close all" : "Close")) {
+			for (WindowHandle target : handles)
+				this->platform.CloseWindow(target);
+		}
+		ImGui::EndPopup();
+	}
 
-	case WM_DESTROY:
-		PostQuitMessage(0);
-		return 0;
+	// Picker for the windows of a group, above the button
+	ImGui::SetNextWindowPos(ImVec2(min.x, min.y - ImGui::GetStyle().WindowPadding.y), ImGuiCond_Always, ImVec2(0.0f, 1.0f));
+	ImGui::SetNextWindowSizeConstraints(ImVec2(240, 0), ImVec2(480, 400));
+	if (ImGui::BeginPopup("Windows")) {
+		this->BuildWindowList(handles);
+		ImGui::EndPopup();
+	}
 
-	default:
-		if (msg == RegisterWindowMessage(TEXT("SHELLHOOK"))) {
-			if (wParam == HSHELL_WINDOWDESTROYED) {
-				auto it = g_Taskbar->windows.find((HWND)lParam);
-				if (it != g_Taskbar->windows.end()) {
-					g_Taskbar->windows.erase(it);
-				}
+	ImGui::SameLine();
+	ImGui::PopID();
+	return true;
+}
 
-				return 0;
+/// <summary>
+/// Clipped list of windows by title (in a popup), picking one activates it
+/// </summary>
+void Taskbar::BuildWindowList(std::span<const WindowHandle> handles) {
+	WindowHandle focused = this->windows.Focused();
+
+	ImGuiListClipper clipper;
+	clipper.Begin((int)handles.size());
+	while (clipper.Step()) {
+		for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+			WindowHandle handle = handles[row];
+			const Window* window = this->windows.Find(handle);
+			if (!window) continue;
+
+			ImGui::PushID(reinterpret_cast<void*>(handle));
+			const char* name = window->title.empty() ? (window->resolved ? this->processCache.CStr(window->exe) : "...") : window->title.c_str();
+			if (ImGui::Selectable(name, handle == focused)) {
+				this->platform.ActivateWindow(handle);
+				ImGui::CloseCurrentPopup();
 			}
+			ImGui::PopID();
+		}
+	}
+}
 
-			if (wParam == HSHELL_WINDOWCREATED) {
-				DWORD processId;
-				GetWindowThreadProcessId((HWND)lParam, &processId);
-				HANDLE iterProc = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, processId);
-				if (!iterProc) return 0;
-				char exePath[MAX_PATH];
-				GetModuleFileNameExA(iterProc, nullptr, exePath, MAX_PATH);
-				CloseHandle(iterProc);
-
-				// Validate (not a tool window, not us, not invisible)
-				if (!validateWindow((HWND)lParam)) return 0;
-
-				std::string exeFileName = std::filesystem::path(exePath).filename().string();
-				g_Taskbar->windows[(HWND)lParam] = { exeFileName, false };
-				return 0;
-			}
+/// <summary>
+/// A button for the buttons that didn't fit on the strip, opening a list of their windows
+/// </summary>
+void Taskbar::BuildOverflow(size_t shown, float size) {
+	size_t hidden = (this->groupByApp ? this->groups.size() : this->windows.Size()) - shown;
+
+	if (ImGui::Button(this->frameArena.Format("+{}##Overflow", hidden), ImVec2(size, size)))
+		ImGui::OpenPopup("Overflow");
 
-			if (wParam == HSHELL_WINDOWACTIVATED) {
-				// If we clicked the taskbar, we don't want to focus on the window
-				if (GetForegroundWindow() == g_Taskbar->hWnd) return 0;
+	// Above the button, growing upwards
+	ImVec2 min = ImGui::GetItemRectMin();
+	ImGui::SetNextWindowPos(ImVec2(min.x, min.y - ImGui::GetStyle().WindowPadding.y), ImGuiCond_Always, ImVec2(0.0f, 1.0f));
+	ImGui::SetNextWindowSizeConstraints(ImVec2(240, 0), ImVec2(480, 400));
+	if (!ImGui::BeginPopup("Overflow"))
+		return;
 
-				for (auto& [_, window] : g_Taskbar->windows) {
-					window.isFocused = false;
+	// Handles only, nothing is measured or submitted for rows that aren't on screen
+	this->overflowWindows.clear();
+	if (this->groupByApp) {
+		for (size_t i = shown; i < this->groups.size(); i++)
+			this->overflowWindows.insert(this->overflowWindows.end(), this->groups[i].windows.begin(), this->groups[i].windows.end());
+	}
+	else {
+		size_t index = 0;
+		for (auto& record : this->windows) {
+			if (index++ >= shown)
+				this->overflowWindows.push_back(record.handle);
+		}
+	}
+
+	this->BuildWindowList(this->overflowWindows);
+	ImGui::EndPopup();
+}
+
+/// <summary>
+/// Group the windows by exe, in order of each exe's first window. Only runs after the windows changed.
+/// Windows that aren't resolved yet get a group each.
+/// </summary>
+void Taskbar::RebuildGroups() {
+	if (!this->groupsDirty) return;
+	this->groupsDirty = false;
+
+	this->groups.clear();
+	this->groupSlots.clear();
+	for (auto& record : this->windows) {
+		const Window& window = record.value;
+		if (!window.resolved) {
+			this->groups.push_back({ 0, { record.handle } });
+			continue;
+		}
+
+		auto [it, inserted] = this->groupSlots.try_emplace(window.exePath, this->groups.size());
+		if (inserted)
+			this->groups.push_back({ window.exePath, {} });
+		this->groups[it->second].windows.push_back(record.handle);
+	}
+}
+
+/// <summary>
+/// CPU and memory of the processes behind `handles` in the latest sample, each process counted once
+/// </summary>
+/// <returns>False if none of them was sampled</returns>
+bool Taskbar::GroupUsage(std::span<const WindowHandle> handles, ProcessUsage& total) {
+	const ResourceSnapshot& snapshot = this->resources.Latest();
+	if (snapshot.processes.empty()) return false;
+
+	bool found = false;
+	this->usageCounted.clear();
+	for (WindowHandle handle : handles) {
+		const Window* window = this->windows.Find(handle);
+		if (!window || !window->resolved) continue;
+
+		// Groups are windows of one exe, usually a handful of processes
+		if (std::find(this->usageCounted.begin(), this->usageCounted.end(), window->process) != this->usageCounted.end()) continue;
+		this->usageCounted.push_back(window->process);
+
+		if (const ProcessUsage* usage = snapshot.Find(window->process)) {
+			total.cpu += usage->cpu;
+			total.workingSet += usage->workingSet;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void Taskbar::BuildStartMenu() {
+	IMS_PROFILE_SCOPE(StartMenuBuild);
+
+	if (!this->showStartMenu) {
+		this->startMenuWasOpen = false;
+		return;
+	}
+
+	if (!this->startMenuWasOpen) {
+		this->startMenuWasOpen = true;
+		if (!this->appWatcher.Active())
+			this->appIndex.ScanAsync(this->appRoots, [this]() { this->OnAppsChanged(); });
+	}
+
+	ImVec2 screen = this->platform.ScreenSize();
+	float tbHeight = this->platform.TaskbarHeight();
+
+	static constexpr float startMenuWidth = 400;
+	static constexpr float startMenuHeight = 400;
+	ImGui::SetNextWindowPos(ImVec2(0, screen.y - startMenuHeight - tbHeight));
+	ImGui::SetNextWindowSize(ImVec2(startMenuWidth, startMenuHeight));
+	ImGui::Begin("Start", &this->showStartMenu, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoNavFocus | ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoNav);
+
+	ImGui::SetNextItemWidth(ImGui::GetWindowContentRegionMax().x - this->imguiStyle->WindowPadding.x);
+	if (this->focusSearch)
+		ImGui::SetKeyboardFocusHere();
+	ImGuiInputTextFlags searchFlags = ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_CallbackCompletion | ImGuiInputTextFlags_CallbackAlways;
+	bool submitted = ImGui::InputText("##Search", this->searchBuffer, IM_ARRAYSIZE(this->searchBuffer), searchFlags, SearchCallback, this);
+	if (ImGui::IsItemEdited())
+		this->searchRows = 0; // A new query starts over at one page
+
+	// A leading '>' switches to Run mode
+	if (this->searchBuffer[0] == '>') {
+		this->BuildCommandList(submitted);
+		ImGui::End();
+		return;
+	}
+
+	float windowWidth = ImGui::GetWindowContentRegionMax().x - this->imguiStyle->WindowPadding.x;
+
+	ImGui::BeginChild("##Display", ImVec2(0, 0), false);
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->ChannelsSplit(2);
+	float iconSize = (float)this->icons.IconSize();
+
+	// Only the rows scrolled through so far get ranked, a page at a time, not every match.
+	// Only re-ranks when the query, the index or the page count changed.
+	float rowHeight = tbHeight + ImGui::GetStyle().ItemSpacing.y;
+	size_t page = (size_t)(ImGui::GetContentRegionAvail().y / rowHeight) + 2;
+	this->searchRows = (std::max)(this->searchRows, page);
+	auto apps = this->appIndex.Snapshot();
+	const auto& results = this->appSearch.Query(apps, this->searchBuffer, this->searchRows);
+	bool more = results.size() == this->searchRows || this->appSearch.MatchCount() > this->searchRows;
+
+	int lastRow = 0;
+	ImGuiListClipper clipper;
+	clipper.Begin((int)results.size(), rowHeight);
+	while (clipper.Step()) {
+		lastRow = (std::max)(lastRow, clipper.DisplayEnd);
+		for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+			const SearchResult& result = results[row];
+
+			ImGui::PushID((int)result.index);
+			if (ImGui::Button(apps->NameCStr(result.index), ImVec2(windowWidth, tbHeight))) {
+				this->launchHistory.Record(apps->Path(result.index), this->platform.Clock().WallNow());
+				this->platform.Launch(apps->Path(result.index));
+			}
+			if (!apps->Target(result.index).empty() && ImGui::IsItemHovered())
+				ImGui::SetTooltip("%s", apps->TargetCStr(result.index));
+
+			// Only entries on screen take up room in the atlas (the clipper can step a row past the edge)
+			if (ImGui::IsItemVisible()) {
+				std::string_view iconPath = apps->IconLocation(result.index);
+				int32_t iconIndex = apps->IconIndex(result.index);
+				if (iconPath.empty()) {
+					iconPath = apps->Target(result.index);
+					iconIndex = 0;
 				}
 
-				auto it = g_Taskbar->windows.find((HWND)lParam);
-				if (it != g_Taskbar->windows.end()) {
-					it->second.isFocused = true;
+				if (const IconCache::Icon* icon = this->icons.Get(iconPath, iconIndex)) {
+					ImVec2 min = ImGui::GetItemRectMin();
+					this->DrawIcon(*icon, ImVec2(min.x + ImGui::GetStyle().FramePadding.x, min.y + (tbHeight - iconSize) * 0.5f), iconSize);
 				}
 			}
+			ImGui::PopID();
+		}
+	}
 
-			if (wParam == HSHELL_WINDOWREPLACING) {
-				auto it = g_Taskbar->windows.find((HWND)lParam);
-				if (it != g_Taskbar->windows.end()) {
-					it->second.isFocused = false;
-				}
+	drawList->ChannelsMerge();
+	ImGui::EndChild();
 
-				return 0;
-			}
+	// Scrolled to the last ranked row, rank the next page
+	if (more && lastRow >= (int)results.size()) {
+		this->searchRows += page;
+		this->scheduler.Invalidate();
+	}
 
-			if (wParam == HSHELL_WINDOWREPLACED) {
-				auto it = g_Taskbar->windows.find((HWND)lParam);
-				if (it != g_Taskbar->windows.end()) {
-					it->second.isFocused = true;
+	ImGui::End();
+}
+
+/// <summary>
+/// Split what follows the '>' into the command and its arguments, views into `line`
+/// </summary>
+static void splitCommandLine(std::string_view line, std::string_view& command, std::string_view& arguments) {
+	size_t start = line.find_first_not_of(' ');
+	line = start == std::string_view::npos ? std::string_view() : line.substr(start);
+
+	size_t end = line.find(' ');
+	command = line.substr(0, end);
+	arguments = end == std::string_view::npos ? std::string_view() : line.substr(end + 1);
+
+	size_t first = arguments.find_first_not_of(' ');
+	arguments = first == std::string_view::npos ? std::string_view() : arguments.substr(first);
+}
+
+/// <summary>
+/// Run mode: the executables on PATH completing the command, Enter runs the first one,
+/// or the command as typed if nothing matches (a full path, a URL, ...)
+/// </summary>
+void Taskbar::BuildCommandList(bool submitted) {
+	std::string_view command, arguments;
+	splitCommandLine(this->searchBuffer + 1, command, arguments);
+
+	// A walk down the trie, as long as the command, nothing is copied
+	auto commands = this->commandIndex.Snapshot();
+	PrefixTrie::Range matches = commands->Complete(command);
+
+	if (submitted && !command.empty()) {
+		this->RunCommand(matches.Empty() ? command : commands->Path(matches.begin), arguments);
+		return;
+	}
+
+	if (commands->Empty()) {
+		ImGui::TextDisabled("No executables found on PATH");
+		return;
+	}
+
+	float windowWidth = ImGui::GetWindowContentRegionMax().x - this->imguiStyle->WindowPadding.x;
+	float tbHeight = this->platform.TaskbarHeight();
+	float iconSize = (float)this->icons.IconSize();
+
+	ImGui::BeginChild("##Commands", ImVec2(0, 0), false);
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->ChannelsSplit(2);
+
+	// Matches are a contiguous range of the snapshot, in name order
+	ImGuiListClipper clipper;
+	clipper.Begin((int)matches.Size(), tbHeight + ImGui::GetStyle().ItemSpacing.y);
+	while (clipper.Step()) {
+		for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+			size_t index = matches.begin + (size_t)row;
+
+			ImGui::PushID((int)index);
+			if (ImGui::Button(commands->NameCStr(index), ImVec2(windowWidth, tbHeight)))
+				this->RunCommand(commands->Path(index), arguments);
+			if (ImGui::IsItemHovered())
+				ImGui::SetTooltip("%s", commands->PathCStr(index));
+
+			if (ImGui::IsItemVisible()) {
+				if (const IconCache::Icon* icon = this->icons.Get(commands->Path(index))) {
+					ImVec2 min = ImGui::GetItemRectMin();
+					this->DrawIcon(*icon, ImVec2(min.x + ImGui::GetStyle().FramePadding.x, min.y + (tbHeight - iconSize) * 0.5f), iconSize);
 				}
-				return 0;
 			}
+			ImGui::PopID();
+		}
+	}
+
+	drawList->ChannelsMerge();
+	ImGui::EndChild();
+}
 
-			return 0;
+/// <summary>
+/// Launch, then close the Start menu. The views may point into the search buffer, it's cleared last.
+/// </summary>
+void Taskbar::RunCommand(std::string_view command, std::string_view arguments) {
+	this->platform.LaunchCommand(command, arguments);
+	this->showStartMenu = false;
+	this->searchBuffer[0] = '\0';
+}
+
+/// <summary>
+/// Tab completes the command in Run mode as far as every match agrees, like a shell.
+/// Also puts the cursor at the end of text filled in by a shortcut, rather than selecting it.
+/// </summary>
+int Taskbar::SearchCallback(ImGuiInputTextCallbackData* data) {
+	Taskbar* taskbar = (Taskbar*)data->UserData;
+
+	if (data->EventFlag == ImGuiInputTextFlags_CallbackAlways) {
+		if (taskbar->focusSearch) {
+			taskbar->focusSearch = false;
+			data->CursorPos = data->SelectionStart = data->SelectionEnd = data->BufTextLen;
 		}
+		return 0;
 	}
 
-	return DefWindowProcW(hWnd, msg, wParam, lParam);
+	if (data->EventFlag != ImGuiInputTextFlags_CallbackCompletion || data->BufTextLen == 0 || data->Buf[0] != '>')
+		return 0;
+
+	// The edit buffer, not searchBuffer, which is only updated once InputText returns
+	std::string_view command, arguments;
+	splitCommandLine(std::string_view(data->Buf + 1, data->BufTextLen - 1), command, arguments);
+
+	auto commands = taskbar->commandIndex.Snapshot();
+	PrefixTrie::Range matches = commands->Complete(command);
+	if (command.empty() || matches.Empty()) return 0;
+
+	// Sorted, so where the first and the last match part ways is where all of them do
+	std::string_view first = commands->LowerName(matches.begin), last = commands->LowerName(matches.end - 1);
+	size_t shared = command.size();
+	while (shared < first.size() && shared < last.size() && first[shared] == last[shared])
+		shared++;
+
+	std::string_view name = commands->Name(matches.begin);
+	int start = (int)(command.data() - data->Buf);
+	bool atEnd = start + (int)command.size() == data->BufTextLen;
+	data->DeleteChars(start, (int)command.size());
+	data->InsertChars(start, name.data(), name.data() + shared);
+	data->CursorPos = start + (int)shared;
+
+	// A single match is done, on to the arguments
+	if (matches.Size() == 1 && atEnd) {
+		data->InsertChars(data->BufTextLen, " ");
+		data->CursorPos = data->BufTextLen;
+	}
+	return 0;
 }
 
-// TODO: More slow code, optimize this or find a better way
-LRESULT CALLBACK Taskbar::KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
-	if (nCode == HC_ACTION) {
-		KBDLLHOOKSTRUCT* kbd = (KBDLLHOOKSTRUCT*)lParam;
-
-		if (kbd->vkCode == VK_LWIN && wParam == WM_KEYUP) {
-			static std::chrono::time_point<std::chrono::system_clock> lastPress = std::chrono::system_clock::now() - std::chrono::milliseconds(500);
-			for (int i = 0; i < 256; i++) {
-				if (GetAsyncKeyState(i) & 0x8000 && i != VK_LWIN) {
-					lastPress = std::chrono::system_clock::now();
-					break;
-				}
+/// <summary>
+/// Icons are drawn into channel 1 of the current window's draw list, split by the caller
+/// </summary>
+void Taskbar::DrawIcon(const IconCache::Icon& icon, ImVec2 min, float size) {
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->ChannelsSetCurrent(1);
+	drawList->AddImage(icon.texture, min, ImVec2(min.x + size, min.y + size), icon.uv0, icon.uv1);
+	drawList->ChannelsSetCurrent(0);
+}
+
+void Taskbar::OnShellEvent(ShellEventType type, WindowHandle handle) {
+	if (this->recorder) this->recorder->Shell(type, handle);
+
+	// Queued and coalesced, applied once per frame in ApplyShellEvents
+	this->shellEvents.Push(type, handle);
+	this->scheduler.Invalidate();
+}
+
+bool Taskbar::OnKey(uint8_t key, bool down) {
+	if (this->recorder) this->recorder->Key(key, down);
+	return this->hotkeys.OnKey(key, down);
+}
+
+void Taskbar::OnKeyStateLost() {
+	this->hotkeys.Reset();
+}
+
+void Taskbar::ApplyShellEvents() {
+	if (this->shellEvents.Empty()) return;
+
+	for (const ShellEvent& event : this->shellEvents.Coalesce()) {
+		switch (event.type) {
+		case ShellEventType::Created:
+			this->AddWindow(event.handle);
+			break;
+
+		case ShellEventType::Destroyed:
+			this->RemoveWindow(event.handle);
+			break;
+
+		case ShellEventType::Activated:
+			// O(1), an unknown window just clears the focus
+			this->windows.Activate(event.handle);
+			break;
+
+		case ShellEventType::Replacing:
+			if (this->windows.IsFocused(event.handle))
+				this->windows.ClearFocus();
+			break;
+
+		case ShellEventType::Replaced:
+			if (this->windows.Contains(event.handle))
+				this->windows.Activate(event.handle);
+			break;
+
+		case ShellEventType::Replace:
+			// The replacement takes over the old window's button
+			if (!this->windows.Rekey(event.handle, event.other))
+				this->AddWindow(event.other);
+			else if (Window* window = this->windows.Find(event.other)) {
+				// Still a placeholder: the worker answers for the old handle, which the drain drops
+				if (window->resolved)
+					window->title = this->platform.WindowTitle(event.other);
+				else
+					this->windowWorker.Request(event.other);
 			}
+			this->groupsDirty = true;
+			break;
 
-			if (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - lastPress).count() > 250)
-				g_Taskbar->showStartMenu = !g_Taskbar->showStartMenu;
+		case ShellEventType::Redraw:
+			// The one cross-process title read per change, tooltips and pickers use the copy
+			if (Window* window = this->windows.Find(event.handle)) {
+				window->title = this->platform.WindowTitle(event.handle);
+				if (this->recorder) this->recorder->Title(event.handle, window->title);
+			}
+			break;
 		}
 	}
-	return CallNextHookEx(g_Taskbar->kbdHook, nCode, wParam, lParam);
-}
\ No newline at end of file
+
+	// Every applied batch, so through the async log: no formatting or I/O on the UI thread, compiled out of release builds
+	IMS_LOG_TRACE("Shell events: {} received, {} applied", this->shellEvents.Received(), this->shellEvents.Applied());
+}
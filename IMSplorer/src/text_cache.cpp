@@ -0,0 +1,44 @@
+#include "pch.h"
+
+#include "text_cache.h"
+
+using namespace IMS;
+
+void TextWidthCache::Validate() {
+	ImFont* font = ImGui::GetFont();
+	float fontSize = ImGui::GetFontSize();
+	if (font == this->font && fontSize == this->fontSize) return;
+
+	this->font = font;
+	this->fontSize = fontSize;
+	this->generation++;
+	std::fill(this->widths.begin(), this->widths.end(), -1.0f);
+}
+
+float TextWidthCache::Width(StringId id, std::string_view text) {
+	if (id >= this->widths.size())
+		this->widths.resize((size_t)id + 1, -1.0f);
+
+	float& width = this->widths[id];
+	if (width >= 0) {
+		this->hits++;
+		return width;
+	}
+
+	this->misses++;
+	width = ImGui::CalcTextSize(text.data(), text.data() + text.size()).x;
+	return width;
+}
+
+float TextWidthCache::Width(Slot& slot, std::string_view text) {
+	if (slot.generation == this->generation && slot.text == text) {
+		this->hits++;
+		return slot.width;
+	}
+
+	this->misses++;
+	slot.text.assign(text);
+	slot.width = ImGui::CalcTextSize(text.data(), text.data() + text.size()).x;
+	slot.generation = this->generation;
+	return slot.width;
+}
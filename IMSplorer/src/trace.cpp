@@ -0,0 +1,201 @@
+#include "pch.h"
+
+#include "trace.h"
+
+#include "hotkeys.h"
+#include "mapped_file.h"
+
+using namespace IMS;
+
+static_assert(sizeof(TraceEvent) == 24, "TraceEvent is the on-disk record");
+static_assert(std::is_trivially_copyable_v<TraceEvent> && std::is_trivially_copyable_v<TraceFileHeader>);
+
+bool TraceWriter::Open(const std::filesystem::path& path) {
+	this->Close();
+
+	this->out.open(path, std::ios::binary | std::ios::trunc);
+	if (!this->out) return false;
+
+	TraceFileHeader header;
+	std::memcpy(header.magic, TraceFileHeader::kMagic, sizeof(header.magic));
+	header.version = TraceFileHeader::kVersion;
+	header.headerSize = sizeof(TraceFileHeader);
+	header.eventSize = sizeof(TraceEvent);
+	this->out.write((const char*)&header, sizeof(header));
+
+	this->buffer.reserve(kBufferSize);
+	this->events = 0;
+	return (bool)this->out;
+}
+
+void TraceWriter::Write(const TraceEvent& event) {
+	if (!this->out.is_open()) return;
+
+	this->buffer.push_back(event);
+	this->events++;
+	if (this->buffer.size() >= kBufferSize)
+		this->Flush();
+}
+
+bool TraceWriter::Flush() {
+	if (!this->out.is_open()) return false;
+
+	if (!this->buffer.empty()) {
+		this->out.write((const char*)this->buffer.data(), (std::streamsize)(this->buffer.size() * sizeof(TraceEvent)));
+		this->buffer.clear();
+	}
+	this->out.flush();
+	return (bool)this->out;
+}
+
+bool TraceWriter::Close() {
+	if (!this->out.is_open()) return false;
+
+	bool ok = this->Flush();
+	this->out.close();
+	return ok;
+}
+
+bool IMS::LoadTrace(const std::filesystem::path& path, std::vector<TraceEvent>& events) {
+	events.clear();
+
+	MappedFile file;
+	if (!file.Open(path) || file.Size() < sizeof(TraceFileHeader)) return false;
+
+	TraceFileHeader header;
+	std::memcpy(&header, file.Data(), sizeof(header));
+	if (std::memcmp(header.magic, TraceFileHeader::kMagic, sizeof(header.magic)) != 0 || header.version != TraceFileHeader::kVersion ||
+		header.headerSize < sizeof(TraceFileHeader) || header.headerSize > file.Size() || header.eventSize != sizeof(TraceEvent))
+		return false;
+
+	// Records are packed right after the header, not necessarily aligned for TraceEvent
+	size_t count = (file.Size() - header.headerSize) / sizeof(TraceEvent);
+	events.resize(count);
+	if (count > 0)
+		std::memcpy(events.data(), file.Data() + header.headerSize, count * sizeof(TraceEvent));
+	return true;
+}
+
+bool TraceRecorder::Open(const std::filesystem::path& path) {
+	this->start = std::chrono::steady_clock::now();
+	this->flushed = this->start;
+	return this->writer.Open(path);
+}
+
+int64_t TraceRecorder::Now() const {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - this->start).count();
+}
+
+void TraceRecorder::Write(TraceEventKind kind, uint64_t handle, uint16_t code, int16_t x, int16_t y, bool down) {
+	TraceEvent event;
+	event.time = this->Now();
+	event.handle = handle;
+	event.code = code;
+	event.x = x;
+	event.y = y;
+	event.kind = kind;
+	event.down = down ? 1 : 0;
+	this->writer.Write(event);
+}
+
+void TraceRecorder::Shell(ShellEventType type, WindowHandle handle) {
+	this->Write(TraceEventKind::Shell, handle, (uint16_t)type);
+}
+
+void TraceRecorder::Key(uint8_t key, bool down) {
+	static constexpr uint8_t modifiers[] = {
+		Keys::Shift, Keys::Control, Keys::Alt, Keys::LWin, Keys::RWin,
+		Keys::LShift, Keys::RShift, Keys::LControl, Keys::RControl, Keys::LAlt, Keys::RAlt,
+	};
+	static constexpr uint8_t shortcuts[] = {
+		Keys::Control, Keys::Alt, Keys::LWin, Keys::RWin, Keys::LControl, Keys::RControl, Keys::LAlt, Keys::RAlt,
+	};
+
+	// Whether a shortcut modifier was held before this key changed
+	bool held = std::any_of(std::begin(shortcuts), std::end(shortcuts), [this](uint8_t modifier) { return this->hookDown[modifier]; });
+	this->hookDown[key] = down;
+
+	bool record = std::find(std::begin(modifiers), std::end(modifiers), key) != std::end(modifiers);
+	if (down)
+		record = record || held;
+	else
+		record = record || this->hookRecorded[key];
+
+	if (!record) return;
+
+	this->hookRecorded[key] = down;
+	this->Write(TraceEventKind::Key, 0, key, 0, 0, down);
+}
+
+void TraceRecorder::Existing(WindowHandle handle) {
+	this->Write(TraceEventKind::Existing, handle);
+}
+
+void TraceRecorder::Window(WindowHandle handle, std::string_view exePath, std::string_view exe, std::string_view title) {
+	auto [it, inserted] = this->exeIds.try_emplace(std::string(exePath), (uint16_t)this->exeIds.size());
+	auto length = [](size_t size) { return (uint16_t)(std::min)(size, (size_t)INT16_MAX); };
+	this->Write(TraceEventKind::Window, handle, length(title.size()), (int16_t)length(exe.size()), (int16_t)it->second);
+}
+
+void TraceRecorder::Title(WindowHandle handle, std::string_view title) {
+	this->Write(TraceEventKind::Title, handle, (uint16_t)(std::min)(title.size(), (size_t)UINT16_MAX));
+}
+
+void TraceRecorder::Input(ImVec2 screenSize, float taskbarHeight) {
+	if (!this->writer.IsOpen()) return;
+
+	auto coordinate = [](float value) { return (int16_t)std::clamp(std::lround(value), (long)INT16_MIN + 1, (long)INT16_MAX); };
+
+	if (screenSize.x != this->screenSize.x || screenSize.y != this->screenSize.y || taskbarHeight != this->taskbarHeight) {
+		this->screenSize = screenSize;
+		this->taskbarHeight = taskbarHeight;
+		this->Write(TraceEventKind::Screen, 0, (uint16_t)std::lround(taskbarHeight), coordinate(screenSize.x), coordinate(screenSize.y));
+	}
+
+	const ImGuiIO& io = ImGui::GetIO();
+
+	int16_t x = INT16_MIN, y = INT16_MIN;
+	if (ImGui::IsMousePosValid(&io.MousePos)) {
+		x = coordinate(io.MousePos.x);
+		y = coordinate(io.MousePos.y);
+	}
+	if (x != this->mouseX || y != this->mouseY) {
+		this->mouseX = x;
+		this->mouseY = y;
+		this->Write(TraceEventKind::MousePos, 0, 0, x, y);
+	}
+
+	for (int button = 0; button < ImGuiMouseButton_COUNT; button++) {
+		if (io.MouseDown[button] == this->mouseDown[button]) continue;
+		this->mouseDown[button] = io.MouseDown[button];
+		this->Write(TraceEventKind::MouseButton, 0, (uint16_t)button, 0, 0, io.MouseDown[button]);
+	}
+
+	if (io.MouseWheel != 0 || io.MouseWheelH != 0)
+		this->Write(TraceEventKind::MouseWheel, 0, 0, (int16_t)std::lround(io.MouseWheelH * 120), (int16_t)std::lround(io.MouseWheel * 120));
+
+	// Named keys first, the modifiers after them
+	for (size_t i = 0; i < kUiKeys; i++) {
+		ImGuiKey key = i < ImGuiKey_NamedKey_COUNT ? (ImGuiKey)(ImGuiKey_NamedKey_BEGIN + i) : kMods[i - ImGuiKey_NamedKey_COUNT];
+		bool down = ImGui::IsKeyDown(key);
+		if (down == this->uiKeys[i]) continue;
+		this->uiKeys[i] = down;
+		this->Write(TraceEventKind::UiKey, 0, (uint16_t)key, 0, 0, down);
+	}
+
+	for (ImWchar character : io.InputQueueCharacters)
+		this->Write(TraceEventKind::Char, 0, (uint16_t)character);
+}
+
+void TraceRecorder::Frame() {
+	if (!this->writer.IsOpen()) return;
+
+	this->Write(TraceEventKind::Frame);
+
+	// A crash loses at most the last second
+	auto now = std::chrono::steady_clock::now();
+	if (now - this->flushed > std::chrono::seconds(1)) {
+		this->writer.Flush();
+		this->flushed = now;
+	}
+}
@@ -0,0 +1,597 @@
+#include "pch.h"
+
+#include "win32_platform.h"
+
+#include "app_index.h"
+#include "async_log.h"
+#include "profiler.h"
+
+#ifdef _WIN32
+#include <wtsapi32.h>
+#pragma comment(lib, "wtsapi32.lib")
+
+using namespace IMS;
+
+static Win32Platform* g_Platform = nullptr;
+
+extern LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
+#define SAFE_CLEANUP(x) if (x) { x->Release(); x = nullptr; }
+
+static std::string formatError(DWORD error) {
+	LPSTR messageBuffer = nullptr;
+	size_t size = FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr, error, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPSTR)&messageBuffer, 0, nullptr);
+	std::string message(messageBuffer, size);
+	LocalFree(messageBuffer);
+	return message;
+}
+
+bool Win32Platform::Init(const std::string& title) {
+	StartupGraph graph;
+	this->AddStartupTasks(graph, title);
+	return graph.Run();
+}
+
+Win32Platform::StartupTasks Win32Platform::AddStartupTasks(StartupGraph& graph, const std::string& title) {
+	using Affinity = StartupGraph::Affinity;
+
+	g_Platform = this;
+	this->title = title;
+
+	// The window and everything tied to it stay on the thread that pumps its messages
+	auto window = graph.Add("Window", [this]() { return this->InitWindow(); }, {}, Affinity::Main);
+	auto shell = graph.Add("Shell", [this]() { this->InitShell(); return true; }, { window }, Affinity::Main);
+	auto device = graph.Add("D3D11 device", [this]() { this->InitD3D(); return true; }, { window }, Affinity::Main);
+
+	// Rasterizing the font doesn't need the context, only the context needs the font
+	auto fonts = graph.Add("Font atlas", [this]() { return this->BuildFonts(); });
+	auto imgui = graph.Add("ImGui", [this]() { this->InitImGui(); return true; }, { device, fonts }, Affinity::Main);
+
+	// Last, a low level hook on a thread that doesn't pump messages yet stalls every key press
+	auto hooks = graph.Add("Hooks", [this]() { this->InitHooks(); return true; }, { shell, imgui }, Affinity::Main);
+
+	return { shell, hooks };
+}
+
+Win32Platform::~Win32Platform() {
+	if (!this->hWnd) return;
+
+	// Destroy ImGui
+	ImGui_ImplDX11_Shutdown();
+	ImGui_ImplWin32_Shutdown();
+	ImGui::DestroyContext(this->imguiContext);
+	if (this->fontAtlas) {
+		this->fontCache->Release(*this->fontAtlas);
+		IM_DELETE(this->fontAtlas);
+	}
+
+	// Destroy DX11
+	SAFE_CLEANUP(this->renderTargetView);
+	SAFE_CLEANUP(this->swapChain);
+	SAFE_CLEANUP(this->deviceContext);
+	SAFE_CLEANUP(this->device);
+
+	// Destroy window
+	if (this->sessionNotifications)
+		WTSUnRegisterSessionNotification(this->hWnd);
+	DestroyWindow(this->hWnd);
+	UnregisterClass(this->wc.lpszClassName, this->wc.hInstance);
+
+	// Unhook
+	UnhookWindowsHookEx(this->kbdHook);
+	if (this->desktopHook)
+		UnhookWinEvent(this->desktopHook);
+
+	g_Platform = nullptr;
+}
+
+bool Win32Platform::InitWindow() {
+	// Create window
+	this->wc.cbSize = sizeof(WNDCLASSEX);
+	this->wc.style = CS_CLASSDC;
+	this->wc.lpfnWndProc = WndProc;
+	this->wc.cbClsExtra = 0L;
+	this->wc.cbWndExtra = 0L;
+	this->wc.hInstance = GetModuleHandle(nullptr);
+	this->wc.hIcon = nullptr;
+	this->wc.hCursor = nullptr;
+	this->wc.hbrBackground = nullptr;
+	this->wc.lpszMenuName = nullptr;
+	this->wc.lpszClassName = L"ImSplorerTB";
+	this->wc.style = CS_DBLCLKS; // Double click messages
+	this->wc.hIconSm = nullptr;
+	RegisterClassEx(&this->wc);
+
+	std::wstring titleW(this->title.begin(), this->title.end());
+
+	DWORD dwStyle = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+	DWORD dwExStyle = WS_EX_LEFT | WS_EX_LTRREADING | WS_EX_RIGHTSCROLLBAR |
+		WS_EX_TOPMOST | WS_EX_TOOLWINDOW;
+
+	int screenWidth = GetSystemMetrics(SM_CXSCREEN);
+	int screenHeight = GetSystemMetrics(SM_CYSCREEN);
+
+	RECT workArea = { 0 };
+	if (SystemParametersInfo(SPI_GETWORKAREA, 0, &workArea, 0)) {
+		int taskbarHeight = screenHeight - (workArea.bottom - workArea.top);
+		if (taskbarHeight != (float)this->tbHeight) {
+			spdlog::info("Taskbar height changed from {} to {}", this->tbHeight, taskbarHeight);
+			this->tbHeight = (float)taskbarHeight;
+		}
+	}
+	else {
+		spdlog::warn("SystemParametersInfo failed, can't calculate taskbar height");
+	}
+
+	this->hWnd = CreateWindowExW(
+		dwExStyle,
+		wc.lpszClassName,
+		titleW.c_str(),
+		dwStyle,
+		0, screenHeight - this->tbHeight, // X, Y position (bottom of screen)
+		screenWidth, this->tbHeight,        // Width, Height
+		nullptr,
+		nullptr,
+		wc.hInstance,
+		nullptr
+	);
+
+	// Check for errors
+	if (this->hWnd == nullptr) {
+		spdlog::error("Failed to create window: {}", formatError(GetLastError()));
+		return false;
+	}
+
+	this->width = screenWidth;
+	this->height = (int)this->tbHeight;
+
+	// Show window
+	ShowWindow(this->hWnd, SW_SHOWDEFAULT);
+	UpdateWindow(this->hWnd);
+
+	return true;
+}
+
+void Win32Platform::InitShell() {
+	auto user32 = LoadLibrary(L"user32.dll");
+	if (user32) {
+		auto SetShellWindow = (BOOL(WINAPI*)(HWND))GetProcAddress(user32, "SetShellWindow");
+		SetShellWindow ? SetShellWindow(this->hWnd) : false;
+		auto SetTaskmanWindow = (BOOL(WINAPI*)(HWND))GetProcAddress(user32, "SetTaskmanWindow");
+		SetTaskmanWindow ? SetTaskmanWindow(this->hWnd) : false;
+
+		if (!SetShellWindow || !SetTaskmanWindow)
+			spdlog::error("SetShellWindow/SetTaskmanTaskbar not found or failed");
+	}
+	else {
+		spdlog::error("user32.dll not found");
+	}
+
+	this->shellHookMessage = RegisterWindowMessage(TEXT("SHELLHOOK"));
+	if (!RegisterShellHookWindow(this->hWnd)) {
+		spdlog::error("RegisterShellHookTaskbar failed");
+	}
+}
+
+void Win32Platform::InitD3D() {
+	// Create DX11
+	DXGI_SWAP_CHAIN_DESC scd = { 0 };
+	scd.BufferDesc.Width = this->width;
+	scd.BufferDesc.Height = this->height;
+	scd.BufferDesc.RefreshRate.Numerator = 60;
+	scd.BufferDesc.RefreshRate.Denominator = 1;
+	scd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	scd.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;
+	scd.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;
+	scd.SampleDesc.Count = 1;
+	scd.SampleDesc.Quality = 0;
+	scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	scd.BufferCount = 1;
+	scd.OutputWindow = this->hWnd;
+	scd.Windowed = TRUE;
+	scd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+	scd.Flags = 0;
+
+#ifdef _DEBUG
+	UINT createDeviceFlags = D3D11_CREATE_DEVICE_DEBUG;
+#else
+	UINT createDeviceFlags = 0;
+#endif
+
+	D3D_FEATURE_LEVEL featureLevel;
+	HRESULT res = D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, createDeviceFlags, nullptr, 0, D3D11_SDK_VERSION, &scd, &this->swapChain, &this->device, &featureLevel, &this->deviceContext);
+
+	if (FAILED(res)) {
+		std::ofstream file("error.txt");
+		file << formatError(res);
+		file.close();
+	}
+
+	ID3D11Texture2D* pBackBuffer;
+	this->swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&pBackBuffer);
+	this->device->CreateRenderTargetView(pBackBuffer, nullptr, &this->renderTargetView);
+	pBackBuffer->Release();
+}
+
+bool Win32Platform::BuildFonts() {
+	// Segoe UI (C:\Windows\Fonts\segoeui.ttf) at 100%, 125%, 150% and 200% scale, ImGui's own if it's not there.
+	// Rasterized once, later launches map the baked atlas from the cache.
+	std::filesystem::path cacheDirectory = this->CacheDirectory();
+	this->fontCache = std::make_unique<FontAtlasCache>(cacheDirectory.empty() ? std::filesystem::path() : cacheDirectory / "fonts.bin");
+	this->fontAtlas = IM_NEW(ImFontAtlas)();
+
+	FontAtlasSpec spec;
+	spec.path = "C:\\Windows\\Fonts\\segoeui.ttf";
+	spec.sizes = { 16.0f, 20.0f, 24.0f, 32.0f };
+	if (this->fontCache->Build(*this->fontAtlas, spec))
+		return true;
+
+	this->fontAtlas->Clear();
+	spec.path.clear();
+	return this->fontCache->Build(*this->fontAtlas, spec);
+}
+
+void Win32Platform::SelectFont(float dpiScale) {
+	// The baked size closest to 16px at this scale
+	ImFont* best = nullptr;
+	for (ImFont* font : this->fontAtlas->Fonts) {
+		if (!best || std::abs(font->FontSize - 16.0f * dpiScale) < std::abs(best->FontSize - 16.0f * dpiScale))
+			best = font;
+	}
+	this->imguiIO->FontDefault = best;
+}
+
+void Win32Platform::InitImGui() {
+	// Create ImGui, with the atlas built by BuildFonts
+	IMGUI_CHECKVERSION();
+	this->imguiContext = ImGui::CreateContext(this->fontAtlas);
+	this->imguiIO = &ImGui::GetIO();
+
+	// Set ImGui io
+	this->imguiIO->ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+	this->imguiIO->ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+	this->imguiIO->ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
+	this->imguiIO->IniFilename = nullptr;
+
+	ImGui_ImplWin32_Init(this->hWnd);
+	ImGui_ImplDX11_Init(this->device, this->deviceContext);
+
+	this->SelectFont(ImGui_ImplWin32_GetDpiScaleForHwnd(this->hWnd));
+}
+
+void Win32Platform::InitHooks() {
+	this->kbdHook = SetWindowsHookEx(WH_KEYBOARD_LL, KeyboardProc, GetModuleHandle(nullptr), 0);
+
+	// The hook doesn't see the key ups swallowed by the lock screen and the secure desktop
+	this->sessionNotifications = WTSRegisterSessionNotification(this->hWnd, NOTIFY_FOR_THIS_SESSION);
+	this->desktopHook = SetWinEventHook(EVENT_SYSTEM_DESKTOPSWITCH, EVENT_SYSTEM_DESKTOPSWITCH, nullptr, DesktopSwitchProc, 0, 0, WINEVENT_OUTOFCONTEXT);
+}
+
+bool Win32Platform::PumpEvents() {
+	MSG msg = { 0 };
+	while (PeekMessage(&msg, nullptr, 0U, 0U, PM_REMOVE)) {
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+
+		if (msg.message == WM_QUIT) {
+			spdlog::info("WM_QUIT received, stopping taskbar");
+			return false;
+		}
+
+		// Wake() from a worker, Update decides whether what it brought changes anything
+		if (msg.message == WM_NULL && msg.hwnd == nullptr) continue;
+
+		// Anything else that reaches the queue (input, focus, our viewports) can change what's on screen
+		if (this->host) this->host->OnInvalidate();
+	}
+
+	return true;
+}
+
+std::function<bool(uint8_t key)> Win32Platform::KeyStateQuery() {
+	// From a low level hook this is the state from before the event being handled
+	return [](uint8_t key) { return (GetAsyncKeyState(key) & 0x8000) != 0; };
+}
+
+void Win32Platform::EnumerateWindows(const std::function<void(WindowHandle)>& callback) {
+	EnumWindows([](HWND hWnd, LPARAM lParam) -> BOOL {
+		(*(const std::function<void(WindowHandle)>*)lParam)((WindowHandle)hWnd);
+		return TRUE;
+		}, (LPARAM)&callback);
+}
+
+/// <summary>
+/// Check if a window wants to be shown (not a tool window, not invisible, etc).
+/// Only does checks that don't talk to the owning process, the title check happens on the metadata worker.
+/// </summary>
+bool Win32Platform::IsTaskbarWindow(WindowHandle handle) {
+	HWND hWnd = (HWND)handle;
+
+	if (GetWindowLong(hWnd, GWL_EXSTYLE) & WS_EX_TOOLWINDOW) return false;
+	if (!IsWindowVisible(hWnd)) return false;
+	if (GetWindowLong(hWnd, GWLP_HWNDPARENT) != 0) return false;
+
+	return true;
+}
+
+std::string Win32Platform::WindowTitle(WindowHandle handle) {
+	wchar_t title[256] = { 0 };
+	int length = GetWindowTextW((HWND)handle, title, 256);
+	if (length <= 0) return {};
+
+	int size = WideCharToMultiByte(CP_UTF8, 0, title, length, nullptr, 0, nullptr, nullptr);
+	std::string out(size, '\0');
+	WideCharToMultiByte(CP_UTF8, 0, title, length, out.data(), size, nullptr, nullptr);
+	return out;
+}
+
+void Win32Platform::ActivateWindow(WindowHandle handle) {
+	HWND hWnd = (HWND)handle;
+
+	AllowSetForegroundWindow(ASFW_ANY);
+	SetForegroundWindow(hWnd);
+	if (IsIconic(hWnd)) ShowWindow(hWnd, SW_RESTORE);
+}
+
+void Win32Platform::MinimizeWindow(WindowHandle handle) {
+	HWND hWnd = (HWND)handle;
+
+	AllowSetForegroundWindow(ASFW_ANY);
+	SetForegroundWindow(hWnd);
+	ShowWindow(hWnd, SW_MINIMIZE);
+}
+
+void Win32Platform::CloseWindow(WindowHandle handle) {
+	PostMessage((HWND)handle, WM_CLOSE, 0, 0);
+}
+
+std::unique_ptr<IProcessBackend> Win32Platform::CreateProcessBackend() {
+	return std::make_unique<Win32ProcessBackend>();
+}
+
+std::unique_ptr<IWindowInfoResolver> Win32Platform::CreateWindowResolver(ProcessCache& processes) {
+	return std::make_unique<Win32WindowResolver>(processes);
+}
+
+std::vector<std::filesystem::path> Win32Platform::AppRoots() {
+	return AppIndex::DefaultRoots();
+}
+
+std::filesystem::path Win32Platform::CacheDirectory() {
+	// %LocalAppData%\IMSplorer
+	std::filesystem::path directory;
+
+	PWSTR folder = nullptr;
+	if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, KF_FLAG_DEFAULT, nullptr, &folder)))
+		directory = std::filesystem::path(folder) / L"IMSplorer";
+	CoTaskMemFree(folder);
+
+	return directory;
+}
+
+void Win32Platform::Launch(std::string_view path) {
+	ShellExecuteW(nullptr, L"open", PathFromUtf8(path).c_str(), nullptr, nullptr, SW_SHOWNORMAL);
+}
+
+void Win32Platform::LaunchCommand(std::string_view file, std::string_view arguments) {
+	// ShellExecute searches PATH and App Paths itself, like the Run dialog
+	std::wstring parameters = PathFromUtf8(arguments).wstring();
+	ShellExecuteW(nullptr, nullptr, PathFromUtf8(file).c_str(), parameters.empty() ? nullptr : parameters.c_str(), nullptr, SW_SHOWNORMAL);
+}
+
+ImVec2 Win32Platform::ScreenSize() {
+	return ImVec2((float)GetSystemMetrics(SM_CXSCREEN), (float)GetSystemMetrics(SM_CYSCREEN));
+}
+
+bool Win32Platform::BeginFrame() {
+	if (this->occluded) {
+		if (this->swapChain->Present(0, DXGI_PRESENT_TEST) == DXGI_STATUS_OCCLUDED)
+			return false;
+
+		// Whatever was on screen may be gone
+		this->occluded = false;
+		this->frameDiff.Invalidate();
+	}
+
+	if (this->resizeWidth != 0 && this->resizeHeight != 0) {
+		SAFE_CLEANUP(this->renderTargetView);
+
+		this->swapChain->ResizeBuffers(0, this->resizeWidth, this->resizeHeight, DXGI_FORMAT_UNKNOWN, 0);
+
+		ID3D11Texture2D* pBackBuffer;
+		this->swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&pBackBuffer);
+		this->device->CreateRenderTargetView(pBackBuffer, nullptr, &this->renderTargetView);
+		pBackBuffer->Release();
+
+		this->width = this->resizeWidth;
+		this->height = this->resizeHeight;
+		this->resizeWidth = 0; this->resizeHeight = 0;
+
+		// New buffers, nothing in them yet
+		this->frameDiff.Invalidate();
+	}
+
+	// ImGui
+	IMS_PROFILE_SCOPE(NewFrame);
+	ImGui_ImplDX11_NewFrame();
+	ImGui_ImplWin32_NewFrame();
+	ImGui::NewFrame();
+
+	return true;
+}
+
+void Win32Platform::EndFrame() {
+	bool present = false;
+	{
+		IMS_PROFILE_SCOPE(Render);
+		ImGui::Render();
+
+		// Same picture as what's on screen, leave the swap chain alone
+		ImDrawData* drawData = ImGui::GetDrawData();
+		present = this->frameDiff.Changed(ImGui::GetMainViewport()->ID, *drawData, this->textureUpdates);
+		if (present) {
+			static constexpr float clearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			this->deviceContext->OMSetRenderTargets(1, &this->renderTargetView, nullptr);
+			this->deviceContext->ClearRenderTargetView(this->renderTargetView, clearColor);
+			ImGui_ImplDX11_RenderDrawData(drawData);
+		}
+
+		if (this->imguiIO->ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
+			ImGui::UpdatePlatformWindows();
+			this->RenderViewports();
+		}
+		this->frameDiff.EndFrame();
+	}
+
+	if (!present) {
+		IMS_LOG_TRACE("Frame unchanged, present skipped");
+		return;
+	}
+
+	// Swap buffers
+	{
+		IMS_PROFILE_SCOPE(Present);
+		HRESULT result = this->swapChain->Present(1, 0);
+		if (result == DXGI_STATUS_OCCLUDED)
+			this->occluded = true;
+		else if (result == DXGI_ERROR_DEVICE_REMOVED || result == DXGI_ERROR_DEVICE_RESET) {
+			IMS_LOG_WARN("Present failed ({:#x}), device lost", (uint32_t)result);
+			this->frameDiff.Invalidate(); // Nothing we drew survived, submit everything again
+		}
+	}
+}
+
+/// <summary>
+/// ImGui::RenderPlatformWindowsDefault, minus the viewports (Start menu, popups) whose draw data didn't change
+/// </summary>
+void Win32Platform::RenderViewports() {
+	ImGuiPlatformIO& platformIO = ImGui::GetPlatformIO();
+	for (int i = 1; i < platformIO.Viewports.Size; i++) {
+		ImGuiViewport* viewport = platformIO.Viewports[i];
+		if (viewport->Flags & ImGuiViewportFlags_IsMinimized) continue;
+		if (!viewport->DrawData || !this->frameDiff.Changed(viewport->ID, *viewport->DrawData, this->textureUpdates)) continue;
+
+		if (platformIO.Platform_RenderWindow) platformIO.Platform_RenderWindow(viewport, nullptr);
+		if (platformIO.Renderer_RenderWindow) platformIO.Renderer_RenderWindow(viewport, nullptr);
+		if (platformIO.Platform_SwapBuffers) platformIO.Platform_SwapBuffers(viewport, nullptr);
+		if (platformIO.Renderer_SwapBuffers) platformIO.Renderer_SwapBuffers(viewport, nullptr);
+	}
+}
+
+LRESULT WINAPI Win32Platform::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+	//RegisterTaskbarMessageW(TEXT("SHELLHOOK"));
+	IMS_PROFILE_SCOPE(WndProc);
+
+	if (ImGui_ImplWin32_WndProcHandler(hWnd, msg, wParam, lParam))
+		return true;
+
+	// Messages sent while the window is being created
+	if (!g_Platform || !g_Platform->host)
+		return DefWindowProcW(hWnd, msg, wParam, lParam);
+
+	IPlatformHost* host = g_Platform->host;
+
+	switch (msg) {
+	case WM_SIZE:
+		if (wParam == SIZE_MINIMIZED)
+			return 0;
+
+		g_Platform->resizeWidth = (UINT)LOWORD(lParam); // Queue resize
+		g_Platform->resizeHeight = (UINT)HIWORD(lParam);
+		host->OnInvalidate();
+
+		return 0;
+
+	case WM_DPICHANGED:
+		// Moved to a monitor with another scale
+		g_Platform->SelectFont((float)LOWORD(wParam) / USER_DEFAULT_SCREEN_DPI);
+		host->OnInvalidate();
+		break;
+
+	case WM_SETTINGCHANGE:
+		// Broadcast by the environment variables editor (and setx), the PATH is read again from the registry
+		if (lParam && std::wcscmp((const wchar_t*)lParam, L"Environment") == 0)
+			host->OnEnvironmentChanged();
+		break;
+
+	case WM_WTSSESSION_CHANGE:
+		// Locked, unlocked, switched away or back: whatever was held when it happened was released unseen
+		host->OnKeyStateLost();
+		break;
+
+	case WM_SYSCOMMAND:
+		if ((wParam & 0xfff0) == SC_KEYMENU) // Disable ALT application menu
+			return 0;
+
+		break;
+
+	case WM_DESTROY:
+		PostQuitMessage(0);
+		return 0;
+
+	default:
+		if (g_Platform->shellHookMessage != 0 && msg == g_Platform->shellHookMessage) {
+			IMS_LOG_TRACE("Shell hook {} for window {:#x}", (uint32_t)wParam, (uint64_t)lParam);
+
+			// Queued and coalesced by the host, applied once per frame
+			switch (wParam & ~HSHELL_HIGHBIT) {
+			case HSHELL_WINDOWCREATED:
+				host->OnShellEvent(ShellEventType::Created, (WindowHandle)lParam);
+				break;
+
+			case HSHELL_WINDOWDESTROYED:
+				host->OnShellEvent(ShellEventType::Destroyed, (WindowHandle)lParam);
+				break;
+
+			case HSHELL_WINDOWACTIVATED:
+				// If we clicked the taskbar, we don't want to focus on the window
+				if (GetForegroundWindow() == g_Platform->hWnd) return 0;
+				host->OnShellEvent(ShellEventType::Activated, (WindowHandle)lParam);
+				break;
+
+			case HSHELL_WINDOWREPLACING:
+				host->OnShellEvent(ShellEventType::Replacing, (WindowHandle)lParam);
+				break;
+
+			case HSHELL_WINDOWREPLACED:
+				host->OnShellEvent(ShellEventType::Replaced, (WindowHandle)lParam);
+				break;
+
+			case HSHELL_REDRAW:
+				host->OnShellEvent(ShellEventType::Redraw, (WindowHandle)lParam);
+				break;
+
+			default:
+				return 0;
+			}
+
+			return 0;
+		}
+	}
+
+	return DefWindowProcW(hWnd, msg, wParam, lParam);
+}
+
+LRESULT CALLBACK Win32Platform::KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
+	// This runs for every key press on the system, keep it cheap
+	IMS_PROFILE_SCOPE(KeyboardProc);
+
+	if (nCode == HC_ACTION && g_Platform && g_Platform->host) {
+		KBDLLHOOKSTRUCT* kbd = (KBDLLHOOKSTRUCT*)lParam;
+		bool down = wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN;
+
+		if (g_Platform->host->OnKey((uint8_t)kbd->vkCode, down)) {
+			// Only keys our shortcuts took, never what's typed into other applications
+			IMS_LOG_DEBUG("Shortcut key {:#x} {}", (uint32_t)kbd->vkCode, down ? "down" : "up");
+			return 1; // Handled by one of our shortcuts, don't pass it on
+		}
+	}
+	return CallNextHookEx(g_Platform ? g_Platform->kbdHook : nullptr, nCode, wParam, lParam);
+}
+
+void CALLBACK Win32Platform::DesktopSwitchProc(HWINEVENTHOOK hook, DWORD event, HWND hWnd, LONG idObject, LONG idChild, DWORD thread, DWORD time) {
+	// Ctrl+Alt+Del and UAC prompts run on the secure desktop, our hook misses the keys released there
+	if (event == EVENT_SYSTEM_DESKTOPSWITCH && g_Platform && g_Platform->host)
+		g_Platform->host->OnKeyStateLost();
+}
+#endif
@@ -0,0 +1,103 @@
+#include "pch.h"
+
+#include "window_info_worker.h"
+
+using namespace IMS;
+
+#ifdef _WIN32
+static std::string toUtf8(const wchar_t* str, int length) {
+	if (length <= 0) return {};
+
+	int size = WideCharToMultiByte(CP_UTF8, 0, str, length, nullptr, 0, nullptr, nullptr);
+	std::string out(size, '\0');
+	WideCharToMultiByte(CP_UTF8, 0, str, length, out.data(), size, nullptr, nullptr);
+	return out;
+}
+
+WindowInfo Win32WindowResolver::Resolve(WindowHandle handle) {
+	HWND hWnd = (HWND)handle;
+
+	WindowInfo info;
+	info.handle = handle;
+
+	wchar_t title[256] = { 0 };
+	int titleLength = GetWindowTextW(hWnd, title, 256);
+	info.title = toUtf8(title, titleLength);
+
+	// Not us, not the Start menu
+	if (info.title.find("ImSplorer") != std::string::npos || info.title.starts_with("Start"))
+		return info;
+
+	// Other windows of the same process are served from the cache without touching the process
+	DWORD processId = 0;
+	GetWindowThreadProcessId(hWnd, &processId);
+	auto process = this->processes.Acquire(processId);
+	if (!process) return info;
+
+	info.process = process->key;
+	info.exePath = process->exePath;
+	info.exe = process->exe;
+	info.valid = true;
+
+	return info;
+}
+#endif
+
+WindowInfoWorker::WindowInfoWorker(std::unique_ptr<IWindowInfoResolver> resolver, std::function<void()> onReady)
+	: resolver(std::move(resolver)), onReady(std::move(onReady)) {
+	this->thread = std::jthread([this](std::stop_token stop) { this->Work(stop); });
+}
+
+WindowInfoWorker::~WindowInfoWorker() {
+	this->thread.request_stop();
+	this->pending.release();
+	this->thread.join();
+}
+
+void WindowInfoWorker::Request(WindowHandle handle) {
+	this->inFlight.fetch_add(1, std::memory_order_relaxed);
+
+	// Keep submission order, anything behind the backlog has to wait its turn
+	if (!this->backlog.empty() || !this->requests.TryPush(handle)) {
+		this->backlog.push_back(handle);
+		return;
+	}
+
+	this->pending.release();
+}
+
+void WindowInfoWorker::FlushBacklog() {
+	size_t pushed = 0;
+	while (pushed < this->backlog.size() && this->requests.TryPush(this->backlog[pushed]))
+		pushed++;
+
+	if (pushed == 0) return;
+
+	this->backlog.erase(this->backlog.begin(), this->backlog.begin() + pushed);
+	this->pending.release((std::ptrdiff_t)pushed);
+}
+
+void WindowInfoWorker::Work(std::stop_token stop) {
+	WindowHandle handle = 0;
+
+	while (!stop.stop_requested()) {
+		this->pending.acquire();
+
+		bool produced = false;
+		while (!stop.stop_requested() && this->requests.TryPop(handle)) {
+			WindowInfo info = this->resolver->Resolve(handle);
+
+			// The UI drains once per frame, if it's behind make sure it's awake and back off
+			while (!this->results.TryPush(std::move(info))) {
+				if (stop.stop_requested()) return;
+				if (this->onReady) this->onReady();
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+
+			produced = true;
+		}
+
+		if (produced && this->onReady)
+			this->onReady();
+	}
+}
@@ -0,0 +1,221 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "app_index_file.h"
+
+using namespace IMS;
+
+namespace {
+	/// <summary>
+	/// Two nested folders of shortcuts, some pointing at the same program
+	/// </summary>
+	std::shared_ptr<const AppSnapshot> sampleSnapshot() {
+		AppSnapshotBuilder builder;
+		builder.BeginDirectory("C:\\Start Menu", 100);
+		builder.Add("Notepad", "C:\\Start Menu\\Notepad.lnk", { "C:\\Windows\\notepad.exe", {}, "", "%USERPROFILE%", "", 0 });
+		builder.BeginDirectory("C:\\Start Menu\\Tools", 200);
+		builder.Add("Paint", "C:\\Start Menu\\Tools\\Paint.lnk", { "C:\\Windows\\System32\\mspaint.exe", {}, "/pt", "", "C:\\icons.dll", -3 });
+		builder.Add("Paint (copy)", "C:\\Start Menu\\Tools\\Paint (copy).lnk", { "C:\\Windows\\System32\\mspaint.exe", {}, "/pt", "", "", 0 });
+		builder.Add("Caf\xC3\xA9", "C:\\Start Menu\\Tools\\Caf\xC3\xA9.lnk");
+		builder.EndDirectory();
+		builder.BeginDirectory("C:\\Start Menu\\Empty", 300);
+		builder.EndDirectory();
+		builder.EndDirectory();
+		return builder.Build();
+	}
+
+	std::vector<char> readFile(const std::filesystem::path& path) {
+		std::ifstream in(path, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	void writeFile(const std::filesystem::path& path, const char* data, size_t size) {
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(data, (std::streamsize)size);
+	}
+
+	/// <summary>
+	/// Rejected files log a warning each, thousands of them here
+	/// </summary>
+	struct QuietLog {
+		QuietLog() : level(spdlog::get_level()) { spdlog::set_level(spdlog::level::err); }
+		~QuietLog() { spdlog::set_level(this->level); }
+		spdlog::level::level_enum level;
+	};
+} // namespace
+
+IMS_TEST(AppIndexFileRoundTrips) {
+	Test::TempDirectory temp("imsplorer-test-app-index-file");
+	auto saved = sampleSnapshot();
+	IMS_CHECK(SaveAppIndex(*saved, temp.path / "index.bin"));
+
+	auto loaded = LoadAppIndex(temp.path / "index.bin");
+	IMS_CHECK(loaded != nullptr);
+	if (!loaded) return;
+
+	IMS_CHECK(loaded->Size() == saved->Size());
+	for (size_t i = 0; i < saved->Size() && i < loaded->Size(); i++) {
+		IMS_CHECK(loaded->Name(i) == saved->Name(i));
+		IMS_CHECK(loaded->LowerName(i) == saved->LowerName(i));
+		IMS_CHECK(loaded->Path(i) == saved->Path(i));
+		IMS_CHECK(loaded->Target(i) == saved->Target(i));
+		IMS_CHECK(loaded->Arguments(i) == saved->Arguments(i));
+		IMS_CHECK(loaded->WorkingDirectory(i) == saved->WorkingDirectory(i));
+		IMS_CHECK(loaded->IconLocation(i) == saved->IconLocation(i));
+		IMS_CHECK(loaded->IconIndex(i) == saved->IconIndex(i));
+		IMS_CHECK(loaded->TargetName(i) == saved->TargetName(i));
+		IMS_CHECK(loaded->LowerTargetName(i) == saved->LowerTargetName(i));
+		IMS_CHECK(loaded->Primary(i) == saved->Primary(i));
+		IMS_CHECK(loaded->Entries()[i].directory == saved->Entries()[i].directory);
+	}
+
+	auto savedDirectories = saved->Directories(), loadedDirectories = loaded->Directories();
+	IMS_CHECK(loadedDirectories.size() == savedDirectories.size());
+	for (size_t i = 0; i < savedDirectories.size() && i < loadedDirectories.size(); i++) {
+		IMS_CHECK(loaded->DirectoryPath(i) == saved->DirectoryPath(i));
+		IMS_CHECK(loadedDirectories[i].modified == savedDirectories[i].modified);
+		IMS_CHECK(loadedDirectories[i].parent == savedDirectories[i].parent);
+		IMS_CHECK(loadedDirectories[i].subtreeEnd == savedDirectories[i].subtreeEnd);
+	}
+
+	IMS_CHECK(loaded->LowerNames() == saved->LowerNames());
+	IMS_CHECK(loaded->LowerTargetNames() == saved->LowerTargetNames());
+
+	// The same copy of the program is listed once
+	IMS_CHECK(std::count_if(loaded->Entries().begin(), loaded->Entries().end(), [&](const AppEntry& entry) {
+		return entry.primary != (uint32_t)(&entry - loaded->Entries().data());
+	}) == 1);
+}
+
+IMS_TEST(AppIndexFileRejectsEveryTruncation) {
+	QuietLog quiet;
+	Test::TempDirectory temp("imsplorer-test-app-index-truncated");
+	IMS_CHECK(SaveAppIndex(*sampleSnapshot(), temp.path / "index.bin"));
+	std::vector<char> valid = readFile(temp.path / "index.bin");
+	IMS_CHECK(valid.size() > sizeof(AppIndexFileHeader));
+
+	bool rejected = true;
+	for (size_t size = 0; size < valid.size(); size++) {
+		writeFile(temp.path / "truncated.bin", valid.data(), size);
+		if (LoadAppIndex(temp.path / "truncated.bin")) {
+			spdlog::error("A {} byte prefix of a {} byte index loaded", size, valid.size());
+			rejected = false;
+		}
+	}
+	IMS_CHECK(rejected);
+
+	// Trailing garbage is as wrong as missing bytes
+	std::vector<char> longer = valid;
+	longer.push_back(0);
+	writeFile(temp.path / "longer.bin", longer.data(), longer.size());
+	IMS_CHECK(!LoadAppIndex(temp.path / "longer.bin"));
+}
+
+IMS_TEST(AppIndexFileRejectsBitFlips) {
+	QuietLog quiet;
+	Test::TempDirectory temp("imsplorer-test-app-index-flipped");
+	IMS_CHECK(SaveAppIndex(*sampleSnapshot(), temp.path / "index.bin"));
+	std::vector<char> valid = readFile(temp.path / "index.bin");
+
+	// Every bit of the header, one bit of every byte of the records and the blob
+	auto flip = [&](size_t byte, int bit) {
+		std::vector<char> corrupted = valid;
+		corrupted[byte] ^= (char)(1 << bit);
+		writeFile(temp.path / "flipped.bin", corrupted.data(), corrupted.size());
+		if (!LoadAppIndex(temp.path / "flipped.bin")) return true;
+
+		spdlog::error("Flipping bit {} of byte {} went unnoticed", bit, byte);
+		return false;
+	};
+
+	bool rejected = true;
+	for (size_t byte = 0; byte < sizeof(AppIndexFileHeader); byte++) {
+		for (int bit = 0; bit < 8; bit++)
+			rejected = flip(byte, bit) && rejected;
+	}
+	for (size_t byte = sizeof(AppIndexFileHeader); byte < valid.size(); byte++)
+		rejected = flip(byte, (int)(byte % 8)) && rejected;
+	IMS_CHECK(rejected);
+}
+
+IMS_TEST(AppIndexFileRejectsOtherFormats) {
+	QuietLog quiet;
+	Test::TempDirectory temp("imsplorer-test-app-index-format");
+	IMS_CHECK(SaveAppIndex(*sampleSnapshot(), temp.path / "index.bin"));
+	std::vector<char> valid = readFile(temp.path / "index.bin");
+	IMS_CHECK(LoadAppIndex(temp.path / "index.bin") != nullptr);
+
+	// Only the header changes, the checksum over the rest still matches
+	auto loadsWith = [&](const std::function<void(AppIndexFileHeader&)>& change) {
+		std::vector<char> copy = valid;
+		AppIndexFileHeader header;
+		std::memcpy(&header, copy.data(), sizeof(header));
+		change(header);
+		std::memcpy(copy.data(), &header, sizeof(header));
+		writeFile(temp.path / "other.bin", copy.data(), copy.size());
+		return LoadAppIndex(temp.path / "other.bin") != nullptr;
+	};
+
+	IMS_CHECK(loadsWith([](AppIndexFileHeader&) {}));
+	IMS_CHECK(!loadsWith([](AppIndexFileHeader& header) { std::memcpy(header.magic, "IMSFONTS", 8); }));
+	IMS_CHECK(!loadsWith([](AppIndexFileHeader& header) { header.version = AppIndexFileHeader::kVersion - 1; }));
+	IMS_CHECK(!loadsWith([](AppIndexFileHeader& header) { header.version = AppIndexFileHeader::kVersion + 1; }));
+	IMS_CHECK(!loadsWith([](AppIndexFileHeader& header) { header.headerSize += 8; }));
+	IMS_CHECK(!loadsWith([](AppIndexFileHeader& header) { header.directorySize += 8; }));
+	IMS_CHECK(!loadsWith([](AppIndexFileHeader& header) { header.entrySize -= 4; }));
+
+	// Missing and empty files are just not there
+	IMS_CHECK(!LoadAppIndex(temp.path / "missing.bin"));
+	writeFile(temp.path / "empty.bin", nullptr, 0);
+	IMS_CHECK(!LoadAppIndex(temp.path / "empty.bin"));
+}
+
+IMS_TEST(ShortcutScannerOnlyRelistsStaleFolders) {
+	namespace fs = std::filesystem;
+
+	QuietLog quiet; // The empty .lnk files don't parse
+	Test::TempDirectory temp("imsplorer-test-shortcut-scanner");
+	fs::path root = temp.path / "Programs";
+	fs::create_directories(root / "Games");
+	fs::create_directories(root / "Tools" / "Admin");
+	for (const fs::path& shortcut : { root / "Browser.lnk", root / "Games" / "Solitaire.lnk", root / "Tools" / "Paint.lnk", root / "Tools" / "Admin" / "Registry.lnk" })
+		std::ofstream(shortcut) << "";
+
+	auto scan = [&](ShortcutScanner& scanner) {
+		AppSnapshotBuilder builder;
+		scanner.Scan(root, builder);
+		builder.ResolveShortcuts();
+		return builder.Build();
+	};
+
+	ShortcutScanner first;
+	auto snapshot = scan(first);
+	IMS_CHECK(snapshot->Size() == 4);
+	IMS_CHECK(snapshot->Directories().size() == 4);
+	IMS_CHECK(first.Rescanned() == 4 && first.Reused() == 0);
+
+	// Nothing changed, every folder is carried over
+	ShortcutScanner unchanged(snapshot);
+	snapshot = scan(unchanged);
+	IMS_CHECK(unchanged.Rescanned() == 0 && unchanged.Reused() == 4);
+	IMS_CHECK(snapshot->Size() == 4);
+
+	// A shortcut added to Tools moves only its modification time, its parent and its subfolder are reused
+	std::ofstream(root / "Tools" / "Terminal.lnk") << "";
+	fs::last_write_time(root / "Tools", fs::last_write_time(root / "Tools") + std::chrono::hours(1));
+
+	ShortcutScanner stale(snapshot);
+	snapshot = scan(stale);
+	IMS_CHECK(stale.Rescanned() == 1 && stale.Reused() == 3);
+	IMS_CHECK(snapshot->Size() == 5);
+
+	// Carried over shortcuts keep their folder
+	bool found = false;
+	for (size_t i = 0; i < snapshot->Size(); i++) {
+		if (snapshot->Name(i) != "Registry") continue;
+		found = true;
+		IMS_CHECK(snapshot->DirectoryPath(snapshot->Entries()[i].directory) == PathToUtf8(root / "Tools" / "Admin"));
+	}
+	IMS_CHECK(found);
+}
@@ -0,0 +1,68 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "app_index.h"
+
+using namespace IMS;
+
+IMS_TEST(AppIndexMergesEveryRoot) {
+	namespace fs = std::filesystem;
+
+	// Machine wide and per-user folders at different depths, so the fixture's relative target resolves differently
+	Test::TempDirectory temp("imsplorer-test-app-index");
+	fs::path machine = temp.path / "ProgramData" / "Programs";
+	fs::path user = temp.path / "User";
+	fs::create_directories(machine / "Accessories");
+	fs::create_directories(user);
+
+	fs::path fixture = Test::DataPath("relative.lnk");
+	for (const fs::path& shortcut : { machine / "Notepad.lnk", machine / "Accessories" / "MS Paint.lnk", user / "Zebra Browser.lnk", user / PathFromUtf8("CAF\xC3\x89 Menu.lnk") })
+		fs::copy_file(fixture, shortcut);
+
+	AppIndex index;
+	IMS_CHECK(index.Snapshot() && index.Snapshot()->Empty());
+	index.Scan({ machine, user });
+	auto snapshot = index.Snapshot();
+	IMS_CHECK(snapshot->Size() == 4);
+	if (snapshot->Size() != 4) return;
+
+	// Sorted by the lowercased name, only ASCII gets lowercased
+	struct Expected {
+		std::string_view name, lower;
+		fs::path path;
+	};
+	const Expected expected[] = {
+		{ "CAF\xC3\x89 Menu", "caf\xC3\x89 menu", user / PathFromUtf8("CAF\xC3\x89 Menu.lnk") },
+		{ "MS Paint", "ms paint", machine / "Accessories" / "MS Paint.lnk" },
+		{ "Notepad", "notepad", machine / "Notepad.lnk" },
+		{ "Zebra Browser", "zebra browser", user / "Zebra Browser.lnk" },
+	};
+
+	std::string lowerNames;
+	for (size_t i = 0; i < snapshot->Size(); i++) {
+		IMS_CHECK(snapshot->Name(i) == expected[i].name);
+		IMS_CHECK(snapshot->LowerName(i) == expected[i].lower);
+		IMS_CHECK(snapshot->Path(i) == PathToUtf8(expected[i].path));
+		IMS_CHECK(std::strlen(snapshot->NameCStr(i)) == expected[i].name.size());
+
+		// Read from the file, relative to the folder it's in
+		fs::path target = (expected[i].path.parent_path() / ".." / "Tools" / "app.exe").lexically_normal();
+		IMS_CHECK(PathFromUtf8(snapshot->Target(i)) == target);
+		IMS_CHECK(snapshot->TargetName(i) == "app" && snapshot->LowerTargetName(i) == "app");
+		IMS_CHECK(snapshot->Arguments(i) == "--flag \"quoted arg\"");
+
+		IMS_CHECK(snapshot->DirectoryPath(snapshot->Entries()[i].directory) == PathToUtf8(expected[i].path.parent_path()));
+
+		lowerNames.append(expected[i].lower);
+		lowerNames.push_back('\0');
+	}
+	IMS_CHECK(snapshot->LowerNames() == lowerNames);
+
+	// Both roots and the subfolder
+	IMS_CHECK(snapshot->Directories().size() == 3);
+
+	// The user's two shortcuts launch the same thing, only the first one by name is listed
+	IMS_CHECK(!snapshot->IsDuplicate(0) && snapshot->IsDuplicate(3) && snapshot->Primary(3) == 0);
+	IMS_CHECK(!snapshot->IsDuplicate(1) && !snapshot->IsDuplicate(2));
+}
@@ -0,0 +1,307 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "app_search.h"
+
+using namespace IMS;
+
+namespace {
+	/// <summary>
+	/// Wall time only, set by the test
+	/// </summary>
+	class FakeClock : public IClock {
+	public:
+		std::chrono::steady_clock::time_point Now() const override { return {}; }
+		std::chrono::system_clock::time_point WallNow() const override { return this->wall; }
+
+		std::chrono::system_clock::time_point wall{ std::chrono::seconds(1'700'000'000) };
+	};
+
+	std::shared_ptr<const AppSnapshot> sampleApps() {
+		AppSnapshotBuilder builder;
+		builder.Add("Notepad", "C:\\Start Menu\\Notepad.lnk");
+		builder.Add("Notes", "C:\\Start Menu\\Notes.lnk");
+		builder.Add("Paint", "C:\\Start Menu\\Paint.lnk");
+		return builder.Build();
+	}
+
+	int32_t scoreOf(const std::vector<SearchResult>& results, const AppSnapshot& apps, std::string_view name) {
+		for (const SearchResult& result : results) {
+			if (apps.Name(result.index) == name) return result.score;
+		}
+		return kNoMatch;
+	}
+} // namespace
+
+IMS_TEST(AppSearchDecaysLaunchesAgainstItsClock) {
+	auto apps = sampleApps();
+	FakeClock clock;
+	LaunchHistory history;
+	history.Record(apps->Path(1), clock.wall);
+
+	AppSearch plain;
+	const std::vector<SearchResult>& unranked = plain.Query(apps, "note", 10);
+	IMS_CHECK(unranked.size() == 2 && apps->Name(unranked[0].index) == "Notepad");
+	int32_t base = scoreOf(unranked, *apps, "Notes");
+
+	// Launched just now, a score of 1 is worth one doubling
+	AppSearch now;
+	now.SetHistory(&history, &clock);
+	const std::vector<SearchResult>& launched = now.Query(apps, "note", 10);
+	IMS_CHECK(launched.size() == 2 && apps->Name(launched[0].index) == "Notes");
+	IMS_CHECK(scoreOf(launched, *apps, "Notes") == base + 12);
+	IMS_CHECK(scoreOf(launched, *apps, "Notepad") == scoreOf(unranked, *apps, "Notepad"));
+
+	// A half-life later it's halved, the same whatever the time the test runs at
+	clock.wall += std::chrono::seconds(LaunchHistory::kHalfLife);
+	AppSearch later;
+	later.SetHistory(&history, &clock);
+	IMS_CHECK(scoreOf(later.Query(apps, "note", 10), *apps, "Notes") == base + (int32_t)(12 * std::log2(1.5)));
+
+	// Long forgotten
+	clock.wall += std::chrono::seconds(LaunchHistory::kHalfLife * 30);
+	AppSearch forgotten;
+	forgotten.SetHistory(&history, &clock);
+	const std::vector<SearchResult>& decayed = forgotten.Query(apps, "note", 10);
+	IMS_CHECK(decayed.size() == 2 && apps->Name(decayed[0].index) == "Notepad");
+	IMS_CHECK(scoreOf(decayed, *apps, "Notes") == base);
+}
+
+IMS_TEST(AppSearchListsRecentAppsFirst) {
+	auto apps = sampleApps();
+	FakeClock clock;
+	LaunchHistory history;
+	history.Record(apps->Path(2), clock.wall - std::chrono::hours(1));
+	history.Record(apps->Path(1), clock.wall);
+
+	AppSearch search;
+	search.SetHistory(&history, &clock);
+	const std::vector<SearchResult>& results = search.Query(apps, "", 10);
+	IMS_CHECK(results.size() == 3);
+	if (results.size() != 3) return;
+	IMS_CHECK(apps->Name(results[0].index) == "Notes" && apps->Name(results[1].index) == "Paint" && apps->Name(results[2].index) == "Notepad");
+
+	// Another launch is picked up without a new search
+	history.Record(apps->Path(0), clock.wall);
+	history.Record(apps->Path(0), clock.wall);
+	IMS_CHECK(apps->Name(search.Query(apps, "", 10)[0].index) == "Notepad");
+}
+
+namespace {
+	/// <summary>
+	/// Tools 000 to 199, every tenth one also linked from a vendor folder, plus a few others
+	/// </summary>
+	std::shared_ptr<const AppSnapshot> toolApps() {
+		AppSnapshotBuilder builder;
+		for (int i = 0; i < 200; i++) {
+			ShellLink link;
+			link.target = fmt::format("C:\\Program Files\\Tools\\tool{}.exe", i);
+			builder.Add(fmt::format("Tool {:03}", i), fmt::format("C:\\Start Menu\\Tool {:03}.lnk", i), link);
+			if (i % 10 == 0)
+				builder.Add(fmt::format("Vendor Tool {}", i), fmt::format("C:\\Start Menu\\Vendor\\Tool {}.lnk", i), link);
+		}
+		builder.Add("Toolbox", "C:\\Start Menu\\Toolbox.lnk");
+		builder.Add("Total Commander", "C:\\Start Menu\\Total Commander.lnk");
+		builder.Add("Outlook", "C:\\Start Menu\\Outlook.lnk");
+		return builder.Build();
+	}
+
+	/// <summary>
+	/// Score every entry and keep each program's best, the best `limit` of them: Query without the heap or candidates
+	/// </summary>
+	std::vector<SearchResult> rescan(const AppSnapshot& apps, std::string_view query, size_t limit) {
+		std::vector<SearchResult> all;
+		for (size_t i = 0; i < apps.Size(); i++) {
+			int32_t score = FuzzyScore(apps.Name(i), apps.LowerName(i), query);
+			int32_t target = apps.LowerTargetName(i).empty() ? kNoMatch : FuzzyScore(apps.TargetName(i), apps.LowerTargetName(i), query);
+			if (target != kNoMatch) score = (std::max)(score, target - 8); // A match on the file it runs counts 8 less
+			if (score != kNoMatch) all.push_back({ (uint32_t)i, score });
+		}
+		std::sort(all.begin(), all.end(), [](const SearchResult& a, const SearchResult& b) { return a.score != b.score ? a.score > b.score : a.index < b.index; });
+
+		std::vector<SearchResult> best;
+		std::set<uint32_t> primaries;
+		for (const SearchResult& result : all) {
+			if (best.size() < limit && primaries.insert(apps.Primary(result.index)).second)
+				best.push_back(result);
+		}
+		return best;
+	}
+
+	bool sameResults(const std::vector<SearchResult>& a, const std::vector<SearchResult>& b) {
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const SearchResult& x, const SearchResult& y) { return x.index == y.index && x.score == y.score; });
+	}
+} // namespace
+
+IMS_TEST(FuzzyScoreMatchesSubsequences) {
+	auto score = [](std::string_view name, std::string_view query) {
+		std::string lower(name);
+		std::transform(lower.begin(), lower.end(), lower.begin(), ToLowerAscii);
+		return FuzzyScore(name, lower, query);
+	};
+
+	// In order, not necessarily next to each other
+	IMS_CHECK(score("Notepad", "ntp") != kNoMatch);
+	IMS_CHECK(score("Notepad", "pn") == kNoMatch);
+	IMS_CHECK(score("Notepad", "notepads") == kNoMatch);
+	IMS_CHECK(score("Notepad", "x") == kNoMatch);
+	IMS_CHECK(score("Notepad", "") == 0);
+
+	// The whole name beats a prefix beats the middle, a run beats the same letters apart
+	IMS_CHECK(score("Paint", "paint") > score("Paintbrush", "paint"));
+	IMS_CHECK(score("Paintbrush", "paint") > score("MS Paintbrush", "paint"));
+	IMS_CHECK(score("Notepad", "note") > score("Notepad", "ntep"));
+
+	// Fewer and shorter gaps score higher
+	IMS_CHECK(score("abcd", "ad") > score("abcdef", "af"));
+	IMS_CHECK(score("abxcd", "abcd") > score("axbxcxd", "abcd"));
+
+	// The tightest window wins, the stray "a" at the start doesn't drag "ab" into a gap
+	IMS_CHECK(score("a_xab", "ab") == score("c_xab", "ab"));
+
+	// Shorter names first when everything else is equal
+	IMS_CHECK(score("Tool", "t") > score("Tool with a long name", "t"));
+}
+
+IMS_TEST(FuzzyScorePrefersWordBoundaries) {
+	auto score = [](std::string_view name, std::string_view query) {
+		std::string lower(name);
+		std::transform(lower.begin(), lower.end(), lower.begin(), ToLowerAscii);
+		return FuzzyScore(name, lower, query);
+	};
+
+	// After a separator, a lowercase to uppercase step, or a letter to digit step, the first query letter counts double
+	int32_t inside = score("Foobar", "b");
+	IMS_CHECK(score("Foo Bar", "b") == inside + 16);
+	IMS_CHECK(score("Foo-Bar", "b") == inside + 16);
+	IMS_CHECK(score("Foo_bar", "b") == inside + 16);
+	IMS_CHECK(score("Foo.bar", "b") == inside + 16);
+	IMS_CHECK(score("Foo(bar", "b") == inside + 16);
+	IMS_CHECK(score("FooBar", "b") == inside + 14);
+	IMS_CHECK(score("Foo2", "2") == score("Fooz", "z") + 14);
+	IMS_CHECK(score("12", "2") == score("1z", "z"));
+	IMS_CHECK(score("FOOBAR", "b") == inside);
+
+	// Initials
+	IMS_CHECK(score("Visual Studio Code", "vsc") > score("Visualscope", "vsc"));
+	IMS_CHECK(score("GitHub Desktop", "ghd") > score("Ghidra", "ghd"));
+}
+
+IMS_TEST(AppSearchKeepsTheBestResultsInOrder) {
+	auto apps = toolApps();
+	AppSearch search;
+
+	// Nothing that belongs in the top `limit` gets lost, however many match
+	for (std::string_view query : { "o", "tool", "t1", "l9", "vendor", "outlook", "tc", "zzz" }) {
+		for (size_t limit : { 1, 5, 32, 1000 })
+			IMS_CHECK(sameResults(search.Query(apps, query, limit), rescan(*apps, query, limit)));
+	}
+
+	// Best first, ties alphabetical
+	const std::vector<SearchResult>& results = search.Query(apps, "tool", 50);
+	IMS_CHECK(results.size() == 50);
+	IMS_CHECK(std::is_sorted(results.begin(), results.end(), [](const SearchResult& a, const SearchResult& b) {
+		return a.score != b.score ? a.score > b.score : a.index < b.index;
+	}));
+	IMS_CHECK(!results.empty() && apps->Name(results[0].index) == "Tool 000"); // Ties with "Toolbox", a space sorts first
+	IMS_CHECK(search.Query(apps, "zzz", 10).empty() && search.MatchCount() == 0);
+	IMS_CHECK(search.Query(apps, "tool", 0).empty() && search.MatchCount() > 200);
+}
+
+IMS_TEST(AppSearchListsAProgramOnceAndStillFillsTheLimit) {
+	AppSnapshotBuilder builder;
+	ShellLink editor;
+	editor.target = "C:\\Program Files\\Editor\\editor.exe";
+	builder.Add("Editor", "C:\\Start Menu\\Editor.lnk", editor);
+	builder.Add("Editor (User)", "C:\\Users\\A\\Start Menu\\Editor.lnk", editor);
+	builder.Add("Editor Launcher", "C:\\Start Menu\\Editor\\Editor Launcher.lnk", editor);
+	builder.Add("Editor Tools", "C:\\Start Menu\\Editor Tools.lnk");
+	builder.Add("Code Editor", "C:\\Start Menu\\Code Editor.lnk");
+	builder.Add("Hex Editor Neo", "C:\\Start Menu\\Hex Editor Neo.lnk");
+	auto apps = builder.Build();
+
+	// The editor's shortcuts are three of the four best matches, they still take one slot
+	AppSearch search;
+	const std::vector<SearchResult>& results = search.Query(apps, "editor", 3);
+	IMS_CHECK(search.MatchCount() == 6);
+	IMS_CHECK(results.size() == 3);
+	if (results.size() == 3) {
+		IMS_CHECK(apps->Name(results[0].index) == "Editor");
+		IMS_CHECK(apps->Name(results[1].index) == "Editor Tools");
+		IMS_CHECK(apps->Name(results[2].index) == "Code Editor");
+	}
+
+	// Under whichever of its names matched best
+	const std::vector<SearchResult>& launcher = search.Query(apps, "launch", 3);
+	IMS_CHECK(launcher.size() == 1 && apps->Name(launcher[0].index) == "Editor Launcher" && apps->IsDuplicate(launcher[0].index));
+
+	// Everything there is, each program once
+	const std::vector<SearchResult>& all = search.Query(apps, "e", 100);
+	std::set<uint32_t> primaries;
+	for (const SearchResult& result : all)
+		primaries.insert(apps->Primary(result.index));
+	IMS_CHECK(all.size() == 4 && primaries.size() == 4);
+	IMS_CHECK(sameResults(all, rescan(*apps, "e", 100)));
+}
+
+IMS_TEST(AppSearchNarrowingMatchesAFullRescan) {
+	auto apps = toolApps();
+	AppSearch typing;
+
+	// Typed a letter at a time, with a backspace and a change of mind, against a fresh search every time
+	for (std::string_view query : { "t", "to", "too", "tool", "tool ", "tool 1", "tool 12", "tool 1", "tool 19", "vendor", "vendor t", "o", "ou" }) {
+		for (size_t limit : { 3, 40 }) {
+			AppSearch fresh;
+			const std::vector<SearchResult>& expected = fresh.Query(apps, query, limit);
+			const std::vector<SearchResult>& results = typing.Query(apps, query, limit);
+			IMS_CHECK(sameResults(results, expected));
+			IMS_CHECK(typing.MatchCount() == fresh.MatchCount());
+		}
+	}
+
+	// A new snapshot isn't narrowed from the old one
+	AppSnapshotBuilder builder;
+	builder.Add("Tool 500", "C:\\Start Menu\\Tool 500.lnk");
+	auto other = builder.Build();
+	typing.Query(apps, "tool", 10);
+	IMS_CHECK(typing.Query(other, "tool 5", 10).size() == 1 && typing.MatchCount() == 1);
+}
+
+IMS_TEST(FilterByCharMatchesAScalarScan) {
+	// Names and targets of every length, so hits land everywhere in the 16 byte chunks and across entries
+	AppSnapshotBuilder builder;
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+	auto next = [&](uint64_t bound) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		return (state >> 33) % bound;
+	};
+	static constexpr std::string_view alphabet = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 -_.";
+	auto word = [&](size_t length) {
+		std::string result;
+		for (size_t i = 0; i < length; i++)
+			result.push_back(alphabet[next(alphabet.size())]);
+		return result;
+	};
+	for (int i = 0; i < 300; i++) {
+		ShellLink link;
+		if (i % 3 != 0) link.target = fmt::format("C:\\Program Files\\{}.exe", word(1 + next(40)));
+		builder.Add(fmt::format("{}{}", word(1 + next(48)), i), fmt::format("C:\\Start Menu\\{}.lnk", i), link);
+	}
+	auto apps = builder.Build();
+
+	bool same = true;
+	for (char c : std::string_view("abcdefghijklmnopqrstuvwxyz0123456789 -_.!")) {
+		std::vector<uint32_t> expected = { 7 };
+		for (size_t i = 0; i < apps->Size(); i++) {
+			if (apps->LowerName(i).find(c) != std::string_view::npos || apps->LowerTargetName(i).find(c) != std::string_view::npos)
+				expected.push_back((uint32_t)i);
+		}
+
+		// Appended after what's already there
+		std::vector<uint32_t> filtered = { 7 };
+		FilterByChar(*apps, c, filtered);
+		same = same && filtered == expected;
+	}
+	IMS_CHECK(same);
+}
@@ -0,0 +1,109 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "async_log.h"
+
+#include <spdlog/sinks/base_sink.h>
+
+using namespace IMS;
+
+namespace {
+	/// <summary>
+	/// Keeps every line that reaches it
+	/// </summary>
+	class LineSink : public spdlog::sinks::base_sink<std::mutex> {
+	public:
+		std::vector<std::string> Lines() {
+			std::lock_guard lock(this->mutex_);
+			return this->lines;
+		}
+
+	protected:
+		void sink_it_(const spdlog::details::log_msg& msg) override { this->lines.emplace_back(msg.payload.data(), msg.payload.size()); }
+		void flush_() override {}
+
+	private:
+		std::vector<std::string> lines;
+	};
+} // namespace
+
+#if IMS_LOG_LEVEL <= IMS_LOG_LEVEL_INFO
+IMS_TEST(AsyncLogWakesUpForTheFirstMessage) {
+	AsyncLog& log = AsyncLog::Get();
+	auto sink = std::make_shared<LineSink>();
+	IMS_CHECK(log.Start(sink, 64));
+
+	// The drain thread is asleep with no timer by now, a message alone has to get it going
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	IMS_LOG_INFO("window {:x} at {:.1f}% CPU, {}", 0x1234, 12.5, "explorer.exe");
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (sink->Lines().empty() && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	std::vector<std::string> lines = sink->Lines();
+	IMS_CHECK(lines.size() == 1 && lines[0] == "window 1234 at 12.5% CPU, explorer.exe");
+
+	// Again after it went back to sleep
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	IMS_LOG_INFO("{}", std::string(1000, 'x'));
+	log.Flush();
+	IMS_CHECK(sink->Lines().size() == 2);
+	IMS_CHECK(log.Truncated() == 1);
+
+	log.Stop();
+	IMS_CHECK(!log.Running());
+
+	// Ignored while stopped, not dropped
+	IMS_LOG_INFO("after {}", 1);
+	IMS_CHECK(sink->Lines().size() == 2 && log.Dropped() == 0);
+}
+
+IMS_TEST(AsyncLogAccountsForEveryCallUnderLoad) {
+	AsyncLog& log = AsyncLog::Get();
+	auto sink = std::make_shared<LineSink>();
+	IMS_CHECK(log.Start(sink, 256));
+
+	// More than the ring holds at once, so the high-water wake has to keep it draining
+	static constexpr int threads = 4, calls = 20'000;
+	std::vector<std::jthread> writers;
+	for (int t = 0; t < threads; t++) {
+		writers.emplace_back([t] {
+			for (int i = 0; i < calls; i++)
+				IMS_LOG_INFO("thread {} call {}", t, i);
+		});
+	}
+	writers.clear();
+	log.Flush();
+
+	IMS_CHECK(log.Written() + log.Dropped() == (uint64_t)threads * calls);
+	IMS_CHECK(sink->Lines().size() >= log.Written());
+	log.Stop();
+}
+
+IMS_TEST(AsyncLogSurvivesLoggingAcrossStopAndStart) {
+	AsyncLog& log = AsyncLog::Get();
+	std::atomic<bool> done = false;
+
+	// Keeps logging through every Stop and Start, calls that race with them may be lost but never touch freed slots
+	std::vector<std::jthread> writers;
+	for (int t = 0; t < 3; t++) {
+		writers.emplace_back([&, t] {
+			for (int i = 0; !done.load(std::memory_order_relaxed); i++)
+				IMS_LOG_INFO("thread {} call {} {}", t, i, "some text to copy");
+		});
+	}
+
+	for (int round = 0; round < 20; round++) {
+		auto sink = std::make_shared<LineSink>();
+		IMS_CHECK(log.Start(sink, (size_t)16 << (round % 4)));
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		log.Stop();
+	}
+
+	done = true;
+	writers.clear();
+	IMS_CHECK(!log.Running());
+}
+#endif
@@ -0,0 +1,153 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "app_index.h"
+#include "command_index.h"
+
+using namespace IMS;
+
+namespace {
+	/// <summary>
+	/// Names shaped like a crowded PATH: a few tool families, each with many variants sharing a long prefix
+	/// </summary>
+	std::shared_ptr<const CommandSnapshot> syntheticCommands(size_t count) {
+		static constexpr std::string_view families[] = {
+			"git", "git-credential-", "python3.", "pip", "node", "npm", "clang", "clang-tidy-", "llvm-", "VsDevCmd",
+		};
+
+		// xorshift64*
+		uint64_t state = 0xD1B54A32D192ED03ull;
+		auto next = [&]() {
+			state ^= state >> 12; state ^= state << 25; state ^= state >> 27;
+			return state * 0x2545F4914F6CDD1Dull;
+		};
+
+		CommandSnapshotBuilder builder;
+		for (size_t i = 0; i < count; i++) {
+			std::string name(families[next() % std::size(families)]);
+			for (size_t length = next() % 6; length > 0; length--)
+				name.push_back("abcdefghijklmnopqrstuvwxyz0123456789"[next() % 36]);
+			builder.Add(name, fmt::format("/opt/tools{}/bin/{}", i % 16, name));
+		}
+		return builder.Build();
+	}
+
+	/// <summary>
+	/// What the trie should find, by binary search over the sorted names
+	/// </summary>
+	PrefixTrie::Range searchSorted(const std::vector<std::string_view>& names, std::string_view prefix) {
+		std::string lower(prefix);
+		std::transform(lower.begin(), lower.end(), lower.begin(), ToLowerAscii);
+		auto first = std::lower_bound(names.begin(), names.end(), std::string_view(lower));
+		auto last = std::partition_point(first, names.end(), [&](std::string_view name) { return name.starts_with(lower); });
+		return { (uint32_t)(first - names.begin()), (uint32_t)(last - names.begin()) };
+	}
+} // namespace
+
+IMS_TEST(CommandIndexMatchesABinarySearch) {
+	auto commands = syntheticCommands(50'000);
+	std::vector<std::string_view> names(commands->Size());
+	for (size_t i = 0; i < commands->Size(); i++)
+		names[i] = commands->LowerName(i);
+	IMS_CHECK(std::is_sorted(names.begin(), names.end()));
+	IMS_CHECK(std::adjacent_find(names.begin(), names.end()) == names.end());
+
+	// Every prefix of a sample of names, in their own case and uppercased since lookups fold case
+	bool same = true;
+	for (size_t i = 0; i < commands->Size(); i += 37) {
+		std::string name(commands->Name(i));
+		std::string upper = name;
+		std::transform(upper.begin(), upper.end(), upper.begin(), [](char c) { return (char)std::toupper((unsigned char)c); });
+
+		for (size_t length = 0; length <= name.size(); length++) {
+			for (std::string_view prefix : { std::string_view(name).substr(0, length), std::string_view(upper).substr(0, length) }) {
+				PrefixTrie::Range expected = searchSorted(names, prefix), found = commands->Complete(prefix);
+				if (found.begin == expected.begin && found.end == expected.end) continue;
+
+				spdlog::error("'{}' completes to [{}, {}) instead of [{}, {})", prefix, found.begin, found.end, expected.begin, expected.end);
+				same = false;
+			}
+		}
+	}
+	IMS_CHECK(same);
+
+	IMS_CHECK(commands->Complete("zz-not-a-command").Empty());
+	IMS_CHECK(commands->Complete("gitz-").Empty());
+	IMS_CHECK(commands->Complete("").Size() == commands->Size());
+}
+
+IMS_TEST(CommandIndexHandlesKeysThatArePrefixesOfOthers) {
+	CommandSnapshotBuilder builder;
+	for (std::string_view name : { "gitk", "git", "git-lfs", "g", "Git-Bash", "gi" })
+		builder.Add(name, name);
+	auto commands = builder.Build();
+	IMS_CHECK(commands->Size() == 6);
+
+	IMS_CHECK(commands->Complete("g").Size() == 6);
+	IMS_CHECK(commands->Complete("gi").Size() == 5);
+	IMS_CHECK(commands->Complete("git").Size() == 4);
+	IMS_CHECK(commands->Complete("GIT-").Size() == 2);
+	IMS_CHECK(commands->Complete("gitk").Size() == 1);
+	IMS_CHECK(commands->Complete("gitkk").Empty());
+
+	// A key ending inside another's edge sorts first
+	PrefixTrie::Range git = commands->Complete("git");
+	IMS_CHECK(commands->Name(git.begin) == "git");
+	IMS_CHECK(commands->Name(git.end - 1) == "gitk");
+}
+
+IMS_TEST(CommandIndexKeepsTheFirstOfTheSameName) {
+	CommandSnapshotBuilder builder;
+	builder.Add("Tool", "/first/Tool");
+	builder.Add("tool", "/second/tool");
+	builder.Add("TOOL", "/third/TOOL");
+	auto commands = builder.Build();
+
+	IMS_CHECK(commands->Size() == 1);
+	IMS_CHECK(commands->Name(0) == "Tool" && commands->Path(0) == "/first/Tool");
+	IMS_CHECK(commands->Complete("tOOL").Size() == 1);
+}
+
+IMS_TEST(CommandIndexScansTheSearchPathInOrder) {
+	Test::TempDirectory temp("imsplorer-test-command-index");
+	std::filesystem::path root = temp.path;
+	std::filesystem::create_directories(root / "first");
+	std::filesystem::create_directories(root / "second");
+
+#ifdef _WIN32
+	static constexpr const char* tool = "Tool.exe";
+	static constexpr const char* other = "other.exe";
+	static constexpr const char* ignored = "readme.txt";
+#else
+	static constexpr const char* tool = "Tool";
+	static constexpr const char* other = "other";
+	static constexpr const char* ignored = "readme";
+#endif
+	// Two directories sharing a name, plus a file that isn't an executable
+	for (const std::filesystem::path& file : { root / "first" / tool, root / "second" / tool, root / "second" / other, root / "first" / ignored }) {
+		std::ofstream(file) << "#!/bin/sh\n";
+		if (file.filename() != ignored)
+			std::filesystem::permissions(file, std::filesystem::perms::owner_exec, std::filesystem::perm_options::add);
+	}
+
+	// Empty and repeated entries are dropped, quotes too
+	CommandSources sources;
+	sources.directories = SplitSearchPath(PathToUtf8(root / "first") + ";\"" + PathToUtf8(root / "second") + "\";;" + PathToUtf8(root / "first"), ';');
+	IMS_CHECK(sources.directories.size() == 2);
+#ifdef _WIN32
+	sources.extensions = { ".exe" };
+#endif
+
+	CommandSnapshotBuilder builder;
+	IMS_CHECK(builder.Scan(sources) == 3);
+	auto scanned = builder.Build();
+	IMS_CHECK(scanned->Size() == 2);
+
+	// The first directory wins
+	PrefixTrie::Range found = scanned->Complete("tOOL");
+	IMS_CHECK(found.Size() == 1);
+	if (found.Size() == 1)
+		IMS_CHECK(scanned->Name(found.begin) == tool && PathFromUtf8(scanned->Path(found.begin)) == root / "first" / tool);
+	IMS_CHECK(scanned->Complete(ignored).Empty());
+}
@@ -0,0 +1,211 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "dir_watcher.h"
+
+using namespace IMS;
+
+namespace {
+	FileChange change(FileChangeType type, std::filesystem::path path, std::filesystem::path oldPath = {}) {
+		return { type, std::move(path), std::move(oldPath) };
+	}
+
+	bool same(const FileChangeBatch& batch, std::initializer_list<FileChange> expected) {
+		return std::equal(batch.changes.begin(), batch.changes.end(), expected.begin(), expected.end(), [](const FileChange& a, const FileChange& b) {
+			return a.type == b.type && a.path == b.path && a.oldPath == b.oldPath;
+		});
+	}
+
+	/// <summary>
+	/// Poll until `done` says the changes so far are complete, or give up after a couple of seconds
+	/// </summary>
+	std::vector<FileChange> pollUntil(IDirWatchBackend& backend, const std::function<bool(const std::vector<FileChange>&)>& done) {
+		std::vector<FileChange> changes;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+		while (!done(changes) && std::chrono::steady_clock::now() < deadline)
+			backend.Poll(std::chrono::milliseconds(50), changes);
+		return changes;
+	}
+
+	bool contains(const std::vector<FileChange>& changes, const FileChange& expected) {
+		return std::any_of(changes.begin(), changes.end(), [&](const FileChange& c) {
+			return c.type == expected.type && c.path == expected.path && c.oldPath == expected.oldPath;
+		});
+	}
+} // namespace
+
+IMS_TEST(FileChangeCoalescerCancelsAndMergesChangesToOnePath) {
+	FileChangeCoalescer coalescer;
+	IMS_CHECK(coalescer.Empty());
+
+	// Added and removed again: nothing happened
+	coalescer.Push(change(FileChangeType::Added, "a.lnk"));
+	coalescer.Push(change(FileChangeType::Modified, "a.lnk"));
+	coalescer.Push(change(FileChangeType::Removed, "a.lnk"));
+	IMS_CHECK(coalescer.Empty());
+
+	// Repeated modifications are one
+	coalescer.Push(change(FileChangeType::Modified, "b.lnk"));
+	coalescer.Push(change(FileChangeType::Modified, "b.lnk"));
+
+	// Modified then removed is just removed
+	coalescer.Push(change(FileChangeType::Modified, "c.lnk"));
+	coalescer.Push(change(FileChangeType::Removed, "c.lnk"));
+
+	// Removed and added again: replaced, so modified
+	coalescer.Push(change(FileChangeType::Removed, "d.lnk"));
+	coalescer.Push(change(FileChangeType::Added, "d.lnk"));
+
+	IMS_CHECK(same(coalescer.Take(), {
+		change(FileChangeType::Modified, "b.lnk"),
+		change(FileChangeType::Removed, "c.lnk"),
+		change(FileChangeType::Modified, "d.lnk"),
+	}));
+	IMS_CHECK(coalescer.Empty());
+}
+
+IMS_TEST(FileChangeCoalescerFollowsRenames) {
+	FileChangeCoalescer coalescer;
+
+	// Added then renamed: an add of the final name
+	coalescer.Push(change(FileChangeType::Added, "new.tmp"));
+	coalescer.Push(change(FileChangeType::Renamed, "new.lnk", "new.tmp"));
+
+	// Renamed twice: one rename from the first name to the last
+	coalescer.Push(change(FileChangeType::Renamed, "b.lnk", "a.lnk"));
+	coalescer.Push(change(FileChangeType::Renamed, "c.lnk", "b.lnk"));
+
+	// Renamed and back: nothing
+	coalescer.Push(change(FileChangeType::Renamed, "y.lnk", "x.lnk"));
+	coalescer.Push(change(FileChangeType::Renamed, "x.lnk", "y.lnk"));
+
+	// Renamed then removed: the original went away
+	coalescer.Push(change(FileChangeType::Renamed, "q.lnk", "p.lnk"));
+	coalescer.Push(change(FileChangeType::Removed, "q.lnk"));
+
+	IMS_CHECK(same(coalescer.Take(), {
+		change(FileChangeType::Added, "new.lnk"),
+		change(FileChangeType::Renamed, "c.lnk", "a.lnk"),
+		change(FileChangeType::Removed, "p.lnk"),
+	}));
+}
+
+IMS_TEST(FileChangeCoalescerTreatsAReusedOldNameAsAnotherFile) {
+	FileChangeCoalescer coalescer;
+
+	// The shortcut moved away and a new one took its name, neither change may swallow the other
+	coalescer.Push(change(FileChangeType::Renamed, "old.lnk", "app.lnk"));
+	coalescer.Push(change(FileChangeType::Added, "app.lnk"));
+	coalescer.Push(change(FileChangeType::Modified, "app.lnk"));
+
+	IMS_CHECK(same(coalescer.Take(), { change(FileChangeType::Renamed, "old.lnk", "app.lnk"), change(FileChangeType::Added, "app.lnk") }));
+}
+
+IMS_TEST(FileChangeCoalescerOverflowDropsTheBatch) {
+	FileChangeCoalescer coalescer;
+	coalescer.Push(change(FileChangeType::Added, "a.lnk"));
+	coalescer.Push(change(FileChangeType::Overflow, {}));
+	IMS_CHECK(!coalescer.Empty());
+
+	// Everything gets rescanned, changes after the overflow don't matter either
+	coalescer.Push(change(FileChangeType::Added, "b.lnk"));
+	coalescer.Push(change(FileChangeType::Renamed, "c.lnk", "b.lnk"));
+
+	FileChangeBatch batch = coalescer.Take();
+	IMS_CHECK(batch.overflow);
+	IMS_CHECK(batch.changes.empty());
+
+	// The next batch starts over
+	IMS_CHECK(coalescer.Empty());
+	coalescer.Push(change(FileChangeType::Added, "d.lnk"));
+	batch = coalescer.Take();
+	IMS_CHECK(!batch.overflow);
+	IMS_CHECK(same(batch, { change(FileChangeType::Added, "d.lnk") }));
+}
+
+IMS_TEST(DirWatcherDeliversAStormAsOneBatch) {
+	// Hands out scripted notifications, then blocks until interrupted
+	class ScriptedBackend : public IDirWatchBackend {
+	public:
+		bool Add(const std::filesystem::path&) override { return true; }
+
+		void Poll(std::chrono::milliseconds timeout, std::vector<FileChange>& out) override {
+			std::unique_lock lock(this->mutex);
+			if (this->script.empty()) {
+				this->wake.wait_for(lock, (std::min)(timeout, std::chrono::milliseconds(1000)), [&] { return this->interrupted; });
+				this->interrupted = false;
+				return;
+			}
+
+			out.push_back(std::move(this->script.front()));
+			this->script.pop_front();
+		}
+
+		void Interrupt() override {
+			std::lock_guard lock(this->mutex);
+			this->interrupted = true;
+			this->wake.notify_all();
+		}
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<FileChange> script;
+		bool interrupted = false;
+	};
+
+	auto backend = std::make_unique<ScriptedBackend>();
+	for (int i = 0; i < 300; i++)
+		backend->script.push_back(change(FileChangeType::Added, fmt::format("installer/{}.lnk", i)));
+	backend->script.push_back(change(FileChangeType::Overflow, {}));
+	backend->script.push_back(change(FileChangeType::Added, "after.lnk"));
+
+	std::mutex mutex;
+	std::condition_variable delivered;
+	std::vector<FileChangeBatch> batches;
+	DirWatcher watcher(std::move(backend), [&](const FileChangeBatch& batch) {
+		std::lock_guard lock(mutex);
+		batches.push_back(batch);
+		delivered.notify_all();
+	}, { std::chrono::milliseconds(50), std::chrono::milliseconds(2000) });
+
+	IMS_CHECK(watcher.Watch({ "root" }));
+
+	std::unique_lock lock(mutex);
+	delivered.wait_for(lock, std::chrono::seconds(5), [&] { return !batches.empty(); });
+	IMS_CHECK(batches.size() == 1);
+	IMS_CHECK(!batches.empty() && batches[0].overflow && batches[0].changes.empty());
+}
+
+IMS_TEST(DirWatchBackendReportsRenamesAndMovesOut) {
+	std::unique_ptr<IDirWatchBackend> backend = DirWatcher::CreateDefaultBackend();
+	if (!backend) return;
+
+	Test::TempDirectory temp("imsplorer-test-dir-watcher");
+	std::filesystem::path root = temp.path / "Start Menu";
+	std::filesystem::path outside = temp.path / "Elsewhere";
+	std::filesystem::create_directories(root / "Programs");
+	std::filesystem::create_directories(outside);
+	IMS_CHECK(backend->Add(root));
+
+	// A file renamed within the tree
+	std::ofstream(root / "Programs" / "app.tmp") << "shortcut";
+	pollUntil(*backend, [&](const auto& changes) { return contains(changes, change(FileChangeType::Modified, root / "Programs" / "app.tmp")); });
+	std::filesystem::rename(root / "Programs" / "app.tmp", root / "Programs" / "app.lnk");
+	auto changes = pollUntil(*backend, [&](const auto& changes) { return !changes.empty(); });
+	IMS_CHECK(contains(changes, change(FileChangeType::Renamed, root / "Programs" / "app.lnk", root / "Programs" / "app.tmp")));
+
+	// A folder renamed, then a file created inside it under the new name
+	std::filesystem::rename(root / "Programs", root / "Apps");
+	changes = pollUntil(*backend, [&](const auto& changes) { return !changes.empty(); });
+	IMS_CHECK(contains(changes, change(FileChangeType::Renamed, root / "Apps", root / "Programs")));
+
+	std::ofstream(root / "Apps" / "other.lnk") << "shortcut";
+	changes = pollUntil(*backend, [&](const auto& changes) { return contains(changes, change(FileChangeType::Added, root / "Apps" / "other.lnk")); });
+	IMS_CHECK(contains(changes, change(FileChangeType::Added, root / "Apps" / "other.lnk")));
+
+	// Moved out of the tree is gone
+	std::filesystem::rename(root / "Apps" / "app.lnk", outside / "app.lnk");
+	changes = pollUntil(*backend, [&](const auto& changes) { return !changes.empty(); });
+	IMS_CHECK(contains(changes, change(FileChangeType::Removed, root / "Apps" / "app.lnk")));
+}
@@ -0,0 +1,140 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "font_cache.h"
+
+using namespace IMS;
+
+namespace {
+	FontAtlasSpec builtInSpec() {
+		FontAtlasSpec spec;
+		spec.sizes = { 13.0f, 16.25f, 19.5f, 26.0f };
+		return spec;
+	}
+
+	bool build(FontAtlasCache& cache, ImFontAtlas& atlas, const FontAtlasSpec& spec) {
+		if (!cache.Build(atlas, spec)) return false;
+		unsigned char* pixels = nullptr;
+		int width = 0, height = 0;
+		atlas.GetTexDataAsRGBA32(&pixels, &width, &height);
+		return pixels != nullptr;
+	}
+
+	/// <summary>
+	/// Everything ImGui reads from an atlas to draw text
+	/// </summary>
+	bool sameAtlas(const ImFontAtlas& a, const ImFontAtlas& b) {
+		if (a.TexWidth != b.TexWidth || a.TexHeight != b.TexHeight || a.Fonts.Size != b.Fonts.Size) return false;
+		if (a.TexUvScale.x != b.TexUvScale.x || a.TexUvScale.y != b.TexUvScale.y) return false;
+		if (a.TexUvWhitePixel.x != b.TexUvWhitePixel.x || a.TexUvWhitePixel.y != b.TexUvWhitePixel.y) return false;
+		if (std::memcmp(a.TexPixelsRGBA32, b.TexPixelsRGBA32, (size_t)a.TexWidth * a.TexHeight * 4) != 0) return false;
+		for (int i = 0; i <= IM_DRAWLIST_TEX_LINES_WIDTH_MAX; i++) {
+			if (a.TexUvLines[i].x != b.TexUvLines[i].x || a.TexUvLines[i].y != b.TexUvLines[i].y ||
+				a.TexUvLines[i].z != b.TexUvLines[i].z || a.TexUvLines[i].w != b.TexUvLines[i].w) return false;
+		}
+
+		for (int i = 0; i < a.Fonts.Size; i++) {
+			const ImFont* x = a.Fonts[i];
+			const ImFont* y = b.Fonts[i];
+			if (x->FontSize != y->FontSize || x->Ascent != y->Ascent || x->Descent != y->Descent || x->Glyphs.Size != y->Glyphs.Size ||
+				x->FallbackChar != y->FallbackChar || x->EllipsisChar != y->EllipsisChar) return false;
+			if (x->CalcTextSizeA(x->FontSize, FLT_MAX, 0, "Visual Studio Code ...").x != y->CalcTextSizeA(y->FontSize, FLT_MAX, 0, "Visual Studio Code ...").x) return false;
+			for (int j = 0; j < x->Glyphs.Size; j++) {
+				if (std::memcmp(&x->Glyphs[j], &y->Glyphs[j], sizeof(ImFontGlyph)) != 0) return false;
+			}
+		}
+		return true;
+	}
+} // namespace
+
+IMS_TEST(FontCacheLoadsWhatItRasterized) {
+	Test::TempDirectory temp("imsplorer-test-font-cache");
+	FontAtlasSpec spec = builtInSpec();
+
+	FontAtlasCache coldCache(temp.path / "fonts.bin"), warmCache(temp.path / "fonts.bin");
+	ImFontAtlas cold, warm;
+	IMS_CHECK(build(coldCache, cold, spec));
+	IMS_CHECK(!coldCache.Hit());
+	IMS_CHECK(std::filesystem::exists(temp.path / "fonts.bin"));
+
+	IMS_CHECK(build(warmCache, warm, spec));
+	IMS_CHECK(warmCache.Hit());
+	IMS_CHECK(warm.Fonts.Size == (int)spec.sizes.size());
+	IMS_CHECK(sameAtlas(cold, warm));
+	warmCache.Release(warm);
+}
+
+IMS_TEST(FontCacheMissesOnAnotherSpec) {
+	Test::TempDirectory temp("imsplorer-test-font-cache-spec");
+	FontAtlasSpec spec = builtInSpec();
+	{
+		FontAtlasCache cache(temp.path / "fonts.bin");
+		ImFontAtlas atlas;
+		IMS_CHECK(build(cache, atlas, spec) && !cache.Hit());
+	}
+
+	auto hits = [&](const FontAtlasSpec& other) {
+		FontAtlasCache cache(temp.path / "fonts.bin");
+		ImFontAtlas atlas;
+		bool built = build(cache, atlas, other);
+		bool hit = cache.Hit();
+		cache.Release(atlas);
+		return built && hit;
+	};
+
+	// Each miss saves over the file, the same spec hits right after
+	FontAtlasSpec sizes = spec;
+	sizes.sizes.push_back(32.0f);
+	IMS_CHECK(!hits(sizes));
+	IMS_CHECK(hits(sizes));
+
+	FontAtlasSpec oversampled = spec;
+	oversampled.oversampleH = 2;
+	IMS_CHECK(!hits(oversampled));
+
+	FontAtlasSpec ranges = spec;
+	ranges.glyphRanges = { 0x0020, 0x007E, 0 };
+	IMS_CHECK(!hits(ranges));
+	IMS_CHECK(hits(ranges));
+	IMS_CHECK(!hits(spec));
+}
+
+IMS_TEST(FontCacheRasterizesOverACorruptedFile) {
+	Test::TempDirectory temp("imsplorer-test-font-cache-corrupted");
+	FontAtlasSpec spec = builtInSpec();
+	{
+		FontAtlasCache cache(temp.path / "fonts.bin");
+		ImFontAtlas atlas;
+		IMS_CHECK(build(cache, atlas, spec));
+	}
+
+	// One byte of the pixels, past the header and every record
+	{
+		std::fstream file(temp.path / "fonts.bin", std::ios::binary | std::ios::in | std::ios::out);
+		file.seekg(-16, std::ios::end);
+		char byte = 0;
+		file.read(&byte, 1);
+		byte ^= 0x5A;
+		file.seekp(-16, std::ios::end);
+		file.write(&byte, 1);
+	}
+
+	FontAtlasCache corrupted(temp.path / "fonts.bin");
+	ImFontAtlas rasterized;
+	IMS_CHECK(build(corrupted, rasterized, spec));
+	IMS_CHECK(!corrupted.Hit());
+
+	// Saved again, whole
+	FontAtlasCache repaired(temp.path / "fonts.bin");
+	ImFontAtlas loaded;
+	IMS_CHECK(build(repaired, loaded, spec));
+	IMS_CHECK(repaired.Hit());
+	IMS_CHECK(sameAtlas(rasterized, loaded));
+	repaired.Release(loaded);
+
+	// Without a path nothing is read or written
+	FontAtlasCache uncached({});
+	ImFontAtlas plain;
+	IMS_CHECK(build(uncached, plain, spec) && !uncached.Hit());
+}
@@ -0,0 +1,91 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "allocation_counters.h"
+#include "headless_platform.h"
+#include "taskbar.h"
+
+using namespace IMS;
+
+namespace {
+	struct Setup {
+		size_t windows = 0;
+		bool grouped = false;
+		size_t apps = 0;       // Start menu entries, 0 keeps it closed
+		const char* query = "";
+	};
+
+	/// <summary>
+	/// Build a headless taskbar, warm it up, then count what the calling thread allocates over steady frames
+	/// </summary>
+	AllocationStats steadyFrameAllocations(const Setup& setup, size_t frames) {
+		HeadlessPlatform platform;
+		platform.SetCommandPaths({});
+		for (size_t i = 0; i < setup.windows; i++)
+			platform.AddWindow(fmt::format("Window {}", i), fmt::format("C:\\Program Files\\App{}\\app{}.exe", i % 40, i % 40));
+
+		Taskbar taskbar(platform);
+		taskbar.Init();
+		taskbar.groupByApp = setup.grouped;
+
+		if (setup.apps > 0) {
+			AppSnapshotBuilder builder;
+			for (size_t i = 0; i < setup.apps; i++)
+				builder.Add(fmt::format("Application {}", i), fmt::format("C:\\ProgramData\\Microsoft\\Windows\\Start Menu\\Programs\\Application {}.lnk", i));
+			taskbar.appIndex.Publish(builder.Build());
+			std::snprintf(taskbar.searchBuffer, sizeof(taskbar.searchBuffer), "%s", setup.query);
+			taskbar.showStartMenu = true;
+			taskbar.startMenuWasOpen = true; // Keep the synthetic index, skip the rescan on open
+		}
+
+		while (taskbar.windowWorker.InFlight() > 0) {
+			taskbar.Update();
+			std::this_thread::yield();
+		}
+		taskbar.Update();
+
+		auto frame = [&]() {
+			platform.BeginFrame();
+			taskbar.BuildFrame();
+			platform.EndFrame();
+		};
+
+		// Window creation, text measuring and the first search may allocate
+		for (int i = 0; i < 10; i++)
+			frame();
+
+		AllocationStats before = ThreadAllocations();
+		for (size_t i = 0; i < frames; i++)
+			frame();
+		return ThreadAllocations() - before;
+	}
+} // namespace
+
+IMS_TEST(AllocationCountersCountThisThread) {
+	// Without them every check below would pass vacuously
+	IMS_CHECK(AllocationCountersEnabled());
+
+	AllocationStats before = ThreadAllocations();
+	auto buffer = std::make_unique<std::array<char, 1000>>();
+	AllocationStats allocated = ThreadAllocations() - before;
+	IMS_CHECK(buffer && allocated.count == 1 && allocated.bytes >= 1000);
+}
+
+IMS_TEST(SteadyFramesDontAllocate) {
+	static constexpr Setup setups[] = {
+		{ 10 },
+		{ 1000 },
+		{ 500, true },
+		{ 10, false, 1000, "" },
+		{ 10, false, 10000, "app 12" },
+	};
+
+	for (const Setup& setup : setups) {
+		AllocationStats allocations = steadyFrameAllocations(setup, 100);
+		if (allocations.count > 0)
+			spdlog::error("{} windows{}, {} apps, query \"{}\": {} allocations ({} bytes) over 100 steady frames",
+				setup.windows, setup.grouped ? " grouped" : "", setup.apps, setup.query, allocations.count, allocations.bytes);
+		IMS_CHECK(allocations.count == 0);
+	}
+}
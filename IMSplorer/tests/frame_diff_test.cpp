@@ -0,0 +1,180 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "frame_diff.h"
+
+using namespace IMS;
+
+namespace {
+	/// <summary>
+	/// A viewport's worth of draw data built by hand: `rects` 8x8 quads in one command, clipped to a taskbar
+	/// </summary>
+	struct Frame {
+		explicit Frame(int rects) {
+			for (int i = 0; i < rects; i++) {
+				float x = (float)(i % 64) * 10.0f, y = (float)(i / 64) * 10.0f;
+				ImU32 colour = 0xFF000000 | (ImU32)i;
+				this->list.VtxBuffer.push_back({ ImVec2(x, y), ImVec2(0.0f, 0.0f), colour });
+				this->list.VtxBuffer.push_back({ ImVec2(x + 8.0f, y), ImVec2(1.0f, 0.0f), colour });
+				this->list.VtxBuffer.push_back({ ImVec2(x + 8.0f, y + 8.0f), ImVec2(1.0f, 1.0f), colour });
+				this->list.VtxBuffer.push_back({ ImVec2(x, y + 8.0f), ImVec2(0.0f, 1.0f), colour });
+
+				for (int index : { 0, 1, 2, 0, 2, 3 })
+					this->list.IdxBuffer.push_back((ImDrawIdx)(i * 4 + index));
+			}
+
+			ImDrawCmd command;
+			command.ClipRect = ImVec4(0.0f, 0.0f, 1920.0f, 48.0f);
+			command.ElemCount = (unsigned int)rects * 6;
+			this->list.CmdBuffer.push_back(command);
+
+			this->data.DisplaySize = ImVec2(1920.0f, 48.0f);
+			this->data.FramebufferScale = ImVec2(1.0f, 1.0f);
+			this->data.CmdLists.push_back(&this->list);
+			this->data.CmdListsCount = this->data.CmdLists.Size;
+		}
+
+		Frame(const Frame&) = delete;
+		Frame& operator=(const Frame&) = delete;
+
+		ImDrawList list{ nullptr };
+		ImDrawData data;
+	};
+} // namespace
+
+IMS_TEST(HashBytesMatchesTheScalarPathForEveryTailLength) {
+	std::vector<uint8_t> bytes(4 * 64 + 64 + 8);
+	uint64_t state = 0x243F6A8885A308D3ull;
+	for (uint8_t& byte : bytes) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		byte = (uint8_t)(state >> 56);
+	}
+
+	// No stripes to several, every tail from 0 to 63 bytes, from aligned and unaligned starts
+	bool same = true;
+	for (size_t offset = 0; offset < 8; offset++) {
+		for (size_t size = 0; offset + size <= 4 * 64 + 64; size++) {
+			same = same && HashBytes(bytes.data() + offset, size) == HashBytesScalar(bytes.data() + offset, size);
+			same = same && HashBytes(bytes.data() + offset, size, state) == HashBytesScalar(bytes.data() + offset, size, state);
+		}
+	}
+	IMS_CHECK(same);
+
+	// Trailing zeros aren't the padding, and every byte counts wherever it is
+	std::vector<uint8_t> zeros(200, 0);
+	IMS_CHECK(HashBytes(zeros.data(), 3) != HashBytes(zeros.data(), 4));
+	IMS_CHECK(HashBytes(zeros.data(), 64) != HashBytes(zeros.data(), 72));
+
+	uint64_t original = HashBytes(bytes.data(), 200);
+	bool all = true;
+	for (size_t i = 0; i < 200; i++) {
+		bytes[i] ^= 0x10;
+		all = all && HashBytes(bytes.data(), 200) != original && HashBytesScalar(bytes.data(), 200) != original;
+		bytes[i] ^= 0x10;
+	}
+	IMS_CHECK(all);
+
+	// Two words trading places, in the same stripe and in different ones
+	std::swap_ranges(bytes.begin(), bytes.begin() + 8, bytes.begin() + 8);
+	IMS_CHECK(HashBytes(bytes.data(), 200) != original);
+	std::swap_ranges(bytes.begin(), bytes.begin() + 8, bytes.begin() + 8);
+	std::swap_ranges(bytes.begin(), bytes.begin() + 8, bytes.begin() + 64);
+	IMS_CHECK(HashBytes(bytes.data(), 200) != original);
+	std::swap_ranges(bytes.begin(), bytes.begin() + 8, bytes.begin() + 64);
+	IMS_CHECK(HashBytes(bytes.data(), 200) == original);
+
+	// Continuing from a seed isn't hashing from scratch
+	IMS_CHECK(HashBytes(bytes.data(), 200, 1) != original);
+}
+
+IMS_TEST(DrawDataHashSeesWhatEndsUpOnScreen) {
+	Frame frame(100);
+	uint64_t original = HashDrawData(frame.data);
+
+	// The same picture built again hashes the same
+	Frame same(100);
+	IMS_CHECK(HashDrawData(same.data) == original);
+
+	Frame moved(100);
+	moved.list.VtxBuffer[42].pos.x += 1.0f;
+	IMS_CHECK(HashDrawData(moved.data) != original);
+
+	Frame recoloured(100);
+	recoloured.list.VtxBuffer[42].col ^= 0x00FF0000;
+	IMS_CHECK(HashDrawData(recoloured.data) != original);
+
+	Frame clipped(100);
+	clipped.list.CmdBuffer[0].ClipRect.z = 960.0f;
+	IMS_CHECK(HashDrawData(clipped.data) != original);
+
+	Frame fewer(100);
+	fewer.list.CmdBuffer[0].ElemCount -= 6;
+	IMS_CHECK(HashDrawData(fewer.data) != original);
+
+	Frame reordered(100);
+	std::swap(reordered.list.IdxBuffer[0], reordered.list.IdxBuffer[1]);
+	IMS_CHECK(HashDrawData(reordered.data) != original);
+
+	Frame resized(100);
+	resized.data.DisplaySize.x = 1280.0f;
+	IMS_CHECK(HashDrawData(resized.data) != original);
+
+	IMS_CHECK(HashDrawData(frame.data, 1) != original);
+}
+
+IMS_TEST(FrameDiffSkipsUnchangedViewports) {
+	FrameDiff diff;
+	Frame frame(100);
+	Frame other(50);
+
+	// New viewports are drawn
+	IMS_CHECK(diff.Changed(1, frame.data));
+	IMS_CHECK(diff.Changed(2, other.data));
+	diff.EndFrame();
+
+	// Nothing changed
+	IMS_CHECK(!diff.Changed(1, frame.data));
+	IMS_CHECK(!diff.Changed(2, other.data));
+	diff.EndFrame();
+	IMS_CHECK(diff.Drawn() == 2 && diff.Skipped() == 2);
+
+	// Only the one that changed is drawn, and then remembered
+	frame.list.VtxBuffer[0].pos.y += 1.0f;
+	IMS_CHECK(diff.Changed(1, frame.data));
+	IMS_CHECK(!diff.Changed(2, other.data));
+	diff.EndFrame();
+	IMS_CHECK(!diff.Changed(1, frame.data));
+	IMS_CHECK(!diff.Changed(2, other.data, 0));
+
+	// Something outside the draw data, like a texture upload
+	IMS_CHECK(diff.Changed(2, other.data, 1));
+	diff.EndFrame();
+	IMS_CHECK(diff.Drawn() == 4 && diff.Skipped() == 5);
+}
+
+IMS_TEST(FrameDiffDrawsEverythingAfterInvalidate) {
+	FrameDiff diff;
+	Frame frame(100);
+	Frame other(50);
+
+	diff.Changed(1, frame.data);
+	diff.Changed(2, other.data);
+	diff.EndFrame();
+
+	// The device was lost or the swap chain resized, what's on screen can't be kept
+	diff.Invalidate();
+	IMS_CHECK(diff.Changed(1, frame.data));
+	IMS_CHECK(diff.Changed(2, other.data));
+	diff.EndFrame();
+	IMS_CHECK(!diff.Changed(1, frame.data) && !diff.Changed(2, other.data));
+	diff.EndFrame();
+
+	// A viewport that skipped a frame (hidden, minimised) is drawn when it comes back
+	IMS_CHECK(!diff.Changed(1, frame.data));
+	diff.EndFrame();
+	IMS_CHECK(!diff.Changed(1, frame.data));
+	IMS_CHECK(diff.Changed(2, other.data));
+	diff.EndFrame();
+	IMS_CHECK(diff.Drawn() == 5 && diff.Skipped() == 4);
+}
@@ -0,0 +1,191 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "frame_scheduler.h"
+
+using namespace IMS;
+using namespace std::chrono_literals;
+
+namespace {
+	/// <summary>
+	/// Time only moves when told to, the wall clock starts 250 ms past a whole second
+	/// </summary>
+	class FakeClock : public IClock {
+	public:
+		std::chrono::steady_clock::time_point Now() const override { return this->now; }
+		std::chrono::system_clock::time_point WallNow() const override { return this->wall; }
+
+		void Advance(std::chrono::milliseconds duration) {
+			this->now += duration;
+			this->wall += duration;
+		}
+
+		std::chrono::steady_clock::time_point now{ 1h };
+		std::chrono::system_clock::time_point wall{ std::chrono::milliseconds(1'700'000'000'250) };
+	};
+
+	/// <summary>
+	/// Sleeping moves the fake clock to the timeout or to the next scripted event, whichever is first
+	/// </summary>
+	class FakeEventSource : public IEventSource {
+	public:
+		explicit FakeEventSource(FakeClock& clock) : clock(clock) {}
+
+		bool Wait(std::chrono::milliseconds timeout) override {
+			this->waits.push_back(timeout);
+
+			auto event = std::find_if(this->events.begin(), this->events.end(), [&](auto at) { return at >= this->clock.now; });
+			if (event != this->events.end() && (timeout == kInfinite || *event <= this->clock.now + timeout)) {
+				this->clock.Advance(std::chrono::duration_cast<std::chrono::milliseconds>(*event - this->clock.now));
+				this->events.erase(event);
+				return true;
+			}
+
+			// Nothing would ever wake a real thread
+			if (timeout == kInfinite) {
+				this->blocked = true;
+				return false;
+			}
+
+			this->clock.Advance(timeout);
+			return false;
+		}
+
+		void Wake() override { this->events.push_back(this->clock.now); }
+
+		FakeClock& clock;
+		std::vector<std::chrono::steady_clock::time_point> events; // When something wakes the thread
+		std::vector<std::chrono::milliseconds> waits;
+		bool blocked = false;
+	};
+
+	/// <summary>
+	/// The render loop of Taskbar::Run until `duration` has passed, a frame takes 16 ms
+	/// </summary>
+	/// <returns>Frames rendered</returns>
+	uint64_t run(FrameScheduler& scheduler, FakeClock& clock, FakeEventSource& events, std::chrono::milliseconds duration) {
+		auto end = clock.now + duration;
+		uint64_t before = scheduler.FramesRendered();
+		while (clock.now < end && !events.blocked) {
+			scheduler.WaitForWork();
+			if (clock.now >= end) break;
+			if (scheduler.BeginFrame())
+				clock.Advance(16ms);
+		}
+		return scheduler.FramesRendered() - before;
+	}
+} // namespace
+
+IMS_TEST(FrameSchedulerSettlesThenSleepsWithoutATimeout) {
+	FakeClock clock;
+	FakeEventSource events(clock);
+	FrameScheduler scheduler(clock, events);
+
+	IMS_CHECK(run(scheduler, clock, events, 10s) == FrameScheduler::kSettleFrames);
+	IMS_CHECK(events.blocked);
+	IMS_CHECK(events.waits.size() == 1 && events.waits.back() == IEventSource::kInfinite);
+	IMS_CHECK(!scheduler.BeginFrame());
+}
+
+IMS_TEST(FrameSchedulerRendersSettleFramesAfterAnInvalidate) {
+	FakeClock clock;
+	FakeEventSource events(clock);
+	FrameScheduler scheduler(clock, events);
+	run(scheduler, clock, events, 1s);
+
+	events.blocked = false;
+	scheduler.Invalidate();
+	IMS_CHECK(run(scheduler, clock, events, 10s) == FrameScheduler::kSettleFrames);
+
+	// A smaller request doesn't cut a pending larger one short
+	events.blocked = false;
+	scheduler.Invalidate(5);
+	scheduler.Invalidate(1);
+	IMS_CHECK(run(scheduler, clock, events, 10s) == 5);
+}
+
+IMS_TEST(FrameSchedulerTicksOnWholeWallClockSeconds) {
+	FakeClock clock;
+	FakeEventSource events(clock);
+	FrameScheduler scheduler(clock, events);
+	run(scheduler, clock, events, 1s);
+	events.blocked = false;
+
+	// The settle frames left the wall clock 298 ms past a second, the first tick is 702 ms away and every one after a second apart
+	scheduler.SetTickInterval(1000ms);
+	auto start = clock.now;
+	uint64_t frames = run(scheduler, clock, events, 10s);
+	IMS_CHECK(frames == 10);
+	IMS_CHECK(events.waits.size() > 2 && events.waits[1] == 702ms && events.waits[2] == 984ms);
+	IMS_CHECK(!events.blocked);
+
+	// Idle between ticks: one sleep per tick, never a busy loop
+	IMS_CHECK(scheduler.Wakeups() <= 12);
+	IMS_CHECK(clock.now - start >= 10s);
+
+	// Off again, back to sleeping for good
+	scheduler.SetTickInterval(0ms);
+	run(scheduler, clock, events, 10s);
+	IMS_CHECK(events.blocked);
+}
+
+IMS_TEST(FrameSchedulerRendersOnceAtARequestedDeadline) {
+	FakeClock clock;
+	FakeEventSource events(clock);
+	FrameScheduler scheduler(clock, events);
+	run(scheduler, clock, events, 1s);
+	events.blocked = false;
+
+	auto requested = clock.now;
+	scheduler.RequestFrameIn(500ms);
+	scheduler.RequestFrameIn(2s); // The earlier deadline wins
+	IMS_CHECK(run(scheduler, clock, events, 10s) == 1);
+	IMS_CHECK(events.waits.back() == IEventSource::kInfinite);
+	IMS_CHECK(events.waits[events.waits.size() - 2] == 500ms);
+	IMS_CHECK(clock.now - requested == 516ms);
+}
+
+IMS_TEST(FrameSchedulerAnimatesForTheRequestedDuration) {
+	FakeClock clock;
+	FakeEventSource events(clock);
+	FrameScheduler scheduler(clock, events);
+	run(scheduler, clock, events, 1s);
+	events.blocked = false;
+
+	// Back to back frames until the animation is over, then asleep
+	scheduler.AnimateFor(160ms);
+	size_t waits = events.waits.size();
+	IMS_CHECK(run(scheduler, clock, events, 10s) == 10);
+	IMS_CHECK(events.waits.size() == waits + 1);
+	IMS_CHECK(events.blocked);
+}
+
+IMS_TEST(FrameSchedulerPostponeDropsPendingFrames) {
+	FakeClock clock;
+	FakeEventSource events(clock);
+	FrameScheduler scheduler(clock, events);
+
+	// Occluded: the settle frames are dropped and one frame is tried again later
+	scheduler.AnimateFor(1s);
+	scheduler.Postpone(100ms);
+	auto postponed = clock.now;
+	IMS_CHECK(!scheduler.BeginFrame());
+	IMS_CHECK(run(scheduler, clock, events, 10s) == 1);
+	IMS_CHECK(clock.now - postponed == 116ms);
+}
+
+IMS_TEST(FrameSchedulerWakesForEventsOnly) {
+	FakeClock clock;
+	FakeEventSource events(clock);
+	FrameScheduler scheduler(clock, events);
+	run(scheduler, clock, events, 1s);
+	events.blocked = false;
+
+	// Messages the UI doesn't care about wake the thread but don't render
+	events.events = { clock.now + 100ms, clock.now + 200ms, clock.now + 300ms };
+	uint64_t wakeups = scheduler.Wakeups();
+	IMS_CHECK(run(scheduler, clock, events, 10s) == 0);
+	IMS_CHECK(scheduler.Wakeups() - wakeups == 4);
+	IMS_CHECK(events.blocked);
+}
@@ -0,0 +1,91 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "headless_platform.h"
+#include "taskbar.h"
+
+using namespace IMS;
+
+IMS_TEST(HeadlessTaskbarDrawsItsWindows) {
+	HeadlessPlatform platform;
+	platform.SetCommandPaths({});
+	for (int i = 0; i < 20; i++)
+		platform.AddWindow(fmt::format("Window {}", i), fmt::format("C:\\Program Files\\App{}\\app{}.exe", i % 4, i % 4));
+
+	Taskbar taskbar(platform);
+	taskbar.Init();
+
+	while (taskbar.windowWorker.InFlight() > 0) {
+		taskbar.Update();
+		std::this_thread::yield();
+	}
+	taskbar.Update();
+
+	for (int i = 0; i < 3; i++) {
+		IMS_CHECK(platform.BeginFrame());
+		taskbar.BuildFrame();
+		platform.EndFrame();
+	}
+
+	IMS_CHECK(platform.LastVertexCount() > 0);
+}
+
+namespace {
+	/// <summary>
+	/// Holds every metadata lookup until the test opens the gate
+	/// </summary>
+	class GatedPlatform : public HeadlessPlatform {
+	public:
+		std::unique_ptr<IWindowInfoResolver> CreateWindowResolver(ProcessCache& processes) override {
+			return std::make_unique<Resolver>(HeadlessPlatform::CreateWindowResolver(processes), this->gate);
+		}
+
+		void Open() { this->gate.release(); }
+
+	private:
+		class Resolver : public IWindowInfoResolver {
+		public:
+			Resolver(std::unique_ptr<IWindowInfoResolver> inner, std::binary_semaphore& gate) : inner(std::move(inner)), gate(gate) {}
+
+			WindowInfo Resolve(WindowHandle handle) override {
+				this->gate.acquire();
+				this->gate.release();
+				return this->inner->Resolve(handle);
+			}
+
+		private:
+			std::unique_ptr<IWindowInfoResolver> inner;
+			std::binary_semaphore& gate;
+		};
+
+		std::binary_semaphore gate{ 0 };
+	};
+} // namespace
+
+IMS_TEST(HeadlessTaskbarResolvesWindowsReplacedBeforeTheirMetadata) {
+	GatedPlatform platform;
+	platform.SetCommandPaths({});
+	WindowHandle old = platform.AddWindow("Old", "C:\\Program Files\\App\\app.exe");
+
+	Taskbar taskbar(platform);
+	taskbar.Init();
+	IMS_CHECK(taskbar.windows.Contains(old));
+
+	// The replacement shows up while the old window's lookup is still running
+	WindowHandle replacement = platform.AddWindow("New", "C:\\Program Files\\App\\app.exe");
+	taskbar.OnShellEvent(ShellEventType::Replacing, replacement);
+	taskbar.OnShellEvent(ShellEventType::Replaced, old);
+	taskbar.Update();
+	platform.Open();
+
+	while (taskbar.windowWorker.InFlight() > 0) {
+		taskbar.Update();
+		std::this_thread::yield();
+	}
+	taskbar.Update();
+
+	const Window* window = taskbar.windows.Find(replacement);
+	IMS_CHECK(!taskbar.windows.Contains(old) && window && window->resolved && window->title == "New");
+	IMS_CHECK(taskbar.windows.Size() == 1);
+}
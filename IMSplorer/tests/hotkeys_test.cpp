@@ -0,0 +1,208 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "hotkeys.h"
+
+using namespace IMS;
+
+namespace {
+	/// <summary>
+	/// A keyboard the engine is fed from. Events can be dropped to model the secure desktop
+	/// swallowing them, the query still reports the physical state and counts how often it's asked.
+	/// </summary>
+	struct FakeKeyboard {
+		explicit FakeKeyboard(HotkeyEngine& engine) : engine(engine) {
+			engine.SetKeyQuery([this](uint8_t key) {
+				this->queries++;
+				return this->physical.test(key);
+			});
+		}
+
+		// Like the hook, the engine sees the event before the keyboard state changes
+		bool Press(uint8_t key) {
+			bool consumed = this->engine.OnKey(key, true);
+			this->physical.set(key);
+			return consumed;
+		}
+
+		bool Release(uint8_t key) {
+			bool consumed = this->engine.OnKey(key, false);
+			this->physical.reset(key);
+			return consumed;
+		}
+
+		// Released without the engine hearing about it
+		void LoseRelease(uint8_t key) { this->physical.reset(key); }
+
+		HotkeyEngine& engine;
+		std::bitset<256> physical;
+		size_t queries = 0;
+	};
+} // namespace
+
+IMS_TEST(HotkeysTellAWinTapFromACombo) {
+	HotkeyEngine engine;
+	FakeKeyboard keyboard(engine);
+	int taps = 0, runs = 0;
+	engine.OnWinTap([&] { taps++; });
+	engine.Register("Win+R", [&] { runs++; });
+
+	keyboard.Press(Keys::LWin);
+	keyboard.Release(Keys::LWin);
+	IMS_CHECK(taps == 1);
+
+	// Win+X isn't bound, but it's still not a tap
+	keyboard.Press(Keys::LWin);
+	IMS_CHECK(!keyboard.Press('X'));
+	keyboard.Release('X');
+	keyboard.Release(Keys::LWin);
+	IMS_CHECK(taps == 1 && runs == 0);
+
+	// Neither is Win pressed while something else is held
+	keyboard.Press(Keys::LShift);
+	keyboard.Press(Keys::LWin);
+	keyboard.Release(Keys::LWin);
+	keyboard.Release(Keys::LShift);
+	IMS_CHECK(taps == 1);
+
+	// A bound combo fires and isn't a tap either
+	keyboard.Press(Keys::LWin);
+	IMS_CHECK(keyboard.Press('R'));
+	keyboard.Release('R');
+	keyboard.Release(Keys::LWin);
+	IMS_CHECK(taps == 1 && runs == 1);
+	IMS_CHECK(engine.Modifiers() == 0);
+}
+
+IMS_TEST(HotkeysSwallowTheReleaseOfAConsumedKey) {
+	HotkeyEngine engine;
+	FakeKeyboard keyboard(engine);
+	int runs = 0;
+	IMS_CHECK(engine.Register("Ctrl+Alt+F12", [&] { runs++; }));
+
+	keyboard.Press(Keys::LControl);
+	keyboard.Press(Keys::LAlt);
+	IMS_CHECK(keyboard.Press(0x7B)); // F12
+	IMS_CHECK(runs == 1);
+
+	// Modifiers weren't consumed, only the key was
+	IMS_CHECK(!keyboard.Release(Keys::LAlt));
+	IMS_CHECK(keyboard.Release(0x7B));
+	IMS_CHECK(!keyboard.Release(Keys::LControl));
+
+	// Once only, the next plain F12 goes through
+	IMS_CHECK(!keyboard.Press(0x7B));
+	IMS_CHECK(!keyboard.Release(0x7B));
+	IMS_CHECK(runs == 1);
+}
+
+IMS_TEST(HotkeysDontRefireOnAutoRepeat) {
+	HotkeyEngine engine;
+	FakeKeyboard keyboard(engine);
+	int taps = 0, runs = 0;
+	engine.OnWinTap([&] { taps++; });
+	engine.Register("Win+Shift+P", [&] { runs++; });
+
+	keyboard.Press(Keys::LWin);
+	keyboard.Press(Keys::LShift);
+	IMS_CHECK(keyboard.Press('P'));
+
+	// Repeats stay consumed, and each asks about the repeating key alone
+	size_t queries = keyboard.queries;
+	for (int i = 0; i < 30; i++)
+		IMS_CHECK(keyboard.Press('P'));
+	IMS_CHECK(keyboard.queries - queries == 30);
+	IMS_CHECK(runs == 1);
+
+	keyboard.Release('P');
+	keyboard.Release(Keys::LShift);
+	keyboard.Release(Keys::LWin);
+
+	// A held Win repeats too, it's still a tap
+	keyboard.Press(Keys::LWin);
+	keyboard.Press(Keys::LWin);
+	keyboard.Press(Keys::LWin);
+	keyboard.Release(Keys::LWin);
+	IMS_CHECK(taps == 1);
+}
+
+IMS_TEST(HotkeysRecoverFromMissedReleases) {
+	HotkeyEngine engine;
+	FakeKeyboard keyboard(engine);
+	int taps = 0, runs = 0;
+	engine.OnWinTap([&] { taps++; });
+	engine.Register("Win+R", [&] { runs++; });
+
+	// Win+L locks the machine, the secure desktop eats both releases
+	keyboard.Press(Keys::LWin);
+	keyboard.Press('L');
+	keyboard.LoseRelease('L');
+	keyboard.LoseRelease(Keys::LWin);
+	IMS_CHECK(engine.IsDown(Keys::LWin) && engine.IsDown('L'));
+
+	// The next Win press checks every key, and is a tap again
+	keyboard.Press(Keys::LWin);
+	IMS_CHECK(!engine.IsDown('L'));
+	keyboard.Release(Keys::LWin);
+	IMS_CHECK(taps == 1);
+
+	// Stuck modifiers would turn Win+R into Ctrl+Alt+Win+R
+	keyboard.Press(Keys::LControl);
+	keyboard.Press(Keys::LAlt);
+	keyboard.LoseRelease(Keys::LControl);
+	keyboard.LoseRelease(Keys::LAlt);
+	keyboard.Press(Keys::LWin);
+	IMS_CHECK(keyboard.Press('R'));
+	keyboard.Release('R');
+	keyboard.Release(Keys::LWin);
+	IMS_CHECK(runs == 1 && taps == 1);
+
+	// A key pressed again after a missed release is a new press, not a repeat, found by asking about that key only
+	keyboard.Press(Keys::LWin);
+	keyboard.Press('R');
+	keyboard.LoseRelease('R');
+	size_t queries = keyboard.queries;
+	IMS_CHECK(keyboard.Press('R'));
+	IMS_CHECK(keyboard.queries - queries == 1);
+	IMS_CHECK(runs == 3);
+	keyboard.Release('R');
+	keyboard.Release(Keys::LWin);
+	IMS_CHECK(engine.Modifiers() == 0);
+}
+
+IMS_TEST(HotkeysResetForgetsEverything) {
+	HotkeyEngine engine;
+	int taps = 0, runs = 0;
+	engine.OnWinTap([&] { taps++; });
+	engine.Register("Win+R", [&] { runs++; });
+
+	// No key query, only Reset can help
+	engine.OnKey(Keys::LWin, true);
+	IMS_CHECK(engine.OnKey('R', true));
+	IMS_CHECK(engine.Modifiers() == ModWin);
+
+	engine.Reset();
+	IMS_CHECK(engine.Modifiers() == 0);
+	IMS_CHECK(!engine.IsDown('R') && !engine.IsDown(Keys::LWin));
+
+	// Neither release is swallowed nor a tap
+	IMS_CHECK(!engine.OnKey('R', false));
+	IMS_CHECK(!engine.OnKey(Keys::LWin, false));
+	IMS_CHECK(taps == 0);
+
+	engine.OnKey(Keys::LWin, true);
+	engine.OnKey(Keys::LWin, false);
+	IMS_CHECK(taps == 1 && runs == 1);
+}
+
+IMS_TEST(HotkeysParseShortcuts) {
+	uint8_t modifiers = 0, key = 0;
+	IMS_CHECK(ParseHotkey("Win+Shift+P", modifiers, key) && modifiers == (ModWin | ModShift) && key == 'P');
+	IMS_CHECK(ParseHotkey("ctrl+alt+f12", modifiers, key) && modifiers == (ModControl | ModAlt) && key == 0x7B);
+	IMS_CHECK(ParseHotkey("Space", modifiers, key) && modifiers == 0 && key == 0x20);
+	IMS_CHECK(!ParseHotkey("Win", modifiers, key));
+	IMS_CHECK(!ParseHotkey("Win+P+Shift", modifiers, key));
+	IMS_CHECK(!ParseHotkey("Win+F25", modifiers, key));
+	IMS_CHECK(!ParseHotkey("", modifiers, key));
+}
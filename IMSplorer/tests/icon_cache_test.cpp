@@ -0,0 +1,282 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "icon_cache.h"
+
+using namespace IMS;
+
+namespace {
+	/// <summary>
+	/// Marks every pixel a rectangle covers
+	/// </summary>
+	/// <returns>False if it leaves the atlas or covers a pixel that's taken</returns>
+	bool place(std::vector<bool>& taken, int width, int height, const AtlasRect& rect) {
+		if (rect.x + rect.width > width || rect.y + rect.height > height) return false;
+
+		for (int y = rect.y; y < rect.y + rect.height; y++) {
+			for (int x = rect.x; x < rect.x + rect.width; x++) {
+				if (taken[(size_t)y * width + x]) return false;
+				taken[(size_t)y * width + x] = true;
+			}
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// What the icon cache asked of its backend, shared with the test
+	/// </summary>
+	struct IconLog {
+		std::mutex mutex;
+		std::vector<std::pair<std::string, int32_t>> extracted; // Path and index, in order
+		std::atomic<size_t> extractions = 0;
+		std::atomic<size_t> ready = 0; // Extractions queued for upload when the worker last went idle
+
+		int textures = 0;
+		bool failTextures = false; // CreateTexture returns a null texture
+		std::vector<AtlasRect> updates;
+	};
+
+	/// <summary>
+	/// A solid colour per path like the headless backend, paths containing "missing" have no icon
+	/// and paths containing "wrong" come back at half the size
+	/// </summary>
+	class FakeIconBackend : public IIconBackend {
+	public:
+		explicit FakeIconBackend(std::shared_ptr<IconLog> log) : log(std::move(log)) {}
+
+		bool Extract(const std::string& path, int32_t index, int size, IconImage& out) override {
+			{
+				std::lock_guard lock(this->log->mutex);
+				this->log->extracted.emplace_back(path, index);
+			}
+			this->log->extractions++;
+
+			if (path.find("missing") != std::string::npos) return false;
+			if (path.find("wrong") != std::string::npos) size /= 2;
+
+			out.width = size;
+			out.height = size;
+			out.pixels.assign((size_t)size * size, ((uint32_t)std::hash<std::string>()(path) ^ (uint32_t)index) | 0xFF000000);
+			return true;
+		}
+
+		ImTextureID CreateTexture(int /*width*/, int /*height*/) override {
+			return this->log->failTextures ? ImTextureID() : (ImTextureID)(intptr_t)++this->log->textures;
+		}
+		void UpdateTexture(ImTextureID /*texture*/, const AtlasRect& rect, const uint32_t* /*pixels*/) override { this->log->updates.push_back(rect); }
+		void DestroyTexture(ImTextureID /*texture*/) override {}
+
+	private:
+		std::shared_ptr<IconLog> log;
+	};
+
+	struct IconFixture {
+		explicit IconFixture(IconCache::Options options = {})
+			: log(std::make_shared<IconLog>()),
+			  cache(std::make_unique<FakeIconBackend>(this->log), [log = this->log]() { log->ready.store(log->extractions.load()); }, options) {}
+
+		/// <summary>
+		/// Wait for the worker to have extracted `extractions` icons in total, then upload them
+		/// </summary>
+		/// <returns>Icons that became available</returns>
+		size_t Settle(size_t extractions) {
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+			while (this->log->ready.load() < extractions && std::chrono::steady_clock::now() < deadline)
+				std::this_thread::yield();
+			return this->cache.Upload();
+		}
+
+		std::shared_ptr<IconLog> log;
+		IconCache cache;
+	};
+
+	bool sameRect(const AtlasRect& a, const AtlasRect& b) {
+		return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+	}
+} // namespace
+
+IMS_TEST(SkylinePackerFillsAnAtlasWithEqualIcons) {
+	SkylinePacker packer(256, 256);
+	std::vector<bool> taken(256 * 256);
+
+	// The icon cache's case: one size only, every cell of the grid gets used
+	int placed = 0;
+	bool disjoint = true;
+	while (std::optional<AtlasRect> rect = packer.Insert(32, 32)) {
+		disjoint = disjoint && place(taken, 256, 256, *rect) && rect->width == 32 && rect->height == 32;
+		placed++;
+	}
+
+	IMS_CHECK(disjoint);
+	IMS_CHECK(placed == 64);
+	IMS_CHECK(packer.UsedArea() == 256 * 256);
+	IMS_CHECK(!packer.Insert(1, 1));
+}
+
+IMS_TEST(SkylinePackerNeverOverlapsMixedSizes) {
+	static constexpr int size = 512;
+	SkylinePacker packer(size, size);
+	std::vector<bool> taken((size_t)size * size);
+
+	uint64_t state = 0x2545F4914F6CDD1Dull;
+	auto next = [&](int bound) {
+		state ^= state >> 12; state ^= state << 25; state ^= state >> 27;
+		return (int)((state * 0x2545F4914F6CDD1Dull) % (uint64_t)bound);
+	};
+
+	// Keep going past the first failure, smaller rectangles may still fit in the gaps
+	size_t area = 0, failures = 0;
+	bool disjoint = true;
+	while (failures < 200) {
+		int width = 8 + next(57), height = 8 + next(57);
+		std::optional<AtlasRect> rect = packer.Insert(width, height);
+		if (!rect) {
+			failures++;
+			continue;
+		}
+		disjoint = disjoint && rect->width == width && rect->height == height && place(taken, size, size, *rect);
+		area += (size_t)width * height;
+	}
+
+	IMS_CHECK(disjoint);
+	IMS_CHECK(packer.UsedArea() >= area);
+	IMS_CHECK(packer.UsedArea() <= (size_t)size * size);
+
+	// Bottom-left placement keeps the waste low
+	IMS_CHECK(area * 10 >= (size_t)size * size * 7);
+}
+
+IMS_TEST(SkylinePackerRejectsWhatCanNeverFit) {
+	SkylinePacker packer(64, 64);
+	IMS_CHECK(!packer.Insert(0, 16));
+	IMS_CHECK(!packer.Insert(16, -1));
+	IMS_CHECK(!packer.Insert(65, 1));
+	IMS_CHECK(!packer.Insert(1, 65));
+	IMS_CHECK(packer.UsedArea() == 0);
+
+	// Exactly the atlas fits, once
+	IMS_CHECK(packer.Insert(64, 64).has_value());
+	IMS_CHECK(!packer.Insert(1, 1));
+
+	// No atlas yet, nothing fits
+	SkylinePacker empty;
+	IMS_CHECK(!empty.Insert(1, 1));
+}
+
+IMS_TEST(SkylinePackerResetStartsOver) {
+	SkylinePacker packer(64, 64);
+	packer.Insert(64, 40);
+	IMS_CHECK(!packer.Insert(64, 40));
+
+	// Same size
+	packer.Reset(64, 64);
+	IMS_CHECK(packer.UsedArea() == 0);
+	std::optional<AtlasRect> rect = packer.Insert(64, 40);
+	IMS_CHECK(rect && rect->x == 0 && rect->y == 0);
+
+	// Grown, the atlas texture was recreated larger
+	packer.Reset(128, 128);
+	IMS_CHECK(packer.Width() == 128 && packer.Height() == 128);
+	IMS_CHECK(packer.Insert(128, 64).has_value());
+	IMS_CHECK(packer.Insert(128, 64).has_value());
+	IMS_CHECK(!packer.Insert(1, 1));
+}
+
+IMS_TEST(IconCacheSharesAnIconAcrossSpellingsOfAPath) {
+	IconFixture fixture;
+	IMS_CHECK(!fixture.cache.Get("C:\\Program Files\\App\\App.exe"));
+	IMS_CHECK(!fixture.cache.Get("c:\\program files\\app\\APP.EXE"));
+	IMS_CHECK(!fixture.cache.Get("C:\\Program Files\\App\\App.exe", 1));
+	IMS_CHECK(fixture.cache.Size() == 2);
+
+	// Through the worker and back, one extraction per path and index
+	IMS_CHECK(fixture.Settle(2) == 2);
+	IMS_CHECK((fixture.log->extracted == std::vector<std::pair<std::string, int32_t>>{
+		{ "C:\\Program Files\\App\\App.exe", 0 }, { "C:\\Program Files\\App\\App.exe", 1 } }));
+
+	const IconCache::Icon* first = fixture.cache.Get("c:\\PROGRAM FILES\\app\\app.exe");
+	const IconCache::Icon* second = fixture.cache.Get("C:\\Program Files\\App\\App.exe", 1);
+	IMS_CHECK(first && second && first != second);
+	IMS_CHECK(first == fixture.cache.Get("C:\\Program Files\\App\\App.exe"));
+
+	// One shared texture, each icon an icon sized cell of it
+	IMS_CHECK(fixture.log->textures == 1 && first->texture == second->texture);
+	IMS_CHECK(first->uv1.x - first->uv0.x == 32.0f / 512.0f && first->uv1.y - first->uv0.y == 32.0f / 512.0f);
+	IMS_CHECK(first->uv0.x != second->uv0.x || first->uv0.y != second->uv0.y);
+	IMS_CHECK(fixture.cache.Resident() == 2 && fixture.log->extractions == 2);
+}
+
+IMS_TEST(IconCacheMarksFailedExtractionsMissing) {
+	IconFixture fixture;
+	fixture.cache.Get("C:\\missing.exe");
+	fixture.cache.Get("C:\\wrong.exe");
+	IMS_CHECK(fixture.Settle(2) == 0);
+
+	// Missing for good, neither drawn nor extracted again
+	for (int i = 0; i < 3; i++) {
+		IMS_CHECK(!fixture.cache.Get("C:\\missing.exe"));
+		IMS_CHECK(!fixture.cache.Get("C:\\wrong.exe"));
+	}
+	IMS_CHECK(fixture.cache.Upload() == 0);
+	IMS_CHECK(fixture.log->extractions == 2);
+	IMS_CHECK(fixture.cache.Size() == 2 && fixture.cache.Resident() == 0);
+	IMS_CHECK(fixture.log->textures == 0 && fixture.log->updates.empty());
+
+	// Nothing for an empty path, nothing without a backend
+	IMS_CHECK(!fixture.cache.Get("") && fixture.cache.Size() == 2);
+	IconCache none(nullptr);
+	IMS_CHECK(!none.Get("C:\\app.exe") && none.Size() == 0 && none.Upload() == 0);
+}
+
+IMS_TEST(IconCacheMarksIconsMissingWithoutATexture) {
+	IconFixture fixture;
+	fixture.log->failTextures = true;
+	fixture.cache.Get("a.exe");
+	fixture.cache.Get("b.exe");
+	IMS_CHECK(fixture.Settle(2) == 0);
+
+	// Never drawn with a null texture
+	IMS_CHECK(!fixture.cache.Get("a.exe") && !fixture.cache.Get("b.exe"));
+	IMS_CHECK(fixture.cache.Resident() == 0 && fixture.log->updates.empty());
+
+	// The texture is created with the next icon once the backend can
+	fixture.log->failTextures = false;
+	fixture.cache.Get("c.exe");
+	IMS_CHECK(fixture.Settle(3) == 1);
+	const IconCache::Icon* c = fixture.cache.Get("c.exe");
+	IMS_CHECK(c && c->texture == (ImTextureID)(intptr_t)1);
+	IMS_CHECK(fixture.log->textures == 1 && fixture.log->updates.size() == 1 && fixture.cache.Resident() == 1);
+}
+
+IMS_TEST(IconCacheEvictsTheLeastRecentlyDrawnIcon) {
+	// Room for four icons
+	IconFixture fixture({ 64, 32 });
+	for (const char* path : { "a.exe", "b.exe", "c.exe", "d.exe" })
+		fixture.cache.Get(path);
+	IMS_CHECK(fixture.Settle(4) == 4);
+	IMS_CHECK(fixture.cache.Resident() == 4 && fixture.cache.Evictions() == 0);
+
+	// a is drawn again, which leaves b as the least recently drawn
+	IMS_CHECK(fixture.cache.Get("a.exe"));
+	ImVec2 b = fixture.cache.Get("b.exe")->uv0;
+	for (const char* path : { "c.exe", "d.exe", "a.exe" })
+		IMS_CHECK(fixture.cache.Get(path));
+
+	fixture.cache.Get("e.exe");
+	IMS_CHECK(fixture.Settle(5) == 1);
+	IMS_CHECK(fixture.cache.Evictions() == 1 && fixture.cache.Resident() == 4);
+
+	// e took over b's cell, b is forgotten
+	const IconCache::Icon* e = fixture.cache.Get("e.exe");
+	IMS_CHECK(e && e->uv0.x == b.x && e->uv0.y == b.y);
+	IMS_CHECK(fixture.log->updates.size() == 5 && sameRect(fixture.log->updates[4], fixture.log->updates[1]));
+	for (const char* path : { "a.exe", "c.exe", "d.exe" })
+		IMS_CHECK(fixture.cache.Get(path));
+
+	// Asking for b again extracts it again and evicts the next one in line, e wasn't drawn since a, c and d
+	IMS_CHECK(!fixture.cache.Get("b.exe"));
+	IMS_CHECK(fixture.Settle(6) == 1);
+	IMS_CHECK(fixture.cache.Evictions() == 2 && fixture.cache.Resident() == 4);
+	IMS_CHECK(fixture.cache.Get("b.exe") && fixture.cache.Get("a.exe") && fixture.cache.Get("c.exe") && !fixture.cache.Get("e.exe"));
+}
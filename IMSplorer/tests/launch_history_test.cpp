@@ -0,0 +1,170 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "launch_history.h"
+
+using namespace IMS;
+
+namespace {
+	int64_t now() {
+		return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	/// <summary>
+	/// (rank, key) of every app, best first
+	/// </summary>
+	std::vector<std::pair<double, uint64_t>> ranking(const LaunchHistory& history) {
+		return { history.Ranked().begin(), history.Ranked().end() };
+	}
+
+	/// <summary>
+	/// Cut an append short: a few bytes of a record past the last whole one
+	/// </summary>
+	void tear(const std::filesystem::path& path) {
+		std::ofstream(path, std::ios::binary | std::ios::app).write("\x01\x02\x03", 3);
+	}
+} // namespace
+
+IMS_TEST(LaunchHistoryReadsBackWhatItAppended) {
+	Test::TempDirectory temp("imsplorer-test-launches");
+	std::filesystem::path path = temp.path / "launches.bin";
+	int64_t start = now() - 3600;
+
+	std::vector<std::pair<double, uint64_t>> ranked;
+	{
+		LaunchHistory history;
+		IMS_CHECK(!history.Load(path));
+		IMS_CHECK(history.Size() == 0 && history.Generation() == 1);
+
+		history.Record("C:\\Apps\\a.exe", std::chrono::system_clock::time_point(std::chrono::seconds(start)));
+		history.Record(LaunchHistory::Key("C:\\Apps\\b.exe"), start + 10);
+		history.Record(LaunchHistory::Key("C:\\APPS\\A.EXE"), start + 20);
+		history.Flush();
+
+		// Paths are case-insensitive, a is ahead with two launches
+		IMS_CHECK(history.Size() == 2 && history.Generation() == 4);
+		IMS_CHECK(history.Ranked().begin()->second == LaunchHistory::Key("c:\\apps\\a.exe"));
+		ranked = ranking(history);
+	}
+
+	// Records appended one per launch, behind the header the first run wrote
+	std::error_code ec;
+	IMS_CHECK(std::filesystem::file_size(path, ec) == sizeof(LaunchFileHeader) + 3 * sizeof(LaunchRecord));
+
+	LaunchHistory reloaded;
+	IMS_CHECK(reloaded.Load(path));
+	IMS_CHECK(ranking(reloaded) == ranked);
+
+	const LaunchHistory::Entry* a = reloaded.Find(LaunchHistory::Key("C:\\Apps\\a.exe"));
+	IMS_CHECK(a && a->count == 2 && a->last == start + 20);
+	IMS_CHECK(a && std::abs(LaunchHistory::Score(*a, start + 20) - (1.0 + std::exp2(-20.0 / LaunchHistory::kHalfLife))) < 1e-9);
+	IMS_CHECK(!reloaded.Find(LaunchHistory::Key("C:\\Apps\\c.exe")));
+}
+
+IMS_TEST(LaunchHistoryDropsATornRecord) {
+	Test::TempDirectory temp("imsplorer-test-launches-torn");
+	std::filesystem::path path = temp.path / "launches.bin";
+	int64_t start = now() - 3600;
+	{
+		LaunchHistory history;
+		history.Load(path);
+		for (int i = 0; i < 5; i++)
+			history.Record(LaunchHistory::Key("C:\\Apps\\a.exe"), start + i);
+	}
+	tear(path);
+
+	// The whole records still count, the file is rewritten without the partial one
+	{
+		LaunchHistory history;
+		IMS_CHECK(history.Load(path));
+		const LaunchHistory::Entry* a = history.Find(LaunchHistory::Key("C:\\Apps\\a.exe"));
+		IMS_CHECK(history.Size() == 1 && a && a->count == 5 && a->last == start + 4);
+	}
+
+	std::error_code ec;
+	IMS_CHECK(std::filesystem::file_size(path, ec) == sizeof(LaunchFileHeader) + sizeof(LaunchRecord));
+
+	// Anything that isn't a launch log is ignored and replaced
+	std::ofstream(path, std::ios::binary | std::ios::trunc) << "not a launch history";
+	{
+		LaunchHistory history;
+		IMS_CHECK(!history.Load(path));
+		IMS_CHECK(history.Size() == 0);
+	}
+	IMS_CHECK(std::filesystem::file_size(path, ec) == sizeof(LaunchFileHeader));
+}
+
+IMS_TEST(LaunchHistoryCompactionKeepsTheRanking) {
+	Test::TempDirectory temp("imsplorer-test-launches-compaction");
+	std::filesystem::path path = temp.path / "launches.bin";
+
+	// Enough launches of a few apps to compact the log, app i launched i + 1 times as often as app 0
+	static constexpr int apps = 8;
+	int64_t time = now() - 20000;
+	std::vector<std::pair<double, uint64_t>> ranked;
+	std::vector<LaunchHistory::Entry> entries;
+	{
+		LaunchHistory history;
+		history.Load(path);
+		for (int round = 0; round < 300; round++) {
+			for (int i = 0; i < apps; i++) {
+				for (int j = 0; j <= i; j++)
+					history.Record(LaunchHistory::Key(fmt::format("C:\\Apps\\{}.exe", i)), time++);
+			}
+		}
+		history.Flush();
+		IMS_CHECK(history.Compactions() >= 2); // The new file, then the log outgrowing the apps
+
+		ranked = ranking(history);
+		for (int i = 0; i < apps; i++)
+			entries.push_back(*history.Find(LaunchHistory::Key(fmt::format("C:\\Apps\\{}.exe", i))));
+	}
+	IMS_CHECK(ranked.size() == apps && ranked.front().second == LaunchHistory::Key("C:\\Apps\\7.exe"));
+
+	// One record per app after the last compaction, plus what was appended since
+	std::error_code ec;
+	IMS_CHECK(std::filesystem::file_size(path, ec) < sizeof(LaunchFileHeader) + 4096 * sizeof(LaunchRecord));
+
+	// Compacted weights are floats, so ranks only come back close, but in the same order
+	LaunchHistory reloaded;
+	IMS_CHECK(reloaded.Load(path));
+	std::vector<std::pair<double, uint64_t>> reloadedRanking = ranking(reloaded);
+	IMS_CHECK(reloadedRanking.size() == ranked.size());
+	for (size_t i = 0; i < (std::min)(ranked.size(), reloadedRanking.size()); i++)
+		IMS_CHECK(reloadedRanking[i].second == ranked[i].second && std::abs(reloadedRanking[i].first - ranked[i].first) < 1e-3);
+
+	for (int i = 0; i < apps; i++) {
+		const LaunchHistory::Entry* entry = reloaded.Find(LaunchHistory::Key(fmt::format("C:\\Apps\\{}.exe", i)));
+		IMS_CHECK(entry && entry->count == entries[i].count && entry->last == entries[i].last);
+	}
+}
+
+IMS_TEST(LaunchHistoryForgetsAppsNotLaunchedForLong) {
+	Test::TempDirectory temp("imsplorer-test-launches-forget");
+	std::filesystem::path path = temp.path / "launches.bin";
+
+	// a was launched once ten half-lives before b, a score of 1/1024 by then
+	int64_t recent = now() - 60;
+	int64_t old = recent - 10 * LaunchHistory::kHalfLife;
+	{
+		LaunchHistory history;
+		history.Load(path);
+		history.Record(LaunchHistory::Key("C:\\Apps\\a.exe"), old);
+		history.Record(LaunchHistory::Key("C:\\Apps\\b.exe"), recent);
+		history.Record(LaunchHistory::Key("C:\\Apps\\c.exe"), recent - LaunchHistory::kHalfLife);
+	}
+	tear(path); // Compacted on the next load
+
+	{
+		LaunchHistory history;
+		IMS_CHECK(history.Load(path));
+		IMS_CHECK(history.Size() == 3); // Dropped from the file, not from what was read
+	}
+
+	LaunchHistory reloaded;
+	IMS_CHECK(reloaded.Load(path));
+	IMS_CHECK(reloaded.Size() == 2);
+	IMS_CHECK(!reloaded.Find(LaunchHistory::Key("C:\\Apps\\a.exe")));
+	IMS_CHECK(reloaded.Find(LaunchHistory::Key("C:\\Apps\\b.exe")) && reloaded.Find(LaunchHistory::Key("C:\\Apps\\c.exe")));
+}
@@ -0,0 +1,266 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "process_cache.h"
+
+using namespace IMS;
+
+namespace {
+	/// <summary>
+	/// Processes are whatever the test says they are, a pid can be handed to a new process at any time
+	/// </summary>
+	class FakeProcessBackend : public IProcessBackend {
+	public:
+		struct Process {
+			uint64_t startTime = 0;
+			std::string path;
+		};
+
+		struct Counters {
+			int startTimes = 0;
+			int queries = 0;
+			int pins = 0;
+			std::vector<uintptr_t> unpinned;
+
+			// The next calls that fail as if the process couldn't be opened for a moment
+			int startTimeFailures = 0;
+			int pinFailures = 0;
+
+			std::function<void()> onStartTime; // Runs before every StartTime, e.g. to hold the worker there
+		};
+
+		FakeProcessBackend(std::shared_ptr<std::map<uint32_t, Process>> processes, std::shared_ptr<Counters> counters, bool pinnable)
+			: processes(std::move(processes)), counters(std::move(counters)), pinnable(pinnable) {}
+
+		bool StartTime(uint32_t pid, uint64_t& startTime) override {
+			this->counters->startTimes++;
+			if (this->counters->onStartTime) this->counters->onStartTime();
+			if (this->counters->startTimeFailures > 0 && this->counters->startTimeFailures--) return false;
+
+			auto it = this->processes->find(pid);
+			if (it == this->processes->end()) return false;
+
+			startTime = it->second.startTime;
+			return true;
+		}
+
+		bool ImagePath(uint32_t pid, std::string& path) override {
+			auto it = this->processes->find(pid);
+			if (it == this->processes->end()) return false;
+
+			path = it->second.path;
+			return true;
+		}
+
+		bool Pin(uint32_t pid, uintptr_t& pin) override {
+			if (!this->pinnable || (this->counters->pinFailures > 0 && this->counters->pinFailures--)) return false;
+
+			pin = ++this->counters->pins * 1000 + pid;
+			return true;
+		}
+
+		void Unpin(uintptr_t pin) override { this->counters->unpinned.push_back(pin); }
+
+		bool Query(uint32_t pid, Details& details) override {
+			this->counters->queries++;
+			return IProcessBackend::Query(pid, details);
+		}
+
+	private:
+		std::shared_ptr<std::map<uint32_t, Process>> processes;
+		std::shared_ptr<Counters> counters;
+		bool pinnable;
+	};
+
+	struct Fixture {
+		explicit Fixture(bool pinnable)
+			: processes(std::make_shared<std::map<uint32_t, FakeProcessBackend::Process>>()),
+			  counters(std::make_shared<FakeProcessBackend::Counters>()),
+			  cache(std::make_unique<FakeProcessBackend>(this->processes, this->counters, pinnable)) {}
+
+		std::shared_ptr<std::map<uint32_t, FakeProcessBackend::Process>> processes;
+		std::shared_ptr<FakeProcessBackend::Counters> counters;
+		ProcessCache cache;
+	};
+} // namespace
+
+IMS_TEST(ProcessCacheResolvesAProcessOncePerInstance) {
+	Fixture fixture(false);
+	(*fixture.processes)[42] = { 100, "C:\\Windows\\notepad.exe" };
+
+	auto first = fixture.cache.Acquire(42);
+	auto second = fixture.cache.Acquire(42);
+	IMS_CHECK(first && second);
+	IMS_CHECK(first->key == second->key && first->key == (ProcessKey{ 42, 100 }));
+	IMS_CHECK(fixture.cache.String(first->exePath) == "C:\\Windows\\notepad.exe");
+	IMS_CHECK(fixture.cache.String(first->exe) == "notepad.exe");
+
+	// One full query for the miss, the hit only revalidates the start time
+	IMS_CHECK(fixture.cache.Misses() == 1 && fixture.cache.Hits() == 1);
+	IMS_CHECK(fixture.counters->queries == 1);
+
+	// Every window holds a reference
+	fixture.cache.Release(first->key);
+	IMS_CHECK(fixture.cache.Size() == 1);
+	fixture.cache.Release(second->key);
+	IMS_CHECK(fixture.cache.Size() == 0);
+}
+
+IMS_TEST(ProcessCacheTellsAReusedPidApart) {
+	Fixture fixture(false);
+	(*fixture.processes)[7] = { 100, "C:\\Program Files\\Old\\old.exe" };
+	auto old = fixture.cache.Acquire(7);
+
+	// The process exits and its pid goes to a new one while the old window still holds its entry
+	(*fixture.processes)[7] = { 200, "C:\\Program Files\\New\\new.exe" };
+	auto reused = fixture.cache.Acquire(7);
+	IMS_CHECK(old && reused);
+	IMS_CHECK(reused->key == (ProcessKey{ 7, 200 }));
+	IMS_CHECK(fixture.cache.String(reused->exe) == "new.exe");
+	IMS_CHECK(fixture.cache.String(old->exe) == "old.exe");
+	IMS_CHECK(fixture.cache.Misses() == 2 && fixture.cache.Hits() == 0);
+	IMS_CHECK(fixture.cache.Size() == 2);
+
+	// Releasing the old instance leaves the new one as the pid's entry
+	fixture.cache.Release(old->key);
+	IMS_CHECK(fixture.cache.Size() == 1);
+	auto again = fixture.cache.Acquire(7);
+	IMS_CHECK(again && again->key == reused->key);
+	IMS_CHECK(fixture.cache.Hits() == 1);
+
+	// Gone for good
+	fixture.processes->erase(7);
+	fixture.cache.Release(reused->key);
+	fixture.cache.Release(again->key);
+	IMS_CHECK(!fixture.cache.Acquire(7));
+	IMS_CHECK(fixture.cache.Size() == 0);
+}
+
+IMS_TEST(ProcessCacheTrustsPinnedEntriesAndUnpinsThem) {
+	auto unpinned = std::make_shared<FakeProcessBackend::Counters>();
+	{
+		Fixture fixture(true);
+		(*fixture.processes)[3] = { 100, "/usr/bin/a" };
+		(*fixture.processes)[4] = { 100, "/usr/bin/b" };
+
+		auto a = fixture.cache.Acquire(3);
+		int startTimes = fixture.counters->startTimes;
+		for (int i = 0; i < 10; i++)
+			fixture.cache.Acquire(3);
+
+		// A pinned pid can't be reused, hits don't ask the backend at all
+		IMS_CHECK(fixture.counters->startTimes == startTimes);
+		IMS_CHECK(fixture.cache.Hits() == 10);
+
+		for (int i = 0; i < 11; i++)
+			fixture.cache.Release(a->key);
+		IMS_CHECK((fixture.counters->unpinned == std::vector<uintptr_t>{ 1003 }));
+
+		// Whatever is still cached gets unpinned with the cache
+		fixture.cache.Acquire(4);
+		unpinned = fixture.counters;
+	}
+	IMS_CHECK((unpinned->unpinned == std::vector<uintptr_t>{ 1003, 2004 }));
+}
+
+IMS_TEST(ProcessCacheKeepsAnEntryThatFailedToRevalidateOnce) {
+	Fixture fixture(true);
+	(*fixture.processes)[9] = { 100, "/usr/bin/c" };
+
+	// Not pinned the first time, so the next lookup revalidates, and that fails for a moment
+	fixture.counters->pinFailures = 1;
+	auto first = fixture.cache.Acquire(9);
+	fixture.counters->startTimeFailures = 1;
+	auto second = fixture.cache.Acquire(9);
+	IMS_CHECK(first && second && first->key == second->key);
+	IMS_CHECK(fixture.counters->queries == 2 && fixture.cache.Size() == 1);
+
+	// The query found the cached process: its new pin is dropped right away, the entry keeps both windows
+	IMS_CHECK((fixture.counters->unpinned == std::vector<uintptr_t>{ 1009 }));
+	fixture.cache.Release(first->key);
+	IMS_CHECK(fixture.cache.Size() == 1);
+	auto third = fixture.cache.Acquire(9);
+	IMS_CHECK(third && third->key == first->key && fixture.cache.Hits() == 1);
+
+	fixture.cache.Release(second->key);
+	fixture.cache.Release(third->key);
+	IMS_CHECK(fixture.cache.Size() == 0);
+	IMS_CHECK((fixture.counters->unpinned == std::vector<uintptr_t>{ 1009 }));
+}
+
+IMS_TEST(ProcessCacheReleasesWhileTheBackendIsBusy) {
+	Fixture fixture(false);
+	(*fixture.processes)[5] = { 100, "C:\\Windows\\explorer.exe" };
+	(*fixture.processes)[6] = { 100, "C:\\Windows\\notepad.exe" };
+	auto other = fixture.cache.Acquire(5);
+	auto cached = fixture.cache.Acquire(6);
+	IMS_CHECK(other && cached);
+
+	// The worker revalidates 6 and is held inside the backend call
+	std::binary_semaphore entered(0), proceed(0);
+	std::atomic<bool> released = false;
+	bool releasedFirst = false;
+	fixture.counters->onStartTime = [&]() {
+		entered.release();
+		proceed.try_acquire_for(std::chrono::seconds(5)); // Holding the lock would block the releases until this times out
+		releasedFirst = released.load();
+	};
+
+	std::optional<ProcessInfo> revalidated;
+	std::jthread worker([&]() { revalidated = fixture.cache.Acquire(6); });
+	entered.acquire();
+
+	// Both go through meanwhile, including the entry being revalidated
+	fixture.cache.Release(other->key);
+	fixture.cache.Release(cached->key);
+	IMS_CHECK(fixture.cache.Size() == 0);
+	released = true;
+	proceed.release();
+	worker.join();
+
+	// The entry went away under the worker, so it's queried and cached again
+	IMS_CHECK(releasedFirst);
+	IMS_CHECK(revalidated && revalidated->key == cached->key);
+	IMS_CHECK(fixture.cache.String(revalidated->exe) == "notepad.exe");
+	IMS_CHECK(fixture.counters->queries == 3 && fixture.cache.Misses() == 3 && fixture.cache.Hits() == 0);
+	IMS_CHECK(fixture.cache.Size() == 1);
+	fixture.cache.Release(revalidated->key);
+	IMS_CHECK(fixture.cache.Size() == 0);
+}
+
+IMS_TEST(StringInternerReadsWhileInterning) {
+	StringInterner strings;
+	IMS_CHECK(strings.Get(0).empty());
+	IMS_CHECK(strings.Intern("") == 0);
+	IMS_CHECK(strings.Get(123456).empty()); // Unknown ids read as the empty string
+
+	// Enough strings to fill several chunks while readers chase the writer
+	static constexpr size_t count = StringInterner::kChunkSize * 8;
+	std::atomic<bool> done = false;
+	std::atomic<size_t> wrong = 0;
+
+	std::vector<std::jthread> readers;
+	for (int i = 0; i < 3; i++) {
+		readers.emplace_back([&]() {
+			while (!done.load(std::memory_order_acquire)) {
+				size_t size = strings.Size();
+				for (size_t id = 1; id < size; id += 7) {
+					if (strings.Get((StringId)id) != fmt::format("C:\\Program Files\\App{}\\app.exe", id)) wrong++;
+				}
+			}
+		});
+	}
+
+	bool ids = true;
+	for (size_t i = 1; i <= count; i++)
+		ids = ids && strings.Intern(fmt::format("C:\\Program Files\\App{}\\app.exe", i)) == i;
+	done.store(true, std::memory_order_release);
+	readers.clear();
+
+	IMS_CHECK(ids);
+	IMS_CHECK(wrong == 0);
+	IMS_CHECK(strings.Size() == count + 1);
+	IMS_CHECK(strings.Intern("C:\\Program Files\\App5\\app.exe") == 5);
+	IMS_CHECK(std::string_view(strings.CStr(5)) == "C:\\Program Files\\App5\\app.exe");
+}
@@ -0,0 +1,142 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "profiler.h"
+
+using namespace IMS;
+
+namespace {
+	// What a sample recorded at `start` carries, so a reader can tell a torn one
+	uint64_t durationAt(uint64_t start) { return start % 997 + 1; }
+	ProfileZone zoneAt(uint64_t start) { return (ProfileZone)(start / 7 % (uint64_t)ProfileZone::Count); }
+
+	void record(uint64_t start) {
+		Profiler::Get().Record(zoneAt(start), start, start + durationAt(start));
+	}
+
+	/// <summary>
+	/// Fill the whole ring from this thread, starts 1000, 2000, ...
+	/// </summary>
+	void fill() {
+		for (uint64_t i = 1; i <= Profiler::kCapacity; i++)
+			record(i * 1000);
+	}
+
+	std::vector<std::string> lines(const std::filesystem::path& path) {
+		std::ifstream file(path, std::ios::binary);
+		std::vector<std::string> result;
+		for (std::string line; std::getline(file, line);)
+			result.push_back(line);
+		return result;
+	}
+} // namespace
+
+IMS_TEST(ProfilerRingIsReadWhileWritten) {
+	static constexpr uint64_t writers = 4;
+	static constexpr uint64_t perWriter = Profiler::kCapacity * 8;
+
+	std::atomic<bool> done = false;
+	std::atomic<size_t> torn = 0, unordered = 0, snapshots = 0;
+
+	// Snapshots while the ring wraps over and over, a sample is either whole or not there
+	std::jthread reader([&]() {
+		std::vector<ProfileSample> samples;
+		while (!done.load(std::memory_order_acquire)) {
+			Profiler::Get().Snapshot(samples);
+			std::map<uint32_t, uint64_t> last;
+			for (const ProfileSample& sample : samples) {
+				if (sample.duration != durationAt(sample.start) || sample.zone != zoneAt(sample.start) || sample.thread == 0) torn++;
+
+				// Oldest first, so every thread's own samples come in the order it wrote them
+				uint64_t& previous = last[sample.thread];
+				if (sample.start <= previous) unordered++;
+				previous = sample.start;
+			}
+			snapshots++;
+		}
+	});
+
+	{
+		std::vector<std::jthread> threads;
+		for (uint64_t writer = 0; writer < writers; writer++) {
+			threads.emplace_back([writer]() {
+				for (uint64_t i = 1; i <= perWriter; i++)
+					record((writer << 40) + i);
+			});
+		}
+	}
+	done.store(true, std::memory_order_release);
+	reader.join();
+
+	IMS_CHECK(snapshots > 0);
+	IMS_CHECK(torn == 0);
+	IMS_CHECK(unordered == 0);
+
+	// Once the writers are done the ring is full of their samples, none of them torn
+	std::vector<ProfileSample> samples;
+	Profiler::Get().Snapshot(samples);
+	IMS_CHECK(samples.size() == Profiler::kCapacity);
+	IMS_CHECK(std::all_of(samples.begin(), samples.end(), [](const ProfileSample& sample) {
+		return sample.start >> 40 < writers && sample.duration == durationAt(sample.start) && sample.zone == zoneAt(sample.start);
+	}));
+}
+
+IMS_TEST(ProfilerExportsWhatTheRingHolds) {
+	Test::TempDirectory temp("imsplorer-test-profiler");
+	fill();
+
+	std::vector<ProfileSample> samples;
+	Profiler::Get().Snapshot(samples);
+	IMS_CHECK(samples.size() == Profiler::kCapacity);
+
+	// One row per sample after the header, oldest first, in microseconds
+	IMS_CHECK(Profiler::Get().ExportCsv(temp.path / "profile.csv"));
+	std::vector<std::string> csv = lines(temp.path / "profile.csv");
+	IMS_CHECK(csv.size() == samples.size() + 1 && csv.front() == "zone,thread,start_us,duration_us");
+
+	bool same = csv.size() == samples.size() + 1;
+	for (size_t i = 0; same && i < samples.size(); i++) {
+		std::istringstream row(csv[i + 1]);
+		std::string zone, thread, start, duration;
+		std::getline(row, zone, ',');
+		std::getline(row, thread, ',');
+		std::getline(row, start, ',');
+		std::getline(row, duration, ',');
+
+		same = zone == ProfileZoneName(samples[i].zone) && std::stoul(thread) == samples[i].thread &&
+			std::abs(std::stod(start) * 1000.0 - (double)samples[i].start) < 1.0 && std::abs(std::stod(duration) * 1000.0 - (double)samples[i].duration) < 1.0;
+	}
+	IMS_CHECK(same);
+
+	// A complete event per line, relative to the earliest one
+	IMS_CHECK(Profiler::Get().ExportChromeTrace(temp.path / "profile.json"));
+	std::vector<std::string> trace = lines(temp.path / "profile.json");
+	IMS_CHECK(trace.size() == samples.size() + 2);
+	IMS_CHECK(trace.front() == "{\"traceEvents\":[" && trace.back() == "],\"displayTimeUnit\":\"ms\"}");
+	IMS_CHECK(trace.size() > 2 && trace[1] == fmt::format("{{\"name\":\"{}\",\"cat\":\"imsplorer\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":0.000,\"dur\":{:.3f}}},",
+		ProfileZoneName(samples[0].zone), samples[0].thread, samples[0].duration / 1000.0));
+	IMS_CHECK(trace.size() > 3 && trace[2].starts_with("{\"name\":") && trace[2].find("\"ts\":1.000,") != std::string::npos);
+
+	// Somewhere it can't write
+	IMS_CHECK(!Profiler::Get().ExportCsv(temp.path / "missing" / "profile.csv"));
+	IMS_CHECK(!Profiler::Get().ExportChromeTrace(temp.path / "missing" / "profile.json"));
+}
+
+IMS_TEST(ProfilerPercentilesAreNearestRank) {
+	std::vector<float> values(101);
+	for (size_t i = 0; i < values.size(); i++)
+		values[i] = (float)i;
+
+	IMS_CHECK(ProfilePercentile(values, 0.0f) == 0.0f);
+	IMS_CHECK(ProfilePercentile(values, 0.5f) == 50.0f);
+	IMS_CHECK(ProfilePercentile(values, 0.95f) == 95.0f);
+	IMS_CHECK(ProfilePercentile(values, 0.99f) == 99.0f);
+	IMS_CHECK(ProfilePercentile(values, 1.0f) == 100.0f);
+
+	// Rounded to the nearest sample, clamped to the last
+	IMS_CHECK(ProfilePercentile({ 1.0f, 2.0f, 3.0f, 4.0f }, 0.5f) == 3.0f);
+	IMS_CHECK(ProfilePercentile({ 1.0f, 2.0f }, 2.0f) == 2.0f);
+	IMS_CHECK(ProfilePercentile({ 7.0f }, 0.99f) == 7.0f);
+	IMS_CHECK(ProfilePercentile({}, 0.5f) == 0.0f);
+}
@@ -0,0 +1,219 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "resource_sampler.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace IMS;
+
+namespace {
+	/// <summary>
+	/// Hands out whatever the test put in `processes`, in the order it's in
+	/// </summary>
+	class FakeResourceBackend : public IResourceBackend {
+	public:
+		explicit FakeResourceBackend(std::shared_ptr<std::vector<ProcessSample>> processes) : processes(std::move(processes)) {}
+
+		bool Sample(std::vector<ProcessSample>& out) override {
+			if (this->fail) return false;
+
+			out = *this->processes;
+			return true;
+		}
+
+		bool fail = false;
+
+	private:
+		std::shared_ptr<std::vector<ProcessSample>> processes;
+	};
+
+	ProcessSample* find(std::vector<ProcessSample>& processes, uint32_t pid) {
+		auto it = std::find_if(processes.begin(), processes.end(), [&](const ProcessSample& process) { return process.pid == pid; });
+		return it != processes.end() ? &*it : nullptr;
+	}
+} // namespace
+
+IMS_TEST(SnapshotBufferHandsOverWholeValuesInOrder) {
+	static constexpr uint64_t publishes = 200'000;
+
+	struct Pair {
+		uint64_t a = 0;
+		uint64_t b = 0;
+	};
+
+	SnapshotBuffer<Pair> buffer;
+	IMS_CHECK(!buffer.Update());
+	IMS_CHECK(buffer.Front().a == 0 && buffer.Front().b == 0);
+
+	std::atomic<bool> done = false;
+	std::jthread writer([&]() {
+		for (uint64_t i = 1; i <= publishes; i++) {
+			buffer.Back() = { i, i };
+			buffer.Publish();
+		}
+		done = true;
+	});
+
+	// Every value picked up is whole and newer than the one before, the last one is the last published
+	bool whole = true, ordered = true;
+	uint64_t last = 0;
+	for (;;) {
+		bool finished = done.load();
+		if (buffer.Update()) {
+			const Pair& value = buffer.Front();
+			whole = whole && value.a == value.b;
+			ordered = ordered && value.a > last;
+			last = value.a;
+		}
+		else if (finished) {
+			break;
+		}
+	}
+	writer.join();
+
+	IMS_CHECK(whole);
+	IMS_CHECK(ordered);
+	IMS_CHECK(last == publishes);
+	IMS_CHECK(!buffer.Update() && buffer.Front().a == publishes);
+}
+
+IMS_TEST(ResourceSamplerPublishesCpuFromDeltas) {
+	auto processes = std::make_shared<std::vector<ProcessSample>>(std::vector<ProcessSample>{
+		{ 30, 100, 5'000'000'000, 300 << 20 },
+		{ 10, 100, 1'000'000'000, 100 << 20 },
+		{ 20, 100, 2'000'000'000, 200 << 20 },
+	});
+
+	int published = 0;
+	ResourceSampler sampler(std::make_unique<FakeResourceBackend>(processes), [&]() { published++; }, std::chrono::milliseconds(0));
+
+	// The first sample is only the baseline
+	IMS_CHECK(sampler.Sample());
+	IMS_CHECK(!sampler.Update() && sampler.Samples() == 0 && published == 0);
+	IMS_CHECK(sampler.Latest().sequence == 0 && sampler.Latest().processes.empty());
+
+	// 10 burns 100 ms of CPU, 20 twice that, 30 nothing
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	find(*processes, 10)->cpuTime += 100'000'000;
+	find(*processes, 20)->cpuTime += 200'000'000;
+	find(*processes, 20)->workingSet = 250 << 20;
+	IMS_CHECK(sampler.Sample());
+	IMS_CHECK(sampler.Update() && sampler.Samples() == 1 && published == 1);
+
+	const ResourceSnapshot& snapshot = sampler.Latest();
+	IMS_CHECK(snapshot.sequence == 1 && snapshot.cores >= 1);
+	IMS_CHECK(snapshot.processes.size() == 3);
+	IMS_CHECK(std::is_sorted(snapshot.processes.begin(), snapshot.processes.end(), [](const ProcessUsage& a, const ProcessUsage& b) { return a.key.pid < b.key.pid; }));
+
+	const ProcessUsage* a = snapshot.Find({ 10, 100 });
+	const ProcessUsage* b = snapshot.Find({ 20, 100 });
+	const ProcessUsage* c = snapshot.Find({ 30, 100 });
+	IMS_CHECK(a && b && c);
+	if (a && b && c) {
+		// At least 50 ms passed, so 100 ms of CPU is at most two cores, and it's well above nothing however slow the machine
+		IMS_CHECK(a->cpu > 0.0f && a->cpu <= 2.0f);
+		IMS_CHECK(std::abs(b->cpu - 2.0f * a->cpu) < 1e-4f * b->cpu);
+		IMS_CHECK(c->cpu == 0.0f);
+		IMS_CHECK(b->workingSet == 250 << 20 && c->workingSet == 300 << 20);
+	}
+
+	// Nothing new until the next sample
+	IMS_CHECK(!sampler.Update() && sampler.Latest().sequence == 1);
+}
+
+IMS_TEST(ResourceSamplerGivesRestartedProcessesNoDelta) {
+	auto processes = std::make_shared<std::vector<ProcessSample>>(std::vector<ProcessSample>{
+		{ 10, 100, 1'000'000'000, 1 << 20 },
+		{ 20, 100, 2'000'000'000, 1 << 20 },
+		{ 30, 100, 3'000'000'000, 1 << 20 },
+	});
+	ResourceSampler sampler(std::make_unique<FakeResourceBackend>(processes), nullptr, std::chrono::milliseconds(0));
+	sampler.Sample();
+
+	// 10 exited and its pid went to a process that already used more CPU than the old one had,
+	// 20 reports less CPU than before (it can't), 30 exited and 40 started
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	*processes = { { 10, 200, 9'000'000'000, 1 << 20 }, { 20, 100, 1'000'000'000, 1 << 20 }, { 40, 300, 500'000'000, 1 << 20 } };
+	IMS_CHECK(sampler.Sample() && sampler.Update());
+
+	const ResourceSnapshot& snapshot = sampler.Latest();
+	IMS_CHECK(snapshot.processes.size() == 3);
+	IMS_CHECK(!snapshot.Find({ 10, 100 }));
+	const ProcessUsage* restarted = snapshot.Find({ 10, 200 });
+	IMS_CHECK(restarted && restarted->cpu == 0.0f);
+	const ProcessUsage* backwards = snapshot.Find({ 20, 100 });
+	IMS_CHECK(backwards && backwards->cpu == 0.0f);
+	const ProcessUsage* started = snapshot.Find({ 40, 300 });
+	IMS_CHECK(started && started->cpu == 0.0f);
+	IMS_CHECK(!snapshot.Find({ 30, 100 }));
+
+	// Found by both halves of the key only
+	IMS_CHECK(!snapshot.Find({ 40, 100 }) && !snapshot.Find({ 15, 100 }) && !snapshot.Find({ 50, 300 }));
+}
+
+IMS_TEST(ResourceSamplerSurvivesAFailingBackend) {
+	auto processes = std::make_shared<std::vector<ProcessSample>>(std::vector<ProcessSample>{ { 10, 100, 0, 1 << 20 } });
+	auto backend = std::make_unique<FakeResourceBackend>(processes);
+	FakeResourceBackend* fake = backend.get();
+	ResourceSampler sampler(std::move(backend), nullptr, std::chrono::milliseconds(0));
+
+	fake->fail = true;
+	IMS_CHECK(!sampler.Sample());
+	fake->fail = false;
+	IMS_CHECK(sampler.Sample());
+	IMS_CHECK(!sampler.Update());
+	fake->fail = true;
+	IMS_CHECK(!sampler.Sample() && !sampler.Update());
+	fake->fail = false;
+	IMS_CHECK(sampler.Sample() && sampler.Update() && sampler.Latest().Find({ 10, 100 }));
+
+	// No backend, no samples
+	ResourceSampler none(nullptr, nullptr, std::chrono::milliseconds(0));
+	IMS_CHECK(!none.Sample() && !none.Update() && none.Latest().processes.empty());
+}
+
+IMS_TEST(ResourceSamplerThreadPublishesOnItsOwn) {
+	auto processes = std::make_shared<std::vector<ProcessSample>>(std::vector<ProcessSample>{ { 10, 100, 0, 1 << 20 } });
+	std::atomic<int> published = 0;
+	ResourceSampler sampler(std::make_unique<FakeResourceBackend>(processes), [&]() { published++; }, std::chrono::milliseconds(5));
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (published < 2 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	IMS_CHECK(published >= 2 && sampler.Samples() >= 2);
+	IMS_CHECK(sampler.Update() && sampler.Latest().sequence >= 1 && sampler.Latest().Find({ 10, 100 }));
+}
+
+#ifdef __linux__
+IMS_TEST(ProcFsResourceBackendSeesThisProcess) {
+	uint32_t self = (uint32_t)getpid();
+	ProcFsResourceBackend backend;
+	std::vector<ProcessSample> processes;
+	IMS_CHECK(backend.Sample(processes));
+
+	ProcessSample* sample = find(processes, self);
+	IMS_CHECK(sample && sample->workingSet > 0);
+
+	// Keyed like the process cache, so the taskbar can find a window's process
+	ProcFsProcessBackend processBackend;
+	uint64_t startTime = 0;
+	IMS_CHECK(processBackend.StartTime(self, startTime) && sample && sample->startTime == startTime);
+
+	// CPU time only counts up, spin until it does (it moves in clock ticks)
+	uint64_t before = sample ? sample->cpuTime : 0;
+	bool advanced = false;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	volatile uint64_t spin = 0;
+	while (!advanced && std::chrono::steady_clock::now() < deadline) {
+		for (int i = 0; i < 1'000'000; i++)
+			spin = spin + 1;
+		advanced = backend.Sample(processes) && find(processes, self) && find(processes, self)->cpuTime > before;
+	}
+	IMS_CHECK(advanced);
+}
+#endif
@@ -0,0 +1,114 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "shell_events.h"
+
+using namespace IMS;
+
+namespace {
+	bool same(const std::vector<ShellEvent>& batch, std::initializer_list<ShellEvent> expected) {
+		return std::equal(batch.begin(), batch.end(), expected.begin(), expected.end(), [](const ShellEvent& a, const ShellEvent& b) {
+			return a.type == b.type && a.handle == b.handle && a.other == b.other;
+		});
+	}
+} // namespace
+
+IMS_TEST(ShellEventsDropCreationsOfWindowsDestroyedInOneBatch) {
+	ShellEventQueue queue;
+	queue.Push(ShellEventType::Created, 1);
+	queue.Push(ShellEventType::Created, 2);
+	queue.Push(ShellEventType::Destroyed, 1);
+	queue.Push(ShellEventType::Destroyed, 3); // Created in an earlier batch, has to reach the taskbar
+
+	IMS_CHECK(same(queue.Coalesce(), { { ShellEventType::Created, 2 }, { ShellEventType::Destroyed, 1 }, { ShellEventType::Destroyed, 3 } }));
+	IMS_CHECK(queue.Received() == 4 && queue.Applied() == 3);
+
+	// A handle reused within the batch is a new window
+	queue.Push(ShellEventType::Created, 4);
+	queue.Push(ShellEventType::Destroyed, 4);
+	queue.Push(ShellEventType::Created, 4);
+	IMS_CHECK(same(queue.Coalesce(), { { ShellEventType::Destroyed, 4 }, { ShellEventType::Created, 4 } }));
+	IMS_CHECK(queue.Received() == 7 && queue.Applied() == 5);
+}
+
+IMS_TEST(ShellEventsRemoveWindowsKnownBeforeTheBatch) {
+	// Found by the startup enumeration, then the hook reports it (late) and its destruction in one frame
+	std::set<WindowHandle> taskbar = { 8, 9 };
+	ShellEventQueue queue;
+	queue.Push(ShellEventType::Created, 8);
+	queue.Push(ShellEventType::Redraw, 8);
+	queue.Push(ShellEventType::Destroyed, 8);
+
+	const std::vector<ShellEvent>& batch = queue.Coalesce();
+	IMS_CHECK(same(batch, { { ShellEventType::Redraw, 8 }, { ShellEventType::Destroyed, 8 } }));
+
+	// Applied like the taskbar does, no button is left behind
+	for (const ShellEvent& event : batch) {
+		if (event.type == ShellEventType::Created) taskbar.insert(event.handle);
+		if (event.type == ShellEventType::Destroyed) taskbar.erase(event.handle);
+	}
+	IMS_CHECK(taskbar == std::set<WindowHandle>{ 9 });
+}
+
+IMS_TEST(ShellEventsCollapseDuplicatesInOrder) {
+	ShellEventQueue queue;
+	queue.Push(ShellEventType::Redraw, 5);
+	queue.Push(ShellEventType::Created, 6);
+	for (int i = 0; i < 50; i++) {
+		queue.Push(ShellEventType::Redraw, 5);
+		queue.Push(ShellEventType::Created, 6);
+		queue.Push(ShellEventType::Redraw, 6);
+	}
+
+	IMS_CHECK(same(queue.Coalesce(), { { ShellEventType::Redraw, 5 }, { ShellEventType::Created, 6 }, { ShellEventType::Redraw, 6 } }));
+	IMS_CHECK(queue.Received() == 152);
+	IMS_CHECK(queue.Applied() == 3);
+}
+
+IMS_TEST(ShellEventsKeepOnlyTheLastActivationAndApplyItLast) {
+	ShellEventQueue queue;
+	queue.Push(ShellEventType::Activated, 1);
+	queue.Push(ShellEventType::Created, 2);
+	queue.Push(ShellEventType::Activated, 2);
+	queue.Push(ShellEventType::Redraw, 1);
+	queue.Push(ShellEventType::Activated, 0); // Something off the taskbar, clears the focus
+
+	IMS_CHECK(same(queue.Coalesce(), { { ShellEventType::Created, 2 }, { ShellEventType::Redraw, 1 }, { ShellEventType::Activated, 0 } }));
+
+	// Activating a window destroyed in the same batch still comes last
+	queue.Push(ShellEventType::Activated, 7);
+	queue.Push(ShellEventType::Destroyed, 7);
+	IMS_CHECK(same(queue.Coalesce(), { { ShellEventType::Destroyed, 7 }, { ShellEventType::Activated, 7 } }));
+}
+
+IMS_TEST(ShellEventsFoldReplacePairsInEitherOrder) {
+	ShellEventQueue queue;
+	queue.Push(ShellEventType::Replaced, 10);
+	queue.Push(ShellEventType::Replacing, 11);
+	queue.Push(ShellEventType::Replacing, 21);
+	queue.Push(ShellEventType::Replaced, 20);
+	IMS_CHECK(same(queue.Coalesce(), { { ShellEventType::Replace, 10, 11 }, { ShellEventType::Replace, 20, 21 } }));
+
+	// Half a pair is passed on as is
+	queue.Push(ShellEventType::Replacing, 31);
+	IMS_CHECK(same(queue.Coalesce(), { { ShellEventType::Replacing, 31 } }));
+}
+
+IMS_TEST(ShellEventsStartEveryBatchEmpty) {
+	ShellEventQueue queue;
+	IMS_CHECK(queue.Empty());
+	IMS_CHECK(queue.Coalesce().empty());
+
+	queue.Push(ShellEventType::Created, 1);
+	queue.Push(ShellEventType::Activated, 1);
+	IMS_CHECK(!queue.Empty());
+	IMS_CHECK(queue.Coalesce().size() == 2);
+	IMS_CHECK(queue.Empty());
+
+	// Nothing carries over: the creation, the activation and the redraw state are per batch
+	queue.Push(ShellEventType::Created, 1);
+	queue.Push(ShellEventType::Redraw, 1);
+	IMS_CHECK(same(queue.Coalesce(), { { ShellEventType::Created, 1 }, { ShellEventType::Redraw, 1 } }));
+	IMS_CHECK(queue.Received() == 4 && queue.Applied() == 4);
+}
@@ -0,0 +1,162 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "shell_link.h"
+
+using namespace IMS;
+
+// The fixtures in tests/data are written by hand to [MS-SHLLINK]:
+//   relative.lnk     only a relative path, ANSI strings
+//   environment.lnk  LinkInfo with an expanded path, plus environment variable and icon blocks that win over it
+//   unicode.lnk      item id list, LinkInfo with a Unicode base path, Unicode strings outside the BMP
+//   idlist.lnk       item id list only, a virtual folder with no file target
+
+namespace {
+	std::vector<uint8_t> readFixture(std::string_view name) {
+		std::ifstream in(Test::DataPath(name), std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	/// <summary>
+	/// Parse a copy exactly `size` bytes long on the heap, so reading past the end trips the sanitizers
+	/// </summary>
+	std::optional<ShellLink> parseCopy(const std::vector<uint8_t>& data, size_t size) {
+		auto copy = std::make_unique<uint8_t[]>(size);
+		if (size > 0) std::memcpy(copy.get(), data.data(), size);
+		return ParseShellLink(std::span<const uint8_t>(copy.get(), size));
+	}
+
+	void writeU32(std::vector<uint8_t>& data, size_t offset, uint32_t value) {
+		for (int i = 0; i < 4; i++)
+			data[offset + i] = (uint8_t)(value >> (8 * i));
+	}
+
+	constexpr const char* kFixtures[] = { "relative.lnk", "environment.lnk", "unicode.lnk", "idlist.lnk" };
+} // namespace
+
+IMS_TEST(ShellLinkParsesARelativePath) {
+	std::vector<uint8_t> data = readFixture("relative.lnk");
+	std::optional<ShellLink> link = ParseShellLink(data);
+	IMS_CHECK(link.has_value());
+	if (!link) return;
+
+	IMS_CHECK(link->target.empty());
+	IMS_CHECK(link->relativePath == "..\\Tools\\app.exe");
+	IMS_CHECK(link->workingDirectory == ".");
+	IMS_CHECK(link->arguments == "--flag \"quoted arg\"");
+	IMS_CHECK(link->iconLocation == "..\\Tools\\app.exe");
+	IMS_CHECK(link->iconIndex == 2);
+
+	// Reading the file resolves it against the folder the shortcut is in
+	std::optional<ShellLink> read = ReadShellLink(Test::DataPath("relative.lnk"));
+	IMS_CHECK(read && std::filesystem::path(read->target) == (Test::DataPath("relative.lnk").parent_path() / ".." / "Tools" / "app.exe").lexically_normal());
+}
+
+IMS_TEST(ShellLinkKeepsEnvironmentVariables) {
+	std::optional<ShellLink> link = ParseShellLink(readFixture("environment.lnk"));
+	IMS_CHECK(link.has_value());
+	if (!link) return;
+
+	// The blocks win over the LinkInfo path and the icon string, past an unknown block in between
+	IMS_CHECK(link->target == "%windir%\\system32\\notepad.exe");
+	IMS_CHECK(link->iconLocation == "%SystemRoot%\\system32\\imageres.dll");
+	IMS_CHECK(link->iconIndex == 21);
+	IMS_CHECK(link->workingDirectory == "%HOMEDRIVE%%HOMEPATH%");
+	IMS_CHECK(link->arguments.empty() && link->relativePath.empty());
+
+	// Expanded when read from disk
+	std::string windir = ExpandEnvironmentVariables("%windir%");
+	std::optional<ShellLink> read = ReadShellLink(Test::DataPath("environment.lnk"));
+	IMS_CHECK(read && read->target == windir + "\\system32\\notepad.exe");
+}
+
+IMS_TEST(ShellLinkReadsUnicode) {
+	std::optional<ShellLink> link = ParseShellLink(readFixture("unicode.lnk"));
+	IMS_CHECK(link.has_value());
+	if (!link) return;
+
+	// The Unicode base path, not the ANSI one with question marks
+	IMS_CHECK(link->target == "C:\\Users\\Zo\xC3\xAB\\\xD0\x9F\xD1\x80\xD0\xBE\xD0\xB3\xD1\x80\xD0\xB0\xD0\xBC\xD0\xBC\xD1\x8B\\\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E.exe");
+	IMS_CHECK(link->workingDirectory == "C:\\Users\\Zo\xC3\xAB");
+	IMS_CHECK(link->arguments == "--open \"\xF0\x9F\x93\x81 Documents\"");
+	IMS_CHECK(link->iconLocation.empty() && link->iconIndex == 0);
+}
+
+IMS_TEST(ShellLinkReadsAnItemIdListOnlyLink) {
+	std::optional<ShellLink> link = ParseShellLink(readFixture("idlist.lnk"));
+	IMS_CHECK(link.has_value());
+	if (!link) return;
+
+	// Nothing to launch by path, the icon still comes through
+	IMS_CHECK(link->target.empty() && link->relativePath.empty());
+	IMS_CHECK(link->arguments.empty() && link->workingDirectory.empty());
+	IMS_CHECK(link->iconLocation == "%SystemRoot%\\system32\\shell32.dll");
+	IMS_CHECK(link->iconIndex == -137);
+}
+
+IMS_TEST(ShellLinkRejectsTruncatedFiles) {
+	for (const char* name : kFixtures) {
+		std::vector<uint8_t> data = readFixture(name);
+		std::optional<ShellLink> full = ParseShellLink(data);
+		IMS_CHECK(full.has_value());
+
+		// Cut anywhere up to the end of the strings it's rejected. Past that only extra data blocks go
+		// missing, which end the list without failing the link, so it never comes back once it parses.
+		size_t first = data.size() + 1;
+		bool monotonic = true;
+		for (size_t size = 0; size < data.size(); size++) {
+			std::optional<ShellLink> link = parseCopy(data, size);
+			if (link && first > data.size()) first = size;
+			monotonic = monotonic && (link.has_value() == (size >= first));
+
+			// Whatever survives a cut only lost blocks, the strings are all there
+			if (link && full) IMS_CHECK(link->arguments == full->arguments && link->workingDirectory == full->workingDirectory);
+		}
+		IMS_CHECK(monotonic);
+		IMS_CHECK(first > 0x4C);
+
+		// Without extra data only the terminal block can go
+		if (std::string_view(name) != "environment.lnk") IMS_CHECK(first >= data.size() - 4);
+	}
+}
+
+IMS_TEST(ShellLinkRejectsCorruptedFiles) {
+	std::vector<uint8_t> data = readFixture("environment.lnk");
+
+	auto rejects = [&](const std::function<void(std::vector<uint8_t>&)>& corrupt) {
+		std::vector<uint8_t> copy = data;
+		corrupt(copy);
+		return !parseCopy(copy, copy.size());
+	};
+
+	IMS_CHECK(!rejects([](std::vector<uint8_t>&) {}));
+	IMS_CHECK(rejects([](std::vector<uint8_t>& copy) { writeU32(copy, 0, 0x4D); }));  // Header size
+	IMS_CHECK(rejects([](std::vector<uint8_t>& copy) { copy[0x04] ^= 1; }));          // Class id
+	IMS_CHECK(rejects([](std::vector<uint8_t>& copy) { writeU32(copy, 0x4C, 0x10); })); // LinkInfo smaller than its header
+	IMS_CHECK(rejects([](std::vector<uint8_t>& copy) { writeU32(copy, 0x4C, (uint32_t)copy.size()); })); // LinkInfo past the end
+
+	// A string count running past the end
+	std::vector<uint8_t> relative = readFixture("relative.lnk");
+	relative[0x4C] = 0xFF;
+	relative[0x4D] = 0xFF;
+	IMS_CHECK(!parseCopy(relative, relative.size()));
+
+	// An item id list size running past the end
+	std::vector<uint8_t> idlist = readFixture("idlist.lnk");
+	idlist[0x4C] = 0xF0;
+	idlist[0x4D] = 0xFF;
+	IMS_CHECK(!parseCopy(idlist, idlist.size()));
+
+	// Every byte of every fixture flipped, one at a time: whatever comes out, nothing is read out of bounds
+	size_t parsed = 0, mutations = 0;
+	for (const char* name : kFixtures) {
+		std::vector<uint8_t> fixture = readFixture(name);
+		for (size_t i = 0; i < fixture.size(); i++, mutations++) {
+			fixture[i] ^= 0xFF;
+			if (parseCopy(fixture, fixture.size())) parsed++;
+			fixture[i] ^= 0xFF;
+		}
+	}
+	IMS_CHECK(parsed < mutations);
+}
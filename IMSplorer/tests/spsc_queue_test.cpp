@@ -0,0 +1,89 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "spsc_queue.h"
+
+using namespace IMS;
+
+IMS_TEST(SpscQueueFillsToCapacityAndWrapsAround) {
+	SpscQueue<int, 8> queue;
+	int value = 0;
+	IMS_CHECK(!queue.TryPop(value));
+
+	// Enough rounds for the indices to wrap the slots many times
+	int next = 0, expected = 0;
+	for (int round = 0; round < 100; round++) {
+		while (queue.TryPush(next)) next++;
+		IMS_CHECK(queue.SizeApprox() == queue.capacity);
+
+		int rejected = -1;
+		IMS_CHECK(!queue.TryPush(std::move(rejected)));
+		IMS_CHECK(rejected == -1); // Left untouched when full
+
+		// Drain a different amount every round so head and tail land on every slot
+		for (int i = 0; i <= round % 8; i++) {
+			IMS_CHECK(queue.TryPop(value));
+			IMS_CHECK(value == expected++);
+		}
+	}
+
+	while (queue.TryPop(value))
+		IMS_CHECK(value == expected++);
+	IMS_CHECK(expected == next);
+	IMS_CHECK(queue.SizeApprox() == 0);
+}
+
+IMS_TEST(SpscQueueHandsOverEveryValueInOrderAcrossThreads) {
+	static constexpr uint64_t count = 2'000'000;
+	SpscQueue<uint64_t, 64> queue; // Small, so both sides keep hitting full and empty
+
+	std::jthread producer([&]() {
+		for (uint64_t i = 1; i <= count; i++) {
+			while (!queue.TryPush(i))
+				std::this_thread::yield();
+		}
+	});
+
+	uint64_t expected = 1, outOfOrder = 0, value = 0;
+	while (expected <= count) {
+		if (!queue.TryPop(value)) {
+			std::this_thread::yield();
+			continue;
+		}
+		if (value != expected) outOfOrder++;
+		expected = value + 1;
+	}
+	producer.join();
+
+	IMS_CHECK(outOfOrder == 0);
+	IMS_CHECK(!queue.TryPop(value));
+}
+
+IMS_TEST(SpscQueueMovesOwningValuesAcrossThreads) {
+	static constexpr size_t count = 200'000;
+	SpscQueue<std::string, 16> queue;
+
+	// Long enough to live on the heap, a torn handoff would show up as a garbled string
+	std::jthread producer([&]() {
+		for (size_t i = 0; i < count; i++) {
+			std::string value = fmt::format("message {:08} with a payload past the small string buffer", i);
+			while (!queue.TryPush(std::move(value)))
+				std::this_thread::yield();
+		}
+	});
+
+	size_t received = 0, garbled = 0;
+	std::string value;
+	while (received < count) {
+		if (!queue.TryPop(value)) {
+			std::this_thread::yield();
+			continue;
+		}
+		if (value != fmt::format("message {:08} with a payload past the small string buffer", received)) garbled++;
+		received++;
+	}
+	producer.join();
+
+	IMS_CHECK(garbled == 0);
+}
@@ -0,0 +1,110 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "startup.h"
+
+using namespace IMS;
+
+namespace {
+	using Affinity = StartupGraph::Affinity;
+	using Status = StartupGraph::Status;
+
+	std::function<bool()> sleepFor(int milliseconds) {
+		return [milliseconds]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+			return true;
+		};
+	}
+
+	double end(const StartupGraph::Timing& timing) {
+		return timing.start + timing.duration;
+	}
+} // namespace
+
+IMS_TEST(StartupGraphRunsTasksAfterTheirDependencies) {
+	StartupGraph graph;
+	std::mutex mutex;
+	std::vector<std::string> order;
+	auto record = [&](std::string name) {
+		return [&, name]() {
+			std::lock_guard lock(mutex);
+			order.push_back(name);
+			return true;
+		};
+	};
+
+	auto a = graph.Add("a", record("a"));
+	auto b = graph.Add("b", record("b"), { a });
+	auto c = graph.Add("c", record("c"), { a }, Affinity::Main);
+	auto d = graph.Add("d", record("d"), { b, c, StartupGraph::kNone });
+	IMS_CHECK(graph.Size() == 4);
+	IMS_CHECK(graph.Run(2));
+
+	auto position = [&](std::string_view name) { return std::find(order.begin(), order.end(), name) - order.begin(); };
+	IMS_CHECK(order.size() == 4);
+	IMS_CHECK(position("a") < position("b") && position("a") < position("c"));
+	IMS_CHECK(position("d") == 3);
+	for (auto id : { a, b, c, d })
+		IMS_CHECK(graph.TaskStatus(id) == Status::Done);
+	IMS_CHECK(graph.TaskTiming(c).thread == 0);
+}
+
+IMS_TEST(StartupGraphSkipsWhatDependsOnAFailure) {
+	StartupGraph graph;
+	bool ranAfter = false;
+	auto fine = graph.Add("Fine", sleepFor(1));
+	auto broken = graph.Add("Failing", []() { return false; });
+	auto skipped = graph.Add("After failing", [&]() { ranAfter = true; return true; }, { fine, broken });
+	auto transitive = graph.Add("After skipped", [&]() { ranAfter = true; return true; }, { skipped }, Affinity::Main);
+	auto unrelated = graph.Add("Unrelated", sleepFor(1), { fine }, Affinity::Main);
+
+	IMS_CHECK(!graph.Run(2));
+	IMS_CHECK(!ranAfter);
+	IMS_CHECK(graph.TaskStatus(fine) == Status::Done);
+	IMS_CHECK(graph.TaskStatus(broken) == Status::Failed);
+	IMS_CHECK(graph.TaskStatus(skipped) == Status::Skipped);
+	IMS_CHECK(graph.TaskStatus(transitive) == Status::Skipped);
+	IMS_CHECK(graph.TaskStatus(unrelated) == Status::Done);
+}
+
+IMS_TEST(StartupGraphOverlapsWorkersWithTheMainThread) {
+	// Shaped like the real startup: the window and device on the main thread, fonts and the index on workers
+	StartupGraph graph;
+	std::atomic<bool> windowFirst = true;
+	auto window = graph.Add("Window", sleepFor(5), {}, Affinity::Main);
+	auto device = graph.Add("Device", sleepFor(40), { window }, Affinity::Main);
+	auto fonts = graph.Add("Fonts", sleepFor(30));
+	auto index = graph.Add("Index", sleepFor(30));
+	graph.Add("Enumeration", [&]() { windowFirst = graph.TaskStatus(window) == Status::Done; return true; }, { window });
+	auto ui = graph.Add("UI", sleepFor(1), { device, fonts }, Affinity::Main);
+
+	auto start = std::chrono::steady_clock::now();
+	IMS_CHECK(graph.Run(3));
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	IMS_CHECK(windowFirst);
+	IMS_CHECK(graph.TaskTiming(window).thread == 0 && graph.TaskTiming(device).thread == 0 && graph.TaskTiming(ui).thread == 0);
+	IMS_CHECK(graph.TaskTiming(fonts).thread != 0 && graph.TaskTiming(index).thread != 0);
+	IMS_CHECK(graph.TaskTiming(ui).start >= end(graph.TaskTiming(fonts)));
+	IMS_CHECK(graph.TaskTiming(ui).start >= end(graph.TaskTiming(device)));
+
+	// 106 ms of work, 46 on the main thread. Loose enough for a loaded machine, still short of running it all in turn.
+	IMS_CHECK(graph.TaskTiming(fonts).start < end(graph.TaskTiming(device)));
+	IMS_CHECK(elapsed < 100);
+}
+
+IMS_TEST(StartupGraphRunsInlineWithoutWorkers) {
+	StartupGraph graph;
+	auto any = graph.Add("Any", sleepFor(1));
+	auto main = graph.Add("Main", sleepFor(1), { any }, Affinity::Main);
+	auto broken = graph.Add("Failing", []() { return false; }, { main });
+	auto skipped = graph.Add("After failing", sleepFor(1), { broken });
+
+	IMS_CHECK(!graph.Run(0));
+	for (auto id : { any, main, broken, skipped })
+		IMS_CHECK(graph.TaskTiming(id).thread == 0);
+	IMS_CHECK(graph.TaskStatus(any) == Status::Done && graph.TaskStatus(main) == Status::Done);
+	IMS_CHECK(graph.TaskStatus(broken) == Status::Failed && graph.TaskStatus(skipped) == Status::Skipped);
+	IMS_CHECK(graph.TaskTiming(main).start >= end(graph.TaskTiming(any)));
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "pch.h"
+
+// Where the fixtures are, the build points it at tests/data in the source tree
+#ifndef IMS_TEST_DATA_DIR
+#define IMS_TEST_DATA_DIR "tests/data"
+#endif
+
+namespace IMS::Test {
+	using Function = void (*)();
+
+	/// <summary>
+	/// Add a test to the run, see IMS_TEST
+	/// </summary>
+	bool Register(const char* name, Function function);
+
+	/// <summary>
+	/// Mark the running test as failed and log where, the test keeps going
+	/// </summary>
+	void Fail(const char* file, int line, const char* expression);
+
+	/// <summary>
+	/// A fixture file under tests/data
+	/// </summary>
+	inline std::filesystem::path DataPath(std::string_view name) {
+		return std::filesystem::path(IMS_TEST_DATA_DIR) / name;
+	}
+
+	/// <summary>
+	/// A fresh directory under the temp folder, removed again with the object
+	/// </summary>
+	struct TempDirectory {
+		explicit TempDirectory(std::string_view name) : path(std::filesystem::temp_directory_path() / name) {
+			std::error_code ec;
+			std::filesystem::remove_all(this->path, ec);
+			std::filesystem::create_directories(this->path, ec);
+		}
+
+		~TempDirectory() {
+			std::error_code ec;
+			std::filesystem::remove_all(this->path, ec);
+		}
+
+		std::filesystem::path path;
+	};
+} // namespace IMS::Test
+
+// Define a test, registered before main runs
+#define IMS_TEST(name) \
+	static void name(); \
+	static const bool name##Registered = IMS::Test::Register(#name, name); \
+	static void name()
+
+#define IMS_CHECK(expression) \
+	do { \
+		if (!(expression)) IMS::Test::Fail(__FILE__, __LINE__, #expression); \
+	} while (0)
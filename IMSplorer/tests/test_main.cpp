@@ -0,0 +1,64 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "allocation_counters.h"
+
+namespace {
+	struct Registered {
+		const char* name;
+		IMS::Test::Function function;
+	};
+
+	std::vector<Registered>& registry() {
+		// Filled in by static initializers, so it can't be a plain global
+		static std::vector<Registered> tests;
+		return tests;
+	}
+
+	size_t failures = 0;
+} // namespace
+
+bool IMS::Test::Register(const char* name, Function function) {
+	registry().push_back({ name, function });
+	return true;
+}
+
+void IMS::Test::Fail(const char* file, int line, const char* expression) {
+	spdlog::error("{}:{}: check failed: {}", file, line, expression);
+	failures++;
+}
+
+/// <summary>
+/// Runs every test, or the ones whose name contains the first argument. Non-zero if any check failed.
+/// </summary>
+int main(int argc, char** argv) {
+	auto logger = spdlog::stdout_color_mt("console");
+	logger->set_pattern("[%H:%M:%S] [%^%l%$] %v");
+	logger->set_level(spdlog::level::warn);
+	spdlog::set_default_logger(logger);
+
+	// Before anything is allocated through ImGui, the allocation tests read the counters
+	IMS::CountImGuiAllocations();
+
+	std::string_view filter = argc > 1 ? argv[1] : "";
+
+	std::vector<Registered> tests = registry();
+	std::sort(tests.begin(), tests.end(), [](const Registered& a, const Registered& b) { return std::string_view(a.name) < b.name; });
+
+	size_t run = 0, failed = 0;
+	for (const Registered& test : tests) {
+		if (std::string_view(test.name).find(filter) == std::string_view::npos) continue;
+
+		size_t before = failures;
+		test.function();
+		run++;
+
+		bool passed = failures == before;
+		if (!passed) failed++;
+		fmt::print("[{}] {}\n", passed ? " OK " : "FAIL", test.name);
+	}
+
+	fmt::print("{} of {} tests passed\n", run - failed, run);
+	return failed == 0 && run > 0 ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "hotkeys.h"
+#include "trace.h"
+
+using namespace IMS;
+
+namespace {
+	/// <summary>
+	/// An event whose every field comes from i, so one read back from the wrong place shows
+	/// </summary>
+	TraceEvent eventAt(uint64_t i) {
+		TraceEvent event;
+		event.time = (int64_t)i * 1000 + 7;
+		event.handle = 0x10000 + i;
+		event.code = (uint16_t)(i * 3);
+		event.x = (int16_t)(i % 2560);
+		event.y = (int16_t)-(int64_t)(i % 1440);
+		event.kind = (TraceEventKind)(i % ((size_t)TraceEventKind::Frame + 1));
+		event.down = (uint8_t)(i % 2);
+		return event;
+	}
+
+	bool same(const TraceEvent& a, const TraceEvent& b) {
+		return a.time == b.time && a.handle == b.handle && a.code == b.code && a.x == b.x && a.y == b.y && a.kind == b.kind && a.down == b.down;
+	}
+
+	/// <summary>
+	/// Write `count` events with eventAt
+	/// </summary>
+	bool writeTrace(const std::filesystem::path& path, uint64_t count) {
+		TraceWriter writer;
+		if (!writer.Open(path)) return false;
+		for (uint64_t i = 0; i < count; i++)
+			writer.Write(eventAt(i));
+		return writer.Close();
+	}
+
+	std::string readFile(const std::filesystem::path& path) {
+		std::ifstream file(path, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void writeFile(const std::filesystem::path& path, std::string_view contents) {
+		std::ofstream(path, std::ios::binary | std::ios::trunc).write(contents.data(), (std::streamsize)contents.size());
+	}
+
+	/// <summary>
+	/// The (key, down) of every Key event in a trace
+	/// </summary>
+	std::vector<std::pair<uint16_t, bool>> keys(const std::vector<TraceEvent>& events) {
+		std::vector<std::pair<uint16_t, bool>> result;
+		for (const TraceEvent& event : events) {
+			if (event.kind == TraceEventKind::Key)
+				result.emplace_back(event.code, event.down != 0);
+		}
+		return result;
+	}
+} // namespace
+
+IMS_TEST(TraceReadsBackWhatWasWritten) {
+	Test::TempDirectory temp("imsplorer-test-trace");
+	std::filesystem::path path = temp.path / "session.imstrace";
+
+	// Several buffers' worth, the last one partly filled
+	static constexpr uint64_t count = 2500;
+	{
+		TraceWriter writer;
+		IMS_CHECK(!writer.IsOpen() && !writer.Close());
+		writer.Write(eventAt(0)); // Nowhere to go
+
+		IMS_CHECK(writer.Open(path) && writer.IsOpen());
+		for (uint64_t i = 0; i < count; i++)
+			writer.Write(eventAt(i));
+		IMS_CHECK(writer.Events() == count);
+
+		// Flushed whole buffers are on disk before the writer closes
+		IMS_CHECK(writer.Flush());
+		std::vector<TraceEvent> flushed;
+		IMS_CHECK(LoadTrace(path, flushed) && flushed.size() == count);
+	}
+
+	std::error_code ec;
+	IMS_CHECK(std::filesystem::file_size(path, ec) == sizeof(TraceFileHeader) + count * sizeof(TraceEvent));
+
+	std::vector<TraceEvent> events;
+	IMS_CHECK(LoadTrace(path, events));
+	IMS_CHECK(events.size() == count);
+
+	bool ordered = events.size() == count;
+	for (uint64_t i = 0; ordered && i < count; i++)
+		ordered = same(events[i], eventAt(i));
+	IMS_CHECK(ordered);
+
+	// Reopening starts over
+	IMS_CHECK(writeTrace(path, 3));
+	IMS_CHECK(LoadTrace(path, events) && events.size() == 3 && same(events[2], eventAt(2)));
+
+	// Just the header
+	IMS_CHECK(writeTrace(path, 0));
+	IMS_CHECK(LoadTrace(path, events) && events.empty());
+}
+
+IMS_TEST(TraceDropsARecordCutShort) {
+	Test::TempDirectory temp("imsplorer-test-trace-truncated");
+	std::filesystem::path path = temp.path / "session.imstrace";
+	IMS_CHECK(writeTrace(path, 10));
+	std::string whole = readFile(path);
+
+	// The recording died partway through writing the last record, every cut point
+	std::vector<TraceEvent> events;
+	bool dropped = true;
+	for (size_t cut = 1; cut < sizeof(TraceEvent); cut++) {
+		writeFile(path, std::string_view(whole).substr(0, whole.size() - cut));
+		dropped = dropped && LoadTrace(path, events) && events.size() == 9 && same(events.back(), eventAt(8));
+	}
+	IMS_CHECK(dropped);
+
+	// Not even a whole header
+	writeFile(path, std::string_view(whole).substr(0, sizeof(TraceFileHeader) - 1));
+	IMS_CHECK(!LoadTrace(path, events) && events.empty());
+	writeFile(path, "");
+	IMS_CHECK(!LoadTrace(path, events));
+	IMS_CHECK(!LoadTrace(temp.path / "missing.imstrace", events));
+}
+
+IMS_TEST(TraceRejectsAForeignHeader) {
+	Test::TempDirectory temp("imsplorer-test-trace-header");
+	std::filesystem::path path = temp.path / "session.imstrace";
+	IMS_CHECK(writeTrace(path, 4));
+	std::string whole = readFile(path);
+
+	TraceFileHeader valid;
+	std::memcpy(&valid, whole.data(), sizeof(valid));
+	IMS_CHECK(std::memcmp(valid.magic, TraceFileHeader::kMagic, sizeof(valid.magic)) == 0);
+	IMS_CHECK(valid.version == TraceFileHeader::kVersion && valid.headerSize == sizeof(TraceFileHeader) && valid.eventSize == sizeof(TraceEvent));
+
+	auto load = [&](const TraceFileHeader& header, std::string_view rest, std::vector<TraceEvent>& events) {
+		std::string contents((const char*)&header, sizeof(header));
+		contents.append(rest);
+		writeFile(path, contents);
+		return LoadTrace(path, events);
+	};
+	std::string_view records = std::string_view(whole).substr(sizeof(TraceFileHeader));
+
+	std::vector<TraceEvent> events;
+	IMS_CHECK(load(valid, records, events) && events.size() == 4);
+
+	TraceFileHeader magic = valid;
+	magic.magic[7] = 'X';
+	IMS_CHECK(!load(magic, records, events) && events.empty());
+
+	TraceFileHeader version = valid;
+	version.version++;
+	IMS_CHECK(!load(version, records, events));
+
+	TraceFileHeader eventSize = valid;
+	eventSize.eventSize = sizeof(TraceEvent) + 8;
+	IMS_CHECK(!load(eventSize, records, events));
+
+	TraceFileHeader small = valid;
+	small.headerSize = sizeof(TraceFileHeader) - 4;
+	IMS_CHECK(!load(small, records, events));
+
+	TraceFileHeader past = valid;
+	past.headerSize = (uint32_t)whole.size() + 1;
+	IMS_CHECK(!load(past, records, events));
+
+	// A longer header from a later writer is skipped over, the records follow it
+	TraceFileHeader longer = valid;
+	longer.headerSize = sizeof(TraceFileHeader) + 8;
+	IMS_CHECK(load(longer, std::string(8, '\0') + std::string(records), events) && events.size() == 4 && same(events[3], eventAt(3)));
+}
+
+IMS_TEST(TraceRecorderKeepsOnlyShortcutKeys) {
+	Test::TempDirectory temp("imsplorer-test-trace-keys");
+	std::filesystem::path path = temp.path / "session.imstrace";
+	{
+		TraceRecorder recorder;
+		IMS_CHECK(recorder.Open(path));
+
+		// Typing, with and without Shift, isn't recorded, only Shift itself
+		recorder.Key('H', true);
+		recorder.Key('H', false);
+		recorder.Key(Keys::LShift, true);
+		recorder.Key('I', true);
+		recorder.Key('I', false);
+		recorder.Key(Keys::LShift, false);
+
+		// Ctrl+C, released in either order
+		recorder.Key(Keys::LControl, true);
+		recorder.Key('C', true);
+		recorder.Key(Keys::LControl, false);
+		recorder.Key('C', false);
+
+		// Win+R
+		recorder.Key(Keys::LWin, true);
+		recorder.Key('R', true);
+		recorder.Key('R', false);
+		recorder.Key(Keys::LWin, false);
+
+		// A key pressed before the modifier isn't part of a shortcut, so neither is its release
+		recorder.Key('X', true);
+		recorder.Key(Keys::RAlt, true);
+		recorder.Key('X', false);
+		recorder.Key(Keys::RAlt, false);
+
+		// Nor is anything after the modifiers are up again
+		recorder.Key('Z', true);
+		recorder.Key('Z', false);
+
+		// Exes are ids in order of appearance, names and titles only lengths
+		recorder.Window(1, "C:\\Apps\\a.exe", "a.exe", "Untitled");
+		recorder.Window(2, "C:\\Apps\\b.exe", "b.exe", "A longer title");
+		recorder.Window(3, "C:\\Apps\\a.exe", "a.exe", "");
+		recorder.Title(1, "Saved");
+		recorder.Frame();
+		IMS_CHECK(recorder.Close());
+	}
+
+	std::vector<TraceEvent> events;
+	IMS_CHECK(LoadTrace(path, events));
+	IMS_CHECK(keys(events) == (std::vector<std::pair<uint16_t, bool>>{
+		{ Keys::LShift, true }, { Keys::LShift, false },
+		{ Keys::LControl, true }, { 'C', true }, { Keys::LControl, false }, { 'C', false },
+		{ Keys::LWin, true }, { 'R', true }, { 'R', false }, { Keys::LWin, false },
+		{ Keys::RAlt, true }, { Keys::RAlt, false },
+	}));
+
+	std::vector<TraceEvent> windows;
+	std::copy_if(events.begin(), events.end(), std::back_inserter(windows), [](const TraceEvent& event) { return event.kind == TraceEventKind::Window; });
+	IMS_CHECK(windows.size() == 3);
+	if (windows.size() == 3) {
+		IMS_CHECK(windows[0].handle == 1 && windows[0].code == 8 && windows[0].x == 5 && windows[0].y == 0);
+		IMS_CHECK(windows[1].handle == 2 && windows[1].code == 14 && windows[1].y == 1);
+		IMS_CHECK(windows[2].handle == 3 && windows[2].code == 0 && windows[2].y == 0);
+	}
+	IMS_CHECK(events.size() >= 2 && events[events.size() - 2].kind == TraceEventKind::Title && events[events.size() - 2].code == 5);
+	IMS_CHECK(!events.empty() && events.back().kind == TraceEventKind::Frame);
+	IMS_CHECK(std::is_sorted(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) { return a.time < b.time; }));
+}
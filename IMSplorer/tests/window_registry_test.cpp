@@ -0,0 +1,138 @@
+#include "pch.h"
+
+#include "test.h"
+
+#include "window_registry.h"
+
+using namespace IMS;
+
+namespace {
+	std::vector<std::pair<WindowHandle, int>> contents(const WindowRegistry<int>& registry) {
+		std::vector<std::pair<WindowHandle, int>> out;
+		for (const auto& record : registry)
+			out.emplace_back(record.handle, record.value);
+		return out;
+	}
+} // namespace
+
+IMS_TEST(WindowRegistryReusedHandleStartsFresh) {
+	WindowRegistry<int> registry;
+	registry.Insert(1, 10);
+	registry.Insert(2, 20);
+	registry.Insert(3, 30);
+	registry.Activate(2);
+
+	// Windows reuse handles once destroyed, the new window must not inherit the old one's value, place or focus
+	IMS_CHECK(registry.Erase(2));
+	IMS_CHECK(!registry.Contains(2));
+	IMS_CHECK(registry.Focused() == 0);
+
+	IMS_CHECK(registry.Insert(2, 21) == 21);
+	IMS_CHECK(!registry.IsFocused(2));
+	IMS_CHECK((contents(registry) == std::vector<std::pair<WindowHandle, int>>{ { 1, 10 }, { 3, 30 }, { 2, 21 } }));
+
+	// Inserting a live handle again returns the existing record untouched
+	IMS_CHECK(registry.Insert(2, 99) == 21);
+	IMS_CHECK(registry.Size() == 3);
+	IMS_CHECK(!registry.Erase(4));
+}
+
+IMS_TEST(WindowRegistryFreedSlotIsntFocusedByItsNextOwner) {
+	WindowRegistry<int> registry;
+	registry.Insert(1, 10);
+	registry.Insert(2, 20);
+	registry.Activate(2);
+
+	// The last slot is popped right away, the next insert lands in the same slot
+	registry.Erase(2);
+	registry.Insert(7, 70);
+	IMS_CHECK(registry.Focused() == 0);
+	IMS_CHECK(!registry.IsFocused(7));
+
+	// Same with a tombstone in the middle squeezed out by a compaction
+	registry.Insert(8, 80);
+	registry.Activate(1);
+	registry.Erase(1);
+	registry.Compact();
+	registry.Insert(9, 90);
+	IMS_CHECK(registry.Focused() == 0);
+	IMS_CHECK((contents(registry) == std::vector<std::pair<WindowHandle, int>>{ { 7, 70 }, { 8, 80 }, { 9, 90 } }));
+}
+
+IMS_TEST(WindowRegistryFocusFollowsItsWindowThroughCompactionMoveAndRekey) {
+	WindowRegistry<int> registry;
+	for (WindowHandle handle = 1; handle <= 100; handle++)
+		registry.Insert(handle, (int)handle);
+	registry.Activate(90);
+
+	// Enough tombstones in front of the focused window to trigger a compaction
+	for (WindowHandle handle = 1; handle <= 60; handle++)
+		registry.Erase(handle);
+	IMS_CHECK(registry.Size() == 40);
+	IMS_CHECK(registry.Focused() == 90);
+	IMS_CHECK(*registry.Find(90) == 90);
+
+	IMS_CHECK(registry.Move(90, 0));
+	IMS_CHECK(registry.Focused() == 90);
+	IMS_CHECK(registry.begin()->handle == 90);
+
+	IMS_CHECK(registry.Rekey(90, 1000));
+	IMS_CHECK(registry.IsFocused(1000));
+	IMS_CHECK(!registry.Contains(90));
+	IMS_CHECK(!registry.Rekey(61, 1000)); // Taken
+	IMS_CHECK(*registry.Find(1000) == 90);
+}
+
+IMS_TEST(WindowRegistryMatchesAReferenceUnderRandomChurn) {
+	WindowRegistry<int> registry;
+	std::vector<std::pair<WindowHandle, int>> reference;
+	WindowHandle focused = 0;
+
+	// Few distinct handles, so they get destroyed and reused all the time
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+	auto next = [&](uint64_t bound) {
+		state ^= state >> 12; state ^= state << 25; state ^= state >> 27;
+		return (state * 0x2545F4914F6CDD1Dull) % bound;
+	};
+
+	size_t mismatches = 0;
+	for (int step = 0; step < 200'000; step++) {
+		WindowHandle handle = 1 + next(96);
+		auto it = std::find_if(reference.begin(), reference.end(), [&](const auto& entry) { return entry.first == handle; });
+
+		switch (next(6)) {
+		case 0:
+		case 1:
+			registry.Insert(handle, step);
+			if (it == reference.end()) reference.emplace_back(handle, step);
+			break;
+		case 2:
+		case 3:
+			registry.Erase(handle);
+			if (it != reference.end()) {
+				if (focused == handle) focused = 0;
+				reference.erase(it);
+			}
+			break;
+		case 4:
+			registry.Activate(handle);
+			focused = it != reference.end() ? handle : 0;
+			break;
+		case 5: {
+			if (it == reference.end()) break;
+			size_t position = next(reference.size());
+			registry.Move(handle, position);
+			auto entry = *it;
+			reference.erase(it);
+			reference.insert(reference.begin() + position, entry);
+			break;
+		}
+		}
+
+		if (registry.Size() != reference.size() || registry.Focused() != focused) mismatches++;
+		if (step % 97 == 0 && contents(registry) != reference) mismatches++;
+	}
+
+	IMS_CHECK(mismatches == 0);
+	IMS_CHECK(contents(registry) == reference);
+}